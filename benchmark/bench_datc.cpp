@@ -0,0 +1,119 @@
+/**
+ * @file bench_datc.cpp
+ * @brief DatcCtrl against an in-memory modbus transport: command dispatch and status decoding.
+ * @version 1.0
+ * @date 2024-04-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "datc_ctrl.hpp"
+#include "perf_counters.hpp"
+
+namespace {
+
+const int kBatch = 1000;
+
+// Keeps the last registers written and answers reads with a fixed status
+class MockTransport : public ModbusTransport {
+public:
+    bool writeRegisters(uint16_t, int, int nb, const uint16_t *data) override {
+        written.assign(data, data + nb);
+        return true;
+    }
+
+    bool readRegisters(uint16_t, int, int nb, uint16_t *data) override {
+        for (int i = 0; i < nb; i++) {
+            data[i] = (i < (int) status.size()) ? status[i] : 0;
+        }
+        return true;
+    }
+
+    vector<uint16_t> written;
+    vector<uint16_t> status = {0x0021, (uint16_t) -269, 350, 0, 990, 0, 0, 240};
+};
+
+} // namespace
+
+bool benchDatc(BenchmarkRunner &runner) {
+    MockTransport transport;
+    DatcCtrl datc;
+
+    datc.modbusInit(&transport, 1);
+
+    // The dispatch must put the command and its values into the command registers
+    if (!datc.motorPosCtrl(-1200, 500) ||
+        transport.written != vector<uint16_t>({(uint16_t) DATC_COMMAND::MOTOR_POSITION_CONTROL, (uint16_t) -1200, 500})) {
+        printf("datc: unexpected registers written for a position command\n");
+        return false;
+    }
+
+    if (!datc.readDatcData() || datc.getDatcStatus().finger_pos != 990 || !datc.getDatcStatus().enable) {
+        printf("datc: status decoded from the registers does not match\n");
+        return false;
+    }
+
+    // Both transactions are counted, in the first bucket of a transport that answers at once
+    ModbusStats stats = datc.getModbusStats();
+
+    if (stats.round_trip.count != 2 || stats.errors != 0) {
+        printf("datc: %llu transactions and %llu errors counted instead of 2 and 0\n",
+               (unsigned long long) stats.round_trip.count, (unsigned long long) stats.errors);
+        return false;
+    }
+
+    LatencyHistogram histogram;
+
+    for (uint64_t us : {10, 100, 100, 5000}) {
+        histogram.record(us);
+    }
+
+    LatencySnapshot snapshot = histogram.snapshot();
+
+    if (snapshot.percentileUs(0.5) != 128 || snapshot.percentileUs(0.99) != 8192 || snapshot.max_us != 5000) {
+        printf("datc: histogram percentiles do not match the samples\n");
+        return false;
+    }
+
+    runner.run("datc/command_no_value", [&] () {
+        for (int i = 0; i < kBatch; i++) {
+            datc.grpOpen();
+        }
+        return kBatch;
+    });
+
+    runner.run("datc/command_two_values", [&] () {
+        for (int i = 0; i < kBatch; i++) {
+            datc.motorPosCtrl(-1200, 500);
+        }
+        return kBatch;
+    });
+
+    runner.run("datc/read_status", [&] () {
+        for (int i = 0; i < kBatch; i++) {
+            datc.readDatcData();
+        }
+        return kBatch;
+    });
+
+    runner.run("datc/decode_status", [&] () {
+        DatcStatus status;
+        for (int i = 0; i < kBatch; i++) {
+            DatcCtrl::decodeDatcData(transport.status, status);
+            doNotOptimize(status.states);
+        }
+        return kBatch;
+    });
+
+    runner.run("datc/latency_record", [&] () {
+        for (int i = 0; i < kBatch; i++) {
+            histogram.record(i * 7);
+        }
+        return kBatch;
+    });
+
+    datc.modbusRelease();
+
+    return true;
+}
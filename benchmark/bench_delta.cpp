@@ -0,0 +1,306 @@
+/**
+ * @file bench_delta.cpp
+ * @brief Full against delta-encoded status frames on a grasp trace: bytes and encode time per frame,
+ * and the keyframes StatusBroadcaster sends to clients joining a delta stream.
+ * @version 1.0
+ * @date 2024-03-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "status_broadcaster.hpp"
+
+using namespace tcp_communication;
+
+namespace {
+
+const uint16_t kKeyframeInterval = 50;
+const uint16_t kJsonFields       = STATUS_FIELDS_DEFAULT | FIELD_SEQUENCE | FIELD_SLAVE;
+const uint16_t kBinaryFields     = STATUS_FIELDS_DEFAULT & ~FIELD_SEQUENCE;
+
+/**
+ * @brief 20 s of status at the 50 Hz poll rate, repeating hold / close / hold with force / open.
+ * @details Shaped after the gripper's behaviour (constant state words and voltage, a position
+ * ramp while moving, current noise in the last bit) until recorded sessions can be replayed.
+ */
+vector<StatusMessage> makeGraspTrace() {
+    vector<StatusMessage> trace;
+    uint32_t noise = 12345;
+
+    auto nextNoise = [&noise] () {
+        noise = noise * 1103515245 + 12345;
+        return (noise >> 16) & 0x7fff;
+    };
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t phase = i % 200;
+        StatusMessage status;
+
+        status.sequence = i;
+        status.slave    = 1;
+        status.voltage  = (nextNoise() % 25 == 0) ? 239 : 240;
+
+        if (phase < 50) {            // open, idle
+            status.states     = 0x0001;
+            status.finger_pos = 0;
+        } else if (phase < 80) {     // closing
+            status.states     = 0x0003;
+            status.motor_vel  = 120;
+            status.motor_cur  = 80 + nextNoise() % 3;
+            status.finger_pos = (phase - 50) * 33;
+        } else if (phase < 170) {    // holding with force
+            status.states     = 0x0021;
+            status.motor_cur  = 350 + ((nextNoise() % 4 == 0) ? 1 : 0);
+            status.finger_pos = 990;
+        } else {                     // opening
+            status.states     = 0x0003;
+            status.motor_vel  = -120;
+            status.motor_cur  = -80 - (int16_t) (nextNoise() % 3);
+            status.finger_pos = (200 - phase) * 33;
+        }
+        status.motor_pos = (int16_t) (-1259 + status.finger_pos);
+
+        trace.push_back(status);
+    }
+
+    return trace;
+}
+
+/**
+ * @brief Same keyframe and change detection as StatusBroadcaster for a single group.
+ * @return false if the status did not change, nothing to send
+ */
+template<typename Encode>
+bool encodeDelta(const StatusMessage &status, uint16_t fields, StatusMessage &last, uint32_t &delta_sequence,
+                 uint16_t &since_keyframe, Encode encode) {
+    bool keyframe = delta_sequence == 0 || ++since_keyframe >= kKeyframeInterval;
+
+    if (keyframe) {
+        since_keyframe = 0;
+    } else {
+        uint16_t changed = changedStatusFields(last, status, fields);
+
+        if (changed == 0) {
+            return false;
+        }
+        fields = changed | (fields & FIELD_SLAVE);
+    }
+
+    encode(status, fields, delta_sequence++, keyframe);
+    last = status;
+
+    return true;
+}
+
+// Applying the binary deltas must rebuild every status of the trace
+bool checkDeltaRoundTrip(const vector<StatusMessage> &trace) {
+    StatusMessage last, decoded;
+    uint32_t delta_sequence = 0, expected_sequence = 0;
+    uint16_t since_keyframe = 0;
+    string frame;
+
+    for (const StatusMessage &status : trace) {
+        bool sent = encodeDelta(status, kBinaryFields, last, delta_sequence, since_keyframe,
+                                [&frame] (const StatusMessage &s, uint16_t f, uint32_t seq, bool key) {
+                                    binary_protocol::encodeStatusDelta(s, f, seq, key, frame);
+                                });
+
+        if (sent) {
+            uint32_t sequence;
+            bool keyframe;
+
+            if (!binary_protocol::decodeStatusDelta(frame.data(), frame.data() + frame.size(), decoded, sequence, keyframe) ||
+                sequence != expected_sequence++) {
+                printf("Status delta frame %u could not be decoded\n", status.sequence);
+                return false;
+            }
+        }
+
+        decoded.sequence = status.sequence;
+
+        if (changedStatusFields(decoded, status, kBinaryFields) != 0 || decoded.slave != status.slave) {
+            printf("Status delta mismatch at %u\n", status.sequence);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Keyframe flags of the delta frames waiting for a client, by slave
+bool popKeyframes(DatcMessageHandler &handler, uint32_t id, vector<pair<uint16_t, bool>> &keyframes) {
+    Frame frame;
+    keyframes.clear();
+
+    while (handler.tryPopFromClientQueue(id, frame)) {
+        StatusMessage status;
+        uint32_t sequence;
+        bool keyframe;
+
+        if (!binary_protocol::decodeStatusDelta(frame->data(), frame->data() + frame->size(), status, sequence, keyframe)) {
+            return false;
+        }
+        keyframes.emplace_back(status.slave, keyframe);
+    }
+    return true;
+}
+
+/**
+ * @brief Two polled slaves, a client joining a delta stream mid-stream must get a keyframe of
+ * each slave, while a client of another delta stream goes on with deltas.
+ */
+bool checkBroadcasterJoin() {
+    DatcMessageHandler handler;
+    StatusBroadcaster broadcaster(handler);
+
+    StreamConfig stream, other;
+    stream.format = other.format = WireFormat::BINARY;
+    stream.delta  = other.delta  = true;
+    other.keyframe_interval = 100;
+
+    const uint32_t kEarly = 1, kJoining = 2, kOther = 3;
+
+    for (uint32_t id : {kEarly, kJoining, kOther}) {
+        handler.createClientQueue(id);
+    }
+    handler.setClientStream(kEarly, stream);
+    handler.setClientStream(kOther, other);
+
+    uint64_t now_us = 1;
+
+    auto cycleFn([&] () {
+        for (uint16_t slave : {1, 2}) {
+            StatusMessage status;
+            status.slave      = slave;
+            status.finger_pos = (uint16_t) (now_us * 3 + slave);
+            broadcaster.publish(status, now_us);
+        }
+        now_us += 20000;
+    });
+
+    for (int i = 0; i < 5; i++) {
+        cycleFn();
+    }
+
+    // The joining client got full Json frames until now
+    vector<pair<uint16_t, bool>> keyframes;
+    Frame frame;
+
+    popKeyframes(handler, kEarly, keyframes);
+    popKeyframes(handler, kOther, keyframes);
+    while (handler.tryPopFromClientQueue(kJoining, frame)) {}
+
+    handler.setClientStream(kJoining, stream);
+    cycleFn();
+
+    const vector<pair<uint16_t, bool>> expected_join  = {{1, true}, {2, true}};
+    const vector<pair<uint16_t, bool>> expected_other = {{1, false}, {2, false}};
+
+    if (!popKeyframes(handler, kJoining, keyframes) || keyframes != expected_join) {
+        printf("delta: a client joining mid-stream did not get a keyframe of every slave\n");
+        return false;
+    }
+
+    if (!popKeyframes(handler, kOther, keyframes) || keyframes != expected_other) {
+        printf("delta: a client joining one stream resynchronized another\n");
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool benchDelta(BenchmarkRunner &runner) {
+    const vector<StatusMessage> trace = makeGraspTrace();
+
+    if (!checkDeltaRoundTrip(trace) || !checkBroadcasterJoin()) {
+        return false;
+    }
+
+    // Bandwidth
+    uint64_t json_full = 0, json_delta = 0, binary_full = 0, binary_delta = 0;
+    {
+        StatusMessage json_last, binary_last;
+        uint32_t json_sequence = 0, binary_sequence = 0;
+        uint16_t json_since = 0, binary_since = 0;
+        string frame;
+
+        for (const StatusMessage &status : trace) {
+            json_protocol::encodeStatus(status, frame, kJsonFields);
+            json_full += frame.size();
+
+            binary_protocol::encodeStatus(status, frame);
+            binary_full += frame.size();
+
+            encodeDelta(status, kJsonFields & ~FIELD_SEQUENCE, json_last, json_sequence, json_since,
+                        [&] (const StatusMessage &s, uint16_t f, uint32_t seq, bool key) {
+                            json_protocol::encodeStatusDelta(s, f, seq, key, frame);
+                            json_delta += frame.size();
+                        });
+
+            encodeDelta(status, kBinaryFields, binary_last, binary_sequence, binary_since,
+                        [&] (const StatusMessage &s, uint16_t f, uint32_t seq, bool key) {
+                            binary_protocol::encodeStatusDelta(s, f, seq, key, frame);
+                            binary_delta += frame.size();
+                        });
+        }
+    }
+
+    runner.report("delta/bytes_json_full", (double) json_full / trace.size(), "bytes/status");
+    runner.report("delta/bytes_json_delta", (double) json_delta / trace.size(), "bytes/status");
+    runner.report("delta/bytes_binary_full", (double) binary_full / trace.size(), "bytes/status");
+    runner.report("delta/bytes_binary_delta", (double) binary_delta / trace.size(), "bytes/status");
+
+    // Encoding time, per status of the trace (skipped deltas included)
+    runner.run("delta/status_encode_json_full", [&] () {
+        string frame;
+        for (const StatusMessage &status : trace) {
+            json_protocol::encodeStatus(status, frame, kJsonFields);
+            doNotOptimize(frame.data());
+        }
+        return trace.size();
+    });
+
+    runner.run("delta/status_encode_json_delta", [&] () {
+        StatusMessage last;
+        uint32_t sequence = 0;
+        uint16_t since_keyframe = 0;
+        string frame;
+        for (const StatusMessage &status : trace) {
+            encodeDelta(status, kJsonFields & ~FIELD_SEQUENCE, last, sequence, since_keyframe,
+                        [&frame] (const StatusMessage &s, uint16_t f, uint32_t seq, bool key) {
+                            json_protocol::encodeStatusDelta(s, f, seq, key, frame);
+                        });
+            doNotOptimize(frame.data());
+        }
+        return trace.size();
+    });
+
+    runner.run("delta/status_encode_binary_full", [&] () {
+        string frame;
+        for (const StatusMessage &status : trace) {
+            binary_protocol::encodeStatus(status, frame);
+            doNotOptimize(frame.data());
+        }
+        return trace.size();
+    });
+
+    runner.run("delta/status_encode_binary_delta", [&] () {
+        StatusMessage last;
+        uint32_t sequence = 0;
+        uint16_t since_keyframe = 0;
+        string frame;
+        for (const StatusMessage &status : trace) {
+            encodeDelta(status, kBinaryFields, last, sequence, since_keyframe,
+                        [&frame] (const StatusMessage &s, uint16_t f, uint32_t seq, bool key) {
+                            binary_protocol::encodeStatusDelta(s, f, seq, key, frame);
+                        });
+            doNotOptimize(frame.data());
+        }
+        return trace.size();
+    });
+
+    return true;
+}
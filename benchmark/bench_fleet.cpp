@@ -0,0 +1,112 @@
+/**
+ * @file bench_fleet.cpp
+ * @brief Fleet page frames of hundreds of grippers: cells diffed per frame, for mostly idle
+ * grippers and for every gripper moving.
+ * @version 1.0
+ * @date 2024-04-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "fleet_table.hpp"
+
+namespace {
+
+const int kBuses  = 8;
+const int kSlaves = 60;
+
+vector<SlaveRecord> makeFleet() {
+    vector<SlaveRecord> records;
+
+    for (int bus = 0; bus < kBuses; bus++) {
+        for (int slave = 1; slave <= kSlaves; slave++) {
+            SlaveRecord record;
+            record.bus   = "/dev/ttyUSB" + to_string(bus);
+            record.slave = slave;
+            record.has_status = true;
+            DatcCtrl::decodeDatcData({0x0021, 0, 120, 0, 500, 0, 0, 240}, record.status);
+            records.push_back(record);
+        }
+    }
+    return records;
+}
+
+// One poll cycle of every gripper, 'moving' of them change position
+void advanceFleet(vector<SlaveRecord> &records, size_t moving) {
+    for (size_t i = 0; i < records.size(); i++) {
+        records[i].reads += 10;
+
+        if (i < moving) {
+            vector<uint16_t> reg(records[i].status.registers, records[i].status.registers + kStatusRegNum);
+            reg[4] = (reg[4] + 3) % 1000;
+            DatcCtrl::decodeDatcData(reg, records[i].status);
+        }
+    }
+}
+
+} // namespace
+
+bool benchFleet(BenchmarkRunner &runner) {
+    vector<SlaveRecord> records = makeFleet();
+    vector<FleetCellRange> changed;
+    FleetTable table;
+
+    // The first frame builds the rows, the second starts the rates of every row
+    if (table.update(records, 0, changed) || table.getRowCount() != records.size()) {
+        printf("fleet: the first frame did not build the rows\n");
+        return false;
+    }
+
+    advanceFleet(records, 0);
+
+    if (!table.update(records, 0.2, changed) || changed.size() != records.size()) {
+        printf("fleet: %zu cell runs changed by the first rates instead of one per row\n", changed.size());
+        return false;
+    }
+
+    // Only the position of the moving ones changes, the rates stay
+    advanceFleet(records, 3);
+    table.update(records, 0.2, changed);
+
+    bool is_position_only = changed.size() == 3;
+
+    for (size_t i = 0; is_position_only && i < changed.size(); i++) {
+        is_position_only = changed[i].row == (int) i && changed[i].first_column == (int) FleetColumn::POSITION &&
+                           changed[i].last_column == (int) FleetColumn::POSITION;
+    }
+
+    if (!is_position_only) {
+        printf("fleet: %zu cell runs changed instead of the position of 3 rows\n", changed.size());
+        return false;
+    }
+
+    if (table.getCell(0, (int) FleetColumn::POSITION) != "50.3 %" ||
+        table.getCell(0, (int) FleetColumn::POLL_RATE) != "50.0 Hz") {
+        printf("fleet: cells do not show the records\n");
+        return false;
+    }
+
+    // A gripper more resets the rows
+    records.push_back(records.back());
+    records.back().slave = kSlaves + 1;
+
+    if (table.hasSameRows(records) || table.update(records, 0.2, changed) || !changed.empty()) {
+        printf("fleet: a new gripper did not reset the rows\n");
+        return false;
+    }
+    records.pop_back();
+    table.update(records, 0.2, changed);
+
+    // Per frame of the whole table
+    for (size_t moving : {(size_t) 0, records.size() / 20, records.size()}) {
+        runner.run("fleet/frame_" + to_string(records.size()) + "_rows_" + to_string(moving) + "_moving", [&] () {
+            advanceFleet(records, moving);
+            table.update(records, 0.2, changed);
+            doNotOptimize(changed.size());
+            return 1;
+        });
+    }
+
+    return true;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file bench_framing.cpp
+ * @brief Receive-side framing throughput on a 1 MB burst of pipelined commands.
+ * @version 1.0
+ * @date 2024-03-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "message_framer.hpp"
+
+#include <jsoncpp/json/json.h>
+
+using namespace tcp_communication;
+
+namespace {
+
+const size_t kBurstSize = 1024 * 1024;
+const size_t kReadSize  = 4096; /**< Bytes handed over per socket read */
+
+string makeBurst(bool length_prefixed) {
+    const string commands[] = {
+        "{\"command\":102}",
+        "{\"command\":104,\"value_1\":500}",
+        "{\"command\":5,\"value_1\":-1200,\"value_2\":500}",
+        "{\"command\":103}",
+    };
+
+    string burst;
+    for (size_t i = 0; burst.size() < kBurstSize; i++) {
+        const string &cmd = commands[i % 4];
+
+        if (length_prefixed) {
+            char prefix[MessageFramer::LENGTH_PREFIX_SIZE];
+            MessageFramer::writeLengthPrefix(cmd.size(), prefix);
+            burst.append(prefix, MessageFramer::LENGTH_PREFIX_SIZE);
+            burst += cmd;
+        } else {
+            burst += cmd + "\n";
+        }
+    }
+    return burst;
+}
+
+// Framing as done before the ring buffer: first '{' to first '}', new reader per message
+bool legacyParse(string &recevied, Json::Value &json) {
+    size_t index = recevied.find('{');
+    if (index == string::npos) {
+        recevied.clear();
+        return false;
+    }
+    recevied.erase(0, index);
+
+    index = recevied.find('}');
+    if (index == string::npos) {
+        return false;
+    }
+
+    string json_str = recevied.substr(0, index + 1);
+    recevied.erase(0, index + 1);
+
+    Json::Reader reader;
+    return reader.parse(json_str, json);
+}
+
+// Fed one byte at a time, the line end after the switch must not become part of the prefix
+bool checkFramingSwitch(const string &line_end, const string &message) {
+    char prefix[MessageFramer::LENGTH_PREFIX_SIZE];
+    MessageFramer::writeLengthPrefix(message.size(), prefix);
+
+    const string stream = "{\"framing\":\"length_prefixed\"}" + line_end +
+                          string(prefix, MessageFramer::LENGTH_PREFIX_SIZE) + message;
+
+    RingBuffer recevied;
+    MessageFramer framer;
+    const char *begin, *end;
+    vector<string> messages;
+
+    for (char c : stream) {
+        recevied.write(&c, 1);
+
+        while (framer.next(recevied, begin, end)) {
+            messages.emplace_back(begin, end);
+
+            if (messages.size() == 1) {
+                framer.setMode(FramingMode::LENGTH_PREFIXED);
+            }
+        }
+    }
+
+    return messages.size() == 2 && messages[1] == message && !framer.hasError();
+}
+
+} // namespace
+
+bool benchFraming(BenchmarkRunner &runner) {
+    // A 10 byte message has a prefix starting with '\n'
+    if (!checkFramingSwitch("\n", "{\"id\":123}") || !checkFramingSwitch("\r\n", "{\"id\":123}") ||
+        !checkFramingSwitch("", "{\"id\":1234}")) {
+        printf("framing: the message after switching to length prefixes was not framed\n");
+        return false;
+    }
+
+    // Garbage between objects is counted, whitespace is not
+    RingBuffer garbage;
+    MessageFramer framer;
+    const char *begin, *end;
+    const string text = " \nxy{\"command\":1}\n";
+
+    garbage.write(text.data(), text.size());
+
+    if (!framer.next(garbage, begin, end) || framer.takeSkipped() != 2) {
+        printf("framing: bytes outside of an object were not counted\n");
+        return false;
+    }
+
+    const string ndjson_burst = makeBurst(false);
+    const string prefix_burst = makeBurst(true);
+
+    runner.run("framing/legacy_find_brace_1MB", [&] () {
+        string recevied;
+        Json::Value json;
+        uint64_t messages = 0;
+
+        for (size_t offset = 0; offset < ndjson_burst.size(); offset += kReadSize) {
+            recevied += ndjson_burst.substr(offset, kReadSize);
+            while (legacyParse(recevied, json)) {
+                messages++;
+            }
+        }
+        return messages;
+    });
+
+    auto runFramer = [&] (const string &burst, FramingMode mode) {
+        RingBuffer recevied;
+        MessageFramer framer(mode);
+        Json::Reader reader;
+        Json::Value json;
+        const char *begin, *end;
+        uint64_t messages = 0;
+
+        for (size_t offset = 0; offset < burst.size(); offset += kReadSize) {
+            recevied.write(burst.data() + offset, min(kReadSize, burst.size() - offset));
+            while (framer.next(recevied, begin, end)) {
+                messages += reader.parse(begin, end, json, false);
+            }
+        }
+        return messages;
+    };
+
+    runner.run("framing/ring_newline_delimited_1MB", [&] () {
+        return runFramer(ndjson_burst, FramingMode::JSON_OBJECTS);
+    });
+
+    runner.run("framing/ring_length_prefixed_1MB", [&] () {
+        return runFramer(prefix_burst, FramingMode::LENGTH_PREFIXED);
+    });
+
+    return true;
+}
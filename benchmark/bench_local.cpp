@@ -0,0 +1,211 @@
+/**
+ * @file bench_local.cpp
+ * @brief Unix domain stream socket against loopback TCP, both served by TcpServer: command/ack
+ * round trip and status rate.
+ * Checks as well that the server replaces only a stale socket file and creates it with its mode.
+ * @version 1.0
+ * @date 2024-04-03
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "tcp_manager.hpp"
+
+#include <fstream>
+#include <thread>
+#include <boost/asio.hpp>
+#include <sys/stat.h>
+
+using namespace tcp_communication;
+
+namespace {
+
+const int kRoundTrips  = 200;
+const int kStatusBatch = 1000;
+const int kTcpPort     = 18432;
+
+// Stands in for the command thread and acks every command in the binary protocol
+void serveAcks(const atomic<bool> &flag_stop) {
+    DatcMessageManager &manager = DatcMessageManager::getInstance();
+    CommandRequest request;
+
+    while (!flag_stop) {
+        if (!manager.tryPopFromWokerQueue(request, std::chrono::milliseconds(10))) {
+            continue;
+        }
+
+        CommandAck ack;
+        ack.id      = request.id;
+        ack.command = request.command;
+
+        auto frame = make_shared<string>();
+        binary_protocol::encodeAck(ack, *frame);
+        manager.pushReliableToClientQueue(request.client, frame);
+    }
+}
+
+// client is connected to a TcpServer, so both directions pass its reader, queues and writer
+template<typename Socket>
+bool benchServer(BenchmarkRunner &runner, const string &name, Socket &client) {
+    // Switches the session to binary frames, the server answers with a hello frame
+    const string protocol = "{\"protocol\": \"binary\"}\n";
+    char hello[binary_protocol::HEADER_SIZE];
+    boost::system::error_code ec;
+
+    boost::asio::write(client, boost::asio::buffer(protocol), ec);
+
+    if (boost::asio::read(client, boost::asio::buffer(hello), ec) != sizeof(hello)) {
+        printf("local: %s did not switch to the binary protocol\n", name.c_str());
+        return false;
+    }
+
+    CommandRequest request;
+    request.command = 5;
+    request.has_id  = true;
+
+    string command;
+    binary_protocol::encodeCommand(request, command);
+
+    char ack[binary_protocol::HEADER_SIZE + binary_protocol::ACK_PAYLOAD_SIZE];
+    bool success = true;
+
+    runner.run(name + "/command_ack_round_trip", [&] () {
+        for (int i = 0; i < kRoundTrips; i++) {
+            boost::asio::write(client, boost::asio::buffer(command), ec);
+            success &= boost::asio::read(client, boost::asio::buffer(ack), ec) == sizeof(ack);
+        }
+        return kRoundTrips;
+    });
+
+    // The acks above went through the client queue, so it exists before the first broadcast
+    StatusMessage status;
+    auto frame = make_shared<string>();
+    binary_protocol::encodeStatus(status, *frame);
+
+    const Frame broadcast = frame;
+    vector<char> data(frame->size() * kStatusBatch);
+
+    runner.run(name + "/status_stream", [&] () {
+        for (int i = 0; i < kStatusBatch; i++) {
+            DatcMessageManager::getInstance().pushToAllClientQueue(broadcast);
+        }
+        success &= boost::asio::read(client, boost::asio::buffer(data), ec) == data.size();
+        return kStatusBatch;
+    });
+
+    if (!success) {
+        printf("local: %s lost a frame\n", name.c_str());
+    }
+
+    return success;
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+bool checkSocketFile() {
+    const string path = "/tmp/datc_benchmark_file.sock";
+    struct stat status;
+
+    ::unlink(path.c_str());
+
+    // Left by a process that did not remove it, nobody listens on it
+    {
+        boost::asio::io_service io_service;
+        boost::asio::local::stream_protocol::acceptor stale(io_service, boost::asio::local::stream_protocol::endpoint(path));
+    }
+
+    {
+        TcpServer server(path, 0600);
+
+        if (!server.isListening() || ::stat(path.c_str(), &status) != 0 || (status.st_mode & 0777) != 0600) {
+            printf("local: the stale socket file was not replaced with mode 0600\n");
+            return false;
+        }
+
+        TcpServer second(path, 0600);
+
+        if (second.isListening() || ::stat(path.c_str(), &status) != 0) {
+            printf("local: the socket of a running server was replaced\n");
+            return false;
+        }
+    }
+
+    ofstream(path) << "keep";
+
+    {
+        TcpServer server(path);
+        string content;
+
+        if (server.isListening() || !(ifstream(path) >> content) || content != "keep") {
+            printf("local: a file that is not a socket was replaced\n");
+            return false;
+        }
+    }
+
+    ::unlink(path.c_str());
+    return true;
+}
+#endif
+
+} // namespace
+
+bool benchLocal(BenchmarkRunner &runner) {
+    namespace ip = boost::asio::ip;
+
+    DatcMessageManager &manager = DatcMessageManager::getInstance();
+    const ClientQueueConfig config_prev = manager.getDefaultClientQueueConfig();
+
+    // A whole batch fits into the queue, every broadcast reaches the client
+    ClientQueueConfig config;
+    config.capacity = kStatusBatch;
+    manager.setDefaultClientQueueConfig(config);
+
+    atomic<bool> flag_stop {false};
+    thread worker([&flag_stop] () {serveAcks(flag_stop);});
+
+    boost::asio::io_service io_service;
+    bool success = true;
+
+    {
+        TcpServer server(kTcpPort);
+        ip::tcp::socket client(io_service);
+        boost::system::error_code ec;
+
+        client.connect(ip::tcp::endpoint(ip::address_v4::loopback(), kTcpPort), ec);
+
+        if (ec) {
+            printf("local: could not connect to the TCP server: %s\n", ec.message().c_str());
+            success = false;
+        } else {
+            client.set_option(ip::tcp::no_delay(true));
+            success &= benchServer(runner, "tcp_loopback", client);
+        }
+    }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    {
+        const string path = "/tmp/datc_benchmark.sock";
+
+        TcpServer server(path);
+        boost::asio::local::stream_protocol::socket client(io_service);
+        boost::system::error_code ec;
+
+        client.connect(boost::asio::local::stream_protocol::endpoint(path), ec);
+
+        if (ec) {
+            printf("local: could not connect to the Unix socket server: %s\n", ec.message().c_str());
+            success = false;
+        } else {
+            success &= benchServer(runner, "unix_stream", client);
+        }
+    }
+
+    success &= checkSocketFile();
+#endif
+
+    flag_stop = true;
+    worker.join();
+    manager.setDefaultClientQueueConfig(config_prev);
+
+    return success;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file bench_protocol.cpp
+ * @brief Json (jsoncpp) against binary encoding of status frames and decoding of commands.
+ * @version 1.0
+ * @date 2024-03-11
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "wire_protocol.hpp"
+
+using namespace tcp_communication;
+
+namespace {
+
+const int kBatch = 1000;
+
+StatusMessage makeStatus(int i) {
+    StatusMessage status;
+    status.sequence   = i;
+    status.slave      = 1;
+    status.states     = 0x0023;
+    status.motor_pos  = -1259 + (i % 100);
+    status.motor_vel  = (i % 7) * 10;
+    status.motor_cur  = 79 + (i % 13);
+    status.finger_pos = 500 + (i % 500);
+    status.voltage    = 24;
+    return status;
+}
+
+// Status serialization as done before json_protocol::writeStatus
+void encodeStatusFastWriter(const StatusMessage &status, string &out) {
+    Json::Value json;
+
+    json["states"]     = status.states;
+    json["motor_pos"]  = status.motor_pos;
+    json["motor_vel"]  = status.motor_vel;
+    json["motor_cur"]  = status.motor_cur;
+    json["finger_pos"] = status.finger_pos;
+    json["voltage"]    = status.voltage;
+
+    Json::FastWriter writer;
+    out = writer.write(json);
+}
+
+// json_protocol::writeStatus must stay byte-compatible with Json::FastWriter
+bool checkStatusSerializer() {
+    const int16_t  signed_values[]   = {INT16_MIN, -10000, -1259, -100, -99, -10, -9, -1, 0, 1, 9, 10, 99, 100, 9999, 10000, INT16_MAX};
+    const uint16_t unsigned_values[] = {0, 1, 9, 10, 99, 100, 999, 1000, 9999, 10000, 65535};
+
+    string expected, actual;
+    StatusMessage status;
+
+    for (int16_t s : signed_values) {
+        for (uint16_t u : unsigned_values) {
+            status.motor_pos  = s;
+            status.motor_vel  = -s;
+            status.motor_cur  = s;
+            status.finger_pos = u;
+            status.states     = u;
+            status.voltage    = 65535 - u;
+
+            encodeStatusFastWriter(status, expected);
+            json_protocol::encodeStatus(status, actual);
+
+            if (expected != actual) {
+                printf("Status serializer mismatch:\n  expected %s  actual   %s", expected.c_str(), actual.c_str());
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool benchProtocol(BenchmarkRunner &runner) {
+    if (!checkStatusSerializer()) {
+        return false;
+    }
+
+    runner.run("protocol/status_encode_json_fastwriter", [] () {
+        string out;
+        for (int i = 0; i < kBatch; i++) {
+            encodeStatusFastWriter(makeStatus(i), out);
+            doNotOptimize(out.data());
+        }
+        return kBatch;
+    });
+
+    runner.run("protocol/status_encode_json_fixed_schema", [] () {
+        char out[json_protocol::STATUS_MAX_SIZE];
+        for (int i = 0; i < kBatch; i++) {
+            doNotOptimize(json_protocol::writeStatus(makeStatus(i), out));
+        }
+        return kBatch;
+    });
+
+    runner.run("protocol/status_encode_json_fixed_schema_frame", [] () {
+        for (int i = 0; i < kBatch; i++) {
+            auto frame = make_shared<string>();
+            json_protocol::encodeStatus(makeStatus(i), *frame);
+            doNotOptimize(frame->data());
+        }
+        return kBatch;
+    });
+
+    runner.run("protocol/status_encode_binary", [] () {
+        string out;
+        for (int i = 0; i < kBatch; i++) {
+            binary_protocol::encodeStatus(makeStatus(i), out);
+            doNotOptimize(out.data());
+        }
+        return kBatch;
+    });
+
+    const string json_command = "{\"command\":5,\"value_1\":-1200,\"value_2\":500}";
+
+    CommandRequest binary_request;
+    binary_request.command     = 5;
+    binary_request.value_1     = (uint16_t) -1200;
+    binary_request.value_2     = 500;
+    binary_request.has_value_1 = true;
+    binary_request.has_value_2 = true;
+
+    string binary_command;
+    binary_protocol::encodeCommand(binary_request, binary_command);
+
+    runner.run("protocol/command_decode_json_reader", [&] () {
+        Json::Reader reader;
+        Json::Value json;
+        CommandRequest request;
+        uint64_t decoded = 0;
+        for (int i = 0; i < kBatch; i++) {
+            decoded += reader.parse(json_command.data(), json_command.data() + json_command.size(), json, false) &&
+                       json_protocol::decodeCommand(json, request);
+        }
+        return decoded;
+    });
+
+    runner.run("protocol/command_decode_binary", [&] () {
+        CommandRequest request;
+        uint64_t decoded = 0;
+        for (int i = 0; i < kBatch; i++) {
+            decoded += binary_protocol::decodeCommand(binary_command.data(), binary_command.data() + binary_command.size(), request);
+            doNotOptimize(request);
+        }
+        return decoded;
+    });
+
+    return true;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file bench_queue.cpp
+ * @brief ConcurrentQueue and MessageHandler: worker queue hand-off and status fan-out to clients,
+ * drained in turn and by writer threads waiting on their queue.
+ * @version 1.0
+ * @date 2024-04-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "message_manager.hpp"
+#include "wire_protocol.hpp"
+
+#include <thread>
+#include <memory>
+
+using namespace tcp_communication;
+
+namespace {
+
+typedef MessageHandler<CommandRequest, Frame, StreamConfig> Handler;
+
+const int kBatch = 1000;
+
+} // namespace
+
+bool benchQueue(BenchmarkRunner &runner) {
+    runner.run("queue/concurrent_queue_push_pop", [] () {
+        ConcurrentQueue<int> queue;
+        int value;
+        for (int i = 0; i < kBatch; i++) {
+            queue.push(i);
+            queue.tryPop(value);
+            doNotOptimize(value);
+        }
+        return kBatch;
+    });
+
+    // Commands from a client thread to the worker, which waits on the queue
+    runner.run("queue/worker_queue_hand_off", [] () {
+        Handler handler;
+        CommandRequest request;
+
+        thread client([&handler] () {
+            CommandRequest request;
+            for (int i = 0; i < kBatch; i++) {
+                request.id = i;
+                handler.pushToWorkerQueue(request);
+            }
+        });
+
+        int popped = 0;
+        while (popped < kBatch) {
+            popped += handler.tryPopFromWokerQueue(request, chrono::milliseconds(10));
+        }
+
+        client.join();
+        return kBatch;
+    });
+
+    // One status frame shared by every client, then drained by each client's writer
+    for (uint32_t clients : {1, 8, 32}) {
+        Handler handler;
+        for (uint32_t id = 0; id < clients; id++) {
+            handler.createClientQueue(id);
+        }
+
+        const Frame frame = make_shared<const string>(string(80, 'x'));
+        bool success = true;
+
+        runner.run("queue/status_fan_out_" + to_string(clients) + "_clients", [&] () {
+            Frame popped;
+            for (int i = 0; i < kBatch; i++) {
+                handler.pushToAllClientQueue(frame);
+                for (uint32_t id = 0; id < clients; id++) {
+                    success &= handler.tryPopFromClientQueue(id, popped);
+                }
+            }
+            return kBatch;
+        });
+
+        if (!success) {
+            printf("queue: status frame missing in a client queue\n");
+            return false;
+        }
+    }
+
+    // Writers blocked on their queue as in TcpSocket::writeHandler, a broadcast wakes each once
+    for (uint32_t clients : {8, 32}) {
+        Handler handler;
+        ClientQueueConfig config;
+        config.capacity = kBatch;
+        handler.setDefaultClientQueueConfig(config);
+
+        for (uint32_t id = 0; id < clients; id++) {
+            handler.createClientQueue(id);
+        }
+
+        const Frame frame = make_shared<const string>(string(80, 'x'));
+
+        runner.run("queue/status_fan_out_" + to_string(clients) + "_waiting_writers", [&] () {
+            vector<thread> writers;
+
+            for (uint32_t id = 0; id < clients; id++) {
+                writers.emplace_back([&handler, id] () {
+                    Frame popped;
+                    for (int popped_count = 0; popped_count < kBatch;) {
+                        popped_count += handler.tryPopFromClientQueue(id, popped, chrono::milliseconds(10));
+                    }
+                });
+            }
+
+            for (int i = 0; i < kBatch; i++) {
+                handler.pushToAllClientQueue(frame);
+            }
+
+            for (thread &writer : writers) {
+                writer.join();
+            }
+            return kBatch;
+        });
+    }
+
+    // Replies count into the depth and are bounded, a client that does not read them is lagging
+    Handler handler;
+    ClientQueueStats stats;
+    const Frame reply = make_shared<const string>("{}");
+
+    handler.createClientQueue(0);
+    handler.pushToAllClientQueue(reply);
+
+    for (size_t i = 0; i < kMaxReliableQueue; i++) {
+        handler.pushReliableToClientQueue(0, reply);
+    }
+
+    if (handler.pushReliableToClientQueue(0, reply) || !handler.getClientQueueStats(0, stats) ||
+        stats.depth != kMaxReliableQueue + 1 || !handler.isClientLagging(0)) {
+        printf("queue: replies are not bounded or not counted in the depth\n");
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,294 @@
+/**
+ * @file bench_shm.cpp
+ * @brief Shared-memory status channel against the localhost TCP Json path a local reader used before.
+ * @version 1.0
+ * @date 2024-04-01
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "shm_status_writer.hpp"
+#include "shm_status_reader.hpp"
+#include "wire_protocol.hpp"
+
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <boost/asio.hpp>
+
+using namespace tcp_communication;
+using namespace shm_communication;
+namespace ip = boost::asio::ip;
+
+namespace {
+
+const char kShmName[] = "/datc_status_benchmark";
+
+const uint32_t kLatencySamples = 2000;
+const uint32_t kLatencyRateHz  = 10000;
+
+const uint16_t kTcpFields = STATUS_FIELDS_DEFAULT | FIELD_SEQUENCE;
+
+int64_t nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StatusMessage makeStatus(uint32_t sequence) {
+    StatusMessage status;
+    status.sequence   = sequence;
+    status.slave      = 1;
+    status.states     = 0x0021;
+    status.motor_pos  = -269;
+    status.motor_cur  = 350;
+    status.finger_pos = 990;
+    status.voltage    = 240;
+    return status;
+}
+
+ShmStatusRecord makeRecord(uint32_t sequence) {
+    ShmStatusRecord record;
+    record.sequence   = sequence;
+    record.slave      = 1;
+    record.states     = 0x0021;
+    record.motor_pos  = -269;
+    record.motor_cur  = 350;
+    record.finger_pos = 990;
+    record.voltage    = 240;
+    return record;
+}
+
+/**
+ * @brief Publishes kLatencySamples status from a second thread at kLatencyRateHz while this
+ * thread receives them, and reports the publish-to-receive latency.
+ * @param poll Receives what is available and calls 'received' with the sequence of each status
+ */
+bool measureLatency(BenchmarkRunner &runner, const string &name, function<void(uint32_t)> publish,
+                    function<void(function<void(uint32_t)>)> poll) {
+    vector<int64_t> sent_ns(kLatencySamples);
+    vector<int64_t> latency_ns;
+    latency_ns.reserve(kLatencySamples);
+
+    thread publisher([&] () {
+        auto period     = chrono::nanoseconds(1000000000 / kLatencyRateHz);
+        auto time_start = chrono::steady_clock::now();
+
+        for (uint32_t i = 0; i < kLatencySamples; i++) {
+            this_thread::sleep_until(time_start + i * period);
+            sent_ns[i] = nowNs();
+            publish(i);
+        }
+    });
+
+    int64_t deadline = nowNs() + 5000000000LL;
+
+    while (latency_ns.size() < kLatencySamples && nowNs() < deadline) {
+        poll([&] (uint32_t sequence) {
+            if (sequence < kLatencySamples) {
+                latency_ns.push_back(nowNs() - sent_ns[sequence]);
+            }
+        });
+    }
+
+    publisher.join();
+
+    if (latency_ns.size() < kLatencySamples) {
+        printf("%s: %zu of %u status received\n", name.c_str(), latency_ns.size(), kLatencySamples);
+        return false;
+    }
+
+    sort(latency_ns.begin(), latency_ns.end());
+
+    runner.report(name + "_p50", latency_ns[latency_ns.size() / 2], "ns");
+    runner.report(name + "_p99", latency_ns[latency_ns.size() * 99 / 100], "ns");
+    runner.report(name + "_max", latency_ns.back(), "ns");
+
+    return true;
+}
+
+// A connected pair of loopback TCP sockets
+struct TcpPair {
+    boost::asio::io_service io_service;
+    ip::tcp::socket server{io_service};
+    ip::tcp::socket client{io_service};
+
+    bool connect() {
+        boost::system::error_code ec;
+        ip::tcp::acceptor acceptor(io_service, ip::tcp::endpoint(ip::address_v4::loopback(), 0));
+
+        client.connect(acceptor.local_endpoint(), ec);
+        if (!ec) acceptor.accept(server, ec);
+        if (!ec) server.set_option(ip::tcp::no_delay(true), ec);
+
+        return !ec;
+    }
+};
+
+// What a local client of the TCP server does per status: read, frame by newline and parse
+class TcpJsonReader {
+public:
+    TcpJsonReader(ip::tcp::socket &socket) : socket_(socket) {}
+
+    template<typename Fn>
+    void read(Fn received) {
+        char data[4096];
+        boost::system::error_code ec;
+        size_t size = socket_.read_some(boost::asio::buffer(data), ec);
+
+        if (ec) {
+            return;
+        }
+
+        pending_.append(data, size);
+
+        size_t begin = 0, end;
+        while ((end = pending_.find('\n', begin)) != string::npos) {
+            if (reader_.parse(pending_.data() + begin, pending_.data() + end, json_, false)) {
+                received(json_["sequence"].asUInt());
+            }
+            begin = end + 1;
+        }
+        pending_.erase(0, begin);
+    }
+
+private:
+    ip::tcp::socket &socket_;
+    string pending_;
+    Json::Reader reader_;
+    Json::Value json_;
+};
+
+// A second writer must not take over a live segment, but must replace one left by a crash
+bool checkOwnership(ShmStatusReader &reader) {
+    ShmStatusWriter second;
+    ShmStatusRecord record;
+
+    if (second.open(kShmName) || !reader.readLatest(1, record) || record.sequence != 7) {
+        printf("shm: a second writer took over the segment of a live writer\n");
+        return false;
+    }
+
+    // What a writer that crashed leaves behind: a segment nobody unlinks
+    const char stale_name[] = "/datc_status_benchmark_stale";
+    int fd = shm_open(stale_name, O_CREAT | O_RDWR, 0644);
+
+    if (fd < 0 || ftruncate(fd, sizeof(ShmStatusSegment)) != 0) {
+        printf("shm: stale segment %s could not be created\n", stale_name);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        shm_unlink(stale_name);
+        return false;
+    }
+    ::close(fd);
+
+    if (!second.open(stale_name)) {
+        printf("shm: a segment left by a crashed writer was not replaced\n");
+        shm_unlink(stale_name);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool benchShm(BenchmarkRunner &runner) {
+    ShmStatusWriter writer;
+    ShmStatusReader reader;
+
+    if (!writer.open(kShmName) || !reader.open(kShmName)) {
+        printf("shm: segment %s could not be opened\n", kShmName);
+        return false;
+    }
+
+    // Round trip through the segment, including the history
+    ShmStatusRecord record;
+    uint64_t cursor = reader.getHistoryHead(), lost;
+
+    writer.write(makeRecord(7));
+
+    if (!reader.readLatest(1, record) || record.sequence != 7 || record.finger_pos != 990 ||
+        reader.readHistory(cursor, &record, 1, lost) != 1 || record.sequence != 7 || lost != 0) {
+        printf("shm: status read back does not match the status written\n");
+        return false;
+    }
+
+    if (!checkOwnership(reader)) {
+        return false;
+    }
+
+    runner.run("shm/status_write", [&] () {
+        for (uint32_t i = 0; i < 1000; i++) {
+            writer.write(makeRecord(i));
+        }
+        return 1000;
+    });
+
+    runner.run("shm/status_read_latest", [&] () {
+        uint64_t read = 0;
+        for (int i = 0; i < 1000; i++) {
+            read += reader.readLatest(1, record);
+            doNotOptimize(record);
+        }
+        return read;
+    });
+
+    // Writing and reading one status in the same thread: the cost of the channel without wakeups
+    runner.run("shm/status_write_read", [&] () {
+        for (uint32_t i = 0; i < 1000; i++) {
+            writer.write(makeRecord(i));
+            reader.readLatest(1, record);
+            doNotOptimize(record);
+        }
+        return 1000;
+    });
+
+    TcpPair tcp;
+
+    if (!tcp.connect()) {
+        printf("tcp: loopback connection failed\n");
+        return false;
+    }
+
+    TcpJsonReader tcp_reader(tcp.client);
+
+    runner.run("tcp/status_write_read_json", [&] () {
+        string frame;
+        for (uint32_t i = 0; i < 100; i++) {
+            json_protocol::encodeStatus(makeStatus(i), frame, kTcpFields);
+            boost::asio::write(tcp.server, boost::asio::buffer(frame));
+
+            bool received = false;
+            while (!received) {
+                tcp_reader.read([&] (uint32_t) {received = true;});
+            }
+        }
+        return 100;
+    });
+
+    // Publish-to-receive latency across threads; the shm reader spins on the history head
+    cursor = reader.getHistoryHead();
+
+    bool success = measureLatency(runner, "shm/status_latency",
+        [&] (uint32_t sequence) {
+            writer.write(makeRecord(sequence));
+        },
+        [&] (function<void(uint32_t)> received) {
+            if (reader.readHistory(cursor, &record, 1, lost) == 1) {
+                received(record.sequence);
+            }
+        });
+
+    success &= measureLatency(runner, "tcp/status_latency_json",
+        [&] (uint32_t sequence) {
+            string frame;
+            json_protocol::encodeStatus(makeStatus(sequence), frame, kTcpFields);
+            boost::asio::write(tcp.server, boost::asio::buffer(frame));
+        },
+        [&] (function<void(uint32_t)> received) {
+            tcp_reader.read(received);
+        });
+
+    return success;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file bench_station.cpp
+ * @brief Station files and the startup of a station on the simulator: time until the bus and
+ * every endpoint are open and until the first status. Checks that the shared-memory segment is
+ * published with the TCP status broadcast off.
+ * @version 1.0
+ * @date 2024-04-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "datc_simulator.hpp"
+#include "station_config.hpp"
+#include "shm_status_reader.hpp"
+
+#include <algorithm>
+
+namespace {
+
+const int kStartups = 5;
+const char kShmName[]      = "/datc_station_benchmark";
+const char kQuietShmName[] = "/datc_station_benchmark_quiet";
+const int kTcpPort = 18431;
+
+bool parseFn(const string &text, StationConfig &config) {
+    Json::Value json;
+    Json::Reader reader;
+    return reader.parse(text, json) && parseStationConfig(json, config);
+}
+
+double median(vector<double> values) {
+    sort(values.begin(), values.end());
+    return values.empty() ? 0 : values[values.size() / 2];
+}
+
+} // namespace
+
+bool benchStation(BenchmarkRunner &runner) {
+    StationConfig config;
+
+    const bool is_parsed = parseFn(R"({
+        "buses": [{"device": "/dev/ttyUSB1", "baudrate": 115200, "slave": 4, "poll_slaves": [5, 6]}],
+        "tcp": {"port": 9000, "send_status": false},
+        "udp": {"group": "239.255.0.1"},
+        "telemetry": {"dir": "/tmp/t", "compress": true}
+    })", config);
+
+    if (!is_parsed || config.buses.size() != 1 || config.buses[0].baudrate != 115200 ||
+        config.buses[0].poll_slaves.size() != 2 || config.tcp_port != 9000 || config.tcp_send_status ||
+        config.udp_port != 8422 || config.telemetry_dir != "/tmp/t" || !config.telemetry_compress) {
+        printf("station: the structured file was not read\n");
+        return false;
+    }
+
+    // Flat keys of datc_daemon files
+    StationConfig flat;
+
+    if (!parseFn(R"({"device": "/dev/ttyS0", "slave": 2, "tcp_port": 8421, "telemetry": "/tmp/f"})", flat) ||
+        flat.buses.size() != 1 || flat.buses[0].device != "/dev/ttyS0" || flat.buses[0].slave != 2 ||
+        flat.buses[0].baudrate != BAUDRATE || flat.tcp_port != 8421 || flat.telemetry_dir != "/tmp/f") {
+        printf("station: the flat file was not read\n");
+        return false;
+    }
+
+    if (parseFn("[1, 2]", flat)) {
+        printf("station: a file that is not an object was read\n");
+        return false;
+    }
+
+    // Startups on the simulator, with the endpoints that need no peer
+    StationConfig station;
+    station.buses.resize(1);
+    station.udp_group = "239.255.0.1";
+    station.shm_name  = kShmName;
+
+    vector<double> ready_ms, first_status_ms;
+
+    for (int i = 0; i < kStartups; i++) {
+        DatcSimulator simulator;
+        DatcCommInterface datc_interface(0, nullptr);
+        StartupReport report;
+
+        if (!startStation(datc_interface, station, report, &simulator) || report.first_status_ms < 0) {
+            printf("station: startup %d failed, %zu endpoints not open\n", i, report.failed.size());
+            return false;
+        }
+
+        ready_ms.push_back(report.ready_ms);
+        first_status_ms.push_back(report.first_status_ms);
+    }
+
+    // A failed startup releases the TCP server it opened, the retry binds the port again
+    DatcSimulator simulator;
+    DatcCommInterface datc_interface(0, nullptr);
+    StartupReport report;
+
+    StationConfig broken;
+    broken.buses.resize(1);
+    broken.tcp_port  = kTcpPort;
+    broken.shm_name  = "invalid/shm";
+
+    if (startStation(datc_interface, broken, report, &simulator) || report.failed != vector<string>{"shm"}) {
+        printf("station: a startup with an invalid endpoint did not fail\n");
+        return false;
+    }
+
+    broken.shm_name.clear();
+
+    if (!startStation(datc_interface, broken, report, &simulator)) {
+        printf("station: the retry after a failed startup failed\n");
+        return false;
+    }
+
+    // The send status switch is the TCP one, the segment is still published
+    StationConfig quiet;
+    quiet.buses.resize(1);
+    quiet.tcp_send_status = false;
+    quiet.shm_name        = kQuietShmName;
+
+    DatcSimulator quiet_simulator;
+    DatcCommInterface quiet_interface(0, nullptr);
+    shm_communication::ShmStatusReader reader;
+    shm_communication::ShmStatusRecord record;
+
+    if (!startStation(quiet_interface, quiet, report, &quiet_simulator) || !reader.open(kQuietShmName)) {
+        printf("station: startup without the TCP status broadcast failed\n");
+        return false;
+    }
+
+    bool is_published = false;
+
+    for (int i = 0; i < 1000 && !is_published; i++) {
+        is_published = reader.readLatest(1, record);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (!is_published) {
+        printf("station: no status in shared memory with the TCP status broadcast off\n");
+        return false;
+    }
+
+    runner.report("station/startup_ready", median(ready_ms), "ms");
+    runner.report("station/startup_first_status", median(first_status_ms), "ms");
+
+    return true;
+}
@@ -0,0 +1,409 @@
+/**
+ * @file bench_telemetry.cpp
+ * @brief Cost of queuing a polled sample for the telemetry store, of time range queries, and
+ * size and speed of the compressed archive blocks on a grasp trace.
+ * @version 1.0
+ * @date 2024-04-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "telemetry_store.hpp"
+
+#include <unistd.h>
+
+using namespace telemetry;
+
+namespace {
+
+const int kBatch = 1000;
+
+const uint16_t kStatus[TELEMETRY_REGISTERS] = {0x0021, (uint16_t) -269, 350, 0, 990, 0, 0, 240};
+
+string tempDir() {
+    return "/tmp/datc_bench_telemetry_" + to_string(getpid());
+}
+
+void removeStore(const string &dir) {
+    for (const string &path : TelemetryReader::listFiles(dir)) {
+        unlink(path.c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+TelemetrySample makeSample(uint16_t slave, uint16_t finger_pos) {
+    TelemetrySample sample;
+
+    sample.slave = slave;
+    copy_n(kStatus, TELEMETRY_REGISTERS, sample.registers);
+    sample.registers[4] = finger_pos;
+    return sample;
+}
+
+// Appends as fast as the writer takes the samples, without dropping any
+void appendPaced(TelemetryWriter &writer, TelemetrySample sample) {
+    while (!writer.append(sample)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+/**
+ * @brief Polled status of several grippers at 50 Hz, each repeating idle / close / hold / open.
+ * @details Same shape as the trace of bench_delta (constant states and voltage, position ramps,
+ * current noise in the last bits), per slave shifted in phase, with the poll jitter and the
+ * time of the bus transactions before each slave in the timestamps.
+ */
+vector<TelemetrySample> makeGraspTrace(uint16_t slaves, uint32_t cycles) {
+    vector<TelemetrySample> trace;
+    vector<uint32_t> sequences(slaves + 1, 0);
+    uint32_t noise = 12345;
+
+    auto nextNoise = [&noise] () {
+        noise = noise * 1103515245 + 12345;
+        return (noise >> 16) & 0x7fff;
+    };
+
+    const uint64_t t_start = 1713600000000000ULL;
+
+    for (uint32_t i = 0; i < cycles; i++) {
+        const uint64_t t_cycle = t_start + i * 20000ULL + nextNoise() % 400;
+
+        for (uint16_t slave = 1; slave <= slaves; slave++) {
+            const uint32_t phase = (i + slave * 37) % 300;
+            int16_t motor_vel = 0, motor_cur = 0;
+            uint16_t states, finger_pos;
+
+            if (phase < 100) {           // open, idle
+                states     = 0x0021;
+                finger_pos = 0;
+            } else if (phase < 130) {    // closing
+                states     = 0x0003;
+                motor_vel  = 120;
+                motor_cur  = 80 + nextNoise() % 3;
+                finger_pos = (phase - 100) * 33;
+            } else if (phase < 270) {    // holding with force
+                states     = 0x0041;
+                motor_cur  = 350 + ((nextNoise() % 4 == 0) ? 1 : 0);
+                finger_pos = 990;
+            } else {                     // opening
+                states     = 0x0003;
+                motor_vel  = -120;
+                motor_cur  = -80 - (int16_t) (nextNoise() % 3);
+                finger_pos = (300 - phase) * 33;
+            }
+
+            TelemetrySample sample;
+
+            sample.t_us         = t_cycle + (slave - 1) * 2100;
+            sample.sequence     = sequences[slave]++;
+            sample.slave        = slave;
+            sample.registers[0] = states;
+            sample.registers[1] = (uint16_t) (-1259 + finger_pos);
+            sample.registers[2] = (uint16_t) motor_cur;
+            sample.registers[3] = (uint16_t) motor_vel;
+            sample.registers[4] = finger_pos;
+            sample.registers[7] = (nextNoise() % 25 == 0) ? 239 : 240;
+
+            trace.push_back(sample);
+        }
+    }
+
+    return trace;
+}
+
+bool sameSample(const TelemetrySample &a, const TelemetrySample &b) {
+    return a.t_us == b.t_us && a.sequence == b.sequence && a.slave == b.slave &&
+           equal(a.registers, a.registers + TELEMETRY_REGISTERS, b.registers);
+}
+
+// Blocks decode to the samples encoded, and their indexes hold the ranges of the samples
+bool checkCodec(const vector<TelemetrySample> &trace) {
+    vector<TelemetrySample> slave_samples, decoded;
+
+    for (const TelemetrySample &sample : trace) {
+        if (sample.slave == 2 && slave_samples.size() < kBlockSamples) {
+            slave_samples.push_back(sample);
+        }
+    }
+
+    string block;
+    BlockIndex index, index_read;
+
+    encodeBlock(slave_samples.data(), slave_samples.size(), block, &index);
+
+    bool flag_ok = readBlockIndex(block.data(), block.size(), index_read) &&
+                   decodeBlock(index_read, block.data() + BLOCK_INDEX_SIZE, decoded) &&
+                   decoded.size() == slave_samples.size() && index_read.size + BLOCK_INDEX_SIZE == block.size() &&
+                   index_read.min[2] == index.min[2] && index_read.min[2] < 0 && index_read.max[4] == 990 &&
+                   index_read.states_any == 0x0063 && index_read.states_all == 0x0001;
+
+    for (size_t i = 0; flag_ok && i < decoded.size(); i++) {
+        flag_ok = sameSample(decoded[i], slave_samples[i]);
+    }
+
+    // A truncated block must be rejected, not read beyond its end
+    decoded.clear();
+    flag_ok = flag_ok && !readBlockIndex(block.data(), block.size() - 1, index_read);
+    index_read.size = 20;
+    flag_ok = flag_ok && !decodeBlock(index_read, block.data() + BLOCK_INDEX_SIZE, decoded) && decoded.empty();
+
+    if (!flag_ok) {
+        printf("telemetry: decoded block does not match the samples encoded\n");
+    }
+
+    return flag_ok;
+}
+
+// Segments rotate, are archived and expire, and the samples kept read back in order and by time range
+bool checkStore(bool compress) {
+    const string dir = tempDir();
+    const size_t kSegmentSamples = 100, kSegments = 3;
+
+    TelemetryConfig config;
+    config.segment_bytes = SEGMENT_HEADER_SIZE + kSegmentSamples * sizeof(TelemetrySample);
+    config.max_segments  = kSegments;
+    config.compress      = compress;
+
+    TelemetryWriter writer;
+
+    if (!writer.open(dir, config)) {
+        printf("telemetry: cannot open a store in %s\n", dir.c_str());
+        return false;
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        appendPaced(writer, makeSample(1 + i % 2, i));
+    }
+
+    // A reader sees the samples while they are being written
+    while (writer.getStats().written < 1000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    TelemetryReader reader_live;
+    bool flag_live = reader_live.open(dir) && reader_live.getFiles().back()->size() == kSegmentSamples &&
+                     reader_live.read(0, UINT64_MAX).size() == kSegments * kSegmentSamples;
+
+    writer.close();
+
+    const TelemetryStats stats = writer.getStats();
+    TelemetryReader reader;
+    vector<TelemetrySample> samples;
+
+    if (reader.open(dir)) {
+        samples = reader.read(0, UINT64_MAX);
+    }
+
+    bool flag_ok = flag_live && stats.written == 1000 && stats.dropped == 0 && stats.segments == 10 &&
+                   stats.archived == (compress ? 10 : 0) && reader.getFiles().size() == kSegments &&
+                   samples.size() == kSegments * kSegmentSamples;
+
+    // Samples of the same microsecond may come back in slave order from an archive
+    uint32_t sequences[3] = {0, 350, 350};
+
+    for (size_t i = 0; flag_ok && i < samples.size(); i++) {
+        const TelemetrySample &sample = samples[i];
+        const uint32_t sequence = sequences[min<uint16_t>(sample.slave, 2)]++;
+
+        flag_ok = (sample.slave == 1 || sample.slave == 2) && sample.sequence == sequence &&
+                  sample.registers[4] == 2 * sequence + sample.slave - 1 && sample.registers[7] == 240 &&
+                  (i == 0 || sample.t_us >= samples[i - 1].t_us);
+    }
+
+    // A range starting inside a segment, of one slave
+    if (flag_ok) {
+        const uint64_t t_from = samples[150].t_us, t_to = samples[250].t_us;
+        size_t expected = 0;
+
+        for (const TelemetrySample &sample : samples) {
+            expected += (sample.t_us >= t_from && sample.t_us < t_to && sample.slave == 2);
+        }
+
+        flag_ok = reader.read(t_from, t_to, 2).size() == expected && expected > 0;
+    }
+
+    removeStore(dir);
+
+    if (!flag_ok) {
+        printf("telemetry: %s store read back does not match the samples written (%llu written, %llu dropped, "
+               "%llu segments)\n", compress ? "compressed" : "raw", (unsigned long long) stats.written,
+               (unsigned long long) stats.dropped, (unsigned long long) stats.segments);
+    }
+
+    return flag_ok;
+}
+
+} // namespace
+
+bool benchTelemetry(BenchmarkRunner &runner) {
+    // 10 minutes of 8 grippers
+    const vector<TelemetrySample> trace = makeGraspTrace(8, 30000);
+
+    if (!checkCodec(trace) || !checkStore(false) || !checkStore(true)) {
+        return false;
+    }
+
+    const string dir = tempDir();
+    TelemetryWriter writer;
+
+    if (!writer.open(dir)) {
+        return false;
+    }
+
+    // The poll loop only copies into the queue; bursts fit the queue so no sample is dropped
+    uint64_t samples_appended = 0;
+    std::chrono::duration<double> append_elapsed(0);
+
+    for (int burst = 0; burst < 200; burst++) {
+        auto time_start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < kBatch; i++) {
+            TelemetrySample sample = makeSample(1 + i % 4, i);
+            writer.append(sample);
+        }
+
+        append_elapsed += std::chrono::steady_clock::now() - time_start;
+        samples_appended += kBatch;
+
+        while (writer.getStats().written < samples_appended) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    runner.report("telemetry/append", append_elapsed.count() * 1e9 / samples_appended, "ns/item");
+
+    // Samples per second the writer thread keeps up with, far above a bus at 50 Hz
+    const uint64_t kSustained = 500000;
+    auto time_start = std::chrono::steady_clock::now();
+
+    for (uint64_t i = 0; i < kSustained; i++) {
+        appendPaced(writer, makeSample(1 + i % 4, i));
+    }
+
+    while (writer.getStats().written < samples_appended + kSustained) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::chrono::duration<double> sustained_elapsed = std::chrono::steady_clock::now() - time_start;
+    runner.report("telemetry/sustained_rate", kSustained / sustained_elapsed.count(), "samples/s");
+
+    writer.close();
+
+    TelemetryReader reader;
+
+    if (!reader.open(dir)) {
+        removeStore(dir);
+        return false;
+    }
+
+    const uint64_t t_first = reader.getFirstTime(), t_span = max<uint64_t>(reader.getLastTime() - t_first, 1);
+    uint64_t query = 0;
+
+    // Short windows at spread out times, as a plot of one slave would ask for them
+    runner.run("telemetry/read_range_slave", [&] () {
+        uint64_t visited = 0;
+
+        for (int i = 0; i < 100; i++) {
+            const uint64_t t_from = t_first + (query++ * 7919) % t_span;
+
+            visited += reader.forEach(t_from, t_from + 1000, [] (const TelemetrySample &sample) {
+                doNotOptimize(sample.registers[4]);
+                return true;
+            }, 2);
+        }
+        return max<uint64_t>(visited, 1);
+    });
+
+    removeStore(dir);
+
+    // Blocks of 1024 samples of one slave, as the archive writer makes them
+    vector<vector<TelemetrySample>> blocks;
+    vector<vector<TelemetrySample>> pending(9);
+
+    for (const TelemetrySample &sample : trace) {
+        pending[sample.slave].push_back(sample);
+
+        if (pending[sample.slave].size() == kBlockSamples) {
+            blocks.push_back(move(pending[sample.slave]));
+            pending[sample.slave].clear();
+        }
+    }
+
+    string encoded;
+    size_t samples_encoded = 0;
+
+    for (const vector<TelemetrySample> &block : blocks) {
+        encodeBlock(block.data(), block.size(), encoded);
+        samples_encoded += block.size();
+    }
+
+    runner.report("telemetry/archive_bytes_per_sample", (double) encoded.size() / samples_encoded, "bytes");
+    runner.report("telemetry/compression_ratio", (double) samples_encoded * sizeof(TelemetrySample) / encoded.size(), "x");
+
+    size_t block_next = 0;
+    string block_out;
+
+    runner.run("telemetry/encode_block", [&] () {
+        const vector<TelemetrySample> &block = blocks[block_next++ % blocks.size()];
+
+        block_out.clear();
+        encodeBlock(block.data(), block.size(), block_out);
+        doNotOptimize(block_out.data());
+        return block.size();
+    });
+
+    vector<pair<BlockIndex, const char *>> indexes;
+
+    for (size_t offset = 0; offset < encoded.size();) {
+        BlockIndex index;
+
+        readBlockIndex(encoded.data() + offset, encoded.size() - offset, index);
+        indexes.emplace_back(index, encoded.data() + offset + BLOCK_INDEX_SIZE);
+        offset += BLOCK_INDEX_SIZE + index.size;
+    }
+
+    vector<TelemetrySample> decoded;
+    decoded.reserve(kBlockSamples);
+
+    runner.run("telemetry/decode_block", [&] () {
+        const pair<BlockIndex, const char *> &index = indexes[block_next++ % indexes.size()];
+
+        decoded.clear();
+        decodeBlock(index.first, index.second, decoded);
+        doNotOptimize(decoded.data());
+        return index.first.count;
+    });
+
+    // Archiving a whole segment as the writer thread does, file reads and writes included
+    TelemetryConfig config;
+    config.segment_bytes = SEGMENT_HEADER_SIZE + trace.size() * sizeof(TelemetrySample);
+
+    if (!writer.open(dir, config)) {
+        return false;
+    }
+
+    for (TelemetrySample sample : trace) {
+        appendPaced(writer, sample);
+    }
+    writer.close();
+
+    const vector<string> paths = TelemetryReader::listFiles(dir);
+    const string archive_path = dir + "/archive" + ARCHIVE_SUFFIX;
+
+    auto time_compact = std::chrono::steady_clock::now();
+    const bool flag_compacted = paths.size() == 1 && compactSegment(paths[0], archive_path);
+    std::chrono::duration<double, milli> compact_elapsed = std::chrono::steady_clock::now() - time_compact;
+
+    unlink(archive_path.c_str());
+    removeStore(dir);
+
+    if (!flag_compacted) {
+        printf("telemetry: the segment of the trace could not be archived\n");
+        return false;
+    }
+
+    runner.report("telemetry/compact_segment", compact_elapsed.count() / (config.segment_bytes / 1048576.0), "ms/MiB");
+
+    return true;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file bench_trace.cpp
+ * @brief Cost of a trace point, disabled and enabled, and of the Chrome trace export.
+ * @version 1.0
+ * @date 2024-04-17
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "trace_recorder.hpp"
+
+#include <thread>
+#include <sstream>
+
+using namespace tracing;
+
+namespace {
+
+const int kBatch = 1000;
+
+// A command handed from one thread to another must export as one flow with both threads' slices
+bool checkExport() {
+    clear();
+    setEnabled(true);
+
+    uint32_t id = nextId();
+
+    record(Stage::SOCKET_READ, Phase::INSTANT, id);
+    record(Stage::WORKER_QUEUE, Phase::ASYNC_BEGIN, id);
+
+    thread worker([id] () {
+        setThreadName("benchmark_worker");
+        record(Stage::WORKER_QUEUE, Phase::ASYNC_END, id);
+        Span span(Stage::EXECUTE, id);
+        Span command(Stage::DATC_COMMAND);
+    });
+    worker.join();
+
+    setEnabled(false);
+
+    stringstream out;
+    exportChromeTrace(out);
+
+    Json::Value json;
+    Json::Reader reader;
+
+    if (!reader.parse(out.str(), json)) {
+        printf("trace: export is not valid Json\n");
+        return false;
+    }
+
+    int slices = 0, flows = 0;
+    bool named = false;
+
+    for (const Json::Value &event : json["traceEvents"]) {
+        const string phase = event["ph"].asString();
+
+        if (event["name"].asString() == "flow" && event["id"].asUInt() == id) {
+            flows++;
+        } else if (phase == "B" && event["args"]["id"].asUInt() == id) {
+            slices++;
+        } else if (phase == "M" && event["args"]["name"].asString() == "benchmark_worker") {
+            named = true;
+        }
+    }
+
+    // socket_read, execute and datc_command (which inherits the id): s, t, f
+    if (slices != 2 || flows != 3 || !named) {
+        printf("trace: exported %d slices and %d flow events of the command\n", slices, flows);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool benchTrace(BenchmarkRunner &runner) {
+    if (!checkExport()) {
+        return false;
+    }
+
+    runner.run("trace/span_disabled", [] () {
+        for (int i = 0; i < kBatch; i++) {
+            Span span(Stage::MODBUS_WRITE, i + 1);
+        }
+        return kBatch;
+    });
+
+    setEnabled(true);
+
+    runner.run("trace/span_enabled", [] () {
+        for (int i = 0; i < kBatch; i++) {
+            Span span(Stage::MODBUS_WRITE, i + 1);
+        }
+        return kBatch;
+    });
+
+    setEnabled(false);
+
+    // A full buffer of this thread
+    runner.run("trace/export_chrome_json", [] () {
+        stringstream out;
+        exportChromeTrace(out);
+        doNotOptimize(out.str().size());
+        return 1;
+    });
+
+    clear();
+
+    return true;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file bench_traffic.cpp
+ * @brief Cost of recording a modbus transaction, and the recording read back.
+ * @version 1.0
+ * @date 2024-04-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "traffic_recorder.hpp"
+
+#include <unistd.h>
+
+using namespace traffic;
+
+namespace {
+
+const int kBatch = 1000;
+
+const uint16_t kStatus[8] = {0x0021, (uint16_t) -269, 350, 0, 990, 0, 0, 240};
+
+string tempPath() {
+    return "/tmp/datc_bench_traffic_" + to_string(getpid()) + ".bin";
+}
+
+// Records written by several calls must read back unchanged and in order
+bool checkRoundTrip() {
+    const string path = tempPath();
+    const char message[] = "{\"command\": 102}\n";
+
+    if (!startRecording(path)) {
+        printf("traffic: cannot record to %s\n", path.c_str());
+        return false;
+    }
+
+    recordTcp(RecordType::TCP_OPEN, 7);
+    recordTcp(RecordType::TCP_IN, 7, message, sizeof(message) - 1);
+    recordModbus(RecordType::MODBUS_WRITE, 1, 0, 1, kStatus, 6000, 0);
+    recordModbus(RecordType::MODBUS_READ, 1, 10, 8, kStatus, 7000, 0);
+    recordModbus(RecordType::MODBUS_READ, 1, 10, 0, nullptr, 500000, FLAG_ERROR | FLAG_TIMEOUT);
+    stopRecording();
+
+    TrafficLogReader reader;
+    vector<TrafficRecord> records;
+    TrafficRecord record;
+
+    if (reader.open(path)) {
+        while (reader.next(record)) {
+            records.push_back(record);
+        }
+    }
+    unlink(path.c_str());
+
+    if (records.size() != 5 || reader.hasError()) {
+        printf("traffic: read back %zu records instead of 5\n", records.size());
+        return false;
+    }
+
+    if (records[1].client != 7 || records[1].payload != string(message, sizeof(message) - 1) ||
+        records[3].registers() != vector<uint16_t>(kStatus, kStatus + 8) || records[3].latency_us != 7000 ||
+        records[4].flags != (FLAG_ERROR | FLAG_TIMEOUT) || !records[4].payload.empty() ||
+        records[0].t_us > records[4].t_us) {
+        printf("traffic: records read back do not match the recorded ones\n");
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool benchTraffic(BenchmarkRunner &runner) {
+    if (!checkRoundTrip()) {
+        return false;
+    }
+
+    const string path = tempPath();
+
+    if (!startRecording(path)) {
+        return false;
+    }
+
+    // The calling thread only encodes into the pending buffer, the file is written behind it
+    runner.run("traffic/record_modbus_read", [] () {
+        for (int i = 0; i < kBatch; i++) {
+            recordModbus(RecordType::MODBUS_READ, 1, 10, 8, kStatus, 7000, 0);
+        }
+        return kBatch;
+    });
+
+    stopRecording();
+    unlink(path.c_str());
+
+    if (getRecorderStats().dropped > 0) {
+        printf("traffic: the writer fell behind, %llu records dropped\n",
+               (unsigned long long) getRecorderStats().dropped);
+    }
+
+    return true;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file bench_trend.cpp
+ * @brief Status history of the control page plot: appending a polled status and getting the pixel
+ * columns of the plot window, at the poll rate and at a rate 20 times higher, against decimating
+ * the samples on every redraw. Checks that a slave change starts the history over.
+ * @version 1.0
+ * @date 2024-04-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "datc_comm_interface.hpp"
+#include "datc_simulator.hpp"
+#include "status_history.hpp"
+
+namespace {
+
+const int kBatch = 1000;
+const size_t kColumns = 800;
+const uint64_t kWindowUs = 10000000;
+
+// A window of samples every period_us, the position a triangle wave with one spike
+void fillHistory(StatusHistory &history, uint64_t period_us) {
+    history.clear();
+
+    for (uint64_t t_us = 0; t_us < kWindowUs; t_us += period_us) {
+        TrendSample sample;
+        sample.t_us = t_us;
+        sample.values[(int) TrendChannel::FINGER_POS] = (int16_t) abs((int) ((t_us / 1000) % 2000) - 1000);
+        sample.values[(int) TrendChannel::MOTOR_CUR]  = (t_us == kWindowUs / 2) ? 900 : 100;
+        sample.values[(int) TrendChannel::MOTOR_VEL]  = (int16_t) (t_us % 7);
+        history.append(sample);
+    }
+}
+
+// Waits up to 1 s for a sample polled after t_us
+bool waitForSample(StatusHistory &history, uint64_t t_us) {
+    TrendSample last;
+
+    for (int i = 0; i < 1000; i++) {
+        if (history.getLast(last) && last.t_us > t_us) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// The plot shows the selected gripper only, no sample of the previous slave is left
+bool checkSlaveChange() {
+    DatcSimulator simulator;
+    DatcCommInterface datc_interface(0, nullptr);
+    StatusHistory &history = datc_interface.getStatusHistory();
+    vector<TrendColumn> columns[kTrendChannels];
+
+    datc_interface.start();
+
+    if (!datc_interface.init(&simulator, 1) || !waitForSample(history, 0)) {
+        printf("trend: no status of slave 1 was polled\n");
+        return false;
+    }
+
+    history.setTrendWindow(kWindowUs, kColumns);
+    const uint64_t t_change_us = historyNowUs();
+
+    if (!datc_interface.modbusSlaveChange(2) || !waitForSample(history, t_change_us)) {
+        printf("trend: no status of slave 2 was polled\n");
+        return false;
+    }
+
+    history.decimate(0, t_change_us, 1, columns);
+
+    if (columns[0][0].count != 0) {
+        printf("trend: %u samples of the previous slave are left\n", columns[0][0].count);
+        return false;
+    }
+
+    history.getTrend(t_change_us, columns);
+
+    for (const TrendColumn &column : columns[0]) {
+        if (column.count != 0) {
+            printf("trend: %u samples of the previous slave are left in the plot columns\n", column.count);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool benchTrend(BenchmarkRunner &runner) {
+    StatusHistory history(kWindowUs / 1000);
+    vector<TrendColumn> columns[kTrendChannels], trend[kTrendChannels];
+
+    history.setTrendWindow(kWindowUs, kColumns);
+
+    // Every column gets the samples of its time range and the spike survives the decimation
+    fillHistory(history, 1000);
+    history.decimate(0, kWindowUs, kColumns, columns);
+
+    const vector<TrendColumn> &position = columns[(int) TrendChannel::FINGER_POS];
+    const vector<TrendColumn> &current  = columns[(int) TrendChannel::MOTOR_CUR];
+    uint32_t samples = 0;
+    int16_t current_max = 0;
+
+    for (size_t i = 0; i < kColumns; i++) {
+        samples += position[i].count;
+        current_max = max(current_max, current[i].max);
+    }
+
+    if (samples != kWindowUs / 1000 || position[0].min != 988 || position[0].max != 1000 ||
+        position[0].count != 13 || current_max != 900) {
+        printf("trend: decimated columns do not match the samples\n");
+        return false;
+    }
+
+    // The columns kept on append are those decimated from the samples of the same window
+    history.getTrend(kWindowUs - 1, trend);
+
+    for (size_t channel = 0; channel < kTrendChannels; channel++) {
+        for (size_t i = 0; i < kColumns; i++) {
+            const TrendColumn &a = columns[channel][i], &b = trend[channel][i];
+
+            if (a.count != b.count || a.min != b.min || a.max != b.max) {
+                printf("trend: plot column %zu of channel %zu does not match the decimated one\n", i, channel);
+                return false;
+            }
+        }
+    }
+
+    // Rebuilt from the samples when the plot is resized
+    history.setTrendWindow(kWindowUs, kColumns / 2);
+    history.getTrend(kWindowUs - 1, trend);
+    history.decimate(0, kWindowUs, kColumns / 2, columns);
+
+    if (trend[0].size() != kColumns / 2 || trend[0][0].count != columns[0][0].count ||
+        trend[0].back().count != columns[0].back().count) {
+        printf("trend: plot columns were not rebuilt for the new width\n");
+        return false;
+    }
+    history.setTrendWindow(kWindowUs, kColumns);
+
+    TrendSample last;
+
+    if (!history.getLast(last) || last.t_us != kWindowUs - 1000) {
+        printf("trend: the last sample is not the latest appended\n");
+        return false;
+    }
+
+    TrendSample sample;
+    uint64_t t_us = kWindowUs;
+
+    runner.run("trend/append", [&] () {
+        for (int i = 0; i < kBatch; i++) {
+            sample.t_us = t_us++;
+            history.append(sample);
+        }
+        return kBatch;
+    });
+
+    // Once the ring is full the oldest samples are overwritten and leave the window
+    history.decimate(0, kWindowUs, kColumns, columns);
+
+    if (columns[0][0].count != 0) {
+        printf("trend: overwritten samples are still decimated\n");
+        return false;
+    }
+
+    if (!checkSlaveChange()) {
+        return false;
+    }
+
+    // Per redraw of an 800 pixel wide plot of 10 s, at 50 Hz and at 1 kHz: the columns kept on
+    // append cost the same at both rates, decimating the samples grows with the rate
+    for (uint64_t period_us : {20000, 1000}) {
+        StatusHistory window(kWindowUs / period_us);
+        window.setTrendWindow(kWindowUs, kColumns);
+        fillHistory(window, period_us);
+
+        const string rate = to_string(1000000 / period_us) + "hz";
+
+        runner.run("trend/redraw_" + rate, [&] () {
+            window.getTrend(kWindowUs - 1, trend);
+            doNotOptimize(trend[0][0].max);
+            return 1;
+        });
+
+        runner.run("trend/decimate_" + rate, [&] () {
+            window.decimate(0, kWindowUs, kColumns, columns);
+            doNotOptimize(columns[0][0].max);
+            return 1;
+        });
+    }
+
+    return true;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file bench_udp.cpp
+ * @brief Multicast status publisher over loopback: publish cost, delivered rate and loss.
+ * @version 1.0
+ * @date 2024-03-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "udp_publisher.hpp"
+
+#include <thread>
+
+using namespace tcp_communication;
+namespace ip = boost::asio::ip;
+
+namespace {
+
+const char *kGroup   = "239.255.42.1";
+const uint16_t kPort = 18421;
+
+const uint32_t kPacedFrames = 5000;
+const uint32_t kPacedRateHz = 10000; /**< 200 times the poll rate of one slave */
+
+// Counts received status frames
+class Listener {
+public:
+    Listener() : socket_(io_service_) {}
+
+    bool open() {
+        boost::system::error_code ec;
+
+        socket_.open(ip::udp::v4(), ec);
+        if (!ec) socket_.set_option(ip::udp::socket::reuse_address(true), ec);
+        if (!ec) socket_.set_option(boost::asio::socket_base::receive_buffer_size(1 << 20), ec);
+        if (!ec) socket_.bind(ip::udp::endpoint(ip::address_v4::any(), kPort), ec);
+        if (!ec) socket_.set_option(ip::multicast::join_group(ip::address_v4::from_string(kGroup),
+                                                              ip::address_v4::loopback()), ec);
+        if (ec) {
+            printf("udp/loopback skipped: %s\n", ec.message().c_str());
+            return false;
+        }
+
+        thread_ = thread([this] () {receive();});
+        return true;
+    }
+
+    void stop() {
+        boost::system::error_code ec;
+        socket_.shutdown(ip::udp::socket::shutdown_both, ec);
+        socket_.close(ec);
+
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // Waits until 'frames' arrived or nothing arrived for 100 ms
+    void waitFor(uint64_t frames) {
+        uint64_t last = 0;
+
+        while (received_ < frames) {
+            this_thread::sleep_for(chrono::milliseconds(100));
+            if (received_ == last) {
+                break;
+            }
+            last = received_;
+        }
+    }
+
+    void reset() {
+        received_ = 0;
+    }
+
+    uint64_t getReceived() const {return received_;}
+
+private:
+    void receive() {
+        char data[64];
+        StatusMessage status;
+
+        while (true) {
+            boost::system::error_code ec;
+            size_t size = socket_.receive(boost::asio::buffer(data), 0, ec);
+
+            if (ec) {
+                return;
+            }
+
+            if (binary_protocol::decodeStatus(data, data + size, status)) {
+                received_++;
+            }
+        }
+    }
+
+    boost::asio::io_service io_service_;
+    ip::udp::socket socket_;
+    thread thread_;
+
+    atomic<uint64_t> received_{0};
+};
+
+} // namespace
+
+bool benchUdp(BenchmarkRunner &runner) {
+    Listener listener;
+
+    if (!listener.open()) {
+        return true; // No multicast on this host
+    }
+
+    UdpStatusPublisher publisher;
+
+    if (!publisher.open(kGroup, kPort, 1, "127.0.0.1")) {
+        listener.stop();
+        return false;
+    }
+
+    StatusMessage status;
+    status.slave = 1;
+
+    // Loss check at a fixed rate, far above what the poll loop produces
+    auto period     = chrono::nanoseconds(1000000000 / kPacedRateHz);
+    auto time_start = chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < kPacedFrames; i++) {
+        this_thread::sleep_until(time_start + i * period);
+        status.sequence = i;
+        publisher.publish(status);
+    }
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - time_start;
+    listener.waitFor(kPacedFrames);
+
+    uint64_t received = listener.getReceived();
+    uint64_t lost     = kPacedFrames - received;
+
+    runner.report("udp/loopback_paced_rate", kPacedFrames / elapsed.count(), "frames/s");
+    runner.report("udp/loopback_paced_lost", lost, "frames");
+
+    bool success = lost == 0 && publisher.getStats().dropped == 0;
+    if (!success) {
+        printf("Udp status frames were lost at %u Hz\n", kPacedRateHz);
+    }
+
+    // Cost of one publish on the poll thread; the listener may fall behind here
+    listener.reset();
+    uint32_t sequence = 0;
+
+    runner.run("udp/status_publish", [&] () {
+        for (int i = 0; i < 100; i++) {
+            status.sequence = sequence++;
+            publisher.publish(status);
+        }
+        return 100;
+    });
+
+    listener.waitFor(sequence);
+
+    runner.report("udp/loopback_burst_lost", 100.0 * (sequence - listener.getReceived()) / sequence, "%");
+    runner.report("udp/loopback_burst_dropped", publisher.getStats().dropped, "frames");
+
+    listener.stop();
+    publisher.close();
+
+    return success;
+}
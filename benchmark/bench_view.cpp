@@ -0,0 +1,163 @@
+/**
+ * @file bench_view.cpp
+ * @brief Status views the poll loop publishes to the gui, for an idle and a moving gripper, and
+ * commands the gui submits to its worker while the bus is slow.
+ * @details The gui used to refresh every widget 10 times a second whatever the gripper did.
+ * It now refreshes once per view published, which is none while idle and at most one per poll
+ * cycle while moving. Its commands used to hold the gui thread for the whole transaction.
+ * @version 1.0
+ * @date 2024-04-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+#include "datc_comm_interface.hpp"
+
+namespace {
+
+const int kBatch = 1000;
+const double kPhaseSeconds = 0.5;
+
+// Answers reads with a fixed status, or with a finger position that moves on every read
+class RampTransport : public ModbusTransport {
+public:
+    bool writeRegisters(uint16_t, int, int, const uint16_t *) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(write_delay_ms));
+        return true;
+    }
+
+    bool readRegisters(uint16_t, int, int nb, uint16_t *data) override {
+        if (is_moving) {
+            finger_pos = (finger_pos + 7) % 1000;
+        }
+
+        const uint16_t status[] = {0x0021, (uint16_t) -269, 350, 0, finger_pos, 0, 0, 240};
+
+        for (int i = 0; i < nb; i++) {
+            data[i] = (i < (int) (sizeof(status) / sizeof(status[0]))) ? status[i] : 0;
+        }
+        return true;
+    }
+
+    atomic<bool> is_moving{false};
+    atomic<int> write_delay_ms{0};
+    uint16_t finger_pos = 500;
+};
+
+} // namespace
+
+bool benchView(BenchmarkRunner &runner) {
+    RampTransport transport;
+    DatcCommInterface datc_interface(0, nullptr);
+    atomic<uint64_t> notifications{0};
+
+    datc_interface.setStatusListener([&] () {
+        notifications.fetch_add(1, memory_order_relaxed);
+    });
+
+    datc_interface.init(&transport, 1);
+    datc_interface.start();
+
+    // Views published per second while the gripper does what is_moving says
+    auto measureFn([&] (bool is_moving) {
+        transport.is_moving = is_moving;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        const uint64_t notifications_start = notifications;
+        const uint64_t cycles_start = datc_interface.getPerfStats().poll_cycles;
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(kPhaseSeconds));
+
+        const uint64_t cycles = datc_interface.getPerfStats().poll_cycles - cycles_start;
+        return make_pair(notifications - notifications_start, cycles);
+    });
+
+    const auto idle   = measureFn(false);
+    const auto moving = measureFn(true);
+
+    if (idle.first != 0) {
+        printf("view: %llu views published for a gripper that did not change\n", (unsigned long long) idle.first);
+        return false;
+    }
+
+    if (moving.first == 0 || moving.first > moving.second + 1) {
+        printf("view: %llu views published in %llu poll cycles of a moving gripper\n",
+               (unsigned long long) moving.first, (unsigned long long) moving.second);
+        return false;
+    }
+
+    // Once the gripper stops, the view settles on the last status read
+    transport.is_moving = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    if (datc_interface.getStatusView().status.finger_pos != transport.finger_pos) {
+        printf("view: the view does not show the last status read\n");
+        return false;
+    }
+
+    runner.report("view/refreshes_idle", idle.first / kPhaseSeconds, "refreshes/s");
+    runner.report("view/refreshes_moving", moving.first / kPhaseSeconds, "refreshes/s");
+    runner.report("view/refreshes_timer", 10, "refreshes/s");
+
+    runner.run("view/get_status_view", [&] () {
+        for (int i = 0; i < kBatch; i++) {
+            StatusView view = datc_interface.getStatusView();
+            doNotOptimize(view.status.finger_pos);
+        }
+        return kBatch;
+    });
+
+    datc_interface.setStatusListener(nullptr);
+
+    // Commands on a bus that takes 20 ms per write: submitting never waits for it, the results
+    // come back in order and clicks beyond the queue are refused instead of piling up
+    transport.write_delay_ms = 20;
+
+    mutex mutex_done;
+    vector<uint16_t> done_commands;
+    double submit_us_max = 0;
+    size_t refused = 0;
+
+    for (size_t i = 0; i < kGuiQueueMax + 4; i++) {
+        CommandRequest request;
+        request.command = (uint16_t) ((i % 2 == 0) ? DATC_COMMAND::GRIPPER_OPEN : DATC_COMMAND::GRIPPER_CLOSE);
+
+        auto time_start = std::chrono::steady_clock::now();
+
+        const bool is_queued = datc_interface.submitCommand(request, [&] (const CommandAck &ack) {
+            unique_lock<mutex> lg(mutex_done);
+            done_commands.push_back(ack.error == CommandError::NONE ? ack.command : 0);
+        });
+
+        submit_us_max = max(submit_us_max, std::chrono::duration<double, micro>(std::chrono::steady_clock::now() - time_start).count());
+        refused += is_queued ? 0 : 1;
+    }
+
+    for (int i = 0; i < 200; i++) {
+        {
+            unique_lock<mutex> lg(mutex_done);
+            if (done_commands.size() + refused >= kGuiQueueMax + 4) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    bool is_in_order = refused != 0 && done_commands.size() + refused == kGuiQueueMax + 4;
+
+    for (size_t i = 0; is_in_order && i < done_commands.size(); i++) {
+        is_in_order = done_commands[i] == (uint16_t) ((i % 2 == 0) ? DATC_COMMAND::GRIPPER_OPEN : DATC_COMMAND::GRIPPER_CLOSE);
+    }
+
+    if (!is_in_order || submit_us_max > 5000) {
+        printf("view: %zu of %zu commands done in order, %zu refused, %.0f us to submit\n",
+               done_commands.size(), kGuiQueueMax + 4, refused, submit_us_max);
+        return false;
+    }
+
+    runner.report("view/command_submit_max", submit_us_max, "us");
+    transport.write_delay_ms = 0;
+
+    return true;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file benchmark.hpp
+ * @brief Minimal timing harness for the communication benchmarks.
+ * @version 1.0
+ * @date 2024-03-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <fstream>
+#include <jsoncpp/json/json.h>
+
+using namespace std;
+
+extern atomic<uint64_t> g_allocation_count; /**< Calls of the global operator new, see main.cpp */
+
+struct BenchmarkResult {
+    string name;
+    uint64_t iterations = 0;
+    uint64_t items      = 0; /**< Messages (or frames, samples ...) processed over all iterations */
+    uint64_t allocations = 0;
+    double seconds      = 0;
+
+    double nsPerItem() const     {return items ? seconds * 1e9 / items : 0;}
+    double itemsPerSec() const   {return seconds > 0 ? items / seconds : 0;}
+    double allocsPerItem() const {return items ? (double) allocations / items : 0;}
+};
+
+// A value measured outside of BenchmarkRunner::run, e.g. bytes per frame or a latency percentile
+struct BenchmarkMetric {
+    string name;
+    double value;
+    string unit;
+};
+
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(double min_seconds = 0.5) : min_seconds_(min_seconds) {}
+
+    void setMinSeconds(double min_seconds) {min_seconds_ = min_seconds;}
+
+    /**
+     * @brief Repeats 'fn' until at least min_seconds elapsed. 'fn' returns the number of items it processed.
+     */
+    template<typename Fn>
+    const BenchmarkResult &run(const string &name, Fn fn) {
+        BenchmarkResult result;
+        result.name = name;
+
+        fn(); // warm up
+
+        uint64_t allocations_start = g_allocation_count;
+        auto time_start = chrono::steady_clock::now();
+        chrono::duration<double> elapsed(0);
+
+        while (elapsed.count() < min_seconds_) {
+            result.items += fn();
+            result.iterations++;
+            elapsed = chrono::steady_clock::now() - time_start;
+        }
+
+        result.seconds     = elapsed.count();
+        result.allocations = g_allocation_count - allocations_start;
+        results_.push_back(result);
+
+        printf("%-48s %12.1f ns/item %14.0f items/s %8.2f allocs/item\n",
+               name.c_str(), result.nsPerItem(), result.itemsPerSec(), result.allocsPerItem());
+
+        return results_.back();
+    }
+
+    void report(const string &name, double value, const string &unit) {
+        metrics_.push_back({name, value, unit});
+        printf("%-48s %12.1f %s\n", name.c_str(), value, unit.c_str());
+    }
+
+    const vector<BenchmarkResult> &getResults() const {return results_;}
+    const vector<BenchmarkMetric> &getMetrics() const {return metrics_;}
+
+    /**
+     * @brief Writes every result and metric as Json, to be compared between releases.
+     */
+    bool writeJson(const string &path, const Json::Value &context) const {
+        Json::Value json;
+        json["context"] = context;
+        json["benchmarks"] = Json::Value(Json::arrayValue);
+        json["metrics"]    = Json::Value(Json::arrayValue);
+
+        for (const BenchmarkResult &result : results_) {
+            Json::Value item;
+            item["name"]            = result.name;
+            item["iterations"]      = (Json::UInt64) result.iterations;
+            item["items"]           = (Json::UInt64) result.items;
+            item["seconds"]         = result.seconds;
+            item["ns_per_item"]     = result.nsPerItem();
+            item["items_per_sec"]   = result.itemsPerSec();
+            item["allocs_per_item"] = result.allocsPerItem();
+            json["benchmarks"].append(item);
+        }
+
+        for (const BenchmarkMetric &metric : metrics_) {
+            Json::Value item;
+            item["name"]  = metric.name;
+            item["value"] = metric.value;
+            item["unit"]  = metric.unit;
+            json["metrics"].append(item);
+        }
+
+        ofstream file(path);
+        file << Json::StyledWriter().write(json);
+
+        return file.good();
+    }
+
+private:
+    double min_seconds_;
+    vector<BenchmarkResult> results_;
+    vector<BenchmarkMetric> metrics_;
+};
+
+// Keeps the compiler from optimizing away a computed value
+template<typename T>
+inline void doNotOptimize(T const &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Each returns false if a correctness check done before timing failed
+bool benchFraming(BenchmarkRunner &runner);
+bool benchProtocol(BenchmarkRunner &runner);
+bool benchDelta(BenchmarkRunner &runner);
+bool benchUdp(BenchmarkRunner &runner);
+bool benchShm(BenchmarkRunner &runner);
+bool benchLocal(BenchmarkRunner &runner);
+bool benchQueue(BenchmarkRunner &runner);
+bool benchDatc(BenchmarkRunner &runner);
+bool benchTrace(BenchmarkRunner &runner);
+bool benchTraffic(BenchmarkRunner &runner);
+bool benchTelemetry(BenchmarkRunner &runner);
+bool benchView(BenchmarkRunner &runner);
+bool benchTrend(BenchmarkRunner &runner);
+bool benchFleet(BenchmarkRunner &runner);
+bool benchStation(BenchmarkRunner &runner);
+
+#endif // BENCHMARK_HPP
@@ -0,0 +1,115 @@
+/**
+ * @file main.cpp
+ * @brief Benchmarks of the communication hot paths.
+ * @version 1.0
+ * @date 2024-03-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "benchmark.hpp"
+
+#include <new>
+#include <cstdlib>
+
+atomic<uint64_t> g_allocation_count(0);
+
+void *operator new(size_t size) {
+    g_allocation_count.fetch_add(1, memory_order_relaxed);
+
+    if (void *ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+struct BenchmarkGroup {
+    const char *name;
+    bool (*fn)(BenchmarkRunner &);
+};
+
+const BenchmarkGroup kGroups[] = {
+    {"framing",   benchFraming},
+    {"protocol",  benchProtocol},
+    {"delta",     benchDelta},
+    {"queue",     benchQueue},
+    {"datc",      benchDatc},
+    {"udp",       benchUdp},
+    {"shm",       benchShm},
+    {"local",     benchLocal},
+    {"trace",     benchTrace},
+    {"traffic",   benchTraffic},
+    {"telemetry", benchTelemetry},
+    {"view",      benchView},
+    {"trend",     benchTrend},
+    {"fleet",     benchFleet},
+    {"station",   benchStation},
+};
+
+void printUsage() {
+    printf("Usage: datc_benchmark [--filter NAME,...] [--min-time SECONDS] [--json FILE]\n"
+           "Groups:");
+    for (const BenchmarkGroup &group : kGroups) {
+        printf(" %s", group.name);
+    }
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    BenchmarkRunner runner;
+
+    string filter, json_path;
+
+    for (int i = 1; i < argc; i++) {
+        const string option = argv[i];
+
+        if (option == "--filter" && i + 1 < argc) {
+            filter = "," + string(argv[++i]) + ",";
+        } else if (option == "--min-time" && i + 1 < argc) {
+            runner.setMinSeconds(atof(argv[++i]));
+        } else if (option == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            printUsage();
+            return option == "--help" ? 0 : 2;
+        }
+    }
+
+    bool success = true;
+
+    for (const BenchmarkGroup &group : kGroups) {
+        if (filter.empty() || filter.find("," + string(group.name) + ",") != string::npos) {
+            success &= group.fn(runner);
+        }
+    }
+
+    if (!json_path.empty()) {
+        Json::Value context;
+        context["success"]  = success;
+        context["compiler"] = __VERSION__;
+#ifdef NDEBUG
+        context["build"]    = "release";
+#else
+        context["build"]    = "debug";
+#endif
+
+        if (!runner.writeJson(json_path, context)) {
+            printf("Results could not be written to %s\n", json_path.c_str());
+            return 1;
+        }
+    }
+
+    return success ? 0 : 1;
+}
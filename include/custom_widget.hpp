@@ -15,6 +15,20 @@
 #include "ui_datc_control_form.h"
 #include "ui_tcp_form.h"
 #include "ui_advanced_control.h"
+#include "ui_perf_form.h"
+#include "ui_fleet_form.h"
+
+#include <QLabel>
+#include <QPainter>
+#include <QTimer>
+
+#include "perf_counters.hpp"
+#include "status_history.hpp"
+#include "fleet_model.hpp"
+
+const int kTrendWindowMs  = 10000;
+const int kTrendRefreshMs = 50;
+const int kToastMs        = 2500;
 
 class ModbusWidget : public QWidget {
     Q_OBJECT
@@ -27,15 +41,149 @@ public:
     Ui::ModbusForm ui_;
 };
 
+/**
+ * @brief Finger position, motor current and velocity over the last kTrendWindowMs, one lane each.
+ * @details Redrawn every kTrendRefreshMs while shown, from the min / max per pixel column the
+ * status history keeps as it is polled, so a faster poll rate does not draw more. Position is on its full range, current
+ * and velocity scale to what the window holds.
+ */
+class TrendWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    TrendWidget(QWidget *parent = nullptr) : QWidget(parent) {
+        setMinimumHeight(145);
+
+        timer_ = new QTimer(this);
+        timer_->setInterval(kTrendRefreshMs);
+        connect(timer_, &QTimer::timeout, this, [this] () {update();});
+    }
+
+    void setHistory(StatusHistory *history) {
+        history_ = history;
+        update();
+    }
+
+protected:
+    void showEvent(QShowEvent *) override {timer_->start();}
+    void hideEvent(QHideEvent *) override {timer_->stop();}
+
+    void paintEvent(QPaintEvent *) override {
+        struct Lane {
+            const char *name;
+            const char *unit;
+            double scale;     /**< Display unit per raw value */
+            int fixed_min, fixed_max;
+            bool is_fixed;
+        };
+        static const Lane lanes[kTrendChannels] = {
+            {"Position", "%"  , 0.1, 0, 1000, true},
+            {"Current" , "mA" , 1.0, 0, 0   , false},
+            {"Velocity", "rpm", 1.0, 0, 0   , false},
+        };
+
+        QPainter painter(this);
+        painter.fillRect(rect(), QColor("#FFFFFF"));
+
+        const int columns = max(width(), 1);
+        const uint64_t t_to_us = historyNowUs();
+
+        TrendSample last;
+        const bool has_last = history_ != nullptr && history_->getLast(last) &&
+                              last.t_us + (uint64_t) kTrendWindowMs * 1000 >= t_to_us;
+
+        if (history_ != nullptr) {
+            history_->setTrendWindow((uint64_t) kTrendWindowMs * 1000, columns);
+            history_->getTrend(t_to_us, columns_);
+        } else {
+            for (vector<TrendColumn> &channel : columns_) {
+                channel.assign(columns, TrendColumn());
+            }
+        }
+
+        const double lane_height = (double) height() / kTrendChannels;
+        const int label_height   = fontMetrics().height();
+
+        for (size_t channel = 0; channel < kTrendChannels; channel++) {
+            const Lane &lane = lanes[channel];
+            const vector<TrendColumn> &cols = columns_[channel];
+            const double top = channel * lane_height;
+
+            // Range of the lane, at least 1 raw unit high around zero for the scaled ones
+            int lo = lane.fixed_min, hi = lane.fixed_max;
+
+            if (!lane.is_fixed) {
+                lo = -1;
+                hi = 1;
+                for (const TrendColumn &col : cols) {
+                    if (col.count != 0) {
+                        lo = min(lo, (int) col.min);
+                        hi = max(hi, (int) col.max);
+                    }
+                }
+            }
+
+            auto yFn([&] (int value) {
+                const double plot_top = top + label_height, plot_height = lane_height - label_height - 2;
+                return plot_top + plot_height * (hi - value) / (double) (hi - lo);
+            });
+
+            painter.setPen(QColor("#DDDDDD"));
+            painter.drawLine(QPointF(0, top + lane_height - 1), QPointF(width(), top + lane_height - 1));
+
+            // A column also spans to the previous one so the trace has no gaps between columns
+            painter.setPen(QColor("#555555"));
+            const TrendColumn *prev = nullptr;
+
+            for (int x = 0; x < columns; x++) {
+                const TrendColumn &col = cols[x];
+
+                if (col.count == 0) {
+                    prev = nullptr;
+                    continue;
+                }
+
+                int col_min = col.min, col_max = col.max;
+
+                if (prev != nullptr) {
+                    col_min = min(col_min, (int) prev->max);
+                    col_max = max(col_max, (int) prev->min);
+                }
+
+                painter.drawLine(QPointF(x + 0.5, yFn(col_min)), QPointF(x + 0.5, yFn(col_max)));
+                prev = &col;
+            }
+
+            QString label = QString(lane.name) + "  ";
+            label += has_last ? QString::number(last.values[channel] * lane.scale, 'f', (lane.scale < 1) ? 1 : 0) + " " + lane.unit
+                              : QString("-");
+
+            painter.setPen(QColor("#888888"));
+            painter.drawText(QRectF(4, top, width() - 8, label_height), Qt::AlignLeft | Qt::AlignVCenter, label);
+            painter.drawText(QRectF(4, top, width() - 8, label_height), Qt::AlignRight | Qt::AlignVCenter,
+                             QString::number(lo * lane.scale, 'f', 0) + " ~ " + QString::number(hi * lane.scale, 'f', 0));
+        }
+    }
+
+private:
+    StatusHistory *history_ = nullptr;
+    vector<TrendColumn> columns_[kTrendChannels];
+    QTimer *timer_;
+};
+
 class DatcCtrlWidget : public QWidget {
     Q_OBJECT
 
 public:
     DatcCtrlWidget(QWidget *parent = nullptr) : QWidget(parent) {
         ui_.setupUi(this);
+
+        trend_ = new TrendWidget(ui_.frame_trend);
+        ui_.verticalLayout_trend->addWidget(trend_);
     }
 
     Ui::DatcCtrlForm ui_;
+    TrendWidget *trend_;
 };
 
 class TcpWidget : public QWidget {
@@ -60,4 +208,132 @@ public:
     Ui::AdvancedCtrlForm ui_;
 };
 
+// Bars of a latency histogram, one per bucket, scaled to the largest
+class HistogramWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    HistogramWidget(QWidget *parent = nullptr) : QWidget(parent) {
+        setMinimumHeight(160);
+    }
+
+    void setSnapshot(const LatencySnapshot &snapshot) {
+        snapshot_ = snapshot;
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent *) override {
+        QPainter painter(this);
+
+        const int label_height = fontMetrics().height() + 4;
+        const int chart_height = height() - label_height;
+        const double bar_width = (double) width() / kLatencyBuckets;
+
+        uint64_t max_count = 1;
+        for (uint64_t count : snapshot_.counts) {
+            max_count = max(max_count, count);
+        }
+
+        painter.fillRect(rect(), QColor("#FFFFFF"));
+        painter.setPen(QColor("#888888"));
+
+        for (size_t i = 0; i < kLatencyBuckets; i++) {
+            const int x = (int) (i * bar_width);
+            const int h = (int) (chart_height * snapshot_.counts[i] / max_count);
+
+            painter.fillRect(QRectF(x + 1, chart_height - h, bar_width - 2, h), QColor("#888888"));
+
+            // Upper bounds in ms, every other bucket
+            if (i % 2 == 0 && i + 1 < kLatencyBuckets) {
+                double upper_ms = LatencySnapshot::bucketUpperUs(i) / 1000.0;
+                QString label   = (upper_ms < 1)    ? QString::number(upper_ms, 'f', 2) :
+                                  (upper_ms < 1000) ? QString::number(upper_ms, 'f', 0) :
+                                                      QString::number(upper_ms / 1000, 'f', 1) + "s";
+
+                painter.drawText(QRectF(x, chart_height, 2 * bar_width, label_height), Qt::AlignCenter, "<" + label);
+            }
+        }
+
+        painter.drawText(QRectF(0, chart_height, width(), label_height), Qt::AlignRight | Qt::AlignVCenter, "ms ");
+    }
+
+private:
+    LatencySnapshot snapshot_;
+};
+
+class PerfWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    PerfWidget(QWidget *parent = nullptr) : QWidget(parent) {
+        ui_.setupUi(this);
+
+        histogram_ = new HistogramWidget(ui_.frame_perf_histogram);
+        ui_.verticalLayout_perf_histogram->addWidget(histogram_);
+    }
+
+    Ui::PerfForm ui_;
+    HistogramWidget *histogram_;
+};
+
+class FleetWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    FleetWidget(QWidget *parent = nullptr) : QWidget(parent) {
+        ui_.setupUi(this);
+
+        model_ = new FleetModel(this);
+        ui_.tableView_fleet->setModel(model_);
+        ui_.tableView_fleet->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    }
+
+    Ui::FleetForm ui_;
+    FleetModel *model_;
+};
+
+// Result of a command, shown over the bottom of the window for kToastMs
+class ToastWidget : public QLabel {
+    Q_OBJECT
+
+public:
+    ToastWidget(QWidget *parent) : QLabel(parent) {
+        setAlignment(Qt::AlignCenter);
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+        setStyleSheet(toastStyle(true));
+        hide();
+
+        timer_ = new QTimer(this);
+        timer_->setSingleShot(true);
+        connect(timer_, &QTimer::timeout, this, &QWidget::hide);
+    }
+
+    void showMessage(const QString &text, bool success) {
+        if (success != is_success_) {
+            setStyleSheet(toastStyle(success));
+            is_success_ = success;
+        }
+
+        setText(text);
+        adjustSize();
+
+        const QWidget *window = parentWidget();
+        move((window->width() - width()) / 2, window->height() - height() - 30);
+        raise();
+        show();
+
+        timer_->start(kToastMs);
+    }
+
+private:
+    static QString toastStyle(bool success) {
+        return QString("background-color:") + (success ? "#555555" : "#CC0000") +
+               ";color:#FFFFFF;border-radius:10px;padding:10px 20px;font-size:14pt;";
+    }
+
+    QTimer *timer_;
+    bool is_success_ = true;
+};
+
 #endif // CUSTOM_WIDGET_HPP
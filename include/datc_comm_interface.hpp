@@ -13,50 +13,210 @@
 
 #include "datc_ctrl.hpp"
 #include <thread>
-#include <QThread>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <boost/asio.hpp>
 #include "socket/tcp_manager.hpp"
+#include "socket/status_broadcaster.hpp"
+#include "socket/udp_publisher.hpp"
+#include "socket/concurrent_queue.hpp"
+#include "trace_recorder.hpp"
+#include "status_history.hpp"
+#include "fleet_table.hpp"
+#ifndef _WIN32
+#include "shm/shm_status_writer.hpp"
+#include "telemetry/telemetry_store.hpp"
+#endif
 
 using namespace std;
 using namespace boost::asio;
 using namespace boost::asio::ip;
 
-class DatcCommInterface : public QThread, public DatcCtrl {
-    Q_OBJECT
+// Counters published by the workers, a snapshot costs no lock of the bus or the queues
+struct PerfStats {
+    uint64_t poll_cycles   = 0;
+    uint64_t poll_overruns = 0; /**< Cycles longer than the poll period */
 
+    ModbusStats modbus;
+
+    uint64_t commands = 0;
+    LatencySnapshot command_wait; /**< From the socket framing a command to the worker taking it */
+};
+
+const size_t kGuiQueueMax = 16; /**< Jobs waiting for the gui worker, a dead bus does not pile up clicks */
+
+// What the gui shows, republished by the poll loop whenever any of it changes
+struct StatusView {
+    DatcStatus status;
+    uint16_t slave_addr   = 0;
+    bool modbus_connected = false;
+    bool modbus_recv_err  = false;
+    bool socket_connected = false;
+};
+
+// Qt independent, shared by the gui and the headless daemon
+class DatcCommInterface : public DatcCtrl {
 public:
     DatcCommInterface(int argc, char **argv);
     virtual ~DatcCommInterface();
 
-Q_SIGNALS:
-    void rosShutdown();
-
 public:
-    bool init(const char *port_name, uint16_t slave_address);
-    void initTcp(const string addr, uint16_t socket_port);
+    // Starts the poll loop, which runs until destruction
+    void start();
+
+    bool init(const char *port_name, uint16_t slave_address, int baudrate = BAUDRATE);
+    bool init(ModbusTransport *transport, uint16_t slave_address);
+    // false if the port cannot be bound or a TCP server runs already
+    bool initTcp(const string addr, uint16_t socket_port);
     void releaseTcp();
 
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    // Same protocol as TCP for local clients, access controlled by the socket file permissions
+    bool initLocalSocket(const string &path, mode_t mode = 0660);
+    void releaseLocalSocket();
+#endif
+
+    // Status multicast to any number of listeners, next to the TCP clients
+    bool initUdp(const string &group, uint16_t port, int ttl = 1, const string &interface_addr = "");
+    void releaseUdp();
+    UdpPublisherStats getUdpStats();
+
+#ifndef _WIN32
+    // Latest status of every slave for processes on this machine, see shm/shm_status_reader.hpp
+    bool initShm(const string &name = shm_communication::SHM_DEFAULT_NAME);
+    void releaseShm();
+
+    // Every polled status as read, kept in rotating segment files, see telemetry/telemetry_store.hpp
+    bool initTelemetry(const string &dir, const telemetry::TelemetryConfig &config = telemetry::TelemetryConfig());
+    void releaseTelemetry();
+    telemetry::TelemetryStats getTelemetryStats();
+#endif
+
     bool isSocketConnected() {return is_socket_connected_;}
+    // The status broadcast to TCP clients only, UDP and shm publish while they are open
     bool getTcpSendStatus() {return flag_tcp_send_status_;}
     void setTcpSendStatus(bool flag) {flag_tcp_send_status_ = flag;}
 
+    // Backpressure applied to clients that read slower than the status rate
+    void setTcpQueueConfig(const ClientQueueConfig &config) {
+        DatcMessageManager::getInstance().setDefaultClientQueueConfig(config);
+    }
+    // Locks the client map and each queue while copying, not meant for the poll loop
+    unordered_map<uint32_t, ClientQueueStats> getTcpClientQueueStats() {
+        return DatcMessageManager::getInstance().getAllClientQueueStats();
+    }
+
+    /**
+     * @brief Called on the poll thread after the status view changed, at most once per cycle.
+     * @details A cycle that reads the same registers as the last one does not call it, so an
+     * idle gripper costs the gui nothing. The listener should only schedule the refresh and
+     * read the view with getStatusView() from its own thread.
+     */
+    void setStatusListener(function<void ()> listener);
+    StatusView getStatusView();
+    uint64_t getStatusViewChanges() const {return status_view_changes_;}
+
+    // Every status read from the current slave, for plots at the full poll rate
+    StatusHistory &getStatusHistory() {return status_history_;}
+
+    // Latest status and read counters of the current slave and the poll slaves, by slave
+    vector<SlaveRecord> getSlaveRecords();
+
+    // monotonicMicros() of the first status read since init(), 0 until then
+    uint64_t getFirstStatusTime() const {return t_first_status_us_;}
+
+    PerfStats getPerfStats() const;
+    static uint16_t getPollFrequency();
+
+    /**
+     * @brief Queues a command for the gui worker, done is called on that worker with the result.
+     * @details Commands run one at a time in the order submitted, next to the socket worker and
+     * the poll loop, so the caller never waits for the bus.
+     * @return false if kGuiQueueMax jobs are already waiting, done is then not called
+     */
+    bool submitCommand(const CommandRequest &request, function<void (const CommandAck &)> done);
+
+    // Any other bus access for the gui worker, e.g. opening the port, same order as the commands
+    bool submitTask(function<bool ()> task, function<void (bool)> done);
+
+    // Slaves polled besides the current one, each published to subscribed clients
+    void setPollSlaves(const vector<uint16_t> &slaves);
+    vector<uint16_t> getPollSlaves();
+
 private:
     void run();
-    void sendStatus();
+    void sendStatus(const DatcStatus &status, uint16_t slave_addr);
+    void recordTelemetry(const DatcStatus &status, uint16_t slave_addr);
+    void publishStatusView();
+    void recordSlave(uint16_t slave_addr, const DatcStatus *status);
+    void resetSlaveRecords(const string &bus);
     void recvCommand();
+    void sendAck(uint32_t client, const CommandAck &ack);
+    void startCommandThread();
+    void stopCommandThread();
+    bool submitJob(const function<void ()> &job);
+    void runJobs();
+    CommandError executeRequest(const CommandRequest &request);
 
-    bool flag_program_stop_ = false;
+    atomic<bool> flag_program_stop_{false};
+    std::thread poll_thread_;
 
     // TCP socket related variables
-    TcpServer *tcp_server_;
+    TcpServer *tcp_server_   = NULL;
+    TcpServer *local_server_ = NULL;
     std::thread tcp_thread_;
 
-    bool flag_tcp_stop_        = false;
-    bool is_socket_connected_  = false;
-    bool flag_tcp_send_status_ = true;
+    atomic<bool> flag_tcp_stop_{false};
+    atomic<bool> is_socket_connected_{false};
+    atomic<bool> flag_tcp_send_status_{true};
 
     mutex mutex_tcp_;
+
+    StatusBroadcaster status_broadcaster_;
+    unordered_map<uint16_t, uint32_t> status_sequence_; /**< Per slave */
+
+    UdpStatusPublisher udp_publisher_;
+    atomic<bool> is_udp_open_{false};
+    mutex mutex_udp_;
+
+#ifndef _WIN32
+    shm_communication::ShmStatusWriter shm_writer_;
+    atomic<bool> is_shm_open_{false};
+    mutex mutex_shm_;
+
+    telemetry::TelemetryWriter telemetry_writer_;
+    atomic<bool> is_telemetry_open_{false};
+    mutex mutex_telemetry_;
+#endif
+
+    vector<uint16_t> poll_slaves_;
+    mutex mutex_poll_;
+
+    StatusView status_view_;
+    function<void ()> status_listener_;
+    atomic<uint64_t> status_view_changes_{0};
+    mutex mutex_view_;
+
+    StatusHistory status_history_;
+    uint16_t history_slave_ = 0; /**< Slave of the samples in status_history_, poll thread only */
+
+    string bus_name_;
+    atomic<uint64_t> t_first_status_us_{0};
+    map<uint16_t, SlaveRecord> slave_records_;
+    mutex mutex_records_;
+
+    atomic<uint64_t> poll_cycles_{0};
+    atomic<uint64_t> poll_overruns_{0};
+    LatencyHistogram command_wait_;
+
+    // Gui worker
+    tcp_communication::ConcurrentQueue<function<void ()>> jobs_;
+    std::thread job_thread_;
+    atomic<bool> flag_jobs_stop_{false};
+    mutex mutex_jobs_;
+
+    atomic<uint32_t> trace_status_id_{0}; /**< Trace id of the last command, taken by the next poll cycle */
 };
 
 #endif // DATC_COMM_INTERFACE_HPP
@@ -12,6 +12,7 @@
 #define DATC_CTRL_HPP
 
 #include "modbus_comm.hpp"
+#include "trace_recorder.hpp"
 #include <map>
 
 #define CMD_ADDR 0
@@ -30,6 +31,9 @@ const uint16_t kTorqueRatioMax = 100;
 const uint16_t kSpeedRatioMin  = 0;
 const uint16_t kSpeedRatioMax  = 100;
 
+const uint16_t kStatusRegAddr = 10;
+const uint16_t kStatusRegNum  = 8;
+
 const uint16_t kVelMin =  100;
 const uint16_t kVelMax =  900;
 const uint16_t kCurMax = 1200;
@@ -70,6 +74,8 @@ struct DatcStatus {
     uint16_t finger_pos = 0;
     uint16_t voltage    = 0;
     uint16_t states     = 0;
+
+    uint16_t registers[kStatusRegNum] = {}; /**< As read, for the telemetry store */
 };
 
 class DatcCtrl {
@@ -77,7 +83,8 @@ public:
     DatcCtrl();
     ~DatcCtrl();
 
-    bool modbusInit(const char *port_name, uint16_t slave_address);
+    bool modbusInit(const char *port_name, uint16_t slave_address, int baudrate = BAUDRATE);
+    bool modbusInit(ModbusTransport *transport, uint16_t slave_address);
     bool modbusRelease();
     bool modbusSlaveChange(uint16_t slave_addr);
 
@@ -104,11 +111,14 @@ public:
     bool setMotorSpeed (uint16_t speed_ratio);
 
     bool readDatcData();
+    bool readDatcData(uint16_t slave_addr, DatcStatus &status);
+    static void decodeDatcData(const vector<uint16_t> &reg, DatcStatus &status);
     DatcStatus getDatcStatus() {return status_;}
     bool getConnectionState() {return mbc_.getConnectionState();}
     bool getModbusRecvErr() {return flag_modbus_recv_err_;}
 
     uint16_t getSlaveAddr() {return mbc_.getSlaveAddr();}
+    ModbusStats getModbusStats() const {return mbc_.getStats();}
 
 protected:
     bool checkDurationRange(string error_prefix, uint16_t &duration);
@@ -0,0 +1,176 @@
+/**
+ * @file datc_simulator.hpp
+ * @brief Simulated DATC grippers behind a ModbusTransport, to run without hardware.
+ * @details Every slave address answers. Commands written to the command registers move the
+ * simulated finger, and the status registers report it like the gripper does. By default each
+ * transaction takes as long as its RTU frames at BAUDRATE, so a load test against the
+ * simulator sees the same bus limit as against a real bus.
+ * @version 1.0
+ * @date 2024-04-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef DATC_SIMULATOR_HPP
+#define DATC_SIMULATOR_HPP
+
+#include "datc_ctrl.hpp"
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+
+class DatcSimulator : public ModbusTransport {
+public:
+    /**
+     * @param transaction_us Duration of every transaction, < 0: duration of the frames on the bus
+     */
+    explicit DatcSimulator(int transaction_us = -1) : transaction_us_(transaction_us) {}
+
+    bool writeRegisters(uint16_t slave_addr, int reg_addr, int nb, const uint16_t *data) override {
+        // Function 0x06 for one register, 0x10 (with byte count) for several
+        waitBus(nb == 1 ? 8 : 9 + 2 * nb, 8);
+
+        if (reg_addr != CMD_ADDR || nb < 1) {
+            return true;
+        }
+
+        Gripper &gripper = update(slave_addr);
+        int16_t value_1  = (nb > 1) ? (int16_t) data[1] : 0;
+
+        switch ((DATC_COMMAND) data[0]) {
+            case DATC_COMMAND::MOTOR_ENABLE:
+                gripper.states |= STATE_ENABLE;
+                break;
+
+            case DATC_COMMAND::MOTOR_STOP:
+                gripper.target_pos = gripper.finger_pos;
+                break;
+
+            case DATC_COMMAND::MOTOR_DISABLE:
+                gripper.states     = 0;
+                gripper.target_pos = gripper.finger_pos;
+                break;
+
+            case DATC_COMMAND::GRIPPER_INITIALIZE:
+                gripper.states    |= STATE_ENABLE | STATE_INITIALIZE;
+                gripper.target_pos = 0;
+                break;
+
+            case DATC_COMMAND::GRIPPER_OPEN:
+                setMode(gripper, STATE_GRP_OPEN, 0);
+                break;
+
+            case DATC_COMMAND::GRIPPER_CLOSE:
+                setMode(gripper, STATE_GRP_CLOSE, kClosedPos);
+                break;
+
+            case DATC_COMMAND::SET_FINGER_POSITION:
+            case DATC_COMMAND::MOTOR_POSITION_CONTROL:
+                setMode(gripper, STATE_POS_CTRL, min<int>(max<int>(value_1, 0), kClosedPos));
+                break;
+
+            default:
+                break;
+        }
+
+        return true;
+    }
+
+    bool readRegisters(uint16_t slave_addr, int reg_addr, int nb, uint16_t *data) override {
+        waitBus(8, 5 + 2 * nb);
+
+        const Gripper &gripper = update(slave_addr);
+
+        for (int i = 0; i < nb; i++) {
+            switch (reg_addr + i) {
+                case kStatusRegAddr + 0: data[i] = gripper.states; break;
+                case kStatusRegAddr + 1: data[i] = (uint16_t) (gripper.finger_pos - 1259); break;
+                case kStatusRegAddr + 2: data[i] = (uint16_t) gripper.motor_cur; break;
+                case kStatusRegAddr + 3: data[i] = (uint16_t) gripper.motor_vel; break;
+                case kStatusRegAddr + 4: data[i] = (uint16_t) gripper.finger_pos; break;
+                case kStatusRegAddr + 7: data[i] = 240; break;
+                default:                 data[i] = 0; break;
+            }
+        }
+
+        return true;
+    }
+
+    uint64_t getTransactionCount() {return transactions_;}
+
+private:
+    static const uint16_t STATE_ENABLE     = 1 << 0;
+    static const uint16_t STATE_INITIALIZE = 1 << 1;
+    static const uint16_t STATE_POS_CTRL   = 1 << 2;
+    static const uint16_t STATE_GRP_OPEN   = 1 << 5;
+    static const uint16_t STATE_GRP_CLOSE  = 1 << 6;
+
+    static constexpr int kClosedPos  = 1000; /**< Finger position of a closed gripper */
+    static constexpr int kFingerVel  = 1650; /**< Finger position per second while moving */
+    static constexpr int kHoldingCur = 350;
+
+    struct Gripper {
+        uint16_t states = STATE_ENABLE | STATE_INITIALIZE;
+        int finger_pos  = 0;
+        int target_pos  = 0;
+        int16_t motor_vel = 0;
+        int16_t motor_cur = 0;
+        std::chrono::steady_clock::time_point t_update = std::chrono::steady_clock::now();
+    };
+
+    void setMode(Gripper &gripper, uint16_t mode, int target_pos) {
+        gripper.states     = (gripper.states & (STATE_ENABLE | STATE_INITIALIZE)) | mode;
+        gripper.target_pos = target_pos;
+    }
+
+    // Moves the finger of the slave towards its target for the time passed since the last access
+    Gripper &update(uint16_t slave_addr) {
+        Gripper &gripper = grippers_[slave_addr];
+        auto now = std::chrono::steady_clock::now();
+
+        double elapsed = std::chrono::duration<double>(now - gripper.t_update).count();
+        int step       = (int) (elapsed * kFingerVel);
+        int distance   = gripper.target_pos - gripper.finger_pos;
+
+        if (!(gripper.states & STATE_ENABLE) || distance == 0) {
+            gripper.motor_vel = 0;
+            gripper.motor_cur = (gripper.finger_pos >= kClosedPos) ? kHoldingCur : 0;
+        } else if (step > 0) {
+            gripper.finger_pos += (distance > 0) ? min(step, distance) : max(-step, distance);
+            gripper.motor_vel   = (distance > 0) ? 120 : -120;
+            gripper.motor_cur   = (distance > 0) ? 80 : -80;
+        } else {
+            return gripper; // Less than one position step, the time is kept for the next access
+        }
+
+        gripper.t_update = now;
+
+        return gripper;
+    }
+
+    // Request and response frames in bytes, each followed by the 3.5 character RTU silence
+    void waitBus(int request_size, int response_size) {
+        int duration_us = transaction_us_;
+
+        transactions_++;
+
+        if (duration_us < 0) {
+            const int bits_per_char = 1 + DATA_BIT + STOP_BIT + (PARITY_MODE == 'N' ? 0 : 1);
+            duration_us = (int) ((request_size + response_size + 7) * bits_per_char * 1000000LL / BAUDRATE);
+        }
+
+        if (duration_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(duration_us));
+        }
+    }
+
+    int transaction_us_;
+    atomic<uint64_t> transactions_{0};
+
+    unordered_map<uint16_t, Gripper> grippers_; /**< Calls are serialized by ModbusComm */
+};
+
+#endif // DATC_SIMULATOR_HPP
@@ -0,0 +1,91 @@
+/**
+ * @file fleet_model.hpp
+ * @brief Table model of the fleet page over FleetTable, see fleet_table.hpp.
+ * @details update() is called once per frame. It signals dataChanged for the runs of cells that
+ * changed and resets the model only when grippers appear or disappear.
+ * @version 1.0
+ * @date 2024-04-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef FLEET_MODEL_HPP
+#define FLEET_MODEL_HPP
+
+#include <QAbstractTableModel>
+#include <QBrush>
+#include <QColor>
+
+#include "fleet_table.hpp"
+
+class FleetModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    FleetModel(QObject *parent = nullptr) : QAbstractTableModel(parent) {}
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : (int) table_.getRowCount();
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : kFleetColumns;
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override {
+        if (!index.isValid() || index.row() >= rowCount()) {
+            return QVariant();
+        }
+
+        switch (role) {
+            case Qt::DisplayRole:
+                return QString::fromStdString(table_.getCell(index.row(), index.column()));
+
+            case Qt::TextAlignmentRole:
+                return (int) Qt::AlignCenter;
+
+            case Qt::ForegroundRole:
+                if (index.column() == (int) FleetColumn::FAULT && table_.isFault(index.row())) {
+                    return QBrush(QColor("#CC0000"));
+                }
+                return QVariant();
+
+            default:
+                return QVariant();
+        }
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override {
+        if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+            return QVariant();
+        }
+        return QString(FleetTable::getColumnName(section));
+    }
+
+    // Records of a frame, elapsed_s since the last frame for the rates
+    void update(const vector<SlaveRecord> &records, double elapsed_s) {
+        const bool is_same_rows = table_.hasSameRows(records);
+
+        if (!is_same_rows) {
+            beginResetModel();
+        }
+
+        table_.update(records, elapsed_s, changed_);
+
+        if (!is_same_rows) {
+            endResetModel();
+            return;
+        }
+
+        for (const FleetCellRange &range : changed_) {
+            Q_EMIT dataChanged(index(range.row, range.first_column), index(range.row, range.last_column),
+                               {Qt::DisplayRole, Qt::ForegroundRole});
+        }
+    }
+
+private:
+    FleetTable table_;
+    vector<FleetCellRange> changed_;
+};
+
+#endif // FLEET_MODEL_HPP
@@ -0,0 +1,93 @@
+/**
+ * @file fleet_table.hpp
+ * @brief One row per polled gripper for the fleet page, as text cells diffed between frames.
+ * @details The page takes the slave records once per frame. Only the cells whose text changed
+ * are reported, as runs of neighbouring columns of a row, so a view redraws what changed and
+ * hundreds of idle rows cost a comparison each.
+ * @version 1.0
+ * @date 2024-04-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef FLEET_TABLE_HPP
+#define FLEET_TABLE_HPP
+
+#include <string>
+#include <vector>
+#include "datc_ctrl.hpp"
+
+using namespace std;
+
+// Latest status and read counters of a polled slave
+struct SlaveRecord {
+    string bus;
+    uint16_t slave = 0;
+    DatcStatus status;
+    bool has_status = false; /**< False until the first successful read */
+    uint64_t reads  = 0;
+    uint64_t errors = 0;     /**< Failed reads, not counted in reads */
+};
+
+enum class FleetColumn {
+    BUS        = 0,
+    SLAVE      = 1,
+    STATE      = 2,
+    POSITION   = 3,
+    CURRENT    = 4,
+    VOLTAGE    = 5,
+    FAULT      = 6,
+    POLL_RATE  = 7,
+    ERROR_RATE = 8,
+};
+
+const int kFleetColumns = 9;
+
+// Columns first_column to last_column of a row, both included
+struct FleetCellRange {
+    int row;
+    int first_column;
+    int last_column;
+};
+
+class FleetTable {
+public:
+    static const char *getColumnName(int column);
+
+    /**
+     * @brief Takes the records of a frame, rows ordered by bus and slave.
+     * @param elapsed_s Since the last update, for the rates, 0 leaves them as they are
+     * @param changed Cleared, then filled with the cells whose text changed
+     * @return false if rows were added or removed, changed is then empty and every row is new
+     */
+    bool update(const vector<SlaveRecord> &records, double elapsed_s, vector<FleetCellRange> &changed);
+
+    // True if update() with these records would keep the rows, only their cells may change
+    bool hasSameRows(const vector<SlaveRecord> &records) const;
+
+    size_t getRowCount() const {return rows_.size();}
+    const string &getCell(size_t row, int column) const {return rows_[row].cells[column];}
+    bool isFault(size_t row) const {return rows_[row].is_fault;}
+
+private:
+    bool isSameRows(const vector<const SlaveRecord *> &sorted) const;
+
+    struct Row {
+        string bus;
+        uint16_t slave = 0;
+        uint64_t reads  = 0;
+        uint64_t errors = 0;
+        bool has_counters = false; /**< reads and errors taken, the rates start at the next frame */
+        int64_t poll_rate  = -1;   /**< In tenths as shown, -1 for none */
+        int64_t error_rate = -1;
+        bool has_cells  = false;
+        bool has_status = false;
+        uint16_t registers[kStatusRegNum] = {}; /**< Of the status cells shown */
+        bool is_fault = false;
+        string cells[kFleetColumns];
+    };
+
+    vector<Row> rows_;
+};
+
+#endif // FLEET_TABLE_HPP
@@ -12,14 +12,20 @@
 #define MAIN_WINDOW_HPP
 
 #include <QTimer>
+#include <QEvent>
+#include <QElapsedTimer>
 #include <QLineEdit>
 #include <QList>
 #include <QMainWindow>
 
+#include <map>
+#include <atomic>
+#include <thread>
 #include <iostream>
 #include <math.h>
 
 #include "datc_comm_interface.hpp"
+#include "station_config.hpp"
 #include "ui_main_window.h"
 #include "custom_widget.hpp"
 
@@ -36,13 +42,6 @@ using namespace std;
 
 namespace gripper_ui {
 
-enum class WidgetSeq {
-    MODBUS_WIDGET        = 0,
-    DATC_CTRL_WIDGET     = 1,
-    ADVANCED_CTRL_WIDGET = 2,
-    TCP_WIDGET           = 3
-};
-
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
@@ -50,8 +49,14 @@ public:
     MainWindow(int argc, char** argv, bool &success, QWidget *parent = 0);
     ~MainWindow();
 
+    // monotonicMicros() at the start of main(), the first frame is timed from it
+    void setStartTime(uint64_t t_start_us);
+
 public Q_SLOTS:
-    void timerCallback();
+    // Shows what changed since the last status view shown, queued by the poll thread
+    void refreshStatus();
+    void updatePerfPage();
+    void updateFleetPage();
 
     // Enable & disable
     void datcEnable();
@@ -89,23 +94,91 @@ public Q_SLOTS:
     void on_pushButton_select_datc_ctrl_clicked();
     void on_pushButton_select_adv_clicked();
     void on_pushButton_select_tcp_clicked();
+    void on_pushButton_select_perf_clicked();
+    void on_pushButton_select_fleet_clicked();
     void on_pushButton_modbus_refresh_clicked();
 
     // Serial port find function
     std::vector<std::string> getSerialPortLists();
 
+    // Results of the gui worker, see submitCommand()
+    void showCommandResult(QString name, bool success, double elapsed_ms);
+    void showModbusStarted(bool success);
+    void showStationStarted(bool success, QString failed, double ready_ms, double first_status_ms);
+    void showSerialPorts(QStringList ports, bool keep_current);
+
+Q_SIGNALS:
+    // Emitted on the gui worker, connected queued
+    void commandDone(QString name, bool success, double elapsed_ms);
+    void modbusStarted(bool success);
+    void stationStarted(bool success, QString failed, double ready_ms, double first_status_ms);
+    void serialPortsFound(QStringList ports, bool keep_current);
+
+protected:
+    bool event(QEvent *event) override;
+
 private:
+    // Station file of --config, else datc_config.json in the working directory if there is one
+    bool loadStationFile(int argc, char **argv);
+    void applyStationFile();
+    void startStationAsync();
+
+    // Pages seldom visited, built on their first visit
+    AdvancedCtrlWidget *buildAdvancedPage();
+#ifndef RCLCPP__RCLCPP_HPP_
+    TcpWidget *buildTcpPage();
+#endif
+
+    void scanSerialPorts(bool keep_current);
+    void finishStartup();
+
+    // Queues the request for the gui worker, its result comes back as commandDone
+    void submitCommand(const QString &name, DATC_COMMAND command, bool has_value_1 = false, uint16_t value_1 = 0);
+    void submitCommand(const QString &name, const CommandRequest &request);
+
+    void connectSliderSpinbox(QSlider *slider, QDoubleSpinBox *spinbox);
+
     Ui::MainWindow *ui_;
 
     ModbusWidget       *modbus_widget_;
     DatcCtrlWidget     *datc_ctrl_widget_;
-    TcpWidget          *tcp_widget_;
-    AdvancedCtrlWidget *advanced_ctrl_widget_;
+    TcpWidget          *tcp_widget_           = nullptr;
+    AdvancedCtrlWidget *advanced_ctrl_widget_ = nullptr;
+    PerfWidget         *perf_widget_;
+    FleetWidget        *fleet_widget_;
+    ToastWidget        *toast_;
 
     QString menu_btn_active_str_, menu_btn_inactive_str_;
     QString btn_active_str_, btn_inactive_str_;
+    QString btn_style_str_;
+
+    StatusView view_shown_;
+    bool is_view_shown_ = false;
+    atomic<bool> flag_refresh_pending_{false}; /**< At most one refresh queued at a time */
+
+    // Time the gui thread spends showing status views, on the performance page
+    uint64_t gui_refreshes_ = 0, gui_refreshes_prev_ = 0;
+    qint64 gui_refresh_ns_ = 0, gui_refresh_ns_prev_ = 0;
+
+    QTimer *perf_refresh_timer_;
+
+    // One frame of the fleet page, its rates are taken over the interval
+    QTimer *fleet_refresh_timer_;
+    QElapsedTimer fleet_timer_;
+
+    // Counters of the last refresh of the performance page, rates are taken over the interval
+    PerfStats perf_prev_;
+    QElapsedTimer perf_timer_;
+
+    StationConfig station_config_;
+    bool has_station_config_ = false;
+
+    std::thread port_thread_;
+    atomic<bool> flag_port_scan_running_{false};
+
+    uint64_t t_start_us_ = 0;
+    bool is_first_frame_ = false;
 
-    QTimer *timer_;
     DatcCommInterface *datc_interface_;
 };
 
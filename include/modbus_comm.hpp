@@ -16,11 +16,18 @@
 #include <unistd.h>
 #else
 #include <modbus/modbus-rtu.h>
+#include <unistd.h>
 #endif
 
 #include <mutex>
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <cerrno>
+
+#include "trace_recorder.hpp"
+#include "perf_counters.hpp"
+#include "traffic_recorder.hpp"
 
 #define BAUDRATE      38400
 #define DEBUG_MODE    false
@@ -32,6 +39,24 @@ using namespace std;
 
 #define COUT(...) cout << __VA_ARGS__ << endl
 
+/**
+ * @brief Replaces the serial bus, e.g. by a simulated gripper for benchmarks or for running
+ * without hardware. Calls are serialized by ModbusComm.
+ */
+class ModbusTransport {
+public:
+    virtual ~ModbusTransport() {}
+
+    virtual bool writeRegisters(uint16_t slave_addr, int reg_addr, int nb, const uint16_t *data) = 0;
+    virtual bool readRegisters(uint16_t slave_addr, int reg_addr, int nb, uint16_t *data) = 0;
+};
+
+struct ModbusStats {
+    LatencySnapshot round_trip; /**< Of every transaction, failed ones included */
+    uint64_t errors   = 0;      /**< Failed transactions, timeouts included */
+    uint64_t timeouts = 0;
+};
+
 class ModbusComm {
 public:
     ModbusComm() {}
@@ -39,10 +64,10 @@ public:
         modbusRelease();
     }
 
-    bool modbusInit(const char *port_name, uint16_t slave_addr) {
+    bool modbusInit(const char *port_name, uint16_t slave_addr, int baudrate = BAUDRATE) {
         unique_lock<mutex> lg(mutex_comm_);
 
-        mb_ = modbus_new_rtu(port_name, BAUDRATE, PARITY_MODE, DATA_BIT, STOP_BIT);
+        mb_ = modbus_new_rtu(port_name, baudrate, PARITY_MODE, DATA_BIT, STOP_BIT);
 
         modbus_rtu_set_serial_mode(mb_, MODBUS_RTU_RS485);
         modbus_rtu_set_rts_delay  (mb_, 300);
@@ -56,12 +81,14 @@ public:
         if (modbus_set_slave(mb_, slave_addr) == -1) {
             fprintf(stderr, "server_id= %d Invalid slave ID: %s\n", slave_addr, modbus_strerror(errno));
             modbus_free(mb_);
+            mb_ = NULL;
             return false;
         }
 
         if (modbus_connect(mb_) == -1) {
             fprintf(stderr, "Unable to connect %s\n", modbus_strerror(errno));
             modbus_free(mb_);
+            mb_ = NULL;
             return false;
         }
 
@@ -72,14 +99,36 @@ public:
         return true;
     }
 
+    /**
+     * @param transport Owned by the caller, used until modbusRelease()
+     */
+    bool modbusInit(ModbusTransport *transport, uint16_t slave_addr) {
+        unique_lock<mutex> lg(mutex_comm_);
+
+        transport_ = transport;
+        slave_num_ = slave_addr;
+        connection_state_ = true;
+        COUT("Modbus communication initiated (custom transport)");
+
+        return true;
+    }
+
     void modbusRelease() {
         slave_num_ = 0;
         connection_state_ = false;
 
         unique_lock<mutex> lg(mutex_comm_);
 
+        transport_ = NULL;
+
+        // Also reached from the destructor after an explicit release
+        if (mb_ == NULL) {
+            return;
+        }
+
         modbus_close(mb_);
         modbus_free (mb_);
+        mb_ = NULL;
         COUT("Modbus released");
     }
 
@@ -88,10 +137,11 @@ public:
 
         unique_lock<mutex> lg(mutex_comm_);
 
-        if (modbus_set_slave(mb_, slave_addr) == -1) {
+        if (transport_ == NULL && modbus_set_slave(mb_, slave_addr) == -1) {
             fprintf(stderr, "server_id= %d Invalid slave ID: %s\n", slave_addr, modbus_strerror(errno));
             modbus_close(mb_);
             modbus_free (mb_);
+            mb_ = NULL;
             connection_state_ = false;
             return false;
         }
@@ -110,61 +160,100 @@ public:
             return false;
         }
 
+        tracing::Span lock_span(tracing::Stage::MODBUS_LOCK);
         unique_lock<mutex> lg(mutex_comm_);
+        lock_span.end();
 
-        uint16_t register_number = data.size();
+        tracing::Span span(tracing::Stage::MODBUS_WRITE);
 
-        if (register_number == 1) {
-            if (modbus_write_register(mb_, reg_addr, data[0]) == -1) {
-                fprintf(stderr, "Failed to modbus write register %d : %s\n", reg_addr, modbus_strerror(errno));
-                return false;
-            }
-        } else if (modbus_write_registers(mb_, reg_addr, register_number, &data[0]) == -1) {
-            fprintf(stderr, "Failed to modbus write register %d : %s\n", reg_addr, modbus_strerror(errno));
+        return writeRegisters(reg_addr, data.size(), &data[0]);
+    }
+
+    bool sendData(int reg_addr, uint16_t data) {
+        if (!connection_state_) {
+            COUT("Modbus communication is not enabled.");
             return false;
         }
 
-        return true;
+        tracing::Span lock_span(tracing::Stage::MODBUS_LOCK);
+        unique_lock<mutex> lg(mutex_comm_);
+        lock_span.end();
+
+        tracing::Span span(tracing::Stage::MODBUS_WRITE);
+
+        return writeRegisters(reg_addr, 1, &data);
     }
 
-    bool sendData(int reg_addr, uint16_t data) {
+    bool recvData(int reg_addr, int nb, vector<uint16_t> &data) {
         if (!connection_state_) {
             COUT("Modbus communication is not enabled.");
             return false;
         }
 
+        tracing::Span lock_span(tracing::Stage::MODBUS_LOCK);
         unique_lock<mutex> lg(mutex_comm_);
+        lock_span.end();
 
-        if (modbus_write_register(mb_, reg_addr, data) == -1) {
-            fprintf(stderr, "Failed to modbus write register %d : %s\n", reg_addr, modbus_strerror(errno));
+        tracing::Span span(tracing::Stage::MODBUS_READ);
+        uint16_t data_temp[nb];
+        auto time_start = std::chrono::steady_clock::now();
+
+        if (transport_ != NULL) {
+            bool result = transport_->readRegisters(slave_num_, reg_addr, nb, data_temp);
+
+            if (!recordTransaction(time_start, result, traffic::RecordType::MODBUS_READ, slave_num_, reg_addr, nb, data_temp)) {
+                return false;
+            }
+        } else if (!recordTransaction(time_start, modbus_read_registers(mb_, reg_addr, nb, data_temp) != -1,
+                                      traffic::RecordType::MODBUS_READ, slave_num_, reg_addr, nb, data_temp)) {
+            fprintf(stderr, "Failed to read input registers! : %s\n", modbus_strerror(errno));
             return false;
-        } else {
-            return true;
         }
+
+        data.assign(data_temp, data_temp + nb);
+
+        return true;
     }
 
-    bool recvData(int reg_addr, int nb, vector<uint16_t> &data) {
+    /**
+     * @brief Reads registers of another slave on the same bus, the current slave is kept.
+     */
+    bool recvData(uint16_t slave_addr, int reg_addr, int nb, vector<uint16_t> &data) {
         if (!connection_state_) {
             COUT("Modbus communication is not enabled.");
             return false;
         }
 
+        tracing::Span lock_span(tracing::Stage::MODBUS_LOCK);
         unique_lock<mutex> lg(mutex_comm_);
+        lock_span.end();
 
+        tracing::Span span(tracing::Stage::MODBUS_READ);
         uint16_t data_temp[nb];
+        auto time_start = std::chrono::steady_clock::now();
 
-        if (modbus_read_registers(mb_, reg_addr, nb, data_temp) == -1) {
-            mutex_comm_.unlock();
-            fprintf(stderr, "Failed to read input registers! : %s\n", modbus_strerror(errno));
-            return false;
+        if (transport_ != NULL) {
+            bool result = transport_->readRegisters(slave_addr, reg_addr, nb, data_temp);
+
+            if (!recordTransaction(time_start, result, traffic::RecordType::MODBUS_READ, slave_addr, reg_addr, nb, data_temp)) {
+                return false;
+            }
+            data.assign(data_temp, data_temp + nb);
+            return true;
         }
 
-        data.clear();
+        modbus_set_slave(mb_, slave_addr);
+        bool result = recordTransaction(time_start, modbus_read_registers(mb_, reg_addr, nb, data_temp) != -1,
+                                        traffic::RecordType::MODBUS_READ, slave_addr, reg_addr, nb, data_temp);
+        modbus_set_slave(mb_, slave_num_);
 
-        for (auto i : data_temp) {
-            data.push_back(i);
+        if (!result) {
+            fprintf(stderr, "Failed to read input registers of slave %d! : %s\n", slave_addr, modbus_strerror(errno));
+            return false;
         }
 
+        data.assign(data_temp, data_temp + nb);
+
         return true;
     }
 
@@ -172,13 +261,77 @@ public:
 
     uint16_t getSlaveAddr() {return slave_num_;}
 
+    // Lock free, does not wait for a transaction in progress
+    ModbusStats getStats() const {
+        ModbusStats stats;
+
+        stats.round_trip = round_trip_.snapshot();
+        stats.errors     = errors_.load(memory_order_relaxed);
+        stats.timeouts   = timeouts_.load(memory_order_relaxed);
+
+        return stats;
+    }
+
 private:
+    // mutex_comm_ must be held by the caller
+    bool writeRegisters(int reg_addr, int nb, const uint16_t *data) {
+        auto time_start = std::chrono::steady_clock::now();
+
+        if (transport_ != NULL) {
+            bool result = transport_->writeRegisters(slave_num_, reg_addr, nb, data);
+
+            return recordTransaction(time_start, result, traffic::RecordType::MODBUS_WRITE, slave_num_, reg_addr, nb, data);
+        }
+
+        int result = (nb == 1) ? modbus_write_register(mb_, reg_addr, data[0])
+                               : modbus_write_registers(mb_, reg_addr, nb, data);
+
+        if (!recordTransaction(time_start, result != -1, traffic::RecordType::MODBUS_WRITE, slave_num_, reg_addr, nb, data)) {
+            fprintf(stderr, "Failed to modbus write register %d : %s\n", reg_addr, modbus_strerror(errno));
+            return false;
+        }
+
+        return true;
+    }
+
+    // libmodbus reports a missing response as ETIMEDOUT, errno is left alone for the caller
+    bool recordTransaction(std::chrono::steady_clock::time_point time_start, bool success,
+                           traffic::RecordType type, uint16_t slave_addr, int reg_addr, int nb, const uint16_t *data) {
+        auto elapsed = std::chrono::steady_clock::now() - time_start;
+        uint64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        bool timeout = !success && errno == ETIMEDOUT;
+
+        round_trip_.record(elapsed_us);
+
+        if (!success) {
+            errors_.fetch_add(1, memory_order_relaxed);
+            if (timeout) {
+                timeouts_.fetch_add(1, memory_order_relaxed);
+            }
+        }
+
+        if (traffic::isRecording()) {
+            // A failed read has no registers, a failed write keeps the request
+            bool has_data = success || type == traffic::RecordType::MODBUS_WRITE;
+            uint8_t flags = (success ? 0 : traffic::FLAG_ERROR) | (timeout ? traffic::FLAG_TIMEOUT : 0);
+
+            traffic::recordModbus(type, slave_addr, reg_addr, has_data ? nb : 0, data, (uint32_t) elapsed_us, flags);
+        }
+
+        return success;
+    }
+
     mutex mutex_comm_;
-    modbus_t *mb_;
+    modbus_t *mb_ = NULL;
+    ModbusTransport *transport_ = NULL;
 
     bool connection_state_ = false;
 
     uint16_t slave_num_ = 0;
+
+    LatencyHistogram round_trip_;
+    atomic<uint64_t> errors_{0};
+    atomic<uint64_t> timeouts_{0};
 };
 
 #endif // MODBUS_COMM_HPP
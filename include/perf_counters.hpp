@@ -0,0 +1,107 @@
+/**
+ * @file perf_counters.hpp
+ * @brief Latency histograms and counters published by the poll loop, the bus and the worker.
+ * @details Writers only do relaxed atomic increments, so a reader (the GUI page, a daemon log)
+ * takes snapshots at its own rate without locks and without waiting for a busy bus. Buckets are
+ * powers of two of microseconds, from < 64 us up to the last bucket which is open ended.
+ * @version 1.0
+ * @date 2024-04-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+const size_t   kLatencyBuckets     = 16;
+const uint64_t kLatencyFirstBucket = 64; /**< Upper bound of the first bucket in us */
+
+struct LatencySnapshot {
+    uint64_t counts[kLatencyBuckets] = {};
+    uint64_t count  = 0;
+    uint64_t sum_us = 0;
+    uint64_t max_us = 0; /**< Since start, not windowed by operator- */
+
+    // Exclusive upper bound of the bucket, the last one has none
+    static uint64_t bucketUpperUs(size_t bucket) {
+        return kLatencyFirstBucket << bucket;
+    }
+
+    double meanUs() const {
+        return (count != 0) ? (double) sum_us / count : 0;
+    }
+
+    // Upper bound of the bucket holding the quantile q of [0, 1], 0 without samples
+    uint64_t percentileUs(double q) const {
+        uint64_t rank = (uint64_t) (q * count);
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < kLatencyBuckets; i++) {
+            seen += counts[i];
+            if (count != 0 && seen > rank) {
+                return (i + 1 < kLatencyBuckets) ? bucketUpperUs(i) : max_us;
+            }
+        }
+        return (count != 0) ? max_us : 0;
+    }
+
+    // Samples recorded between an earlier snapshot and this one
+    LatencySnapshot operator-(const LatencySnapshot &earlier) const {
+        LatencySnapshot window;
+
+        for (size_t i = 0; i < kLatencyBuckets; i++) {
+            window.counts[i] = counts[i] - earlier.counts[i];
+        }
+        window.count  = count - earlier.count;
+        window.sum_us = sum_us - earlier.sum_us;
+        window.max_us = max_us;
+
+        return window;
+    }
+};
+
+class LatencyHistogram {
+public:
+    void record(uint64_t us) {
+        size_t bucket = 0;
+
+        while (bucket + 1 < kLatencyBuckets && us >= LatencySnapshot::bucketUpperUs(bucket)) {
+            bucket++;
+        }
+
+        counts_[bucket].fetch_add(1, memory_order_relaxed);
+        sum_us_.fetch_add(us, memory_order_relaxed);
+        count_.fetch_add(1, memory_order_relaxed);
+
+        uint64_t max_us = max_us_.load(memory_order_relaxed);
+        while (us > max_us && !max_us_.compare_exchange_weak(max_us, us, memory_order_relaxed)) {}
+    }
+
+    // Counters are read one by one, a sample recorded meanwhile may be counted in some only
+    LatencySnapshot snapshot() const {
+        LatencySnapshot snapshot;
+
+        for (size_t i = 0; i < kLatencyBuckets; i++) {
+            snapshot.counts[i] = counts_[i].load(memory_order_relaxed);
+        }
+        snapshot.count  = count_.load(memory_order_relaxed);
+        snapshot.sum_us = sum_us_.load(memory_order_relaxed);
+        snapshot.max_us = max_us_.load(memory_order_relaxed);
+
+        return snapshot;
+    }
+
+private:
+    atomic<uint64_t> counts_[kLatencyBuckets] = {};
+    atomic<uint64_t> count_{0};
+    atomic<uint64_t> sum_us_{0};
+    atomic<uint64_t> max_us_{0};
+};
+
+#endif // PERF_COUNTERS_HPP
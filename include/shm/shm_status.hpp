@@ -0,0 +1,108 @@
+/**
+ * @file shm_status.hpp
+ * @brief Layout of the shared-memory status segment, shared by the writer (this program) and
+ * local readers.
+ * @details The segment holds the latest status of every modbus slave and a ring of the most
+ * recent status of all slaves. Each slot is guarded by a seqlock: the writer makes the version
+ * odd, writes the record and makes it even again, and a reader accepts a copy only if it read
+ * the same even version before and after copying. There is a single writer, the poll loop.
+ * @version 1.0
+ * @date 2024-04-01
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SHM_STATUS_HPP
+#define SHM_STATUS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace shm_communication {
+
+const char SHM_DEFAULT_NAME[] = "/datc_status";
+
+const uint32_t SHM_MAGIC          = 0x43544144; /**< "DATC" */
+const uint32_t SHM_LAYOUT_VERSION = 1;
+const size_t SHM_SLAVE_COUNT      = 248;        /**< Modbus addresses 0 to 247 */
+const size_t SHM_HISTORY_SIZE     = 1024;       /**< Power of 2, about 20 s of one slave at 50 Hz */
+
+struct ShmStatusRecord {
+    uint64_t t_us       = 0; /**< Monotonic clock of the writer, microseconds */
+    uint32_t sequence   = 0; /**< Per slave */
+    uint16_t slave      = 0;
+    uint16_t states     = 0;
+    int16_t  motor_pos  = 0;
+    int16_t  motor_vel  = 0;
+    int16_t  motor_cur  = 0;
+    uint16_t finger_pos = 0;
+    uint16_t voltage    = 0;
+    uint16_t reserved[3] = {};
+};
+
+struct alignas(64) ShmSlot {
+    atomic<uint32_t> version; /**< Odd while the record is being written */
+    uint32_t reserved;
+    uint64_t index;           /**< Write count of a latest slot, position of a history slot */
+    ShmStatusRecord record;
+};
+
+struct ShmStatusSegment {
+    uint32_t magic;
+    uint32_t layout_version;
+    atomic<uint32_t> alive;        /**< Cleared when the writer closes the segment */
+    uint32_t writer_pid;           /**< Tells the segment of a running writer from one left by a crash */
+    atomic<uint64_t> history_head; /**< Records written to the history so far */
+
+    ShmSlot latest[SHM_SLAVE_COUNT];
+    ShmSlot history[SHM_HISTORY_SIZE];
+};
+
+static_assert(atomic<uint32_t>::is_always_lock_free && atomic<uint64_t>::is_always_lock_free,
+              "Atomics shared between processes must be lock-free");
+static_assert((SHM_HISTORY_SIZE & (SHM_HISTORY_SIZE - 1)) == 0, "History size must be a power of 2");
+
+inline void writeSlot(ShmSlot &slot, uint64_t index, const ShmStatusRecord &record) {
+    uint32_t version = slot.version.load(memory_order_relaxed);
+
+    slot.version.store(version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot.index = index;
+    memcpy(&slot.record, &record, sizeof(record));
+
+    slot.version.store(version + 2, memory_order_release);
+}
+
+/**
+ * @brief Copies a slot, giving up after a few attempts that raced with the writer so that a
+ * reader never waits on it.
+ */
+inline bool readSlot(const ShmSlot &slot, uint64_t &index, ShmStatusRecord &record) {
+    const int kMaxAttempts = 8;
+
+    for (int attempt = 0; attempt < kMaxAttempts; attempt++) {
+        uint32_t version = slot.version.load(memory_order_acquire);
+
+        if (version & 1) {
+            continue;
+        }
+
+        index = slot.index;
+        memcpy(&record, &slot.record, sizeof(record));
+
+        atomic_thread_fence(memory_order_acquire);
+
+        if (slot.version.load(memory_order_relaxed) == version) {
+            return version != 0;
+        }
+    }
+
+    return false;
+}
+} // namespace shm_communication
+#endif
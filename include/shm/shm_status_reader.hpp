@@ -0,0 +1,135 @@
+/**
+ * @file shm_status_reader.hpp
+ * @brief Reader of the shared-memory status segment, for processes on the same machine.
+ * @details Header-only, depends on nothing but POSIX (link with -lrt on older glibc). Reads copy
+ * a single slot out of the mapping and never block the writer or each other.
+ *
+ * @code
+ * shm_communication::ShmStatusReader reader;
+ * shm_communication::ShmStatusRecord status;
+ *
+ * if (reader.open() && reader.readLatest(1, status)) {
+ *     printf("finger_pos %u\n", status.finger_pos);
+ * }
+ * @endcode
+ * @version 1.0
+ * @date 2024-04-01
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SHM_STATUS_READER_HPP
+#define SHM_STATUS_READER_HPP
+
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "shm_status.hpp"
+
+using namespace std;
+
+namespace shm_communication {
+
+class ShmStatusReader {
+public:
+    ShmStatusReader() {}
+    ~ShmStatusReader() {close();}
+
+    ShmStatusReader(const ShmStatusReader &) = delete;
+    ShmStatusReader &operator=(const ShmStatusReader &) = delete;
+
+public:
+    bool open(const string &name = SHM_DEFAULT_NAME) {
+        close();
+
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+        if (fd < 0) {
+            return false;
+        }
+
+        void *address = mmap(NULL, sizeof(ShmStatusSegment), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (address == MAP_FAILED) {
+            return false;
+        }
+
+        segment_ = static_cast<const ShmStatusSegment *>(address);
+
+        if (segment_->magic != SHM_MAGIC || segment_->layout_version != SHM_LAYOUT_VERSION) {
+            close();
+            return false;
+        }
+        atomic_thread_fence(memory_order_acquire);
+
+        return true;
+    }
+
+    void close() {
+        if (segment_ != NULL) {
+            munmap((void *) segment_, sizeof(ShmStatusSegment));
+            segment_ = NULL;
+        }
+    }
+
+    /**
+     * @brief False once the writer closed the segment; reopen to follow a restarted writer.
+     */
+    bool isAlive() const {
+        return segment_ != NULL && segment_->alive.load(memory_order_acquire);
+    }
+
+    /**
+     * @return false if the slave was never written or the writer kept racing with this read
+     */
+    bool readLatest(uint16_t slave, ShmStatusRecord &record) const {
+        uint64_t index;
+
+        return segment_ != NULL && slave < SHM_SLAVE_COUNT && readSlot(segment_->latest[slave], index, record);
+    }
+
+    /**
+     * @brief Position the next status will be written to in the history.
+     */
+    uint64_t getHistoryHead() const {
+        return segment_ ? segment_->history_head.load(memory_order_acquire) : 0;
+    }
+
+    /**
+     * @brief Reads the history from 'cursor' up to the head and advances the cursor.
+     * @return Number of records copied to 'out'; records already overwritten are skipped and
+     * counted in 'lost'
+     */
+    size_t readHistory(uint64_t &cursor, ShmStatusRecord *out, size_t max_records, uint64_t &lost) const {
+        uint64_t head = getHistoryHead();
+        size_t count  = 0;
+
+        lost = 0;
+
+        if (head > cursor + SHM_HISTORY_SIZE) {
+            lost   = head - SHM_HISTORY_SIZE - cursor;
+            cursor = head - SHM_HISTORY_SIZE;
+        }
+
+        while (cursor < head && count < max_records) {
+            uint64_t index;
+
+            if (readSlot(segment_->history[cursor & (SHM_HISTORY_SIZE - 1)], index, out[count]) && index == cursor) {
+                count++;
+            } else {
+                lost++; // Overwritten while reading
+            }
+            cursor++;
+        }
+
+        return count;
+    }
+
+private:
+    const ShmStatusSegment *segment_ = NULL;
+};
+} // namespace shm_communication
+#endif
@@ -0,0 +1,156 @@
+/**
+ * @file shm_status_writer.hpp
+ * @brief Creates the shared-memory status segment and publishes status into it.
+ * @version 1.0
+ * @date 2024-04-01
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef SHM_STATUS_WRITER_HPP
+#define SHM_STATUS_WRITER_HPP
+
+#include <string>
+#include <iostream>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_status.hpp"
+
+using namespace std;
+
+namespace shm_communication {
+
+class ShmStatusWriter {
+public:
+    ShmStatusWriter() {}
+    ~ShmStatusWriter() {close();}
+
+    ShmStatusWriter(const ShmStatusWriter &) = delete;
+    ShmStatusWriter &operator=(const ShmStatusWriter &) = delete;
+
+public:
+    bool open(const string &name = SHM_DEFAULT_NAME) {
+        close();
+
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+        // A segment left by a writer that crashed is replaced, the one of a running writer is not
+        if (fd < 0 && errno == EEXIST && removeStale(name)) {
+            fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        }
+
+        if (fd < 0) {
+            cout << "[Error] Shared memory " << name << " could not be created" << endl;
+            return false;
+        }
+
+        void *address = MAP_FAILED;
+
+        if (ftruncate(fd, sizeof(ShmStatusSegment)) == 0) {
+            address = mmap(NULL, sizeof(ShmStatusSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+
+        if (address == MAP_FAILED) {
+            cout << "[Error] Shared memory " << name << " could not be mapped" << endl;
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        // The new segment is zero-filled, so every slot starts invalid
+        segment_ = static_cast<ShmStatusSegment *>(address);
+
+        segment_->layout_version = SHM_LAYOUT_VERSION;
+        segment_->writer_pid     = (uint32_t) getpid();
+        segment_->alive.store(1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        segment_->magic = SHM_MAGIC;
+
+        name_ = name;
+
+        return true;
+    }
+
+    void close() {
+        if (segment_ == NULL) {
+            return;
+        }
+
+        segment_->alive.store(0, memory_order_release);
+
+        munmap(segment_, sizeof(ShmStatusSegment));
+        shm_unlink(name_.c_str());
+
+        segment_ = NULL;
+    }
+
+    bool isOpen() const {
+        return segment_ != NULL;
+    }
+
+    // Only one thread may write
+    void write(const ShmStatusRecord &record) {
+        if (segment_ == NULL || record.slave >= SHM_SLAVE_COUNT) {
+            return;
+        }
+
+        ShmSlot &latest = segment_->latest[record.slave];
+        writeSlot(latest, latest.index + 1, record);
+
+        uint64_t head = segment_->history_head.load(memory_order_relaxed);
+        writeSlot(segment_->history[head & (SHM_HISTORY_SIZE - 1)], head, record);
+        segment_->history_head.store(head + 1, memory_order_release);
+    }
+
+private:
+    static bool isRunning(uint32_t pid) {
+        return pid != 0 && (kill((pid_t) pid, 0) == 0 || errno == EPERM);
+    }
+
+    // Unlinks the segment unless a running writer owns it
+    static bool removeStale(const string &name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+
+        if (fd < 0) {
+            return errno == ENOENT;
+        }
+
+        struct stat st;
+        void *address = MAP_FAILED;
+
+        if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(ShmStatusSegment)) {
+            address = mmap(NULL, sizeof(ShmStatusSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+
+        if (address != MAP_FAILED) {
+            ShmStatusSegment *segment = static_cast<ShmStatusSegment *>(address);
+
+            if (segment->magic == SHM_MAGIC && segment->alive.load(memory_order_acquire) != 0
+                && isRunning(segment->writer_pid)) {
+                cout << "[Error] Shared memory " << name << " is in use by process " << segment->writer_pid << endl;
+                munmap(address, sizeof(ShmStatusSegment));
+                return false;
+            }
+
+            // Readers still attached to the stale segment see its writer gone
+            segment->alive.store(0, memory_order_release);
+            munmap(address, sizeof(ShmStatusSegment));
+        }
+
+        shm_unlink(name.c_str());
+
+        return true;
+    }
+
+private:
+    ShmStatusSegment *segment_ = NULL;
+    string name_;
+};
+} // namespace shm_communication
+#endif
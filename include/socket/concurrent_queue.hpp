@@ -15,6 +15,9 @@
 #define CONCURRENT_QUEUE_HPP
 
 #include <queue>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
 
 using namespace std;
 
@@ -28,14 +31,44 @@ public:
 
 public:
     void push(Data const &data) {
+        unique_lock<mutex> lg(mutex_);
         queue_.push(data);
+        lg.unlock();
+        cv_.notify_one();
+    }
+
+    /**
+     * @brief Pushes data and discards the oldest entries so that at most 'capacity' remain.
+     * @return Number of discarded entries
+     */
+    size_t pushDropOldest(Data const &data, size_t capacity) {
+        unique_lock<mutex> lg(mutex_);
+        size_t dropped = 0;
+
+        while (!queue_.empty() && queue_.size() >= capacity) {
+            queue_.pop();
+            dropped++;
+        }
+
+        queue_.push(data);
+        lg.unlock();
+        cv_.notify_one();
+        return dropped;
     }
 
     bool empty() const {
+        unique_lock<mutex> lg(mutex_);
         return queue_.empty();
     }
 
+    size_t size() const {
+        unique_lock<mutex> lg(mutex_);
+        return queue_.size();
+    }
+
     bool tryPop(Data &value) {
+        unique_lock<mutex> lg(mutex_);
+
         if (queue_.empty()) {
             return false;
         }
@@ -45,7 +78,24 @@ public:
         return true;
     }
 
+    /**
+     * @brief Waits up to 'timeout' for data instead of failing on an empty queue.
+     */
+    template<typename Rep, typename Period>
+    bool tryPopFor(Data &value, const chrono::duration<Rep, Period> &timeout) {
+        unique_lock<mutex> lg(mutex_);
+
+        if (!cv_.wait_for(lg, timeout, [this] () {return !queue_.empty();})) {
+            return false;
+        }
+
+        value = queue_.front();
+        queue_.pop();
+        return true;
+    }
+
     bool clear() {
+        unique_lock<mutex> lg(mutex_);
         std::queue<Data> empty_queue;
         queue_ = empty_queue;
         if (queue_.empty()) {
@@ -56,6 +106,8 @@ public:
     }
 
 private:
+    mutable mutex mutex_;
+    condition_variable cv_;
     queue<Data> queue_;
 };
 } // namespace tcp_comm
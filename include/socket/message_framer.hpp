@@ -0,0 +1,246 @@
+/**
+ * @file message_framer.hpp
+ * @brief Splits the received byte stream into messages.
+ * @details Two framings are supported.
+ * - JSON_OBJECTS: JSON objects one after another. The end of a message is found by matching
+ *   braces (strings and escapes are honoured), so objects on a line each, objects sent back to
+ *   back, nested and pretty-printed objects are framed alike. Other bytes between objects are
+ *   skipped, those that are not whitespace are counted (takeSkipped).
+ * - LENGTH_PREFIXED: every message is preceded by its length as a 4 byte little-endian integer.
+ *   A line end right after the JSON message that switched to it still belongs to that message.
+ * - BINARY: binary protocol frames, whose header carries the payload length (see wire_protocol.hpp).
+ *
+ * The scan state is kept between calls, so every received byte is inspected only once no
+ * matter how the stream is split into reads.
+ * @version 1.0
+ * @date 2024-03-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef MESSAGE_FRAMER_HPP
+#define MESSAGE_FRAMER_HPP
+
+#include <cctype>
+
+#include "ring_buffer.hpp"
+#include "wire_protocol.hpp"
+
+using namespace std;
+
+namespace tcp_communication {
+
+enum class FramingMode {
+    JSON_OBJECTS      = 0,
+    LENGTH_PREFIXED   = 1,
+    BINARY            = 2,
+};
+
+class MessageFramer {
+public:
+    static constexpr size_t LENGTH_PREFIX_SIZE = 4;
+
+    MessageFramer(FramingMode mode = FramingMode::JSON_OBJECTS) : mode_(mode) {}
+
+public:
+    FramingMode getMode() const {return mode_;}
+
+    void setMode(FramingMode mode) {
+        reset();
+        skip_line_end_ = (mode_ == FramingMode::JSON_OBJECTS && mode != FramingMode::JSON_OBJECTS);
+        mode_ = mode;
+    }
+
+    void reset() {
+        scanned_   = 0;
+        depth_     = 0;
+        in_string_ = false;
+        escape_    = false;
+        error_     = false;
+        skip_line_end_ = false;
+    }
+
+    /**
+     * @brief Bytes skipped between JSON objects that were not whitespace, since the last call.
+     */
+    size_t takeSkipped() {
+        size_t skipped = skipped_;
+        skipped_ = 0;
+        return skipped;
+    }
+
+    /**
+     * @brief Set when the stream can not be framed any more (e.g. a length prefix larger than the buffer).
+     */
+    bool hasError() const {return error_;}
+
+    /**
+     * @brief Extracts the next complete message from the buffer.
+     * @details The message is consumed from the buffer. [begin, end) stays valid until new
+     * data is written into the buffer or next() is called again.
+     * @return true if a message was extracted
+     */
+    bool next(RingBuffer &buffer, const char *&begin, const char *&end) {
+        if (error_) {
+            return false;
+        }
+
+        switch (mode_) {
+            case FramingMode::LENGTH_PREFIXED:
+                return nextLengthPrefixed(buffer, begin, end);
+
+            case FramingMode::BINARY:
+                return nextBinary(buffer, begin, end);
+
+            default:
+                return nextDelimited(buffer, begin, end);
+        }
+    }
+
+    static void writeLengthPrefix(uint32_t length, char *prefix) {
+        for (size_t i = 0; i < LENGTH_PREFIX_SIZE; i++) {
+            prefix[i] = (char) ((length >> (8 * i)) & 0xFF);
+        }
+    }
+
+private:
+    bool nextDelimited(RingBuffer &buffer, const char *&begin, const char *&end) {
+        while (scanned_ < buffer.size()) {
+            char c = buffer.at(scanned_);
+
+            if (depth_ == 0) {
+                // Whitespace, newlines and garbage between messages are discarded
+                if (c == '{') {
+                    depth_ = 1;
+                    scanned_++;
+                } else {
+                    skipped_ += !isspace((unsigned char) c);
+                    buffer.consume(1);
+                }
+                continue;
+            }
+
+            scanned_++;
+
+            if (in_string_) {
+                if (escape_) {
+                    escape_ = false;
+                } else if (c == '\\') {
+                    escape_ = true;
+                } else if (c == '"') {
+                    in_string_ = false;
+                }
+                continue;
+            }
+
+            if (c == '"') {
+                in_string_ = true;
+            } else if (c == '{' || c == '[') {
+                depth_++;
+            } else if ((c == '}' || c == ']') && --depth_ == 0) {
+                begin = buffer.peek(0, scanned_, scratch_);
+                end   = begin + scanned_;
+                buffer.consume(scanned_);
+                scanned_ = 0;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // false until it is known whether the buffer starts with the line end to skip
+    bool skipLineEnd(RingBuffer &buffer) {
+        if (!skip_line_end_) {
+            return true;
+        }
+
+        if (buffer.size() == 0 || (buffer.at(0) == '\r' && buffer.size() < 2)) {
+            return false;
+        }
+
+        if (buffer.at(0) == '\n') {
+            buffer.consume(1);
+        } else if (buffer.at(0) == '\r' && buffer.at(1) == '\n') {
+            buffer.consume(2);
+        }
+
+        skip_line_end_ = false;
+        return true;
+    }
+
+    bool nextLengthPrefixed(RingBuffer &buffer, const char *&begin, const char *&end) {
+        // A prefix byte may be '\n' as well, so only the one line end is skipped
+        if (!skipLineEnd(buffer)) {
+            return false;
+        }
+
+        if (buffer.size() < LENGTH_PREFIX_SIZE) {
+            return false;
+        }
+
+        uint32_t length = 0;
+        for (size_t i = 0; i < LENGTH_PREFIX_SIZE; i++) {
+            length |= (uint32_t) (uint8_t) buffer.at(i) << (8 * i);
+        }
+
+        if (length > buffer.capacity() - LENGTH_PREFIX_SIZE) {
+            error_ = true;
+            return false;
+        }
+
+        if (buffer.size() < LENGTH_PREFIX_SIZE + length) {
+            return false;
+        }
+
+        begin = buffer.peek(LENGTH_PREFIX_SIZE, length, scratch_);
+        end   = begin + length;
+        buffer.consume(LENGTH_PREFIX_SIZE + length);
+
+        return true;
+    }
+
+    bool nextBinary(RingBuffer &buffer, const char *&begin, const char *&end) {
+        // Line end of the Json message that switched to the binary protocol
+        while (buffer.size() > 0 && isspace((unsigned char) buffer.at(0))) {
+            buffer.consume(1);
+        }
+
+        if (buffer.size() < binary_protocol::HEADER_SIZE) {
+            return false;
+        }
+
+        // Binary frames carry no delimiter to resynchronize on
+        if ((uint8_t) buffer.at(0) != binary_protocol::MAGIC) {
+            error_ = true;
+            return false;
+        }
+
+        size_t length = binary_protocol::HEADER_SIZE + (uint8_t) buffer.at(3);
+
+        if (buffer.size() < length) {
+            return false;
+        }
+
+        begin = buffer.peek(0, length, scratch_);
+        end   = begin + length;
+        buffer.consume(length);
+
+        return true;
+    }
+
+    FramingMode mode_;
+
+    size_t scanned_ = 0; /**< Bytes of the current message already inspected */
+    int depth_      = 0;
+    bool in_string_ = false;
+    bool escape_    = false;
+    bool error_     = false;
+    bool skip_line_end_ = false; /**< Of the JSON message that switched the framing */
+    size_t skipped_     = 0;
+
+    string scratch_;
+};
+} // namespace tcp_comm
+#endif
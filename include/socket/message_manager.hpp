@@ -15,6 +15,9 @@
 #include <vector>
 #include <algorithm>
 #include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <atomic>
 
 #include "concurrent_queue.hpp"
 
@@ -22,82 +25,248 @@ using namespace std;
 
 namespace tcp_communication {
 
-template<typename Data>
+const size_t kDefaultClientQueueCapacity = 50;   /**< 1 s of status at the 50 Hz poll rate */
+const size_t kMaxClientQueueCapacity     = 3000; /**< 1 min, the most a client may ask for */
+const size_t kMaxReliableQueue           = 1000; /**< Replies waiting before the client is dropped */
+
+/**
+ * @brief What to do when a client does not drain its queue fast enough.
+ */
+enum class QueuePolicy {
+    DROP_OLDEST       = 0, /**< Bounded queue, the oldest message is discarded when full */
+    KEEP_LATEST       = 1, /**< Conflation, only the most recent message is kept */
+    DISCONNECT_ON_LAG = 2, /**< The client is disconnected once the queue is full */
+};
+
+struct ClientQueueConfig {
+    QueuePolicy policy = QueuePolicy::DROP_OLDEST;
+    size_t capacity    = kDefaultClientQueueCapacity;
+};
+
+struct ClientQueueStats {
+    size_t   depth     = 0; /**< Messages waiting to be written, replies included (current lag) */
+    size_t   max_depth = 0; /**< Largest lag observed since the client connected */
+    uint64_t pushed    = 0;
+    uint64_t dropped   = 0;
+    bool     lagging   = false; /**< Set when a DISCONNECT_ON_LAG queue or the replies overflowed */
+};
+
+/**
+ * @tparam Request  Message from a client to the worker
+ * @tparam Response Message from the worker to a client
+ * @tparam Stream   Per-client settings deciding how a broadcast is encoded for that client
+ */
+template<typename Request, typename Response, typename Stream>
 class MessageHandler {
+    struct ClientQueue {
+        ConcurrentQueue<Response> queue;
+        ConcurrentQueue<Response> reliable_queue; /**< Replies to this client, never dropped */
+        ClientQueueConfig config;
+        ClientQueueStats stats;
+        Stream stream;
+        uint64_t stream_generation = 0; /**< Of the last setClientStream */
+
+        // Wakes the one writer of this client. Shared, so a writer still waiting on it when the
+        // client is removed does not wait on a destroyed object
+        shared_ptr<condition_variable> cv = make_shared<condition_variable>();
+
+        size_t depth() const {
+            return queue.size() + reliable_queue.size();
+        }
+    };
+
 public:
     bool createClientQueue(uint32_t id) {
+        unique_lock<mutex> lg(mutex_clients_);
+
         if (to_client_queue_map_.find(id) != to_client_queue_map_.end()) {
             return false;
         }
 
-        to_client_queue_map_.insert(make_pair(id, ConcurrentQueue<Data>()));
+        auto itr = to_client_queue_map_.emplace(piecewise_construct, forward_as_tuple(id), forward_as_tuple()).first;
+        itr->second.config = default_config_;
 
         return true;
     }
 
     bool deleteClientQueue(uint32_t id) {
+        unique_lock<mutex> lg(mutex_clients_);
+
         auto itr = to_client_queue_map_.find(id);
 
         if (itr == to_client_queue_map_.end()) {
             return false;
         }
 
+        itr->second.cv->notify_one();
         to_client_queue_map_.erase(itr);
 
         return true;
     }
 
-    void pushToWorkerQueue(Data const &data) {
+    void pushToWorkerQueue(Request const &data) {
         to_worker_queue_.push(data);
     }
 
-    bool tryPopFromWokerQueue(Data &data) {
+    bool tryPopFromWokerQueue(Request &data) {
         if (to_worker_queue_.empty()) {
             return false;
         }
         return to_worker_queue_.tryPop(data);
     }
 
-    void pushToAllClientQueue(Data const &data) {
-        auto ids = getAllClientId();
+    template<typename Rep, typename Period>
+    bool tryPopFromWokerQueue(Request &data, const chrono::duration<Rep, Period> &timeout) {
+        return to_worker_queue_.tryPopFor(data, timeout);
+    }
+
+    void pushToAllClientQueue(Response const &data) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        for (auto &client : to_client_queue_map_) {
+            pushToClientQueue(client.second, data);
+        }
+    }
+
+    /**
+     * @brief Broadcasts a message encoded per stream configuration.
+     * @param encode Called as encode(const Stream &, uint64_t generation) once for every distinct
+     * configuration among the connected clients, the result is shared by the clients of that
+     * configuration. generation is the latest stream generation of those clients, it changes
+     * when a client joins the configuration. A result that converts to false is not queued.
+     */
+    template<typename Encode>
+    void pushToAllClientQueue(Encode encode) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        struct Encoded {
+            const Stream *stream;
+            uint64_t generation;
+            Response frame;
+        };
+        vector<Encoded> encoded;
+        vector<size_t> client_frames;
+
+        client_frames.reserve(to_client_queue_map_.size());
+
+        for (auto &client : to_client_queue_map_) {
+            const Stream &stream = client.second.stream;
+
+            auto itr = find_if(encoded.begin(), encoded.end(), [&stream] (const Encoded &frame) {
+                return *frame.stream == stream;
+            });
+
+            if (itr == encoded.end()) {
+                encoded.push_back({&stream, client.second.stream_generation, Response()});
+                itr = encoded.end() - 1;
+            }
+
+            itr->generation = max(itr->generation, client.second.stream_generation);
+            client_frames.push_back(itr - encoded.begin());
+        }
+
+        for (Encoded &frame : encoded) {
+            frame.frame = encode(*frame.stream, frame.generation);
+        }
+
+        size_t i = 0;
+
+        for (auto &client : to_client_queue_map_) {
+            const Response &frame = encoded[client_frames[i++]].frame;
+
+            if (frame) {
+                pushToClientQueue(client.second, frame);
+            }
+        }
+    }
+
+    bool pushToClientQueue(uint32_t id, Response const &data) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
 
-        for (auto id : ids) {
-            pushToClientQueue(id, data);
+        if (itr == to_client_queue_map_.end()) {
+            return false;
         }
+
+        return pushToClientQueue(itr->second, data);
     }
 
-    bool pushToClientQueue(uint32_t id, Data const &data) {
+    /**
+     * @brief Queues a reply to one client. Replies bypass the queue policy and are written
+     * before any pending broadcast. A client with kMaxReliableQueue replies waiting does not read
+     * any more and is marked lagging instead.
+     */
+    bool pushReliableToClientQueue(uint32_t id, Response const &data) {
+        unique_lock<mutex> lg(mutex_clients_);
+
         auto itr = to_client_queue_map_.find(id);
 
         if (itr == to_client_queue_map_.end()) {
             return false;
         }
 
-        // original
-         itr->second.push(data);
+        ClientQueue &client = itr->second;
+
+        if (client.reliable_queue.size() >= kMaxReliableQueue) {
+            client.stats.lagging = true;
+            client.stats.dropped++;
+            client.cv->notify_one();
+            return false;
+        }
 
-        // modified
-//        if (itr->second.empty()) {
-//            itr->second.push(data);
-//        } else {
-//            itr->second.clear();
-//            itr->second.push(data);
-//        }
+        client.reliable_queue.push(data);
+        client.stats.pushed++;
+        client.stats.max_depth = max(client.stats.max_depth, client.depth());
+        client.cv->notify_one();
 
         return true;
     }
 
-    bool tryPopFromClientQueue(uint32_t id, Data &data) {
+    bool tryPopFromClientQueue(uint32_t id, Response &data) {
+        unique_lock<mutex> lg(mutex_clients_);
+
         auto itr = to_client_queue_map_.find(id);
 
-        if (itr == to_client_queue_map_.end() || itr->second.empty()) {
+        if (itr == to_client_queue_map_.end()) {
             return false;
         }
 
-        return itr->second.tryPop(data);
+        return itr->second.reliable_queue.tryPop(data) || itr->second.queue.tryPop(data);
+    }
+
+    /**
+     * @brief Waits up to 'timeout' for a message to the client. Returns early without one if the
+     * client is removed or starts lagging.
+     */
+    template<typename Rep, typename Period>
+    bool tryPopFromClientQueue(uint32_t id, Response &data, const chrono::duration<Rep, Period> &timeout) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
+
+        if (itr == to_client_queue_map_.end()) {
+            return false;
+        }
+
+        const shared_ptr<condition_variable> cv = itr->second.cv;
+
+        cv->wait_for(lg, timeout, [this, id, &itr] () {
+            itr = to_client_queue_map_.find(id);
+            return itr == to_client_queue_map_.end() || itr->second.stats.lagging ||
+                   !itr->second.reliable_queue.empty() || !itr->second.queue.empty();
+        });
+
+        if (itr == to_client_queue_map_.end()) {
+            return false;
+        }
+
+        return itr->second.reliable_queue.tryPop(data) || itr->second.queue.tryPop(data);
     }
 
     vector<uint32_t> getAllClientId() {
+        unique_lock<mutex> lg(mutex_clients_);
+
         vector<uint32_t> ids;
         for (auto itr = to_client_queue_map_.begin(); itr != to_client_queue_map_.end(); itr++) {
             ids.push_back(itr->first);
@@ -105,13 +274,173 @@ public:
         return ids;
     }
 
+    // Backpressure
+    void setDefaultClientQueueConfig(const ClientQueueConfig &config) {
+        unique_lock<mutex> lg(mutex_clients_);
+        default_config_ = config;
+    }
+
+    ClientQueueConfig getDefaultClientQueueConfig() {
+        unique_lock<mutex> lg(mutex_clients_);
+        return default_config_;
+    }
+
+    bool setClientQueueConfig(uint32_t id, const ClientQueueConfig &config) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
+
+        if (itr == to_client_queue_map_.end()) {
+            return false;
+        }
+
+        itr->second.config = config;
+        itr->second.config.capacity = max<size_t>(config.capacity, 1);
+
+        return true;
+    }
+
+    bool getClientQueueStats(uint32_t id, ClientQueueStats &stats) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
+
+        if (itr == to_client_queue_map_.end()) {
+            return false;
+        }
+
+        stats = itr->second.stats;
+        stats.depth = itr->second.depth();
+
+        return true;
+    }
+
+    unordered_map<uint32_t, ClientQueueStats> getAllClientQueueStats() {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        unordered_map<uint32_t, ClientQueueStats> stats;
+        for (auto &client : to_client_queue_map_) {
+            ClientQueueStats &client_stats = stats[client.first];
+            client_stats = client.second.stats;
+            client_stats.depth = client.second.depth();
+        }
+        return stats;
+    }
+
+    bool setClientStream(uint32_t id, const Stream &stream) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
+
+        if (itr == to_client_queue_map_.end()) {
+            return false;
+        }
+
+        itr->second.stream = stream;
+        itr->second.stream_generation = ++stream_generation_;
+
+        return true;
+    }
+
+    /**
+     * @brief Changes the stream and queues 'announce' as the first message encoded with it.
+     * Broadcasts still waiting in the old encoding are discarded.
+     */
+    bool setClientStream(uint32_t id, const Stream &stream, Response const &announce) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
+
+        if (itr == to_client_queue_map_.end()) {
+            return false;
+        }
+
+        itr->second.stream = stream;
+        itr->second.queue.clear();
+        itr->second.stream_generation = ++stream_generation_;
+        itr->second.reliable_queue.push(announce);
+        itr->second.cv->notify_one();
+
+        return true;
+    }
+
+    bool getClientStream(uint32_t id, Stream &stream) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
+
+        if (itr == to_client_queue_map_.end()) {
+            return false;
+        }
+
+        stream = itr->second.stream;
+
+        return true;
+    }
+
+    /**
+     * @brief Incremented whenever a client changes its stream, e.g. so that stateful encoders
+     * can resynchronize the group the client joined.
+     */
+    uint64_t getStreamGeneration() const {
+        return stream_generation_;
+    }
+
+    bool isClientLagging(uint32_t id) {
+        unique_lock<mutex> lg(mutex_clients_);
+
+        auto itr = to_client_queue_map_.find(id);
+        return itr != to_client_queue_map_.end() && itr->second.stats.lagging;
+    }
+
 private:
-    ConcurrentQueue<Data> to_worker_queue_;
-    unordered_map<uint32_t, ConcurrentQueue<Data>> to_client_queue_map_;
+    // mutex_clients_ must be held by the caller
+    bool pushToClientQueue(ClientQueue &client, Response const &data) {
+        ClientQueueStats &stats = client.stats;
+
+        if (stats.lagging) {
+            stats.dropped++;
+            return false;
+        }
+
+        size_t depth = client.queue.size();
+
+        switch (client.config.policy) {
+            case QueuePolicy::DROP_OLDEST:
+                stats.dropped += client.queue.pushDropOldest(data, client.config.capacity);
+                break;
+
+            case QueuePolicy::KEEP_LATEST:
+                stats.dropped += client.queue.pushDropOldest(data, 1);
+                break;
+
+            case QueuePolicy::DISCONNECT_ON_LAG:
+                if (depth >= client.config.capacity) {
+                    stats.lagging = true;
+                    stats.dropped++;
+                    client.cv->notify_one();
+                    return false;
+                }
+                client.queue.push(data);
+                break;
+        }
+
+        stats.pushed++;
+        stats.max_depth = max(stats.max_depth, client.depth());
+        client.cv->notify_one();
+
+        return true;
+    }
+
+    ConcurrentQueue<Request> to_worker_queue_;
+    unordered_map<uint32_t, ClientQueue> to_client_queue_map_;
+    ClientQueueConfig default_config_;
+    mutex mutex_clients_; /**< Also the mutex the writers wait with on ClientQueue::cv */
+    atomic<uint64_t> stream_generation_{0};
 };
 
-template<typename Data>
-class MessageManager : public MessageHandler<Data> {
+template<typename Request, typename Response, typename Stream>
+class MessageManager : public MessageHandler<Request, Response, Stream> {
 private:
     MessageManager() {}
 public:
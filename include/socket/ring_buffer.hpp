@@ -0,0 +1,113 @@
+/**
+ * @file ring_buffer.hpp
+ * @brief Fixed-capacity byte ring buffer used as the receive buffer of a socket.
+ * @details Bytes are read from the socket straight into the free region of the ring and
+ * are consumed from the front once a complete message has been framed, so received data
+ * is never shifted or reallocated.
+ * @version 1.0
+ * @date 2024-03-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+namespace tcp_communication {
+
+class RingBuffer {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024; /**< Also the largest message that can be framed */
+
+    RingBuffer(size_t capacity = DEFAULT_CAPACITY) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        data_.resize(size);
+        mask_ = size - 1;
+    }
+
+public:
+    size_t capacity() const {return data_.size();}
+    size_t size() const     {return (size_t) (tail_ - head_);}
+    size_t space() const    {return capacity() - size();}
+    bool empty() const      {return head_ == tail_;}
+
+    char at(size_t offset) const {
+        return data_[(head_ + offset) & mask_];
+    }
+
+    /**
+     * @brief Start of the contiguous free region, to be filled by a direct socket read.
+     */
+    char *writePtr() {
+        return &data_[tail_ & mask_];
+    }
+
+    size_t writeSpace() const {
+        size_t tail_index = tail_ & mask_;
+        return min(space(), capacity() - tail_index);
+    }
+
+    void commit(size_t bytes) {
+        tail_ += bytes;
+    }
+
+    size_t write(const char *data, size_t bytes) {
+        size_t written = 0;
+
+        while (written < bytes && writeSpace() > 0) {
+            size_t chunk = min(bytes - written, writeSpace());
+            memcpy(writePtr(), data + written, chunk);
+            commit(chunk);
+            written += chunk;
+        }
+
+        return written;
+    }
+
+    void consume(size_t bytes) {
+        head_ += min(bytes, size());
+    }
+
+    void clear() {
+        head_ = tail_ = 0;
+    }
+
+    /**
+     * @brief Returns a pointer to [offset, offset + bytes). The bytes are returned in place
+     * when they do not wrap around the end of the ring, otherwise they are copied to 'scratch'.
+     */
+    const char *peek(size_t offset, size_t bytes, string &scratch) const {
+        size_t begin = (head_ + offset) & mask_;
+
+        if (begin + bytes <= capacity()) {
+            return &data_[begin];
+        }
+
+        size_t first = capacity() - begin;
+        scratch.assign(&data_[begin], first);
+        scratch.append(&data_[0], bytes - first);
+
+        return scratch.data();
+    }
+
+private:
+    vector<char> data_;
+    size_t mask_;
+
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+};
+} // namespace tcp_comm
+#endif
@@ -0,0 +1,178 @@
+/**
+ * @file status_broadcaster.hpp
+ * @brief Distributes polled status to the client queues according to each client's subscription.
+ * @details Clients are grouped by their StreamConfig. For every status, each group is checked
+ * once against its slave filter and rate; a due group gets one serialized frame that is shared
+ * by all of its clients. Groups subscribed in delta mode get a keyframe every keyframe_interval
+ * cycles and in between only the fields that changed since their previous frame. A client
+ * joining a delta stream makes the next frame of each slave of that stream a keyframe.
+ * @version 1.0
+ * @date 2024-03-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef STATUS_BROADCASTER_HPP
+#define STATUS_BROADCASTER_HPP
+
+#include "tcp_manager.hpp"
+
+using namespace std;
+
+namespace tcp_communication {
+
+class StatusBroadcaster {
+    static constexpr uint64_t GROUP_EXPIRY_US = 60000000; /**< State of groups unused this long is dropped */
+
+    // Rate and delta state of one stream for one slave
+    struct Group {
+        StreamConfig stream;
+        uint16_t slave;
+        uint64_t next_due_us;
+        uint64_t last_used_us;
+
+        StatusMessage last;       /**< Last status sent, baseline of the next delta */
+        bool has_last;
+        uint32_t delta_sequence;
+        uint16_t since_keyframe;  /**< Due cycles since the last keyframe */
+        uint64_t generation;      /**< Stream generation of the last keyframe */
+    };
+
+public:
+    StatusBroadcaster(DatcMessageHandler &message_handler) : message_handler_(message_handler) {}
+
+public:
+    void publish(const StatusMessage &status, uint64_t now_us = monotonicMicros()) {
+        message_handler_.pushToAllClientQueue([&] (const StreamConfig &stream, uint64_t generation) {
+            Frame frame = encodeForStream(stream, generation, status, now_us);
+
+            if (frame) {
+                tracing::record(tracing::Stage::CLIENT_ENQUEUE, tracing::Phase::INSTANT, tracing::currentId(), frame.get());
+            }
+            return frame;
+        });
+
+        pruneGroups(now_us);
+    }
+
+private:
+    Frame encodeForStream(const StreamConfig &stream, uint64_t generation, const StatusMessage &status, uint64_t now_us) {
+        if (!stream.acceptsSlave(status.slave)) {
+            return Frame();
+        }
+
+        if (stream.period_us == 0 && !stream.delta) {
+            return encodeStatus(stream, status);
+        }
+
+        Group &group = findGroup(stream, status.slave, now_us);
+
+        if (!isDue(group, now_us)) {
+            return Frame();
+        }
+
+        return stream.delta ? encodeDelta(group, generation, status) : encodeStatus(stream, status);
+    }
+
+    static Frame encodeStatus(const StreamConfig &stream, const StatusMessage &status) {
+        auto frame = make_shared<string>();
+
+        if (stream.format == WireFormat::BINARY) {
+            binary_protocol::encodeStatus(status, *frame);
+        } else {
+            json_protocol::encodeStatus(status, *frame, stream.fields);
+        }
+
+        return Frame(frame);
+    }
+
+    // Keyframes carry every subscribed field, deltas only those changed since the last frame
+    static Frame encodeDelta(Group &group, uint64_t generation, const StatusMessage &status) {
+        const StreamConfig &stream = group.stream;
+        bool binary = stream.format == WireFormat::BINARY;
+
+        // Sequence is replaced by the delta sequence; binary frames carry the slave in any case
+        uint16_t fields = (binary ? STATUS_FIELDS_DEFAULT : stream.fields) & ~FIELD_SEQUENCE;
+        if (binary) {
+            fields &= ~FIELD_SLAVE;
+        }
+
+        // A client that joined the stream since the last keyframe has no baseline yet
+        bool keyframe = !group.has_last || group.generation != generation ||
+                        ++group.since_keyframe >= stream.keyframe_interval;
+
+        if (keyframe) {
+            group.since_keyframe = 0;
+            group.generation     = generation;
+        } else {
+            uint16_t changed = changedStatusFields(group.last, status, fields);
+
+            if (changed == 0) {
+                return Frame();
+            }
+            fields = changed | (fields & FIELD_SLAVE);
+        }
+
+        auto frame = make_shared<string>();
+
+        if (binary) {
+            binary_protocol::encodeStatusDelta(status, fields, group.delta_sequence, keyframe, *frame);
+        } else {
+            json_protocol::encodeStatusDelta(status, fields, group.delta_sequence, keyframe, *frame);
+        }
+
+        group.last     = status;
+        group.has_last = true;
+        group.delta_sequence++;
+
+        return Frame(frame);
+    }
+
+    Group &findGroup(const StreamConfig &stream, uint16_t slave, uint64_t now_us) {
+        auto itr = find_if(groups_.begin(), groups_.end(), [&] (const Group &group) {
+            return group.slave == slave && group.stream == stream;
+        });
+
+        if (itr == groups_.end()) {
+            groups_.push_back({stream, slave, now_us, now_us, StatusMessage(), false, 0, 0, 0});
+            itr = groups_.end() - 1;
+        }
+
+        itr->last_used_us = now_us;
+
+        return *itr;
+    }
+
+    // Called once per group and status, so the schedule advances once for all clients of a group
+    static bool isDue(Group &group, uint64_t now_us) {
+        uint32_t period_us = group.stream.period_us;
+
+        if (period_us == 0) {
+            return true;
+        }
+
+        if (now_us < group.next_due_us) {
+            return false;
+        }
+
+        // Keeps the cadence, unless the poll loop fell behind by more than a period
+        group.next_due_us += period_us;
+        if (group.next_due_us <= now_us) {
+            group.next_due_us = now_us + period_us;
+        }
+
+        return true;
+    }
+
+    void pruneGroups(uint64_t now_us) {
+        groups_.erase(remove_if(groups_.begin(), groups_.end(), [now_us] (const Group &group) {
+            return group.last_used_us + GROUP_EXPIRY_US < now_us;
+        }), groups_.end());
+    }
+
+    DatcMessageHandler &message_handler_;
+    vector<Group> groups_;
+};
+} // namespace tcp_comm
+#endif
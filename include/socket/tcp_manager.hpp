@@ -13,28 +13,33 @@
 #ifndef TCP_MANAGER_HPP
 #define TCP_MANAGER_HPP
 
+#include <atomic>
 #include <boost/asio.hpp>
 #include "message_manager.hpp"
-
-#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(WIN64) || defined(_WIN64) || defined(__WIN64__)
-#include "../lib/json.h"
-#else
-#include <jsoncpp/json/json.h>
-#endif
+#include "message_framer.hpp"
+#include "wire_protocol.hpp"
+#include "trace_recorder.hpp"
+#include "traffic_recorder.hpp"
 
 using namespace std;
 using namespace tcp_communication;
 
 namespace tcp_communication {
 
+typedef MessageHandler<CommandRequest, Frame, StreamConfig> DatcMessageHandler;
+typedef MessageManager<CommandRequest, Frame, StreamConfig> DatcMessageManager;
+
+// Sessions run over TCP or Unix domain stream sockets alike
+typedef boost::asio::generic::stream_protocol StreamProtocol;
+typedef boost::asio::basic_socket_acceptor<StreamProtocol> StreamAcceptor;
+
 class TcpSocket {
-    static constexpr int MAX_BUFFER = 1024; /**< Maximum size of buffer */
 public:
     TcpSocket(boost::asio::io_service &io_service);
     ~TcpSocket();
 
 public:
-    boost::asio::ip::tcp::socket &getSocket();
+    StreamProtocol::socket &getSocket();
 
     void start();
     void close();
@@ -43,27 +48,61 @@ public:
     void readHandler(const boost::system::error_code& err, size_t bytes_transferred);
 
 private:
-    bool parseJsonFromBuffer(Json::Value &json);
+    void startRead();
+    bool writeFrame(const Frame &frame); // false if the socket was closed on a write error
+    void handleJsonMessage(const char *begin, const char *end);
+    void handleBinaryMessage(const char *begin, const char *end);
+    void pushRequest(CommandRequest &request);
+
+    void setQueuePolicy(const Json::Value &json);
+    void setFraming(const Json::Value &json);
+    void setProtocol(const Json::Value &json);
+    void setSubscription(const Json::Value &json);
 
 private:
-    MessageHandler<Json::Value> &message_handler_;
-    boost::asio::ip::tcp::socket socket_;
-    string recevied_;
-    char buffer_[MAX_BUFFER];
+    // Upper bound on noticing a closed socket while no frame arrives
+    static constexpr std::chrono::milliseconds kWriteWait {10};
+
+    DatcMessageHandler &message_handler_;
+    StreamProtocol::socket socket_;
+
+    RingBuffer recevied_;
+    MessageFramer framer_;
+    Json::Reader reader_;
+
+    atomic<FramingMode> write_framing_ {FramingMode::JSON_OBJECTS};
 };
 
 class TcpServer {
 public:
     TcpServer(const int port = 8421);
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    /**
+     * @brief Serves the same protocol on a Unix domain stream socket for local clients.
+     * @details A socket file at path is replaced only if nobody listens on it any more, anything
+     * else at path leaves the server not listening.
+     * @param mode Permissions of the socket file, which control who may connect
+     */
+    TcpServer(const string &path, mode_t mode = 0660);
+#endif
     ~TcpServer();
 
+    bool isListening() const {return acceptor_.is_open();}
+
 public:
     void startAccept();
     void acceptHandler(TcpSocket *socket, const boost::system::error_code& err);
 
 private:
+    void startIoService();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    // false if path is taken by a live server or is not a socket
+    bool removeStaleSocket(const string &path, const StreamProtocol::endpoint &endpoint);
+#endif
+
     boost::asio::io_service io_service_;
-    boost::asio::ip::tcp::acceptor acceptor_;
+    StreamAcceptor acceptor_;
+    string unix_path_; /**< Removed on destruction */
 };
 } // namespace tcp_comm
 #endif
@@ -0,0 +1,117 @@
+/**
+ * @file udp_publisher.hpp
+ * @brief Publishes polled status to a UDP multicast group, one datagram per status for any
+ * number of listeners.
+ * @details Every datagram is a binary status frame (see wire_protocol.hpp). Listeners detect
+ * lost datagrams from gaps in the per slave sequence. Sending never blocks the poll loop; a
+ * datagram the kernel cannot take right away is counted as dropped.
+ * @version 1.0
+ * @date 2024-03-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef UDP_PUBLISHER_HPP
+#define UDP_PUBLISHER_HPP
+
+#include <iostream>
+#include <boost/asio.hpp>
+#include "wire_protocol.hpp"
+
+using namespace std;
+
+namespace tcp_communication {
+
+struct UdpPublisherStats {
+    uint64_t sent    = 0;
+    uint64_t dropped = 0; /**< Datagrams the socket refused, e.g. full send buffer */
+};
+
+class UdpStatusPublisher {
+public:
+    UdpStatusPublisher() : socket_(io_service_) {}
+    ~UdpStatusPublisher() {close();}
+
+public:
+    /**
+     * @param group Multicast (or unicast) destination address
+     * @param ttl Router hops, 1 keeps the datagrams in the local network
+     * @param interface_addr IPv4 address of the outgoing interface, empty: chosen by the routing table
+     */
+    bool open(const string &group, uint16_t port, int ttl = 1, const string &interface_addr = "") {
+        namespace ip = boost::asio::ip;
+        boost::system::error_code ec;
+
+        close();
+
+        ip::address address = ip::address::from_string(group, ec);
+        if (ec) {
+            cout << "[Error] Invalid udp address: " << group << endl;
+            return false;
+        }
+
+        endpoint_ = ip::udp::endpoint(address, port);
+
+        socket_.open(endpoint_.protocol(), ec);
+        if (!ec) socket_.non_blocking(true, ec);
+
+        if (!ec && address.is_multicast()) {
+            socket_.set_option(ip::multicast::hops(ttl), ec);
+            if (!ec) socket_.set_option(ip::multicast::enable_loopback(true), ec);
+
+            if (!ec && !interface_addr.empty()) {
+                ip::address_v4 interface = ip::address_v4::from_string(interface_addr, ec);
+                if (!ec) socket_.set_option(ip::multicast::outbound_interface(interface), ec);
+            }
+        }
+
+        if (ec) {
+            cout << "[Error] Udp publisher: " << ec.message() << endl;
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close() {
+        boost::system::error_code ec;
+        socket_.close(ec);
+    }
+
+    bool isOpen() const {
+        return socket_.is_open();
+    }
+
+    void publish(const StatusMessage &status) {
+        if (!socket_.is_open()) {
+            return;
+        }
+
+        binary_protocol::encodeStatus(status, frame_);
+
+        boost::system::error_code ec;
+        socket_.send_to(boost::asio::buffer(frame_), endpoint_, 0, ec);
+
+        if (ec) {
+            stats_.dropped++;
+        } else {
+            stats_.sent++;
+        }
+    }
+
+    UdpPublisherStats getStats() const {
+        return stats_;
+    }
+
+private:
+    boost::asio::io_service io_service_;
+    boost::asio::ip::udp::socket socket_;
+    boost::asio::ip::udp::endpoint endpoint_;
+
+    string frame_;
+    UdpPublisherStats stats_;
+};
+} // namespace tcp_comm
+#endif
@@ -0,0 +1,663 @@
+/**
+ * @file wire_protocol.hpp
+ * @brief Messages exchanged with socket clients and their Json / binary encodings.
+ * @details Json is the default protocol. A client may switch its connection to the binary
+ * protocol by sending {"protocol": "binary"}; from then on both directions use fixed-layout
+ * little-endian frames.
+ *
+ * Every binary frame starts with a 4 byte header
+ * | Byte | Field                                  |
+ * | 0    | Magic (0xDA)                           |
+ * | 1    | Protocol version (1)                   |
+ * | 2    | Frame type (hello, command or status)  |
+ * | 3    | Payload length in bytes                |
+ *
+ * Command payload (8 or 12 bytes): opcode (u16, DATC_COMMAND value), flags (u16, bit 0: value_1
+ * present, bit 1: value_2 present, bit 2: id present), value_1 (i16/u16), value_2 (u16),
+ * followed by the request id (u32) when bit 2 is set.
+ * Status payload (20 bytes): sequence (u32), slave (u16), states (u16), motor_pos (i16),
+ * motor_vel (i16), motor_cur (i16), finger_pos (u16), voltage (u16), reserved (u16).
+ * Ack payload (32 bytes): id (u32), opcode (u16), error (u16), receive, dequeue and
+ * completion time (u64 each, microseconds of the server's monotonic clock).
+ * Status delta payload (8 to 20 bytes): delta sequence (u32), slave (u16), field mask (u16,
+ * StatusField bits, bit 15: keyframe), followed by the value (u16) of every field in the mask.
+ * @version 1.0
+ * @date 2024-03-11
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef WIRE_PROTOCOL_HPP
+#define WIRE_PROTOCOL_HPP
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(WIN64) || defined(_WIN64) || defined(__WIN64__)
+#include "../lib/json.h"
+#else
+#include <jsoncpp/json/json.h>
+#endif
+
+using namespace std;
+
+namespace tcp_communication {
+
+enum class WireFormat {
+    JSON   = 0,
+    BINARY = 1,
+};
+
+/**
+ * @brief Serialized message waiting in a client queue, shared by every client it is sent to.
+ */
+typedef shared_ptr<const string> Frame;
+
+enum class RequestType {
+    COMMAND      = 0, /**< DATC_COMMAND sent to the gripper */
+    CHANGE_SLAVE = 1, /**< Change of the modbus slave this program talks to */
+};
+
+/**
+ * @brief Microseconds of the monotonic clock, used to timestamp a request along its way.
+ */
+inline uint64_t monotonicMicros() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct CommandRequest {
+    RequestType type = RequestType::COMMAND;
+    uint32_t client  = 0; /**< Socket the request was received from */
+
+    uint16_t command = 0;
+    uint16_t value_1 = 0; /**< Register value, signed arguments are two's complement */
+    uint16_t value_2 = 0;
+
+    bool has_value_1 = false;
+    bool has_value_2 = false;
+
+    bool has_id = false; /**< Requests with an id are acknowledged */
+    uint32_t id = 0;
+
+    uint64_t t_recv_us = 0;
+    uint32_t trace_id  = 0; /**< Correlation id of the trace points, not sent on the wire */
+};
+
+enum class CommandError : uint16_t {
+    NONE              = 0,
+    MISSING_VALUE     = 1, /**< "value_1" or "value_2" required by the command was not sent */
+    UNDEFINED_COMMAND = 2,
+    COMMAND_FAILED    = 3, /**< The modbus transaction failed */
+    MALFORMED         = 4, /**< The message could not be decoded, e.g. an id that is not a u32 */
+};
+
+struct CommandAck {
+    uint32_t id      = 0;
+    uint16_t command = 0;
+    CommandError error = CommandError::NONE;
+
+    uint64_t t_recv_us    = 0; /**< Request framed by the socket */
+    uint64_t t_dequeue_us = 0; /**< Request taken by the worker */
+    uint64_t t_done_us    = 0; /**< Modbus transaction completed */
+};
+
+struct StatusMessage {
+    uint32_t sequence   = 0;
+    uint16_t slave      = 0;
+    uint16_t states     = 0;
+    int16_t  motor_pos  = 0;
+    int16_t  motor_vel  = 0;
+    int16_t  motor_cur  = 0;
+    uint16_t finger_pos = 0;
+    uint16_t voltage    = 0;
+};
+
+/**
+ * @brief Status fields a client can subscribe to, in the alphabetical order of their Json keys.
+ */
+enum StatusField : uint16_t {
+    FIELD_FINGER_POS = 1 << 0,
+    FIELD_MOTOR_CUR  = 1 << 1,
+    FIELD_MOTOR_POS  = 1 << 2,
+    FIELD_MOTOR_VEL  = 1 << 3,
+    FIELD_SEQUENCE   = 1 << 4,
+    FIELD_SLAVE      = 1 << 5,
+    FIELD_STATES     = 1 << 6,
+    FIELD_VOLTAGE    = 1 << 7,
+};
+
+const size_t STATUS_FIELD_COUNT = 8;
+
+const char *const STATUS_FIELD_NAMES[STATUS_FIELD_COUNT] = {
+    "finger_pos", "motor_cur", "motor_pos", "motor_vel", "sequence", "slave", "states", "voltage"
+};
+
+/** Fields sent to a client that has not subscribed */
+const uint16_t STATUS_FIELDS_DEFAULT = FIELD_FINGER_POS | FIELD_MOTOR_CUR | FIELD_MOTOR_POS |
+                                       FIELD_MOTOR_VEL  | FIELD_STATES    | FIELD_VOLTAGE;
+
+inline int64_t getStatusField(const StatusMessage &status, StatusField field) {
+    switch (field) {
+        case FIELD_FINGER_POS: return status.finger_pos;
+        case FIELD_MOTOR_CUR:  return status.motor_cur;
+        case FIELD_MOTOR_POS:  return status.motor_pos;
+        case FIELD_MOTOR_VEL:  return status.motor_vel;
+        case FIELD_SEQUENCE:   return status.sequence;
+        case FIELD_SLAVE:      return status.slave;
+        case FIELD_STATES:     return status.states;
+        case FIELD_VOLTAGE:    return status.voltage;
+        default:               return 0;
+    }
+}
+
+/**
+ * @brief Fields compared between two status for delta encoding; sequence and slave are
+ * carried in every delta frame anyway.
+ */
+inline uint16_t changedStatusFields(const StatusMessage &prev, const StatusMessage &status, uint16_t fields) {
+    uint16_t changed = 0;
+
+    for (size_t i = 0; i < STATUS_FIELD_COUNT; i++) {
+        StatusField field = (StatusField) (1 << i);
+
+        if ((fields & field) && !(field & (FIELD_SEQUENCE | FIELD_SLAVE)) &&
+            getStatusField(prev, field) != getStatusField(status, field)) {
+            changed |= field;
+        }
+    }
+
+    return changed;
+}
+
+const uint16_t kMaxSlaveAddr = 247; /**< Highest modbus slave address */
+
+/**
+ * @brief Per-client settings that determine which status frames a client receives and their
+ * bytes. Clients with an equal configuration share one serialized frame.
+ */
+struct StreamConfig {
+    WireFormat format = WireFormat::JSON;
+
+    uint16_t fields    = STATUS_FIELDS_DEFAULT; /**< StatusField bits, Json only */
+    uint32_t period_us = 0;                     /**< 0: every poll cycle */
+    vector<uint16_t> slaves;                    /**< Empty: every polled slave */
+
+    bool delta = false;              /**< Only changed fields are sent between keyframes */
+    uint16_t keyframe_interval = 50; /**< Status cycles between two keyframes */
+
+    bool acceptsSlave(uint16_t slave) const {
+        return slaves.empty() || find(slaves.begin(), slaves.end(), slave) != slaves.end();
+    }
+
+    bool operator==(const StreamConfig &rhs) const {
+        return format == rhs.format && fields == rhs.fields && period_us == rhs.period_us && slaves == rhs.slaves &&
+               delta == rhs.delta && keyframe_interval == rhs.keyframe_interval;
+    }
+};
+
+namespace binary_protocol {
+
+const uint8_t MAGIC   = 0xDA;
+const uint8_t VERSION = 1;
+
+const size_t HEADER_SIZE          = 4;
+const size_t COMMAND_PAYLOAD_SIZE    = 8;
+const size_t COMMAND_ID_PAYLOAD_SIZE = 12;
+const size_t STATUS_PAYLOAD_SIZE     = 20;
+const size_t ACK_PAYLOAD_SIZE        = 32;
+const size_t DELTA_HEADER_SIZE       = 8;  /**< Payload of a delta frame without values */
+
+const uint16_t OPCODE_CHANGE_SLAVE = 0x8001; /**< Not a DATC_COMMAND, handled by this program */
+
+const uint16_t FLAG_VALUE_1 = 0x01;
+const uint16_t FLAG_VALUE_2 = 0x02;
+const uint16_t FLAG_ID      = 0x04;
+
+const uint16_t DELTA_KEYFRAME = 0x8000;
+
+enum class FrameType : uint8_t {
+    HELLO        = 0x00,
+    COMMAND      = 0x01,
+    STATUS       = 0x02,
+    ACK          = 0x03,
+    STATUS_DELTA = 0x04,
+};
+
+inline void putU16(char *out, uint16_t value) {
+    out[0] = (char) (value & 0xFF);
+    out[1] = (char) (value >> 8);
+}
+
+inline void putU32(char *out, uint32_t value) {
+    putU16(out, value & 0xFFFF);
+    putU16(out + 2, value >> 16);
+}
+
+inline void putU64(char *out, uint64_t value) {
+    putU32(out, value & 0xFFFFFFFF);
+    putU32(out + 4, value >> 32);
+}
+
+inline uint16_t getU16(const char *in) {
+    return (uint16_t) ((uint8_t) in[0] | ((uint8_t) in[1] << 8));
+}
+
+inline uint32_t getU32(const char *in) {
+    return getU16(in) | ((uint32_t) getU16(in + 2) << 16);
+}
+
+inline uint64_t getU64(const char *in) {
+    return getU32(in) | ((uint64_t) getU32(in + 4) << 32);
+}
+
+inline void putHeader(char *out, FrameType type, uint8_t payload_size) {
+    out[0] = (char) MAGIC;
+    out[1] = (char) VERSION;
+    out[2] = (char) type;
+    out[3] = (char) payload_size;
+}
+
+inline void encodeHello(string &out) {
+    out.resize(HEADER_SIZE);
+    putHeader(&out[0], FrameType::HELLO, 0);
+}
+
+inline void encodeCommand(const CommandRequest &request, string &out) {
+    uint16_t flags = (request.has_value_1 ? FLAG_VALUE_1 : 0) |
+                     (request.has_value_2 ? FLAG_VALUE_2 : 0) |
+                     (request.has_id      ? FLAG_ID      : 0);
+    uint16_t opcode = (request.type == RequestType::CHANGE_SLAVE) ? OPCODE_CHANGE_SLAVE : request.command;
+    size_t payload_size = request.has_id ? COMMAND_ID_PAYLOAD_SIZE : COMMAND_PAYLOAD_SIZE;
+
+    out.resize(HEADER_SIZE + payload_size);
+
+    char *p = &out[0];
+    putHeader(p, FrameType::COMMAND, payload_size);
+    putU16(p + 4 , opcode);
+    putU16(p + 6 , flags);
+    putU16(p + 8 , request.value_1);
+    putU16(p + 10, request.value_2);
+
+    if (request.has_id) {
+        putU32(p + 12, request.id);
+    }
+}
+
+/**
+ * @return false if [begin, end) is not a command frame of a supported version
+ */
+inline bool decodeCommand(const char *begin, const char *end, CommandRequest &request) {
+    if ((size_t) (end - begin) < HEADER_SIZE + COMMAND_PAYLOAD_SIZE ||
+        (uint8_t) begin[1] != VERSION || (FrameType) begin[2] != FrameType::COMMAND) {
+        return false;
+    }
+
+    uint16_t opcode = getU16(begin + 4);
+    uint16_t flags  = getU16(begin + 6);
+
+    request.type        = (opcode == OPCODE_CHANGE_SLAVE) ? RequestType::CHANGE_SLAVE : RequestType::COMMAND;
+    request.command     = opcode;
+    request.value_1     = getU16(begin + 8);
+    request.value_2     = getU16(begin + 10);
+    request.has_value_1 = flags & FLAG_VALUE_1;
+    request.has_value_2 = flags & FLAG_VALUE_2;
+    request.has_id      = flags & FLAG_ID;
+
+    if (request.has_id) {
+        if ((size_t) (end - begin) < HEADER_SIZE + COMMAND_ID_PAYLOAD_SIZE) {
+            return false;
+        }
+        request.id = getU32(begin + 12);
+    }
+
+    return true;
+}
+
+inline void encodeStatus(const StatusMessage &status, string &out) {
+    out.resize(HEADER_SIZE + STATUS_PAYLOAD_SIZE);
+
+    char *p = &out[0];
+    putHeader(p, FrameType::STATUS, STATUS_PAYLOAD_SIZE);
+    putU32(p + 4 , status.sequence);
+    putU16(p + 8 , status.slave);
+    putU16(p + 10, status.states);
+    putU16(p + 12, status.motor_pos);
+    putU16(p + 14, status.motor_vel);
+    putU16(p + 16, status.motor_cur);
+    putU16(p + 18, status.finger_pos);
+    putU16(p + 20, status.voltage);
+    putU16(p + 22, 0);
+}
+
+inline bool decodeStatus(const char *begin, const char *end, StatusMessage &status) {
+    if ((size_t) (end - begin) < HEADER_SIZE + STATUS_PAYLOAD_SIZE ||
+        (uint8_t) begin[1] != VERSION || (FrameType) begin[2] != FrameType::STATUS) {
+        return false;
+    }
+
+    status.sequence   = getU32(begin + 4);
+    status.slave      = getU16(begin + 8);
+    status.states     = getU16(begin + 10);
+    status.motor_pos  = (int16_t) getU16(begin + 12);
+    status.motor_vel  = (int16_t) getU16(begin + 14);
+    status.motor_cur  = (int16_t) getU16(begin + 16);
+    status.finger_pos = getU16(begin + 18);
+    status.voltage    = getU16(begin + 20);
+
+    return true;
+}
+
+inline void encodeAck(const CommandAck &ack, string &out) {
+    out.resize(HEADER_SIZE + ACK_PAYLOAD_SIZE);
+
+    char *p = &out[0];
+    putHeader(p, FrameType::ACK, ACK_PAYLOAD_SIZE);
+    putU32(p + 4 , ack.id);
+    putU16(p + 8 , ack.command);
+    putU16(p + 10, (uint16_t) ack.error);
+    putU64(p + 12, ack.t_recv_us);
+    putU64(p + 20, ack.t_dequeue_us);
+    putU64(p + 28, ack.t_done_us);
+}
+
+inline bool decodeAck(const char *begin, const char *end, CommandAck &ack) {
+    if ((size_t) (end - begin) < HEADER_SIZE + ACK_PAYLOAD_SIZE ||
+        (uint8_t) begin[1] != VERSION || (FrameType) begin[2] != FrameType::ACK) {
+        return false;
+    }
+
+    ack.id           = getU32(begin + 4);
+    ack.command      = getU16(begin + 8);
+    ack.error        = (CommandError) getU16(begin + 10);
+    ack.t_recv_us    = getU64(begin + 12);
+    ack.t_dequeue_us = getU64(begin + 20);
+    ack.t_done_us    = getU64(begin + 28);
+
+    return true;
+}
+
+/**
+ * @brief Status delta frame carrying the value of the fields in 'fields'.
+ * @param fields Fields to carry, StatusField bits except sequence and slave
+ */
+inline void encodeStatusDelta(const StatusMessage &status, uint16_t fields, uint32_t delta_sequence,
+                              bool keyframe, string &out) {
+    out.resize(HEADER_SIZE + DELTA_HEADER_SIZE + 2 * STATUS_FIELD_COUNT);
+
+    char *p = &out[0];
+    char *value = p + HEADER_SIZE + DELTA_HEADER_SIZE;
+
+    for (size_t i = 0; i < STATUS_FIELD_COUNT; i++) {
+        if (fields & (1 << i)) {
+            putU16(value, (uint16_t) getStatusField(status, (StatusField) (1 << i)));
+            value += 2;
+        }
+    }
+
+    size_t payload_size = value - p - HEADER_SIZE;
+
+    putHeader(p, FrameType::STATUS_DELTA, payload_size);
+    putU32(p + 4, delta_sequence);
+    putU16(p + 8, status.slave);
+    putU16(p + 10, fields | (keyframe ? DELTA_KEYFRAME : 0));
+
+    out.resize(HEADER_SIZE + payload_size);
+}
+
+/**
+ * @brief Applies a delta frame on 'status', which must hold the previously decoded values.
+ */
+inline bool decodeStatusDelta(const char *begin, const char *end, StatusMessage &status,
+                              uint32_t &delta_sequence, bool &keyframe) {
+    if ((size_t) (end - begin) < HEADER_SIZE + DELTA_HEADER_SIZE ||
+        (uint8_t) begin[1] != VERSION || (FrameType) begin[2] != FrameType::STATUS_DELTA) {
+        return false;
+    }
+
+    uint16_t mask = getU16(begin + 10);
+    const char *value = begin + HEADER_SIZE + DELTA_HEADER_SIZE;
+
+    delta_sequence = getU32(begin + 4);
+    status.slave   = getU16(begin + 8);
+    keyframe       = mask & DELTA_KEYFRAME;
+
+    for (size_t i = 0; i < STATUS_FIELD_COUNT; i++) {
+        if (!(mask & (1 << i))) {
+            continue;
+        }
+
+        if (value + 2 > end) {
+            return false;
+        }
+
+        uint16_t raw = getU16(value);
+        value += 2;
+
+        switch ((StatusField) (1 << i)) {
+            case FIELD_FINGER_POS: status.finger_pos = raw;           break;
+            case FIELD_MOTOR_CUR:  status.motor_cur  = (int16_t) raw; break;
+            case FIELD_MOTOR_POS:  status.motor_pos  = (int16_t) raw; break;
+            case FIELD_MOTOR_VEL:  status.motor_vel  = (int16_t) raw; break;
+            case FIELD_STATES:     status.states     = raw;           break;
+            case FIELD_VOLTAGE:    status.voltage    = raw;           break;
+            default:                                                  break;
+        }
+    }
+
+    return true;
+}
+} // namespace binary_protocol
+
+namespace json_protocol {
+
+/**
+ * @return false if the message is neither a command nor a slave change, or a number in it is out
+ * of range
+ */
+inline bool decodeCommand(const Json::Value &json, CommandRequest &request) {
+    // Values are 16 bit registers, written signed or unsigned
+    auto getValueFn = [&json] (const char *key, uint16_t &value) {
+        const Json::Value &member = json[key];
+        if (!member.isInt() || member.asInt() < INT16_MIN || member.asInt() > UINT16_MAX) {
+            return false;
+        }
+        value = (uint16_t) member.asInt();
+        return true;
+    };
+
+    if (json.isMember("id")) {
+        if (!json["id"].isUInt()) {
+            return false;
+        }
+        request.has_id = true;
+        request.id     = json["id"].asUInt();
+    }
+
+    if (json.isMember("change_slave")) {
+        request.type = RequestType::CHANGE_SLAVE;
+        request.has_value_1 = getValueFn("change_slave", request.value_1);
+        return request.has_value_1;
+    }
+
+    const Json::Value &command = json["command"];
+
+    if (!command.isUInt() || command.asUInt() > UINT16_MAX) {
+        return false;
+    }
+
+    request.type        = RequestType::COMMAND;
+    request.command     = (uint16_t) command.asUInt();
+    request.has_value_1 = json.isMember("value_1");
+    request.has_value_2 = json.isMember("value_2");
+
+    if ((request.has_value_1 && !getValueFn("value_1", request.value_1)) ||
+        (request.has_value_2 && !getValueFn("value_2", request.value_2))) {
+        return false;
+    }
+
+    return true;
+}
+
+const size_t STATUS_MAX_SIZE = 192; /**< Upper bound of a serialized status, newline included */
+
+/**
+ * @brief Writes a non-negative integer and returns the end of the written digits.
+ */
+inline char *writeDigits(char *out, uint32_t value) {
+    static const char kDigitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    char digits[10];
+    char *p = digits + sizeof(digits);
+
+    while (value >= 100) {
+        p -= 2;
+        memcpy(p, &kDigitPairs[(value % 100) * 2], 2);
+        value /= 100;
+    }
+
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, &kDigitPairs[value * 2], 2);
+    } else {
+        *--p = (char) ('0' + value);
+    }
+
+    size_t length = digits + sizeof(digits) - p;
+    memcpy(out, p, length);
+
+    return out + length;
+}
+
+template<size_t N>
+inline char *writeFragment(char *out, const char (&fragment)[N]) {
+    memcpy(out, fragment, N - 1);
+    return out + N - 1;
+}
+
+inline char *writeInt(char *out, int64_t value) {
+    if (value < 0) {
+        *out++ = '-';
+        return writeDigits(out, (uint32_t) -value);
+    }
+    return writeDigits(out, (uint32_t) value);
+}
+
+/**
+ * @brief Writes ',"<key>":<value>' of every selected field and returns the end of the output.
+ */
+inline char *writeStatusFields(char *out, const StatusMessage &status, uint16_t fields) {
+    // ",\"<key>\":" of every field, in the order of the StatusField bits
+    static const struct {
+        const char *text;
+        size_t size;
+    } kKeys[STATUS_FIELD_COUNT] = {
+        {",\"finger_pos\":", 14},
+        {",\"motor_cur\":" , 13},
+        {",\"motor_pos\":" , 13},
+        {",\"motor_vel\":" , 13},
+        {",\"sequence\":"  , 12},
+        {",\"slave\":"     , 9 },
+        {",\"states\":"    , 10},
+        {",\"voltage\":"   , 11},
+    };
+
+    for (size_t i = 0; i < STATUS_FIELD_COUNT; i++) {
+        if (fields & (1 << i)) {
+            memcpy(out, kKeys[i].text, kKeys[i].size);
+            out = writeInt(out + kKeys[i].size, getStatusField(status, (StatusField) (1 << i)));
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief Serializes the selected status fields without building a Json::Value.
+ * @details The output is byte-identical to Json::FastWriter on the equivalent Json::Value:
+ * keys in alphabetical order, no whitespace and a trailing newline.
+ * @param out At least STATUS_MAX_SIZE bytes
+ * @return Number of bytes written
+ */
+inline size_t writeStatus(const StatusMessage &status, char *out, uint16_t fields = STATUS_FIELDS_DEFAULT) {
+    char *p = writeStatusFields(out, status, fields);
+
+    if (p == out) {
+        *p++ = '{';
+    } else {
+        out[0] = '{';
+    }
+
+    *p++ = '}';
+    *p++ = '\n';
+
+    return p - out;
+}
+
+inline void encodeStatus(const StatusMessage &status, string &out, uint16_t fields = STATUS_FIELDS_DEFAULT) {
+    out.resize(STATUS_MAX_SIZE);
+    out.resize(writeStatus(status, &out[0], fields));
+}
+
+/**
+ * @brief Delta frame: {"delta_seq":<n>[,"keyframe":true],<fields in StatusField order>}\n
+ * @param fields Fields to carry, StatusField bits (sequence is replaced by "delta_seq")
+ */
+inline void encodeStatusDelta(const StatusMessage &status, uint16_t fields, uint32_t delta_sequence,
+                              bool keyframe, string &out) {
+    out.resize(STATUS_MAX_SIZE + 48);
+
+    char *p = &out[0];
+
+    p = writeFragment(p, "{\"delta_seq\":");
+    p = writeDigits(p, delta_sequence);
+
+    if (keyframe) {
+        p = writeFragment(p, ",\"keyframe\":true");
+    }
+
+    p = writeStatusFields(p, status, fields & ~FIELD_SEQUENCE);
+
+    *p++ = '}';
+    *p++ = '\n';
+
+    out.resize(p - &out[0]);
+}
+
+inline const char *errorString(CommandError error) {
+    switch (error) {
+        case CommandError::MISSING_VALUE:     return "missing_value";
+        case CommandError::UNDEFINED_COMMAND: return "undefined_command";
+        case CommandError::COMMAND_FAILED:    return "command_failed";
+        case CommandError::MALFORMED:         return "malformed";
+        default:                              return "";
+    }
+}
+
+inline void encodeAck(const CommandAck &ack, string &out) {
+    Json::Value json;
+
+    json["ack"]       = ack.id;
+    json["success"]   = (ack.error == CommandError::NONE);
+    json["t_recv"]    = (Json::UInt64) ack.t_recv_us;
+    json["t_dequeue"] = (Json::UInt64) ack.t_dequeue_us;
+    json["t_done"]    = (Json::UInt64) ack.t_done_us;
+
+    if (ack.error != CommandError::NONE) {
+        json["error"] = errorString(ack.error);
+    }
+
+    Json::FastWriter writer;
+    out = writer.write(json);
+}
+} // namespace json_protocol
+} // namespace tcp_comm
+#endif
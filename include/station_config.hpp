@@ -0,0 +1,81 @@
+/**
+ * @file station_config.hpp
+ * @brief Buses, slaves and endpoints of a station from a Json file, brought up all at once.
+ * @details A station file looks like
+ *
+ *     {
+ *         "buses": [{"device": "/dev/ttyUSB0", "baudrate": 38400, "slave": 1, "poll_slaves": [2, 3]}],
+ *         "tcp": {"port": 8421, "send_status": true},
+ *         "unix_socket": "/run/datc.sock",
+ *         "udp": {"group": "239.255.0.1", "port": 8422},
+ *         "shm": "/datc_status",
+ *         "telemetry": {"dir": "/var/lib/datc", "segment_mb": 16, "segments": 64, "compress": true},
+ *         "first_status_timeout_ms": 3000
+ *     }
+ *
+ * Every key is optional. The flat keys of the older datc_daemon files (device, slave,
+ * poll_slaves, tcp_port, udp_group, udp_port, telemetry as a directory, telemetry_segment_mb,
+ * ...) are read as well, the bus ones apply to the first bus.
+ * @version 1.0
+ * @date 2024-04-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef STATION_CONFIG_HPP
+#define STATION_CONFIG_HPP
+
+#include "datc_comm_interface.hpp"
+
+using namespace std;
+
+struct BusConfig {
+    string device  = "/dev/ttyUSB0";
+    int baudrate   = BAUDRATE;
+    uint16_t slave = 1;
+    vector<uint16_t> poll_slaves; /**< Polled besides slave, see DatcCommInterface::setPollSlaves */
+};
+
+struct StationConfig {
+    vector<BusConfig> buses; /**< One DatcCommInterface drives the first one */
+
+    int tcp_port = 0;        /**< 0: no TCP server */
+    bool tcp_send_status = true;
+    string unix_socket;      /**< Empty: no Unix domain socket */
+    string udp_group;        /**< Empty: no multicast */
+    uint16_t udp_port = 8422;
+    string shm_name;         /**< Empty: no shared-memory segment */
+
+    string telemetry_dir;    /**< Empty: no telemetry store */
+    size_t telemetry_segment_mb = 16;
+    size_t telemetry_segments   = 64;
+    bool telemetry_compress     = false;
+
+    int first_status_timeout_ms = 3000;
+};
+
+// Keys missing from json keep the values of config, false if json is not an object
+bool parseStationConfig(const Json::Value &json, StationConfig &config);
+bool loadStationConfig(const string &path, StationConfig &config);
+
+struct StartupReport {
+    bool is_bus_open = false;
+    vector<string> failed;       /**< Endpoints that could not be opened, e.g. "udp" */
+    double bus_ms   = 0;         /**< Opening the port of the bus */
+    double ready_ms = 0;         /**< Bus and every endpoint open */
+    double first_status_ms = -1; /**< First status read, -1 if none within the timeout */
+};
+
+/**
+ * @brief Opens the first bus and every endpoint of config at the same time, starts polling and
+ * waits up to first_status_timeout_ms for the first status.
+ * @details A slow serial port or a dead slave does not hold up the sockets, and the other way
+ * round, so a station is up after its slowest part instead of the sum of them.
+ * @param transport Replaces the serial port of the bus if not null, e.g. a simulator
+ * @return false if the bus or an endpoint could not be opened, report says which. Whatever did
+ * open is released again then, so startStation can be retried on the same interface.
+ */
+bool startStation(DatcCommInterface &datc_interface, const StationConfig &config, StartupReport &report,
+                  ModbusTransport *transport = nullptr);
+
+#endif // STATION_CONFIG_HPP
@@ -0,0 +1,244 @@
+/**
+ * @file status_history.hpp
+ * @brief Recent finger position, motor current and velocity of the current slave, for plots.
+ * @details The poll loop appends every status it reads to a fixed ring, so a plot sees the full
+ * poll rate whatever its own refresh rate. The min / max of each channel per pixel column of the
+ * plot window is kept up to date as samples arrive, so the cost of drawing depends on its width
+ * only, not on the poll rate, and a spike shorter than a column still shows.
+ * @version 1.0
+ * @date 2024-04-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef STATUS_HISTORY_HPP
+#define STATUS_HISTORY_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+enum class TrendChannel {
+    FINGER_POS = 0, /**< 0.1 % */
+    MOTOR_CUR  = 1, /**< mA */
+    MOTOR_VEL  = 2, /**< rpm */
+};
+
+const size_t kTrendChannels        = 3;
+const size_t kStatusHistorySamples = 4096; /**< About 80 s at the 50 Hz poll rate */
+
+// Time base of the samples, steady so a plot window does not jump with the wall clock
+inline uint64_t historyNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TrendSample {
+    uint64_t t_us = 0;
+    int16_t values[kTrendChannels] = {};
+};
+
+// Min / max of a channel over one pixel column, count 0 if no sample fell in it
+struct TrendColumn {
+    int16_t min = 0;
+    int16_t max = 0;
+    uint32_t count = 0;
+};
+
+// Column of the trend window, on a grid of bucket_us from t = 0
+struct TrendBucket {
+    uint64_t index = 0; /**< t_us / bucket_us of the samples in it */
+    TrendColumn columns[kTrendChannels];
+};
+
+class StatusHistory {
+public:
+    StatusHistory(size_t capacity = kStatusHistorySamples) : ring_(capacity) {}
+
+    // Samples in time order, the oldest is overwritten once full
+    void append(const TrendSample &sample) {
+        unique_lock<mutex> lg(mutex_);
+
+        ring_[(first_ + size_) % ring_.size()] = sample;
+        addToBucket(sample);
+
+        if (size_ < ring_.size()) {
+            size_++;
+        } else {
+            first_ = (first_ + 1) % ring_.size();
+        }
+    }
+
+    void clear() {
+        unique_lock<mutex> lg(mutex_);
+        first_ = size_ = 0;
+        buckets_.assign(buckets_.size(), TrendBucket());
+    }
+
+    /**
+     * @brief Keeps the min / max of every channel per column of a window of window_us split into
+     * 'columns', updated by append(). Rebuilt from the samples only if the window or width changed.
+     */
+    void setTrendWindow(uint64_t window_us, size_t columns) {
+        unique_lock<mutex> lg(mutex_);
+
+        const uint64_t bucket_us = max<uint64_t>(window_us / max<size_t>(columns, 1), 1);
+
+        if (bucket_us == bucket_us_ && columns == buckets_.size()) {
+            return;
+        }
+
+        bucket_us_ = bucket_us;
+        buckets_.assign(columns, TrendBucket());
+
+        for (size_t i = 0; i < size_; i++) {
+            addToBucket(at(i));
+        }
+    }
+
+    /**
+     * @brief Columns of the trend window that ends at t_to_us, oldest first. The last one is still
+     * filling. One copy per column, whatever the number of samples in the window.
+     * @param out One vector of columns per channel, resized, reused between calls
+     */
+    void getTrend(uint64_t t_to_us, vector<TrendColumn> (&out)[kTrendChannels]) {
+        unique_lock<mutex> lg(mutex_);
+
+        const size_t columns = buckets_.size();
+
+        for (vector<TrendColumn> &channel : out) {
+            channel.assign(columns, TrendColumn());
+        }
+
+        if (columns == 0) {
+            return;
+        }
+
+        const uint64_t last = t_to_us / bucket_us_;
+
+        for (size_t x = 0; x < columns; x++) {
+            if (last + x + 1 < columns) {
+                continue;
+            }
+
+            const uint64_t index = last + x + 1 - columns;
+            const TrendBucket &bucket = buckets_[index % columns];
+
+            // A slot of another index got no sample in this column yet
+            if (bucket.index != index) {
+                continue;
+            }
+
+            for (size_t channel = 0; channel < kTrendChannels; channel++) {
+                out[channel][x] = bucket.columns[channel];
+            }
+        }
+    }
+
+    // False without samples
+    bool getLast(TrendSample &sample) {
+        unique_lock<mutex> lg(mutex_);
+
+        if (size_ == 0) {
+            return false;
+        }
+        sample = at(size_ - 1);
+        return true;
+    }
+
+    /**
+     * @brief Splits [t_from_us, t_to_us) into equal columns and takes the min / max of every
+     * channel of the samples in each.
+     * @param out One vector of columns per channel, resized, reused between calls
+     */
+    void decimate(uint64_t t_from_us, uint64_t t_to_us, size_t columns, vector<TrendColumn> (&out)[kTrendChannels]) {
+        for (vector<TrendColumn> &channel : out) {
+            channel.assign(columns, TrendColumn());
+        }
+
+        if (columns == 0 || t_to_us <= t_from_us) {
+            return;
+        }
+
+        const uint64_t span_us = t_to_us - t_from_us;
+
+        unique_lock<mutex> lg(mutex_);
+
+        // First sample in the window, the ring is in time order
+        size_t lo = 0, hi = size_;
+
+        while (lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+
+            if (at(mid).t_us < t_from_us) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        for (size_t i = lo; i < size_; i++) {
+            const TrendSample &sample = at(i);
+
+            if (sample.t_us >= t_to_us) {
+                break;
+            }
+
+            const size_t column = (size_t) ((sample.t_us - t_from_us) * columns / span_us);
+
+            for (size_t channel = 0; channel < kTrendChannels; channel++) {
+                TrendColumn &col = out[channel][column];
+                const int16_t value = sample.values[channel];
+
+                col.min = (col.count == 0) ? value : min(col.min, value);
+                col.max = (col.count == 0) ? value : max(col.max, value);
+                col.count++;
+            }
+        }
+    }
+
+private:
+    const TrendSample &at(size_t i) const {
+        return ring_[(first_ + i) % ring_.size()];
+    }
+
+    void addToBucket(const TrendSample &sample) {
+        if (buckets_.empty()) {
+            return;
+        }
+
+        const uint64_t index = sample.t_us / bucket_us_;
+        TrendBucket &bucket = buckets_[index % buckets_.size()];
+
+        // The slot is reused once its column left the window
+        if (bucket.index != index) {
+            if (bucket.index > index) {
+                return;
+            }
+            bucket = TrendBucket();
+            bucket.index = index;
+        }
+
+        for (size_t channel = 0; channel < kTrendChannels; channel++) {
+            TrendColumn &col = bucket.columns[channel];
+            const int16_t value = sample.values[channel];
+
+            col.min = (col.count == 0) ? value : min(col.min, value);
+            col.max = (col.count == 0) ? value : max(col.max, value);
+            col.count++;
+        }
+    }
+
+    vector<TrendSample> ring_;
+    size_t first_ = 0;
+    size_t size_  = 0;
+    uint64_t bucket_us_ = 1;
+    vector<TrendBucket> buckets_;
+    mutex mutex_;
+};
+
+#endif // STATUS_HISTORY_HPP
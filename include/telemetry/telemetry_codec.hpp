@@ -0,0 +1,125 @@
+/**
+ * @file telemetry_codec.hpp
+ * @brief Compressed columnar blocks for long-term telemetry, see telemetry_store.hpp.
+ * @details A block holds up to kBlockSamples samples of one slave as columns: time, sequence
+ * and each status register. A column stores its first value and then the differences between
+ * neighbouring values, zigzag mapped so small negative differences stay small, as varints. A
+ * column whose differences repeat (constant states and voltage, a position ramp, the sequence)
+ * is stored as runs of (difference, count) instead, and one whose differences vary little
+ * around a step (the poll times) as the differences of the differences, whichever is shortest.
+ *
+ * Every block starts with a BlockIndex: slave, time range and the min / max of each register,
+ * so a query skips blocks of other slaves, other times or without the values it looks for
+ * without decoding them. An archive file is a header followed by blocks; the blocks of a
+ * slave are in time order, blocks of different slaves interleave.
+ * @version 1.0
+ * @date 2024-04-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef TELEMETRY_CODEC_HPP
+#define TELEMETRY_CODEC_HPP
+
+#include <string>
+#include <vector>
+#include "telemetry_format.hpp"
+
+using namespace std;
+
+namespace telemetry {
+
+const char     ARCHIVE_MAGIC[8]    = {'D', 'A', 'T', 'C', 'T', 'L', 'C', '1'};
+const uint32_t ARCHIVE_VERSION     = 1;
+const size_t   ARCHIVE_HEADER_SIZE = 24;
+const char     ARCHIVE_SUFFIX[]    = ".tlc";
+
+const size_t kBlockSamples    = 1024;
+const size_t BLOCK_INDEX_SIZE = 64;
+const size_t BLOCK_COLUMNS    = 2 + TELEMETRY_REGISTERS; /**< Time, sequence, registers */
+
+enum class ColumnEncoding : uint8_t {
+    DELTA_VARINT       = 0,
+    DELTA_RLE          = 1,
+    DELTA_DELTA_VARINT = 2,
+};
+
+// motor_pos, motor_cur and motor_vel are two's complement, see DatcCtrl::decodeDatcData
+inline bool isSignedRegister(size_t reg) {
+    return reg >= 1 && reg <= 3;
+}
+
+inline int32_t registerValue(const TelemetrySample &sample, size_t reg) {
+    return isSignedRegister(reg) ? (int16_t) sample.registers[reg] : sample.registers[reg];
+}
+
+struct BlockIndex {
+    uint16_t slave = 0;
+    uint16_t count = 0;
+    uint32_t size  = 0;          /**< Encoded columns following the index, in bytes */
+    uint64_t t_first_us = 0;
+    uint64_t t_last_us  = 0;
+    uint32_t sequence_first = 0;
+    uint16_t states_any = 0;     /**< Bits of registers[0] set in any sample */
+    uint16_t states_all = 0;     /**< Bits of registers[0] set in every sample */
+    int32_t min[TELEMETRY_REGISTERS] = {}; /**< As registerValue() */
+    int32_t max[TELEMETRY_REGISTERS] = {};
+
+    bool overlaps(uint64_t t_from_us, uint64_t t_to_us) const {
+        return t_last_us >= t_from_us && t_first_us < t_to_us;
+    }
+};
+
+/**
+ * @brief Appends the index and the columns of samples, all of one slave and in time order.
+ * @param count At most kBlockSamples
+ */
+void encodeBlock(const TelemetrySample *samples, size_t count, string &out, BlockIndex *index = nullptr);
+
+// Reads a block index, false if size is too short for the index and its columns
+bool readBlockIndex(const char *data, size_t size, BlockIndex &index);
+
+/**
+ * @brief Appends the samples of a block.
+ * @param columns The index.size bytes after the index
+ * @return false if the columns are corrupt
+ */
+bool decodeBlock(const BlockIndex &index, const char *columns, vector<TelemetrySample> &samples);
+
+/**
+ * @brief Writes samples of any slaves to an archive file, one block per slave at a time.
+ * @details Memory is bounded by one pending block per slave.
+ */
+class ArchiveWriter {
+public:
+    ~ArchiveWriter() {close();}
+
+    bool open(const string &path, uint64_t sequence);
+
+    // Samples of a slave must be in time order
+    void append(const TelemetrySample &sample);
+
+    // Writes the pending blocks, false if any write failed
+    bool close();
+
+    uint64_t getBytesWritten() const {return bytes_;}
+
+private:
+    void flush(vector<TelemetrySample> &pending);
+
+    FILE *file_ = nullptr;
+    vector<vector<TelemetrySample>> pending_; /**< Per slave */
+    string block_;
+    uint64_t bytes_ = 0;
+    bool error_ = false;
+};
+
+/**
+ * @brief Encodes a finished segment file into an archive file.
+ * @details The archive is written next to its final path and renamed, so a reader never sees
+ * half an archive.
+ */
+bool compactSegment(const string &segment_path, const string &archive_path);
+
+} // namespace telemetry
+#endif // TELEMETRY_CODEC_HPP
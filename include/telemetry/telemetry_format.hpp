@@ -0,0 +1,61 @@
+/**
+ * @file telemetry_format.hpp
+ * @brief Layout of the telemetry segment files, shared by the writer and the readers.
+ * @details A store is a directory of segment files telemetry_<sequence>.seg, each of a fixed
+ * size: a 64 byte header followed by fixed-size samples in the order they were polled. The
+ * writer publishes a sample by storing the header's count after the sample, so a reader of a
+ * segment being written, or left by a writer that crashed, sees a consistent prefix.
+ *
+ * Sample times are the wall clock of the poll in microseconds since the epoch, clamped to be
+ * non-decreasing within a store, so samples can be looked up by time with a binary search.
+ * @version 1.0
+ * @date 2024-04-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef TELEMETRY_FORMAT_HPP
+#define TELEMETRY_FORMAT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+namespace telemetry {
+
+const char     SEGMENT_MAGIC[8]      = {'D', 'A', 'T', 'C', 'T', 'L', 'M', '1'};
+const uint32_t SEGMENT_VERSION       = 1;
+const size_t   SEGMENT_HEADER_SIZE   = 64;
+const size_t   TELEMETRY_REGISTERS   = 8;  /**< Status registers of a sample, kStatusRegNum */
+
+const char SEGMENT_PREFIX[] = "telemetry_";
+const char SEGMENT_SUFFIX[] = ".seg";
+
+struct TelemetrySample {
+    uint64_t t_us     = 0;
+    uint32_t sequence = 0; /**< Per slave, a gap is a lost sample */
+    uint16_t slave    = 0;
+    uint16_t reserved = 0;
+    uint16_t registers[TELEMETRY_REGISTERS] = {}; /**< As read, decoded by DatcCtrl::decodeDatcData */
+};
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sample_size;
+    uint64_t capacity;        /**< Samples */
+    uint64_t sequence;        /**< Of the segment in its store */
+    atomic<uint64_t> count;   /**< Samples written, stored after them */
+    atomic<uint64_t> t_first_us;
+    atomic<uint64_t> t_last_us;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(TelemetrySample) == 32, "Sample layout is part of the file format");
+static_assert(sizeof(SegmentHeader) == SEGMENT_HEADER_SIZE, "Header layout is part of the file format");
+static_assert(atomic<uint64_t>::is_always_lock_free, "Atomics shared through files must be lock-free");
+
+} // namespace telemetry
+#endif // TELEMETRY_FORMAT_HPP
@@ -0,0 +1,263 @@
+/**
+ * @file telemetry_store.hpp
+ * @brief History of every polled status sample in rotating memory-mapped segment files.
+ * @details The poll loop hands samples to TelemetryWriter::append(), which only copies the
+ * sample into a lock-free single-producer queue. A background thread moves the samples into the
+ * mapped segment, creates the next segment when one is full and deletes the oldest beyond
+ * max_segments, so the store never grows beyond max_segments * segment_bytes on disk and the
+ * poll loop never waits for the disk or a page fault. If the writer falls behind by more than
+ * the queue, samples are dropped and counted. With compress set, a full segment is encoded into
+ * an archive file of compressed columnar blocks (see telemetry_codec.hpp) that replaces it.
+ *
+ * TelemetryReader maps the segments and archives of a store read-only, also while it is being
+ * written, and finds the samples of a time range by binary search in segments and by the block
+ * indexes in archives:
+ *
+ * @code
+ * telemetry::TelemetryReader reader;
+ *
+ * if (reader.open("/var/lib/datc/telemetry")) {
+ *     reader.forEach(t_from_us, t_to_us, [] (const telemetry::TelemetrySample &sample) {
+ *         printf("%u %u\n", sample.slave, sample.registers[4]);
+ *         return true;
+ *     });
+ * }
+ * @endcode
+ * @version 1.0
+ * @date 2024-04-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef TELEMETRY_STORE_HPP
+#define TELEMETRY_STORE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+#include "telemetry_format.hpp"
+#include "telemetry_codec.hpp"
+
+using namespace std;
+
+namespace telemetry {
+
+struct TelemetryConfig {
+    size_t segment_bytes = 16 * 1024 * 1024; /**< About 2.9 hours of one slave at 50 Hz */
+    size_t max_segments  = 64;    /**< Segment and archive files kept */
+    bool compress        = false; /**< Replace full segments by archives, done by the writer thread */
+};
+
+struct TelemetryStats {
+    uint64_t appended = 0;
+    uint64_t written  = 0;
+    uint64_t dropped  = 0; /**< Queue full or no segment could be created */
+    uint64_t segments = 0; /**< Created since open */
+    uint64_t archived = 0; /**< Segments replaced by archives */
+    uint64_t archived_bytes = 0; /**< Raw samples of those segments, in bytes */
+    uint64_t archive_bytes  = 0; /**< Their archives */
+};
+
+const size_t kTelemetryQueueSize = 8192; /**< Power of 2 */
+const size_t kTelemetrySlaves    = 248;
+
+class TelemetryWriter {
+public:
+    TelemetryWriter() {}
+    ~TelemetryWriter() {close();}
+
+    TelemetryWriter(const TelemetryWriter &) = delete;
+    TelemetryWriter &operator=(const TelemetryWriter &) = delete;
+
+public:
+    // Creates the directory if needed, segments of an earlier run are kept and count towards max_segments
+    bool open(const string &dir, const TelemetryConfig &config = TelemetryConfig());
+
+    // Writes the queued samples and unmaps the segment
+    void close();
+
+    bool isOpen() const {return writer_.joinable();}
+
+    /**
+     * @brief Queues a sample, t_us and sequence are set here. Only one thread may append.
+     * @return false if the sample was dropped
+     */
+    bool append(TelemetrySample &sample);
+
+    TelemetryStats getStats() const;
+
+private:
+    void writerLoop();
+    void writeQueued();
+    bool rotate();
+    void unmapSegment();
+    void archiveSegment(size_t index);
+
+    string dir_;
+    TelemetryConfig config_;
+
+    vector<TelemetrySample> queue_; /**< kTelemetryQueueSize, allocated by open() */
+    atomic<uint64_t> queue_head_{0}; /**< Samples appended */
+    atomic<uint64_t> queue_tail_{0}; /**< Samples taken by the writer */
+    uint32_t sequences_[kTelemetrySlaves] = {};
+
+    std::thread writer_;
+    atomic<bool> flag_stop_{false};
+
+    // Writer thread only
+    SegmentHeader *segment_ = nullptr;
+    TelemetrySample *samples_ = nullptr;
+    uint64_t capacity_ = 0;
+    uint64_t t_last_us_ = 0;
+    uint64_t next_sequence_ = 0;
+    vector<string> segment_paths_; /**< Oldest first */
+
+    atomic<uint64_t> written_{0};
+    atomic<uint64_t> dropped_{0};
+    atomic<uint64_t> segments_{0};
+    atomic<uint64_t> archived_{0};
+    atomic<uint64_t> archived_bytes_{0};
+    atomic<uint64_t> archive_bytes_{0};
+};
+
+/**
+ * @brief A segment or an archive of a store, read-only.
+ */
+class TelemetryFile {
+public:
+    virtual ~TelemetryFile() {}
+
+    // Samples of the file, a segment grows while it is written
+    virtual uint64_t size() const = 0;
+
+    virtual uint64_t getSequence() const = 0;
+    virtual uint64_t getFirstTime() const = 0;
+    virtual uint64_t getLastTime() const = 0;
+    virtual const string &getPath() const = 0;
+
+    /**
+     * @brief Same as TelemetryReader::forEach for the samples of this file.
+     * @param stop Set if fn returned false
+     */
+    virtual uint64_t forEach(uint64_t t_from_us, uint64_t t_to_us, const function<bool (const TelemetrySample &)> &fn,
+                             int slave, bool &stop) const = 0;
+
+    // A segment or an archive by the suffix of path, nullptr if it cannot be read
+    static unique_ptr<TelemetryFile> open(const string &path);
+};
+
+/**
+ * @brief One segment file mapped read-only.
+ */
+class TelemetrySegment : public TelemetryFile {
+public:
+    TelemetrySegment() {}
+    ~TelemetrySegment() override {close();}
+
+    TelemetrySegment(const TelemetrySegment &) = delete;
+    TelemetrySegment &operator=(const TelemetrySegment &) = delete;
+
+public:
+    bool open(const string &path);
+    void close();
+
+    // Samples written so far, grows while the segment is written
+    uint64_t size() const override {return header_->count.load(memory_order_acquire);}
+    const TelemetrySample &at(uint64_t index) const {return samples_[index];}
+
+    // First sample at or after t_us, size() if none
+    uint64_t lowerBound(uint64_t t_us) const;
+
+    uint64_t getSequence() const override {return header_->sequence;}
+    uint64_t getFirstTime() const override {return header_->t_first_us.load(memory_order_relaxed);}
+    uint64_t getLastTime() const override {return header_->t_last_us.load(memory_order_relaxed);}
+    const string &getPath() const override {return path_;}
+
+    uint64_t forEach(uint64_t t_from_us, uint64_t t_to_us, const function<bool (const TelemetrySample &)> &fn,
+                     int slave, bool &stop) const override;
+
+private:
+    const SegmentHeader *header_ = nullptr;
+    const TelemetrySample *samples_ = nullptr;
+    size_t mapped_size_ = 0;
+    string path_;
+};
+
+struct ArchiveBlock {
+    BlockIndex index;
+    const char *columns; /**< In the mapping of the archive */
+};
+
+/**
+ * @brief One archive file mapped read-only, its block indexes read by open().
+ */
+class TelemetryArchive : public TelemetryFile {
+public:
+    TelemetryArchive() {}
+    ~TelemetryArchive() override {close();}
+
+    TelemetryArchive(const TelemetryArchive &) = delete;
+    TelemetryArchive &operator=(const TelemetryArchive &) = delete;
+
+public:
+    bool open(const string &path);
+    void close();
+
+    uint64_t size() const override {return samples_;}
+    uint64_t getSequence() const override {return sequence_;}
+    uint64_t getFirstTime() const override {return t_first_us_;}
+    uint64_t getLastTime() const override {return t_last_us_;}
+    const string &getPath() const override {return path_;}
+
+    // Blocks of a slave are in time order, blocks of different slaves interleave
+    const vector<ArchiveBlock> &getBlocks() const {return blocks_;}
+    bool decode(const ArchiveBlock &block, vector<TelemetrySample> &samples) const {
+        return decodeBlock(block.index, block.columns, samples);
+    }
+
+    // Merges the blocks of the slaves by time, one decoded block per slave at a time
+    uint64_t forEach(uint64_t t_from_us, uint64_t t_to_us, const function<bool (const TelemetrySample &)> &fn,
+                     int slave, bool &stop) const override;
+
+private:
+    void *mapping_ = nullptr;
+    size_t mapped_size_ = 0;
+    string path_;
+
+    vector<ArchiveBlock> blocks_;
+    uint64_t sequence_   = 0;
+    uint64_t samples_    = 0;
+    uint64_t t_first_us_ = 0;
+    uint64_t t_last_us_  = 0;
+};
+
+class TelemetryReader {
+public:
+    // Maps the files present now; files deleted afterwards stay readable until destruction
+    bool open(const string &dir);
+
+    /**
+     * @brief Visits the samples with t_from_us <= t_us < t_to_us in time order, of one slave if
+     * slave >= 0, until fn returns false.
+     * @return Samples visited
+     */
+    uint64_t forEach(uint64_t t_from_us, uint64_t t_to_us, const function<bool (const TelemetrySample &)> &fn,
+                     int slave = -1) const;
+
+    vector<TelemetrySample> read(uint64_t t_from_us, uint64_t t_to_us, int slave = -1) const;
+
+    uint64_t getFirstTime() const;
+    uint64_t getLastTime() const;
+    const vector<unique_ptr<TelemetryFile>> &getFiles() const {return files_;}
+
+    // Segment and archive files of a store, oldest first; a segment being archived is listed once
+    static vector<string> listFiles(const string &dir);
+
+private:
+    vector<unique_ptr<TelemetryFile>> files_;
+};
+
+} // namespace telemetry
+#endif // TELEMETRY_STORE_HPP
@@ -0,0 +1,155 @@
+/**
+ * @file trace_recorder.hpp
+ * @brief Trace points along the command and status paths, exported as Chrome / Perfetto trace Json.
+ * @details Every thread records into its own ring of the last kTraceBufferEvents events, without
+ * locks: a timestamp of the monotonic clock, the stage, and the correlation id of the command or
+ * poll cycle the event belongs to. A disabled recorder costs one relaxed load per trace point.
+ *
+ * A command gets its id when the socket frames it. The worker makes it the current id of its
+ * thread while executing, so the DatcCtrl and modbus trace points below it need no parameter.
+ * The first poll cycle after a command carries the command's id, so the status showing the
+ * command's effect is part of the same flow. Frames are followed from the broadcaster to the
+ * client writers by their address, joined when the trace is exported.
+ *
+ * Open the exported file in chrome://tracing or https://ui.perfetto.dev.
+ * @version 1.0
+ * @date 2024-04-17
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef TRACE_RECORDER_HPP
+#define TRACE_RECORDER_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+using namespace std;
+
+namespace tracing {
+
+enum class Stage : uint8_t {
+    SOCKET_READ,     /**< Command framed by the socket */
+    WORKER_QUEUE,    /**< Command waiting for the worker */
+    EXECUTE,         /**< Worker executing a command, ack included */
+    DATC_COMMAND,    /**< DatcCtrl::command */
+    MODBUS_LOCK,     /**< Waiting for the bus, e.g. behind a poll */
+    MODBUS_WRITE,
+    MODBUS_READ,
+    POLL_CYCLE,      /**< Status read of one poll cycle */
+    STATUS_PUBLISH,  /**< Status encoded and queued for the clients */
+    CLIENT_ENQUEUE,  /**< Frame queued for the client writers */
+    SOCKET_WRITE,    /**< Frame written by a client writer */
+    STARTUP,         /**< Gui from main() until its window is shown */
+    PAGE_BUILD,      /**< Gui page built on its first visit */
+    PORT_SCAN,       /**< Serial ports listed for the gui */
+    FONT_LOAD,       /**< Gui font loaded after the first frame */
+    FIRST_FRAME,     /**< Gui event loop free after its first paint */
+    COUNT,
+};
+
+const char *const STAGE_NAMES[(size_t) Stage::COUNT] = {
+    "socket_read", "worker_queue", "execute", "datc_command", "modbus_lock", "modbus_write",
+    "modbus_read", "poll_cycle", "status_publish", "client_enqueue", "socket_write", "startup",
+    "page_build", "port_scan", "font_load", "first_frame"
+};
+
+enum class Phase : uint8_t {
+    BEGIN,
+    END,
+    INSTANT,
+    ASYNC_BEGIN, /**< Of a span that ends on another thread, matched by the id */
+    ASYNC_END,
+};
+
+struct TraceEvent {
+    uint64_t t_ns;
+    uint64_t frame; /**< Address of the frame the event handles, 0 if none */
+    uint32_t id;    /**< Correlation id, 0 if none */
+    Stage stage;
+    Phase phase;
+};
+
+const size_t kTraceBufferEvents = 8192; /**< Per thread */
+
+extern atomic<bool> g_trace_enabled;
+
+inline bool isEnabled() {
+    return g_trace_enabled.load(memory_order_relaxed);
+}
+
+void setEnabled(bool enabled);
+
+/**
+ * @brief Events recorded before are left out of the next export.
+ */
+void clear();
+
+// A new correlation id, never 0
+uint32_t nextId();
+
+// Correlation id of the command or poll cycle the calling thread works on, 0 if none
+uint32_t currentId();
+void setCurrentId(uint32_t id);
+
+// Name of the calling thread in the exported trace
+void setThreadName(const string &name);
+
+void recordEvent(Stage stage, Phase phase, uint32_t id, const void *frame);
+
+inline void record(Stage stage, Phase phase, uint32_t id, const void *frame = nullptr) {
+    if (isEnabled()) {
+        recordEvent(stage, phase, id, frame);
+    }
+}
+
+inline void record(Stage stage, Phase phase) {
+    if (isEnabled()) {
+        recordEvent(stage, phase, currentId(), nullptr);
+    }
+}
+
+void exportChromeTrace(ostream &out);
+bool writeChromeTrace(const string &path);
+
+/**
+ * @brief Records the begin and the end of a stage on the calling thread. An id given to the
+ * span is the current id of the thread until the span ends.
+ */
+class Span {
+public:
+    explicit Span(Stage stage, const void *frame = nullptr) : Span(stage, currentId(), frame) {}
+
+    Span(Stage stage, uint32_t id, const void *frame = nullptr)
+        : stage_(stage), id_(id), frame_(frame), previous_id_(currentId()) {
+        setCurrentId(id);
+        record(stage_, Phase::BEGIN, id_, frame_);
+    }
+
+    ~Span() {
+        end();
+    }
+
+    // Ends the span before its scope does
+    void end() {
+        if (!ended_) {
+            ended_ = true;
+            record(stage_, Phase::END, id_, frame_);
+            setCurrentId(previous_id_);
+        }
+    }
+
+private:
+    Stage stage_;
+    uint32_t id_;
+    const void *frame_;
+    uint32_t previous_id_;
+    bool ended_ = false;
+};
+
+} // namespace tracing
+#endif // TRACE_RECORDER_HPP
@@ -0,0 +1,114 @@
+/**
+ * @file traffic_recorder.hpp
+ * @brief Binary log of every modbus transaction and every socket message, for post-mortem
+ * debugging and for replaying production traffic (see traffic_replay.hpp).
+ * @details The recording threads only append the encoded record to an in-memory buffer; a
+ * background thread writes the buffer to the file. If the file cannot keep up, records beyond
+ * kMaxPendingBytes are dropped and counted instead of blocking the bus or the sockets.
+ *
+ * File layout, little endian:
+ *   header : "DATCTRF1", u32 version, u64 wall clock of the start in us since the epoch
+ *   record : u8 type, u8 flags, u16 slave, u16 reg_addr, u32 client, u32 latency_us,
+ *            u64 t_us since the start, u32 payload size, payload
+ * The payload is the registers written or read (u16 each) or the bytes of the socket message.
+ * @version 1.0
+ * @date 2024-04-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef TRAFFIC_RECORDER_HPP
+#define TRAFFIC_RECORDER_HPP
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+using namespace std;
+
+namespace traffic {
+
+enum class RecordType : uint8_t {
+    MODBUS_WRITE = 1, /**< Payload: registers written */
+    MODBUS_READ  = 2, /**< Payload: registers read, empty if the read failed */
+    TCP_OPEN     = 3, /**< Client connected */
+    TCP_IN       = 4, /**< Bytes as received, before framing */
+    TCP_OUT      = 5, /**< Frame written, without a length prefix */
+    TCP_CLOSE    = 6,
+};
+
+const uint8_t FLAG_ERROR   = 1 << 0;
+const uint8_t FLAG_TIMEOUT = 1 << 1;
+
+const char     FILE_MAGIC[8]    = {'D', 'A', 'T', 'C', 'T', 'R', 'F', '1'};
+const uint32_t FILE_VERSION     = 1;
+const size_t   FILE_HEADER_SIZE = 20;
+const size_t   RECORD_HEADER_SIZE = 26;
+
+const size_t kMaxPendingBytes = 16 * 1024 * 1024;
+
+struct TrafficRecord {
+    RecordType type = RecordType::MODBUS_READ;
+    uint8_t flags   = 0;
+
+    uint16_t slave    = 0;
+    uint16_t reg_addr = 0;
+    uint32_t client   = 0; /**< Socket of the client */
+
+    uint32_t latency_us = 0; /**< Modbus transactions only */
+    uint64_t t_us       = 0;
+
+    string payload;
+
+    vector<uint16_t> registers() const;
+};
+
+struct RecorderStats {
+    uint64_t records = 0;
+    uint64_t bytes   = 0; /**< Written to the file */
+    uint64_t dropped = 0; /**< Records lost because the writer fell behind */
+};
+
+extern atomic<bool> g_recording;
+
+inline bool isRecording() {
+    return g_recording.load(memory_order_relaxed);
+}
+
+// Truncates the file, false if it cannot be created or a recording is already running
+bool startRecording(const string &path);
+
+// Writes what is pending and closes the file
+void stopRecording();
+
+RecorderStats getRecorderStats();
+
+void recordModbus(RecordType type, uint16_t slave, int reg_addr, int nb, const uint16_t *registers,
+                  uint32_t latency_us, uint8_t flags);
+void recordTcp(RecordType type, uint32_t client, const char *data = nullptr, size_t size = 0);
+
+/**
+ * @brief Reads a recording back, record by record.
+ */
+class TrafficLogReader {
+public:
+    ~TrafficLogReader();
+
+    bool open(const string &path);
+
+    // False at the end of the file or on a truncated record, see hasError()
+    bool next(TrafficRecord &record);
+
+    bool hasError() {return error_;}
+    uint64_t getStartWallUs() {return t_start_wall_us_;}
+
+private:
+    FILE *file_ = nullptr;
+    bool error_ = false;
+    uint64_t t_start_wall_us_ = 0;
+};
+
+} // namespace traffic
+#endif // TRAFFIC_RECORDER_HPP
@@ -0,0 +1,163 @@
+/**
+ * @file traffic_replay.hpp
+ * @brief Modbus transport answering from a traffic recording, see traffic_recorder.hpp.
+ * @details Reads are answered with the registers recorded for the same slave and register, in
+ * the recorded order; the last answer is repeated once a sequence is used up, so polling may
+ * outlast the recording. Recorded failures fail again, with errno ETIMEDOUT for timeouts. Writes
+ * are compared with the recorded writes, which tells whether the replayed commands reached the
+ * bus as they did in production. Commands of concurrent clients may be executed in another order
+ * than recorded, so a write matches any of the next kWriteWindow recorded writes not matched yet.
+ * In real time, every transaction takes as long as it did when recorded.
+ * @version 1.0
+ * @date 2024-04-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef TRAFFIC_REPLAY_HPP
+#define TRAFFIC_REPLAY_HPP
+
+#include "modbus_comm.hpp"
+#include "traffic_recorder.hpp"
+
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cerrno>
+
+const size_t kWriteWindow = 64;
+
+struct ReplayTransportStats {
+    uint64_t reads            = 0;
+    uint64_t reads_repeated   = 0; /**< Answered with the last recorded registers */
+    uint64_t reads_unanswered = 0; /**< Nothing recorded for the slave and register */
+    uint64_t writes_matched   = 0;
+    uint64_t writes_mismatched = 0;
+    uint64_t writes_unexpected = 0; /**< Beyond the recorded writes */
+    uint64_t writes_pending    = 0; /**< Recorded but not replayed */
+};
+
+class ReplayTransport : public ModbusTransport {
+public:
+    explicit ReplayTransport(bool realtime) : realtime_(realtime) {}
+
+    void addRecord(const traffic::TrafficRecord &record) {
+        if (record.type == traffic::RecordType::MODBUS_READ) {
+            reads_[key(record.slave, record.reg_addr)].sequence.push_back(record);
+        } else if (record.type == traffic::RecordType::MODBUS_WRITE) {
+            writes_.push_back(record);
+            writes_matched_.push_back(false);
+        }
+    }
+
+    bool writeRegisters(uint16_t slave_addr, int reg_addr, int nb, const uint16_t *data) override {
+        unique_lock<mutex> lg(mutex_stats_);
+
+        while (next_write_ < writes_.size() && writes_matched_[next_write_]) {
+            next_write_++;
+        }
+
+        if (next_write_ >= writes_.size()) {
+            stats_.writes_unexpected++;
+            return true;
+        }
+
+        const vector<uint16_t> registers(data, data + nb);
+        const size_t window_end = min(next_write_ + kWriteWindow, writes_.size());
+
+        for (size_t i = next_write_; i < window_end; i++) {
+            const traffic::TrafficRecord &record = writes_[i];
+
+            if (!writes_matched_[i] && record.slave == slave_addr && record.reg_addr == reg_addr &&
+                record.registers() == registers) {
+                writes_matched_[i] = true;
+                stats_.writes_matched++;
+
+                lg.unlock();
+                return answer(record);
+            }
+        }
+
+        // Answered like the write it took the place of
+        const traffic::TrafficRecord &record = writes_[next_write_];
+
+        writes_matched_[next_write_] = true;
+        stats_.writes_mismatched++;
+
+        lg.unlock();
+        return answer(record);
+    }
+
+    bool readRegisters(uint16_t slave_addr, int reg_addr, int nb, uint16_t *data) override {
+        unique_lock<mutex> lg(mutex_stats_);
+        auto itr = reads_.find(key(slave_addr, reg_addr));
+
+        stats_.reads++;
+
+        if (itr == reads_.end() || itr->second.sequence.empty()) {
+            stats_.reads_unanswered++;
+            return false;
+        }
+
+        ReadSequence &reads = itr->second;
+
+        if (reads.next >= reads.sequence.size()) {
+            stats_.reads_repeated++;
+        }
+
+        const traffic::TrafficRecord &record = reads.sequence[min(reads.next++, reads.sequence.size() - 1)];
+        const vector<uint16_t> registers = record.registers();
+
+        for (int i = 0; i < nb; i++) {
+            data[i] = (i < (int) registers.size()) ? registers[i] : 0;
+        }
+
+        lg.unlock();
+
+        return answer(record);
+    }
+
+    ReplayTransportStats getStats() {
+        unique_lock<mutex> lg(mutex_stats_);
+
+        ReplayTransportStats stats = stats_;
+        stats.writes_pending = count(writes_matched_.begin(), writes_matched_.end(), false);
+        return stats;
+    }
+
+private:
+    struct ReadSequence {
+        vector<traffic::TrafficRecord> sequence;
+        size_t next = 0;
+    };
+
+    static uint32_t key(uint16_t slave_addr, int reg_addr) {
+        return ((uint32_t) slave_addr << 16) | (uint16_t) reg_addr;
+    }
+
+    bool answer(const traffic::TrafficRecord &record) {
+        if (realtime_ && record.latency_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(record.latency_us));
+        }
+
+        if (record.flags & traffic::FLAG_ERROR) {
+            errno = (record.flags & traffic::FLAG_TIMEOUT) ? ETIMEDOUT : EIO;
+            return false;
+        }
+        return true;
+    }
+
+    bool realtime_;
+
+    map<uint32_t, ReadSequence> reads_;
+    vector<traffic::TrafficRecord> writes_;
+    vector<bool> writes_matched_; /**< Or replaced by a mismatched write */
+    size_t next_write_ = 0;       /**< First recorded write not matched */
+
+    ReplayTransportStats stats_;
+    mutex mutex_stats_; /**< Also guards the positions in the recording, read by getStats() */
+};
+
+#endif // TRAFFIC_REPLAY_HPP
@@ -0,0 +1,608 @@
+/**
+ * @file main.cpp
+ * @brief Offline analysis of telemetry stores written by datc_daemon --telemetry.
+ * @details Reports per slave: the grasp cycles (rising edges of the grp_close bit), how long
+ * each grasp was held (grp_close set to cleared) and how long the fingers took to close
+ * (grp_close set to the motor standing still), opens, motor current statistics, fault episodes
+ * (fault bit set to cleared) and samples lost by sequence gaps.
+ *
+ * Files are reduced in parallel by a pool of threads, each to per slave counters and the list
+ * of the sample times where the grp_open, grp_close, fault or moving state changed. The state
+ * changes of a slave are then followed in time order across the files, so episodes spanning
+ * two files are measured once. Memory grows with the state changes, not with the samples:
+ * segments are read through their mapping and archives one block at a time.
+ *
+ * An episode whose start was not recorded, at the start of the history or after a pause of
+ * more than kMaxGapUs (daemon stopped, bus disconnected), is not measured.
+ * @version 1.0
+ * @date 2024-04-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "datc_ctrl.hpp"
+#include "telemetry_store.hpp"
+
+#include <ctime>
+#include <cmath>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <sys/stat.h>
+#include <jsoncpp/json/json.h>
+
+using namespace telemetry;
+
+namespace {
+
+const uint16_t STATE_GRP_OPEN  = 1 << 5;
+const uint16_t STATE_GRP_CLOSE = 1 << 6;
+const uint16_t STATE_FAULT     = 1 << 9;
+const uint16_t STATE_TRACKED   = STATE_GRP_OPEN | STATE_GRP_CLOSE | STATE_FAULT;
+
+const uint64_t kMaxGapUs = 5000000; /**< Longer pauses between samples break the history */
+
+struct AnalyzeConfig {
+    vector<string> inputs;   /**< Store directories or single segment / archive files */
+    uint64_t t_from_us = 0;
+    uint64_t t_to_us   = UINT64_MAX;
+    int slave          = -1;
+    unsigned threads   = 0;  /**< 0: one per core */
+    bool csv           = false;
+    string output_path;      /**< Empty: stdout */
+};
+
+// Tracked state bits of a sample, where they changed or the history was broken
+struct StateEvent {
+    uint64_t t_us;
+    uint16_t states;
+    bool moving;
+    bool restart;  /**< First sample of the file, or after a pause */
+};
+
+struct SlavePartial {
+    uint64_t samples    = 0;
+    uint64_t t_first_us = 0;
+    uint64_t t_last_us  = 0;
+    uint32_t sequence_first = 0;
+    uint32_t sequence_last  = 0;
+    uint64_t lost = 0;
+
+    int32_t current_min = 0;
+    int32_t current_max = 0;
+    double current_sum    = 0;
+    double current_sum_sq = 0;
+    uint64_t holding_samples = 0;
+    double holding_sum       = 0;
+
+    vector<StateEvent> events;
+};
+
+struct FileResult {
+    size_t store = 0;
+    string path;
+    bool flag_ok = false;
+    map<uint16_t, SlavePartial> slaves;
+};
+
+struct DurationStats {
+    vector<double> seconds;
+
+    Json::Value toJson() {
+        Json::Value json;
+
+        sort(seconds.begin(), seconds.end());
+
+        auto percentileFn = [this] (double q) {
+            return seconds[min(seconds.size() - 1, (size_t) (q * seconds.size()))];
+        };
+
+        json["count"] = (Json::UInt64) seconds.size();
+
+        if (!seconds.empty()) {
+            double sum = 0;
+            for (double value : seconds) sum += value;
+
+            json["mean"] = sum / seconds.size();
+            json["min"]  = seconds.front();
+            json["max"]  = seconds.back();
+            json["p50"]  = percentileFn(0.5);
+            json["p95"]  = percentileFn(0.95);
+        }
+        return json;
+    }
+};
+
+struct SlaveReport {
+    uint64_t samples    = 0;
+    uint64_t lost       = 0;
+    uint64_t t_first_us = 0;
+    uint64_t t_last_us  = 0;
+    uint32_t sequence_last = 0;
+
+    int32_t current_min = 0;
+    int32_t current_max = 0;
+    double current_sum    = 0;
+    double current_sum_sq = 0;
+    uint64_t holding_samples = 0;
+    double holding_sum       = 0;
+
+    uint64_t cycles = 0;
+    uint64_t opens  = 0;
+    DurationStats grasp;
+    DurationStats close_time;
+
+    uint64_t fault_episodes = 0;
+    double fault_total_s    = 0;
+    double fault_longest_s  = 0;
+
+    // State followed across the files
+    bool flag_known = false;
+    StateEvent state{};
+    uint64_t t_close_us = 0;  /**< 0: no grasp of known start */
+    bool flag_close_moved = false;
+    bool flag_close_done  = false;
+    uint64_t t_fault_us = 0;  /**< 0: no fault of known start */
+};
+
+void printUsage() {
+    COUT("Usage: datc_analyze [options] STORE_OR_FILE...\n"
+         "  STORE_OR_FILE        Directory of datc_daemon --telemetry, or a single .seg / .tlc file\n"
+         "  --from TIME          Only samples at or after TIME\n"
+         "  --to TIME            Only samples before TIME\n"
+         "  --last DURATION      Only the last DURATION before now, e.g. 7d, 12h, 30m\n"
+         "                       TIME: seconds since the epoch or UTC 2024-04-22T08:00:00\n"
+         "  --slave ADDR         Only this slave\n"
+         "  --threads N          Files read in parallel (default: one per core)\n"
+         "  --format FORMAT      json (default) or csv, one row per store and slave\n"
+         "  --output FILE        Write the report to FILE instead of stdout");
+}
+
+bool parseTime(const string &value, uint64_t &t_us) {
+    struct tm tm = {};
+
+    if (value.find('T') != string::npos) {
+        const char *end = strptime(value.c_str(), "%Y-%m-%dT%H:%M:%S", &tm);
+
+        if (end == nullptr || *end != '\0') {
+            return false;
+        }
+        t_us = (uint64_t) timegm(&tm) * 1000000;
+        return true;
+    }
+
+    size_t end;
+    const double seconds = stod(value, &end);
+
+    t_us = (uint64_t) (seconds * 1e6);
+    return end == value.size() && seconds >= 0;
+}
+
+bool parseDuration(const string &value, uint64_t &duration_us) {
+    static const map<char, double> units = {{'s', 1}, {'m', 60}, {'h', 3600}, {'d', 86400}};
+
+    size_t end;
+    const double amount = stod(value, &end);
+
+    if (end + 1 != value.size() || units.count(value.back()) == 0 || amount < 0) {
+        return false;
+    }
+
+    duration_us = (uint64_t) (amount * units.at(value.back()) * 1e6);
+    return true;
+}
+
+bool parseArguments(int argc, char **argv, AnalyzeConfig &config) {
+    for (int i = 1; i < argc; i++) {
+        const string option = argv[i];
+
+        if (option == "--help" || option == "-h") {
+            return false;
+        }
+
+        if (option.compare(0, 2, "--") != 0) {
+            config.inputs.push_back(option);
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            COUT("[Error] Missing value of " + option);
+            return false;
+        }
+
+        const string value = argv[++i];
+        bool flag_valid = true;
+
+        try {
+            if      (option == "--from")    flag_valid = parseTime(value, config.t_from_us);
+            else if (option == "--to")      flag_valid = parseTime(value, config.t_to_us);
+            else if (option == "--slave")   config.slave   = stoi(value);
+            else if (option == "--threads") config.threads = stoul(value);
+            else if (option == "--output")  config.output_path = value;
+            else if (option == "--last") {
+                uint64_t duration_us = 0;
+                const uint64_t t_now_us = chrono::duration_cast<chrono::microseconds>(
+                    chrono::system_clock::now().time_since_epoch()).count();
+
+                flag_valid = parseDuration(value, duration_us);
+                config.t_from_us = (duration_us < t_now_us) ? t_now_us - duration_us : 0;
+            } else if (option == "--format") {
+                flag_valid  = value == "json" || value == "csv";
+                config.csv  = value == "csv";
+            } else {
+                COUT("[Error] Undefined option: " + option);
+                return false;
+            }
+        } catch (const exception &) {
+            flag_valid = false;
+        }
+
+        if (!flag_valid) {
+            COUT("[Error] Invalid value of " + option + ": " + value);
+            return false;
+        }
+    }
+
+    if (config.inputs.empty()) {
+        COUT("[Error] No telemetry store given");
+        return false;
+    }
+
+    return true;
+}
+
+void addSample(SlavePartial &partial, const TelemetrySample &sample) {
+    const uint16_t states = sample.registers[0] & STATE_TRACKED;
+    const int32_t current = registerValue(sample, 2);
+    const bool moving     = registerValue(sample, 3) != 0;
+
+    if (partial.samples == 0) {
+        partial.t_first_us     = sample.t_us;
+        partial.sequence_first = sample.sequence;
+        partial.current_min    = partial.current_max = current;
+        partial.events.push_back(StateEvent{sample.t_us, states, moving, true});
+    } else {
+        const StateEvent &last = partial.events.back();
+
+        if (sample.t_us - partial.t_last_us > kMaxGapUs) {
+            partial.events.push_back(StateEvent{sample.t_us, states, moving, true});
+        } else if (states != last.states || moving != last.moving) {
+            partial.events.push_back(StateEvent{sample.t_us, states, moving, false});
+        }
+
+        // A sequence starting over is a restarted daemon, not a loss
+        if (sample.sequence > partial.sequence_last + 1) {
+            partial.lost += sample.sequence - partial.sequence_last - 1;
+        }
+    }
+
+    partial.samples++;
+    partial.t_last_us     = sample.t_us;
+    partial.sequence_last = sample.sequence;
+
+    partial.current_min     = min(partial.current_min, current);
+    partial.current_max     = max(partial.current_max, current);
+    partial.current_sum    += current;
+    partial.current_sum_sq += (double) current * current;
+
+    // Closed on an object, the current is the grip force
+    if ((states & STATE_GRP_CLOSE) && !moving) {
+        partial.holding_samples++;
+        partial.holding_sum += current;
+    }
+}
+
+// Reduces one file; the samples of each slave are visited in time order
+void analyzeFile(const AnalyzeConfig &config, FileResult &result) {
+    unique_ptr<TelemetryFile> file = TelemetryFile::open(result.path);
+
+    if (!file) {
+        return;
+    }
+
+    auto sampleFn = [&result] (const TelemetrySample &sample) {
+        addSample(result.slaves[sample.slave], sample);
+        return true;
+    };
+
+    const TelemetryArchive *archive = dynamic_cast<const TelemetryArchive *>(file.get());
+
+    if (archive == nullptr) {
+        bool stop = false;
+        file->forEach(config.t_from_us, config.t_to_us, sampleFn, config.slave, stop);
+        result.flag_ok = true;
+        return;
+    }
+
+    // Blocks one at a time, without merging the slaves by time; skipped by their index
+    vector<TelemetrySample> samples;
+
+    result.flag_ok = true;
+
+    for (const ArchiveBlock &block : archive->getBlocks()) {
+        if (!block.index.overlaps(config.t_from_us, config.t_to_us) ||
+            (config.slave >= 0 && block.index.slave != config.slave)) {
+            continue;
+        }
+
+        samples.clear();
+
+        if (!archive->decode(block, samples)) {
+            result.flag_ok = false;
+            continue;
+        }
+
+        for (const TelemetrySample &sample : samples) {
+            if (sample.t_us >= config.t_from_us && sample.t_us < config.t_to_us) {
+                sampleFn(sample);
+            }
+        }
+    }
+}
+
+// Follows a tracked state change of a slave
+void applyEvent(SlaveReport &report, const StateEvent &event, bool flag_continuous) {
+    const double kUs = 1e-6;
+
+    if (!flag_continuous || !report.flag_known) {
+        // Episodes in progress here started unseen
+        report.flag_known = true;
+        report.state      = event;
+        report.t_close_us = 0;
+        report.t_fault_us = 0;
+        return;
+    }
+
+    const uint16_t rising  = event.states & ~report.state.states;
+    const uint16_t falling = report.state.states & ~event.states;
+
+    if (rising & STATE_GRP_CLOSE) {
+        report.cycles++;
+        report.t_close_us       = event.t_us;
+        report.flag_close_moved = event.moving;
+        report.flag_close_done  = false;
+    } else if ((event.states & STATE_GRP_CLOSE) && report.t_close_us != 0 && !report.flag_close_done) {
+        // The fingers stop on the object or at the end of their travel
+        if (event.moving) {
+            report.flag_close_moved = true;
+        } else if (report.flag_close_moved) {
+            report.close_time.seconds.push_back((event.t_us - report.t_close_us) * kUs);
+            report.flag_close_done = true;
+        }
+    }
+
+    if (falling & STATE_GRP_CLOSE) {
+        if (report.t_close_us != 0) {
+            report.grasp.seconds.push_back((event.t_us - report.t_close_us) * kUs);
+        }
+        report.t_close_us = 0;
+    }
+
+    if (rising & STATE_GRP_OPEN) {
+        report.opens++;
+    }
+
+    if (rising & STATE_FAULT) {
+        report.fault_episodes++;
+        report.t_fault_us = event.t_us;
+    }
+
+    if ((falling & STATE_FAULT) && report.t_fault_us != 0) {
+        const double duration = (event.t_us - report.t_fault_us) * kUs;
+
+        report.fault_total_s  += duration;
+        report.fault_longest_s = max(report.fault_longest_s, duration);
+        report.t_fault_us = 0;
+    }
+
+    report.state = event;
+}
+
+void mergePartial(SlaveReport &report, const SlavePartial &partial) {
+    const bool flag_continuous = report.samples > 0 && partial.t_first_us - report.t_last_us <= kMaxGapUs;
+
+    if (flag_continuous && partial.sequence_first > report.sequence_last + 1) {
+        report.lost += partial.sequence_first - report.sequence_last - 1;
+    }
+
+    if (report.samples == 0) {
+        report.t_first_us  = partial.t_first_us;
+        report.current_min = partial.current_min;
+        report.current_max = partial.current_max;
+    }
+
+    report.samples        += partial.samples;
+    report.lost           += partial.lost;
+    report.t_last_us       = partial.t_last_us;
+    report.sequence_last   = partial.sequence_last;
+    report.current_min     = min(report.current_min, partial.current_min);
+    report.current_max     = max(report.current_max, partial.current_max);
+    report.current_sum    += partial.current_sum;
+    report.current_sum_sq += partial.current_sum_sq;
+    report.holding_samples += partial.holding_samples;
+    report.holding_sum     += partial.holding_sum;
+
+    for (size_t i = 0; i < partial.events.size(); i++) {
+        const StateEvent &event = partial.events[i];
+
+        // Only the first sample of a file may continue the history of the previous file
+        applyEvent(report, event, !event.restart || (i == 0 && flag_continuous));
+    }
+}
+
+string formatUtc(uint64_t t_us) {
+    const time_t seconds = t_us / 1000000;
+    struct tm tm;
+    char text[32];
+
+    gmtime_r(&seconds, &tm);
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    return text;
+}
+
+Json::Value slaveJson(uint16_t slave, SlaveReport &report) {
+    Json::Value json;
+
+    json["slave"]    = slave;
+    json["samples"]  = (Json::UInt64) report.samples;
+    json["lost"]     = (Json::UInt64) report.lost;
+    json["from"]     = formatUtc(report.t_first_us);
+    json["to"]       = formatUtc(report.t_last_us);
+    json["cycles"]   = (Json::UInt64) report.cycles;
+    json["opens"]    = (Json::UInt64) report.opens;
+    json["grasp_s"]  = report.grasp.toJson();
+    json["close_time_s"] = report.close_time.toJson();
+
+    const double mean = report.current_sum / max<uint64_t>(report.samples, 1);
+
+    json["current"]["mean"]   = mean;
+    json["current"]["min"]    = report.current_min;
+    json["current"]["max"]    = report.current_max;
+    json["current"]["stddev"] = sqrt(max(0.0, report.current_sum_sq / max<uint64_t>(report.samples, 1) - mean * mean));
+    json["current"]["holding_mean"] = report.holding_sum / max<uint64_t>(report.holding_samples, 1);
+
+    json["faults"]["episodes"]  = (Json::UInt64) report.fault_episodes;
+    json["faults"]["total_s"]   = report.fault_total_s;
+    json["faults"]["longest_s"] = report.fault_longest_s;
+    json["faults"]["active"]    = report.flag_known && (report.state.states & STATE_FAULT) != 0;
+
+    return json;
+}
+
+void writeCsv(ostream &out, const Json::Value &json) {
+    out << "store,slave,samples,lost,from,to,cycles,opens,grasp_count,grasp_mean_s,grasp_p95_s,"
+           "close_time_mean_s,close_time_p95_s,current_mean,current_min,current_max,current_stddev,"
+           "holding_current_mean,fault_episodes,fault_total_s,fault_longest_s,fault_active\n";
+
+    for (const Json::Value &store : json["stores"]) {
+        for (const Json::Value &slave : store["slaves"]) {
+            out << store["path"].asString() << ',' << slave["slave"].asUInt() << ','
+                << slave["samples"].asUInt64() << ',' << slave["lost"].asUInt64() << ','
+                << slave["from"].asString() << ',' << slave["to"].asString() << ','
+                << slave["cycles"].asUInt64() << ',' << slave["opens"].asUInt64() << ','
+                << slave["grasp_s"]["count"].asUInt64() << ',' << slave["grasp_s"]["mean"].asDouble() << ','
+                << slave["grasp_s"]["p95"].asDouble() << ',' << slave["close_time_s"]["mean"].asDouble() << ','
+                << slave["close_time_s"]["p95"].asDouble() << ',' << slave["current"]["mean"].asDouble() << ','
+                << slave["current"]["min"].asInt() << ',' << slave["current"]["max"].asInt() << ','
+                << slave["current"]["stddev"].asDouble() << ',' << slave["current"]["holding_mean"].asDouble() << ','
+                << slave["faults"]["episodes"].asUInt64() << ',' << slave["faults"]["total_s"].asDouble() << ','
+                << slave["faults"]["longest_s"].asDouble() << ',' << slave["faults"]["active"].asBool() << '\n';
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    AnalyzeConfig config;
+
+    if (!parseArguments(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+
+    // Files of every store, each store in its own order
+    vector<FileResult> results;
+
+    for (size_t store = 0; store < config.inputs.size(); store++) {
+        const string &input = config.inputs[store];
+        struct stat st;
+
+        if (stat(input.c_str(), &st) != 0) {
+            COUT("[Error] " + input + " does not exist");
+            return 1;
+        }
+
+        const vector<string> paths = S_ISDIR(st.st_mode) ? TelemetryReader::listFiles(input) : vector<string>{input};
+
+        for (const string &path : paths) {
+            results.emplace_back();
+            results.back().store = store;
+            results.back().path  = path;
+        }
+    }
+
+    const unsigned threads = max(1u, min<unsigned>(config.threads ? config.threads : std::thread::hardware_concurrency(),
+                                                   results.size()));
+    atomic<size_t> next_file{0};
+    vector<std::thread> workers;
+
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back([&] () {
+            for (size_t index = next_file++; index < results.size(); index = next_file++) {
+                analyzeFile(config, results[index]);
+            }
+        });
+    }
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    Json::Value json;
+    json["stores"] = Json::Value(Json::arrayValue);
+
+    int exit_code = 0;
+
+    for (size_t store = 0; store < config.inputs.size(); store++) {
+        map<uint16_t, SlaveReport> reports;
+        Json::Value store_json;
+        uint64_t files = 0, files_failed = 0;
+
+        for (FileResult &result : results) {
+            if (result.store != store) {
+                continue;
+            }
+
+            files++;
+
+            if (!result.flag_ok) {
+                // stdout may be the report
+                cerr << "[Error] " << result.path << " could not be read" << endl;
+                files_failed++;
+                exit_code = 2;
+                continue;
+            }
+
+            for (const auto &partial : result.slaves) {
+                mergePartial(reports[partial.first], partial.second);
+            }
+
+            // The events of a file are no longer needed once followed
+            result.slaves.clear();
+        }
+
+        store_json["path"]         = config.inputs[store];
+        store_json["files"]        = (Json::UInt64) files;
+        store_json["files_failed"] = (Json::UInt64) files_failed;
+        store_json["slaves"]       = Json::Value(Json::arrayValue);
+
+        for (auto &report : reports) {
+            store_json["slaves"].append(slaveJson(report.first, report.second));
+        }
+
+        json["stores"].append(store_json);
+    }
+
+    ofstream file;
+
+    if (!config.output_path.empty()) {
+        file.open(config.output_path);
+    }
+
+    ostream &out = config.output_path.empty() ? cout : file;
+
+    if (config.csv) {
+        writeCsv(out, json);
+    } else {
+        out << Json::StyledWriter().write(json);
+    }
+
+    if (!out) {
+        COUT("[Error] Could not write " + config.output_path);
+        return 1;
+    }
+
+    return exit_code;
+}
@@ -0,0 +1,263 @@
+/**
+ * @file main.cpp
+ * @brief Headless bridge between the modbus bus and the TCP/local clients, without Qt.
+ * @details Options are read from an optional Json config file first and then from the command
+ * line, so flags override the file. The file is a station file, see station_config.hpp, or
+ * has the option names with '_' instead of '-' as keys, e.g.
+ * {"device": "/dev/ttyUSB0", "tcp_port": 8421, "poll_slaves": [2, 3]}.
+ * @version 1.0
+ * @date 2024-04-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "datc_simulator.hpp"
+#include "station_config.hpp"
+
+#include <csignal>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+struct DaemonConfig {
+    StationConfig station;       /**< Bus, slaves and endpoints */
+    bool mock           = false; /**< Simulated grippers instead of the serial bus */
+    int mock_latency_us = -1;    /**< < 0: duration of the frames at BAUDRATE */
+    string trace_path;           /**< Empty: no tracing */
+    string record_path;          /**< Empty: no traffic recording */
+
+    DaemonConfig() {
+        station.buses.resize(1);
+        station.tcp_port = 8421;
+    }
+};
+
+volatile sig_atomic_t g_stop       = 0;
+volatile sig_atomic_t g_write_trace = 0;
+
+void printUsage() {
+    COUT("Usage: datc_daemon [options]\n"
+         "  --config FILE        Json file with any of the options below\n"
+         "  --device PATH        Serial port of the modbus bus (default /dev/ttyUSB0)\n"
+         "  --baudrate BAUD      Baud rate of the serial port (default 38400)\n"
+         "  --slave ADDR         Modbus address of the gripper (default 1)\n"
+         "  --poll-slaves LIST   Further slaves to poll, e.g. 2,3\n"
+         "  --tcp-port PORT      TCP server port, 0 to disable (default 8421)\n"
+         "  --unix-socket PATH   Also serve clients on a Unix domain socket\n"
+         "  --udp-group ADDR     Publish status to this multicast group\n"
+         "  --udp-port PORT      Port of the multicast group (default 8422)\n"
+         "  --shm NAME           Publish status to a shared-memory segment, e.g. /datc_status\n"
+         "  --first-status-timeout-ms MS  Wait for the first status at startup (default 3000)\n"
+         "  --mock               Simulated grippers instead of the serial bus, e.g. for datc_loadgen\n"
+         "  --mock-latency-us US Duration of a simulated transaction (default: as on the bus)\n"
+         "  --trace FILE         Record trace points and write the latest as Chrome trace Json to FILE\n"
+         "                       on SIGUSR1 and on exit (chrome://tracing, ui.perfetto.dev)\n"
+         "  --record FILE        Record every modbus transaction and socket message to FILE,\n"
+         "                       for datc_replay\n"
+         "  --telemetry DIR      Keep every polled status in rotating segment files in DIR\n"
+         "  --telemetry-segment-mb N  Size of a telemetry segment file (default 16)\n"
+         "  --telemetry-segments N    Segment files kept, the oldest are deleted (default 64)\n"
+         "  --telemetry-compress      Replace full segments by compressed archives, about 10x smaller");
+}
+
+vector<uint16_t> parseSlaves(const string &list) {
+    vector<uint16_t> slaves;
+    stringstream ss(list);
+    string item;
+
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) {
+            slaves.push_back(stoi(item));
+        }
+    }
+    return slaves;
+}
+
+bool loadConfigFile(const string &path, DaemonConfig &config) {
+    if (!loadStationConfig(path, config.station)) {
+        return false;
+    }
+
+    // Options of the daemon alone, the file was read once already
+    ifstream file(path);
+    Json::Value json;
+    Json::Reader reader;
+    reader.parse(file, json);
+
+    config.mock            = json.get("mock", config.mock).asBool();
+    config.mock_latency_us = json.get("mock_latency_us", config.mock_latency_us).asInt();
+    config.trace_path      = json.get("trace", config.trace_path).asString();
+    config.record_path     = json.get("record", config.record_path).asString();
+
+    return true;
+}
+
+bool parseArguments(int argc, char **argv, DaemonConfig &config) {
+    // The config file is applied first, wherever it appears
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--config" && !loadConfigFile(argv[i + 1], config)) {
+            return false;
+        }
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const string option = argv[i];
+
+        if (option == "--help" || option == "-h") {
+            return false;
+        }
+
+        if (option == "--mock") {
+            config.mock = true;
+            continue;
+        }
+
+        if (option == "--telemetry-compress") {
+            config.station.telemetry_compress = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            COUT("[Error] Missing value of " + option);
+            return false;
+        }
+
+        const string value = argv[++i];
+
+        try {
+            StationConfig &station = config.station;
+            BusConfig &bus = station.buses[0];
+
+            if      (option == "--config")      {}
+            else if (option == "--device")      bus.device         = value;
+            else if (option == "--baudrate")    bus.baudrate       = stoi(value);
+            else if (option == "--slave")       bus.slave          = stoi(value);
+            else if (option == "--poll-slaves") bus.poll_slaves    = parseSlaves(value);
+            else if (option == "--tcp-port")    station.tcp_port    = stoi(value);
+            else if (option == "--unix-socket") station.unix_socket = value;
+            else if (option == "--udp-group")   station.udp_group   = value;
+            else if (option == "--udp-port")    station.udp_port    = stoi(value);
+            else if (option == "--shm")         station.shm_name    = value;
+            else if (option == "--trace")       config.trace_path   = value;
+            else if (option == "--record")      config.record_path  = value;
+            else if (option == "--telemetry")   station.telemetry_dir = value;
+            else if (option == "--mock-latency-us")      config.mock_latency_us       = stoi(value);
+            else if (option == "--telemetry-segment-mb") station.telemetry_segment_mb = stoul(value);
+            else if (option == "--telemetry-segments")   station.telemetry_segments   = stoul(value);
+            else if (option == "--first-status-timeout-ms") station.first_status_timeout_ms = stoi(value);
+            else {
+                COUT("[Error] Undefined option: " + option);
+                return false;
+            }
+        } catch (const exception &) {
+            COUT("[Error] Invalid value of " + option + ": " + value);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Resident set size from /proc, 0 where unavailable
+long residentKiB() {
+    ifstream statm("/proc/self/statm");
+    long pages_total = 0, pages_resident = 0;
+
+    statm >> pages_total >> pages_resident;
+
+    return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto time_start = std::chrono::steady_clock::now();
+
+    DaemonConfig config;
+
+    if (!parseArguments(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+
+    tracing::setEnabled(!config.trace_path.empty());
+
+    if (!config.record_path.empty() && !traffic::startRecording(config.record_path)) {
+        return 1;
+    }
+
+    // Outlives the interface, whose poll loop uses it until destruction
+    unique_ptr<DatcSimulator> simulator;
+
+    if (config.mock) {
+        simulator.reset(new DatcSimulator(config.mock_latency_us));
+    }
+
+    DatcCommInterface datc_interface(argc, argv);
+    StartupReport report;
+
+    if (!startStation(datc_interface, config.station, report, simulator.get())) {
+        return 1;
+    }
+
+    signal(SIGINT,  [] (int) {g_stop = 1;});
+    signal(SIGTERM, [] (int) {g_stop = 1;});
+    signal(SIGUSR1, [] (int) {g_write_trace = 1;});
+
+    std::chrono::duration<double, milli> startup = std::chrono::steady_clock::now() - time_start;
+    COUT("datc_daemon ready in " << startup.count() << " ms (bus " << report.bus_ms << " ms, bus and endpoints "
+         << report.ready_ms << " ms), rss " << residentKiB() << " KiB");
+
+    if (report.first_status_ms >= 0) {
+        COUT("First status after " << report.first_status_ms << " ms");
+    } else {
+        COUT("[Error] No status within " << config.station.first_status_timeout_ms << " ms, polling goes on");
+    }
+
+    auto writeTraceFn = [&config] () {
+        if (tracing::writeChromeTrace(config.trace_path)) {
+            COUT("Trace written to " + config.trace_path);
+        } else {
+            COUT("[Error] Could not write the trace to " + config.trace_path);
+        }
+    };
+
+    while (!g_stop) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        if (g_write_trace) {
+            g_write_trace = 0;
+            if (tracing::isEnabled()) writeTraceFn();
+        }
+    }
+
+    COUT("datc_daemon stopping");
+
+    if (tracing::isEnabled()) {
+        writeTraceFn();
+    }
+
+    if (traffic::isRecording()) {
+        traffic::stopRecording();
+
+        traffic::RecorderStats stats = traffic::getRecorderStats();
+        COUT("Recorded " << stats.records << " records, " << stats.bytes << " bytes to " << config.record_path
+             << " (" << stats.dropped << " dropped)");
+    }
+
+    if (!config.station.telemetry_dir.empty()) {
+        datc_interface.releaseTelemetry();
+
+        telemetry::TelemetryStats stats = datc_interface.getTelemetryStats();
+        COUT("Telemetry: " << stats.written << " samples written to " << stats.segments << " new segments in "
+             << config.station.telemetry_dir << " (" << stats.dropped << " dropped)");
+
+        if (stats.archived > 0) {
+            COUT("Telemetry: " << stats.archived << " segments archived, " << stats.archived_bytes << " bytes of samples in "
+                 << stats.archive_bytes << " bytes");
+        }
+    }
+
+    return 0;
+}
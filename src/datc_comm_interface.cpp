@@ -9,79 +9,426 @@
  *
  */
 #include "datc_comm_interface.hpp"
+#include <algorithm>
 
 const uint16_t kFreq = 50;
 
-DatcCommInterface::DatcCommInterface(int argc, char **argv) {
+DatcCommInterface::DatcCommInterface(int argc, char **argv)
+    : status_broadcaster_(DatcMessageManager::getInstance()) {
 
 }
 
 DatcCommInterface::~DatcCommInterface() {
     flag_program_stop_ = true;
-    usleep(1000);
+    flag_jobs_stop_    = true;
+
+    if (job_thread_.joinable()) {
+        job_thread_.join();
+    }
+
+    if (poll_thread_.joinable()) {
+        poll_thread_.join();
+    }
 
     releaseTcp();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    releaseLocalSocket();
+#endif
+    releaseUdp();
+#ifndef _WIN32
+    releaseShm();
+    releaseTelemetry();
+#endif
     modbusRelease();
 }
 
-bool DatcCommInterface::init(const char *port_name, uint16_t slave_address) {
-    if (!modbusInit(port_name, slave_address)) {
+void DatcCommInterface::start() {
+    if (!poll_thread_.joinable()) {
+        poll_thread_ = std::thread(&DatcCommInterface::run, this);
+    }
+}
+
+bool DatcCommInterface::init(const char *port_name, uint16_t slave_address, int baudrate) {
+    t_first_status_us_ = 0;
+
+    if (!modbusInit(port_name, slave_address, baudrate)) {
         return false;
     }
 
+    resetSlaveRecords(port_name);
+
     COUT("DATC ros interface init.");
 
     return true;
 }
 
-void DatcCommInterface::initTcp(const string addr, uint16_t socket_port) {
+bool DatcCommInterface::init(ModbusTransport *transport, uint16_t slave_address) {
+    t_first_status_us_ = 0;
+
+    if (!modbusInit(transport, slave_address)) {
+        return false;
+    }
+
+    resetSlaveRecords("custom");
+
+    COUT("DATC ros interface init.");
+
+    return true;
+}
+
+bool DatcCommInterface::initTcp(const string addr, uint16_t socket_port) {
     unique_lock<mutex> lg(mutex_tcp_);
 
-    flag_tcp_stop_ = false;
+    if (tcp_server_ != NULL) {
+        return false;
+    }
 
-    tcp_server_ = new TcpServer(socket_port);
-    tcp_thread_ = std::thread(bind(&DatcCommInterface::recvCommand, this));
+    // The acceptor throws if the port is in use
+    try {
+        tcp_server_ = new TcpServer(socket_port);
+    } catch (const boost::system::system_error &error) {
+        COUT("[Error] TCP port " << socket_port << ": " << error.what());
+        return false;
+    }
 
+    startCommandThread();
     is_socket_connected_ = true;
+
+    return true;
 }
 
 void DatcCommInterface::releaseTcp() {
     unique_lock<mutex> lg(mutex_tcp_);
 
-    is_socket_connected_ = false;
-    flag_tcp_stop_       = true;
+    if (tcp_server_ != NULL) {
+        delete tcp_server_;
+        tcp_server_ = NULL;
+    }
+
+    // Commands of local clients are still served
+    if (local_server_ == NULL) {
+        is_socket_connected_ = false;
+        stopCommandThread();
+    }
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+bool DatcCommInterface::initLocalSocket(const string &path, mode_t mode) {
+    unique_lock<mutex> lg(mutex_tcp_);
+
+    if (local_server_ != NULL) {
+        return false;
+    }
+
+    local_server_ = new TcpServer(path, mode);
+
+    if (!local_server_->isListening()) {
+        delete local_server_;
+        local_server_ = NULL;
+        return false;
+    }
+
+    startCommandThread();
+    is_socket_connected_ = true;
+
+    return true;
+}
+
+void DatcCommInterface::releaseLocalSocket() {
+    unique_lock<mutex> lg(mutex_tcp_);
+
+    if (local_server_ != NULL) {
+        delete local_server_;
+        local_server_ = NULL;
+    }
+
+    if (tcp_server_ == NULL) {
+        is_socket_connected_ = false;
+        stopCommandThread();
+    }
+}
+#endif
+
+// mutex_tcp_ must be held by the caller
+void DatcCommInterface::startCommandThread() {
+    if (tcp_thread_.joinable()) {
+        return;
+    }
 
-    usleep(100);
+    flag_tcp_stop_ = false;
+    tcp_thread_    = std::thread(bind(&DatcCommInterface::recvCommand, this));
+}
+
+// mutex_tcp_ must be held by the caller
+void DatcCommInterface::stopCommandThread() {
+    flag_tcp_stop_ = true;
 
     if (tcp_thread_.joinable()) {
         tcp_thread_.join();
     }
+}
 
-    if (tcp_server_ != NULL) {
-        tcp_server_->~TcpServer();
+bool DatcCommInterface::submitCommand(const CommandRequest &request, function<void (const CommandAck &)> done) {
+    CommandRequest queued = request;
+    queued.t_recv_us = monotonicMicros();
+
+    return submitJob([this, queued, done] () {
+        CommandAck ack;
+
+        ack.id           = queued.id;
+        ack.command      = (queued.type == RequestType::CHANGE_SLAVE) ? binary_protocol::OPCODE_CHANGE_SLAVE : queued.command;
+        ack.t_recv_us    = queued.t_recv_us;
+        ack.t_dequeue_us = monotonicMicros();
+        ack.error        = executeRequest(queued);
+        ack.t_done_us    = monotonicMicros();
+
+        if (done) {
+            done(ack);
+        }
+    });
+}
+
+bool DatcCommInterface::submitTask(function<bool ()> task, function<void (bool)> done) {
+    return submitJob([task, done] () {
+        const bool success = task();
+
+        if (done) {
+            done(success);
+        }
+    });
+}
+
+bool DatcCommInterface::submitJob(const function<void ()> &job) {
+    unique_lock<mutex> lg(mutex_jobs_);
+
+    if (jobs_.size() >= kGuiQueueMax) {
+        return false;
+    }
+
+    if (!job_thread_.joinable()) {
+        job_thread_ = std::thread(&DatcCommInterface::runJobs, this);
+    }
+
+    jobs_.push(job);
+    return true;
+}
+
+void DatcCommInterface::runJobs() {
+    function<void ()> job;
+
+    tracing::setThreadName("gui_worker");
+
+    while (!flag_jobs_stop_) {
+        if (jobs_.tryPopFor(job, std::chrono::milliseconds(10))) {
+            job();
+        }
     }
 }
 
-void DatcCommInterface::sendStatus() {
-    DatcStatus status = getDatcStatus();
+bool DatcCommInterface::initUdp(const string &group, uint16_t port, int ttl, const string &interface_addr) {
+    unique_lock<mutex> lg(mutex_udp_);
+
+    is_udp_open_ = udp_publisher_.open(group, port, ttl, interface_addr);
+
+    return is_udp_open_;
+}
+
+void DatcCommInterface::releaseUdp() {
+    unique_lock<mutex> lg(mutex_udp_);
+
+    is_udp_open_ = false;
+    udp_publisher_.close();
+}
 
-    Json::Value json;
+UdpPublisherStats DatcCommInterface::getUdpStats() {
+    unique_lock<mutex> lg(mutex_udp_);
+    return udp_publisher_.getStats();
+}
 
-    json["states"]     = status.states;
-    json["motor_pos"]  = status.motor_pos;
-    json["motor_vel"]  = status.motor_vel;
-    json["motor_cur"]  = status.motor_cur;
-    json["finger_pos"] = status.finger_pos;
-    json["voltage"]    = status.voltage;
+#ifndef _WIN32
+bool DatcCommInterface::initShm(const string &name) {
+    unique_lock<mutex> lg(mutex_shm_);
+
+    is_shm_open_ = shm_writer_.open(name);
+
+    return is_shm_open_;
+}
+
+void DatcCommInterface::releaseShm() {
+    unique_lock<mutex> lg(mutex_shm_);
+
+    is_shm_open_ = false;
+    shm_writer_.close();
+}
+
+bool DatcCommInterface::initTelemetry(const string &dir, const telemetry::TelemetryConfig &config) {
+    unique_lock<mutex> lg(mutex_telemetry_);
+
+    is_telemetry_open_ = telemetry_writer_.open(dir, config);
+
+    return is_telemetry_open_;
+}
+
+void DatcCommInterface::releaseTelemetry() {
+    unique_lock<mutex> lg(mutex_telemetry_);
+
+    is_telemetry_open_ = false;
+    telemetry_writer_.close();
+}
+
+telemetry::TelemetryStats DatcCommInterface::getTelemetryStats() {
+    return telemetry_writer_.getStats();
+}
+#endif
+
+void DatcCommInterface::setPollSlaves(const vector<uint16_t> &slaves) {
+    unique_lock<mutex> lg(mutex_poll_);
+    poll_slaves_ = slaves;
+}
+
+PerfStats DatcCommInterface::getPerfStats() const {
+    PerfStats stats;
+
+    stats.poll_cycles   = poll_cycles_.load(memory_order_relaxed);
+    stats.poll_overruns = poll_overruns_.load(memory_order_relaxed);
+    stats.modbus        = getModbusStats();
+    stats.command_wait  = command_wait_.snapshot();
+    stats.commands      = stats.command_wait.count;
+
+    return stats;
+}
+
+uint16_t DatcCommInterface::getPollFrequency() {
+    return kFreq;
+}
+
+vector<uint16_t> DatcCommInterface::getPollSlaves() {
+    unique_lock<mutex> lg(mutex_poll_);
+    return poll_slaves_;
+}
+
+void DatcCommInterface::sendStatus(const DatcStatus &status, uint16_t slave_addr) {
+    StatusMessage message;
+
+    message.sequence   = status_sequence_[slave_addr]++;
+    message.slave      = slave_addr;
+    message.states     = status.states;
+    message.motor_pos  = status.motor_pos;
+    message.motor_vel  = status.motor_vel;
+    message.motor_cur  = status.motor_cur;
+    message.finger_pos = status.finger_pos;
+    message.voltage    = status.voltage;
+
+    if (is_udp_open_) {
+        unique_lock<mutex> lg(mutex_udp_);
+        udp_publisher_.publish(message);
+    }
+
+#ifndef _WIN32
+    if (is_shm_open_) {
+        shm_communication::ShmStatusRecord record;
+
+        record.t_us       = monotonicMicros();
+        record.sequence   = message.sequence;
+        record.slave      = message.slave;
+        record.states     = message.states;
+        record.motor_pos  = message.motor_pos;
+        record.motor_vel  = message.motor_vel;
+        record.motor_cur  = message.motor_cur;
+        record.finger_pos = message.finger_pos;
+        record.voltage    = message.voltage;
+
+        unique_lock<mutex> lg(mutex_shm_);
+        shm_writer_.write(record);
+    }
+#endif
+
+    if (!is_socket_connected_ || !flag_tcp_send_status_) {
+        return;
+    }
 
     unique_lock<mutex> lg(mutex_tcp_);
 
-    MessageManager<Json::Value>::getInstance().pushToAllClientQueue(json);
+    tracing::Span span(tracing::Stage::STATUS_PUBLISH);
+    status_broadcaster_.publish(message);
+}
+
+// Only called by the poll loop, the single producer of the telemetry queue
+void DatcCommInterface::recordTelemetry(const DatcStatus &status, uint16_t slave_addr) {
+#ifndef _WIN32
+    if (!is_telemetry_open_) {
+        return;
+    }
+
+    telemetry::TelemetrySample sample;
+
+    sample.slave = slave_addr;
+    copy_n(status.registers, telemetry::TELEMETRY_REGISTERS, sample.registers);
+
+    unique_lock<mutex> lg(mutex_telemetry_);
+    telemetry_writer_.append(sample);
+#endif
 }
 
 void DatcCommInterface::recvCommand() {
-    auto checkValueFn = [] (const Json::Value json, string str) {
-        if (json.isMember(str)) {
+    CommandRequest request;
+
+    tracing::setThreadName("worker");
+
+    while (!flag_tcp_stop_) {
+        // Wakes up as soon as a command arrives, so pipelined commands are executed back to back
+        if (!DatcMessageManager::getInstance().tryPopFromWokerQueue(request, std::chrono::milliseconds(10))) {
+            continue;
+        }
+
+        tracing::record(tracing::Stage::WORKER_QUEUE, tracing::Phase::ASYNC_END, request.trace_id);
+        tracing::Span span(tracing::Stage::EXECUTE, request.trace_id);
+
+        CommandAck ack;
+
+        ack.t_dequeue_us = monotonicMicros();
+        command_wait_.record(ack.t_dequeue_us - request.t_recv_us);
+
+        ack.error        = executeRequest(request);
+        ack.t_done_us    = monotonicMicros();
+
+        if (request.has_id) {
+            ack.id        = request.id;
+            ack.command   = (request.type == RequestType::CHANGE_SLAVE) ? binary_protocol::OPCODE_CHANGE_SLAVE : request.command;
+            ack.t_recv_us = request.t_recv_us;
+
+            sendAck(request.client, ack);
+        }
+
+        // The next poll cycle reads the command's effect
+        if (request.trace_id != 0) {
+            trace_status_id_ = request.trace_id;
+        }
+    }
+}
+
+void DatcCommInterface::sendAck(uint32_t client, const CommandAck &ack) {
+    StreamConfig stream;
+
+    if (!DatcMessageManager::getInstance().getClientStream(client, stream)) {
+        return; // Disconnected in the meantime
+    }
+
+    auto frame = make_shared<string>();
+
+    if (stream.format == WireFormat::BINARY) {
+        binary_protocol::encodeAck(ack, *frame);
+    } else {
+        json_protocol::encodeAck(ack, *frame);
+    }
+
+    tracing::record(tracing::Stage::CLIENT_ENQUEUE, tracing::Phase::INSTANT, tracing::currentId(), frame.get());
+    DatcMessageManager::getInstance().pushReliableToClientQueue(client, frame);
+}
+
+CommandError DatcCommInterface::executeRequest(const CommandRequest &request) {
+    auto checkValueFn = [] (bool has_value, string str) {
+        if (has_value) {
             return true;
         } else {
             COUT("[Error] \"" + str + "\" must be entered.");
@@ -89,103 +436,156 @@ void DatcCommInterface::recvCommand() {
         }
     };
 
-    const string cmd_change_slave = "change_slave";
-    const string cmd_str          = "command";
-    const string value_1_str      = "value_1";
-    const string value_2_str      = "value_2";
+    auto resultFn = [] (bool success) {
+        return success ? CommandError::NONE : CommandError::COMMAND_FAILED;
+    };
 
-    Json::Value json;
+    const string value_1_str = "value_1";
+    const string value_2_str = "value_2";
 
-    while (!flag_tcp_stop_) {
-        mutex_tcp_.lock();
+    if (request.type == RequestType::CHANGE_SLAVE) {
+        return resultFn(modbusSlaveChange(request.value_1));
+    }
 
-        if (MessageManager<Json::Value>::getInstance().tryPopFromWokerQueue(json)) {
-            mutex_tcp_.unlock();
+    switch ((DATC_COMMAND) request.command) {
+        case DATC_COMMAND::MOTOR_ENABLE:
+            return resultFn(motorEnable());
 
-            if (json.isMember(cmd_change_slave)) {
-                modbusSlaveChange(json[cmd_change_slave].asUInt());
-                continue;
-            } else if (!json.isMember(cmd_str)) {
-                continue;
-            }
+        case DATC_COMMAND::MOTOR_STOP:
+            return resultFn(motorStop());
 
-            switch ((DATC_COMMAND) json[cmd_str].asUInt()) {
-                case DATC_COMMAND::MOTOR_ENABLE:
-                    motorEnable();
-                    break;
-
-                case DATC_COMMAND::MOTOR_STOP:
-                    motorStop();
-                    break;
-
-                case DATC_COMMAND::MOTOR_DISABLE:
-                    motorDisable();
-                    break;
-
-                case DATC_COMMAND::MOTOR_POSITION_CONTROL:
-                    if (!checkValueFn(json, value_1_str)) break;
-                    if (!checkValueFn(json, value_2_str)) break;
-                    motorPosCtrl(json[value_1_str].asInt(), json[value_2_str].asUInt());
-                    break;
-
-                case DATC_COMMAND::MOTOR_VELOCITY_CONTROL:
-                    if (!checkValueFn(json, value_1_str)) break;
-                    motorVelCtrl(json[value_1_str].asInt());
-                    break;
-
-                case DATC_COMMAND::MOTOR_CURRENT_CONTROL:
-                    if (!checkValueFn(json, value_1_str)) break;
-                    motorCurCtrl(json[value_1_str].asInt());
-                    break;
-
-                case DATC_COMMAND::CHANGE_MODBUS_ADDRESS:
-                    if (!checkValueFn(json, value_1_str)) break;
-                    setModbusAddr(json[value_1_str].asUInt());
-                    break;
-
-                case DATC_COMMAND::GRIPPER_INITIALIZE:
-                    grpInitialize();
-                    break;
-
-                case DATC_COMMAND::GRIPPER_OPEN:
-                    grpOpen();
-                    break;
-
-                case DATC_COMMAND::GRIPPER_CLOSE:
-                    grpClose();
-                    break;
-
-                case DATC_COMMAND::SET_FINGER_POSITION:
-                    if (!checkValueFn(json, value_1_str)) break;
-                    setFingerPos(json[value_1_str].asUInt());
-                    break;
-
-                case DATC_COMMAND::VACUUM_GRIPPER_ON:
-                    vacuumGrpOn();
-                    break;
-
-                case DATC_COMMAND::VACUUM_GRIPPER_OFF:
-                    vacuumGrpOff();
-                    break;
-
-                case DATC_COMMAND::SET_MOTOR_TORQUE:
-                    if (!checkValueFn(json, value_1_str)) break;
-                    setMotorTorque(json[value_1_str].asUInt());
-                    break;
-
-                case DATC_COMMAND::SET_MOTOR_SPEED:
-                    if (!checkValueFn(json, value_1_str)) break;
-                    setMotorSpeed(json[value_1_str].asUInt());
-                    break;
-
-                default:
-                    COUT("Error: Undefined command.");
-            }
-        } else {
-            mutex_tcp_.unlock();
+        case DATC_COMMAND::MOTOR_DISABLE:
+            return resultFn(motorDisable());
+
+        case DATC_COMMAND::MOTOR_POSITION_CONTROL:
+            if (!checkValueFn(request.has_value_1, value_1_str)) return CommandError::MISSING_VALUE;
+            if (!checkValueFn(request.has_value_2, value_2_str)) return CommandError::MISSING_VALUE;
+            return resultFn(motorPosCtrl((int16_t) request.value_1, request.value_2));
+
+        case DATC_COMMAND::MOTOR_VELOCITY_CONTROL:
+            if (!checkValueFn(request.has_value_1, value_1_str)) return CommandError::MISSING_VALUE;
+            return resultFn(motorVelCtrl((int16_t) request.value_1));
+
+        case DATC_COMMAND::MOTOR_CURRENT_CONTROL:
+            if (!checkValueFn(request.has_value_1, value_1_str)) return CommandError::MISSING_VALUE;
+            return resultFn(motorCurCtrl((int16_t) request.value_1));
+
+        case DATC_COMMAND::CHANGE_MODBUS_ADDRESS:
+            if (!checkValueFn(request.has_value_1, value_1_str)) return CommandError::MISSING_VALUE;
+            return resultFn(setModbusAddr(request.value_1));
+
+        case DATC_COMMAND::GRIPPER_INITIALIZE:
+            return resultFn(grpInitialize());
+
+        case DATC_COMMAND::GRIPPER_OPEN:
+            return resultFn(grpOpen());
+
+        case DATC_COMMAND::GRIPPER_CLOSE:
+            return resultFn(grpClose());
+
+        case DATC_COMMAND::SET_FINGER_POSITION:
+            if (!checkValueFn(request.has_value_1, value_1_str)) return CommandError::MISSING_VALUE;
+            return resultFn(setFingerPos(request.value_1));
+
+        case DATC_COMMAND::VACUUM_GRIPPER_ON:
+            return resultFn(vacuumGrpOn());
+
+        case DATC_COMMAND::VACUUM_GRIPPER_OFF:
+            return resultFn(vacuumGrpOff());
+
+        case DATC_COMMAND::SET_MOTOR_TORQUE:
+            if (!checkValueFn(request.has_value_1, value_1_str)) return CommandError::MISSING_VALUE;
+            return resultFn(setMotorTorque(request.value_1));
+
+        case DATC_COMMAND::SET_MOTOR_SPEED:
+            if (!checkValueFn(request.has_value_1, value_1_str)) return CommandError::MISSING_VALUE;
+            return resultFn(setMotorSpeed(request.value_1));
+
+        default:
+            COUT("Error: Undefined command.");
+            return CommandError::UNDEFINED_COMMAND;
+    }
+}
+
+void DatcCommInterface::setStatusListener(function<void ()> listener) {
+    unique_lock<mutex> lg(mutex_view_);
+    status_listener_ = listener;
+}
+
+StatusView DatcCommInterface::getStatusView() {
+    unique_lock<mutex> lg(mutex_view_);
+    return status_view_;
+}
+
+// Poll thread only, the decoded fields and the status string follow from the registers
+void DatcCommInterface::publishStatusView() {
+    StatusView view;
+    view.status           = getDatcStatus();
+    view.slave_addr       = getSlaveAddr();
+    view.modbus_connected = getConnectionState();
+    view.modbus_recv_err  = getModbusRecvErr();
+    view.socket_connected = is_socket_connected_;
+
+    function<void ()> listener;
+    {
+        unique_lock<mutex> lg(mutex_view_);
+
+        const bool is_changed =
+                view.modbus_connected != status_view_.modbus_connected ||
+                view.modbus_recv_err  != status_view_.modbus_recv_err  ||
+                view.socket_connected != status_view_.socket_connected ||
+                view.slave_addr       != status_view_.slave_addr       ||
+                !equal(begin(view.status.registers), end(view.status.registers), begin(status_view_.status.registers));
+
+        if (!is_changed) {
+            return;
         }
 
-        usleep(10000);
+        status_view_ = view;
+        status_view_changes_.fetch_add(1, memory_order_relaxed);
+        listener = status_listener_;
+    }
+
+    if (listener) {
+        listener();
+    }
+}
+
+vector<SlaveRecord> DatcCommInterface::getSlaveRecords() {
+    unique_lock<mutex> lg(mutex_records_);
+
+    vector<SlaveRecord> records;
+    records.reserve(slave_records_.size());
+
+    for (const auto &record : slave_records_) {
+        records.push_back(record.second);
+    }
+    return records;
+}
+
+void DatcCommInterface::resetSlaveRecords(const string &bus) {
+    unique_lock<mutex> lg(mutex_records_);
+    bus_name_ = bus;
+    slave_records_.clear();
+
+    // Samples of the previous bus may belong to another gripper at the same address
+    status_history_.clear();
+}
+
+// Poll thread only, status is nullptr if the read failed
+void DatcCommInterface::recordSlave(uint16_t slave_addr, const DatcStatus *status) {
+    unique_lock<mutex> lg(mutex_records_);
+
+    SlaveRecord &record = slave_records_[slave_addr];
+    record.bus   = bus_name_;
+    record.slave = slave_addr;
+
+    if (status != nullptr) {
+        record.status = *status;
+        record.has_status = true;
+        record.reads++;
+    } else {
+        record.errors++;
     }
 }
 
@@ -193,16 +593,82 @@ void DatcCommInterface::recvCommand() {
 void DatcCommInterface::run() {
     auto cycleFn([&] () {
         if (mbc_.getConnectionState()) {
-            readDatcData();
+            // Continues the trace of the last command executed, if any
+            uint32_t trace_id = trace_status_id_.exchange(0);
+
+            if (trace_id == 0 && tracing::isEnabled()) {
+                trace_id = tracing::nextId();
+            }
+
+            tracing::Span span(tracing::Stage::POLL_CYCLE, trace_id);
+
+            const uint16_t slave_addr = getSlaveAddr();
+
+            if (readDatcData()) {
+                const DatcStatus &status = status_;
+
+                if (t_first_status_us_ == 0) {
+                    t_first_status_us_ = monotonicMicros();
+                }
+
+                // The trend shows one gripper, another slave starts it over
+                if (slave_addr != history_slave_) {
+                    status_history_.clear();
+                    history_slave_ = slave_addr;
+                }
+
+                TrendSample sample;
+                sample.t_us = historyNowUs();
+                sample.values[(int) TrendChannel::FINGER_POS] = (int16_t) status.finger_pos;
+                sample.values[(int) TrendChannel::MOTOR_CUR]  = status.motor_cur;
+                sample.values[(int) TrendChannel::MOTOR_VEL]  = status.motor_vel;
+                status_history_.append(sample);
 
-            if (is_socket_connected_ && flag_tcp_send_status_) {
-                sendStatus();
+                recordSlave(slave_addr, &status);
+                recordTelemetry(status, slave_addr);
+            } else {
+                recordSlave(slave_addr, nullptr);
+            }
+
+            const bool flag_tcp_publish = is_socket_connected_ && flag_tcp_send_status_;
+#ifndef _WIN32
+            const bool flag_send_status = flag_tcp_publish || is_udp_open_ || is_shm_open_;
+#else
+            const bool flag_send_status = flag_tcp_publish || is_udp_open_;
+#endif
+
+            if (flag_send_status) {
+                sendStatus(getDatcStatus(), slave_addr);
+            }
+
+            for (uint16_t poll_slave : getPollSlaves()) {
+                DatcStatus status;
+
+                if (poll_slave == slave_addr) {
+                    continue;
+                }
+
+                if (!readDatcData(poll_slave, status)) {
+                    recordSlave(poll_slave, nullptr);
+                    continue;
+                }
+
+                recordSlave(poll_slave, &status);
+                recordTelemetry(status, poll_slave);
+
+                if (flag_send_status) {
+                    sendStatus(status, poll_slave);
+                }
             }
         }
+
+        publishStatusView();
     });
 
     const std::chrono::duration<double> period(1 / (double) kFreq);
 
+    tracing::setThreadName("poll");
+
     while(!flag_program_stop_) {
         auto time_start = std::chrono::steady_clock::now();
 
@@ -212,8 +678,12 @@ void DatcCommInterface::run() {
         auto time_end = std::chrono::steady_clock::now();
         auto time_elapsed = time_end - time_start;
 
+        poll_cycles_.fetch_add(1, memory_order_relaxed);
+
         if (time_elapsed < period) {
             std::this_thread::sleep_for(period - time_elapsed);
+        } else {
+            poll_overruns_.fetch_add(1, memory_order_relaxed);
         }
     }
 
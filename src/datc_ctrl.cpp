@@ -10,14 +10,20 @@
  */
 #include "datc_ctrl.hpp"
 
+#include <algorithm>
+
 DatcCtrl::DatcCtrl() {
 }
 
 DatcCtrl::~DatcCtrl() {
 }
 
-bool DatcCtrl::modbusInit(const char *port_name, uint16_t slave_address) {
-    return mbc_.modbusInit(port_name, slave_address);
+bool DatcCtrl::modbusInit(const char *port_name, uint16_t slave_address, int baudrate) {
+    return mbc_.modbusInit(port_name, slave_address, baudrate);
+}
+
+bool DatcCtrl::modbusInit(ModbusTransport *transport, uint16_t slave_address) {
+    return mbc_.modbusInit(transport, slave_address);
 }
 
 bool DatcCtrl::modbusRelease() {
@@ -145,50 +151,11 @@ bool DatcCtrl::setMotorSpeed (uint16_t speed_ratio) {
 }
 
 bool DatcCtrl::readDatcData() {
-    static map<uint16_t, pair<bool*, string>> status_info;
-
-    if (status_info.size() == 0) {
-        // Bit, Value, Status 순서
-        status_info.insert({0, make_pair(&status_.enable        , "Motor Enable")});
-        status_info.insert({1, make_pair(&status_.initialize    , "Gripper Initialize")});
-        status_info.insert({2, make_pair(&status_.motor_pos_ctrl, "Motor Position Control")});
-        status_info.insert({3, make_pair(&status_.motor_vel_ctrl, "Motor Velocity Control")});
-        status_info.insert({4, make_pair(&status_.motor_cur_ctrl, "Motor Current Control")});
-        status_info.insert({5, make_pair(&status_.grp_open      , "Gripper Open")});
-        status_info.insert({6, make_pair(&status_.grp_close     , "Gripper Close")});
-        status_info.insert({9, make_pair(&status_.fault         , "Motor Fault")});
-    }
-
     // Read input register //
-    uint16_t reg_addr = 10;
-    uint16_t reg_num  = 8;
     vector<uint16_t> reg;
 
-    if (mbc_.recvData(reg_addr, reg_num, reg)) {
-        uint16_t status    = reg[0];
-        status_.states     = status;
-        status_.motor_pos  = (int16_t) reg[1];
-        status_.motor_cur  = (int16_t) reg[2];
-        status_.motor_vel  = (int16_t) reg[3];
-        status_.finger_pos = reg[4];
-        status_.voltage    = reg[7];
-
-        status_.status_str = "---";
-
-        for (int i = 0; i < 16; i++) {
-            if (status_info.find(i) != status_info.end()) {
-                if (status & (0x01 << i)) {
-                    *status_info[i].first = true;
-                    status_.status_str = status_info[i].second;
-                } else {
-                    *status_info[i].first = false;
-                }
-            }
-        }
-
-        if (!status_.enable) {
-            status_.status_str = "Motor Disabled";
-        }
+    if (mbc_.recvData(kStatusRegAddr, kStatusRegNum, reg)) {
+        decodeDatcData(reg, status_);
 
         flag_modbus_recv_err_ = false;
         return true;
@@ -198,6 +165,62 @@ bool DatcCtrl::readDatcData() {
     }
 }
 
+bool DatcCtrl::readDatcData(uint16_t slave_addr, DatcStatus &status) {
+    vector<uint16_t> reg;
+
+    if (!mbc_.recvData(slave_addr, kStatusRegAddr, kStatusRegNum, reg)) {
+        return false;
+    }
+
+    decodeDatcData(reg, status);
+    return true;
+}
+
+void DatcCtrl::decodeDatcData(const vector<uint16_t> &reg, DatcStatus &status) {
+    // Bit, Status 순서
+    static const pair<uint16_t, const char *> status_info[] = {
+        {0, "Motor Enable"},
+        {1, "Gripper Initialize"},
+        {2, "Motor Position Control"},
+        {3, "Motor Velocity Control"},
+        {4, "Motor Current Control"},
+        {5, "Gripper Open"},
+        {6, "Gripper Close"},
+        {9, "Motor Fault"},
+    };
+
+    bool *const status_flags[] = {
+        &status.enable, &status.initialize, &status.motor_pos_ctrl, &status.motor_vel_ctrl,
+        &status.motor_cur_ctrl, &status.grp_open, &status.grp_close, &status.fault
+    };
+
+    uint16_t states   = reg[0];
+    status.states     = states;
+    status.motor_pos  = (int16_t) reg[1];
+    status.motor_cur  = (int16_t) reg[2];
+    status.motor_vel  = (int16_t) reg[3];
+    status.finger_pos = reg[4];
+    status.voltage    = reg[7];
+
+    copy_n(reg.begin(), min<size_t>(reg.size(), kStatusRegNum), status.registers);
+
+    const char *status_str = "---";
+
+    for (size_t i = 0; i < sizeof(status_flags) / sizeof(status_flags[0]); i++) {
+        *status_flags[i] = states & (0x01 << status_info[i].first);
+
+        if (*status_flags[i]) {
+            status_str = status_info[i].second;
+        }
+    }
+
+    if (!status.enable) {
+        status_str = "Motor Disabled";
+    }
+
+    status.status_str = status_str;
+}
+
 bool DatcCtrl::checkDurationRange(string error_prefix, uint16_t &duration) {
     if (duration < kDurationMin) {
         printf("%s Duration is too short ( < %dms)", error_prefix.c_str(), kDurationMin);
@@ -213,6 +236,8 @@ bool DatcCtrl::checkDurationRange(string error_prefix, uint16_t &duration) {
 }
 
 bool DatcCtrl::command(DATC_COMMAND cmd, uint16_t value_1, uint16_t value_2) {
+    tracing::Span span(tracing::Stage::DATC_COMMAND);
+
     switch (cmd) {
         case DATC_COMMAND::MOTOR_ENABLE:
             return SEND_CMD(cmd);
@@ -0,0 +1,191 @@
+/**
+ * @file fleet_table.cpp
+ * @brief Text cells of the fleet page and their changes between frames.
+ * @version 1.0
+ * @date 2024-04-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "fleet_table.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+const char *FleetTable::getColumnName(int column) {
+    static const char *const names[kFleetColumns] = {
+        "Bus", "Slave", "State", "Position", "Current", "Voltage", "Fault", "Poll Rate", "Error Rate"
+    };
+    return (column >= 0 && column < kFleetColumns) ? names[column] : "";
+}
+
+namespace {
+
+// Rows in order of bus and slave
+vector<const SlaveRecord *> sortRecords(const vector<SlaveRecord> &records) {
+    vector<const SlaveRecord *> sorted;
+    sorted.reserve(records.size());
+
+    for (const SlaveRecord &record : records) {
+        sorted.push_back(&record);
+    }
+
+    auto lessFn([] (const SlaveRecord *a, const SlaveRecord *b) {
+        const int bus_order = a->bus.compare(b->bus);
+        return (bus_order != 0) ? bus_order < 0 : a->slave < b->slave;
+    });
+
+    // Records of a bus come ordered by slave, usually nothing to sort
+    if (!is_sorted(sorted.begin(), sorted.end(), lessFn)) {
+        sort(sorted.begin(), sorted.end(), lessFn);
+    }
+    return sorted;
+}
+
+} // namespace
+
+bool FleetTable::isSameRows(const vector<const SlaveRecord *> &sorted) const {
+    if (sorted.size() != rows_.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (sorted[i]->bus != rows_[i].bus || sorted[i]->slave != rows_[i].slave) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FleetTable::hasSameRows(const vector<SlaveRecord> &records) const {
+    return isSameRows(sortRecords(records));
+}
+
+bool FleetTable::update(const vector<SlaveRecord> &records, double elapsed_s, vector<FleetCellRange> &changed) {
+    changed.clear();
+
+    const vector<const SlaveRecord *> sorted = sortRecords(records);
+    const bool is_same_rows = isSameRows(sorted);
+
+    if (!is_same_rows) {
+        vector<Row> rows(sorted.size());
+
+        for (size_t i = 0; i < sorted.size(); i++) {
+            rows[i].bus    = sorted[i]->bus;
+            rows[i].slave  = sorted[i]->slave;
+            rows[i].cells[(int) FleetColumn::POLL_RATE]  = "-";
+            rows[i].cells[(int) FleetColumn::ERROR_RATE] = "-";
+
+            // Counters of a row kept, so its rates go on over the change
+            for (const Row &row : rows_) {
+                if (row.bus == rows[i].bus && row.slave == rows[i].slave) {
+                    rows[i] = row;
+                    break;
+                }
+            }
+        }
+        rows_.swap(rows);
+    }
+
+    char text[64];
+    string cells[kFleetColumns];
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const SlaveRecord &record = *sorted[i];
+        const DatcStatus &status  = record.status;
+        Row &row = rows_[i];
+
+        // Cells formatted this frame, the others are as they were
+        bool is_set[kFleetColumns] = {};
+
+        auto setFn([&] (FleetColumn column, const char *value) {
+            cells[(int) column] = value;
+            is_set[(int) column] = true;
+        });
+
+        if (!row.has_cells) {
+            setFn(FleetColumn::BUS, record.bus.c_str());
+            setFn(FleetColumn::SLAVE, to_string(record.slave).c_str());
+        }
+
+        // The status cells follow from the registers, an idle gripper is not formatted again
+        const bool is_status_changed = !row.has_cells || record.has_status != row.has_status ||
+                                       !equal(begin(status.registers), end(status.registers), begin(row.registers));
+
+        if (is_status_changed && record.has_status) {
+            setFn(FleetColumn::STATE, status.status_str.c_str());
+
+            snprintf(text, sizeof(text), "%.1f %%", status.finger_pos / 10.0);
+            setFn(FleetColumn::POSITION, text);
+
+            snprintf(text, sizeof(text), "%d mA", status.motor_cur);
+            setFn(FleetColumn::CURRENT, text);
+
+            snprintf(text, sizeof(text), "%.1f V", status.voltage / 10.0);
+            setFn(FleetColumn::VOLTAGE, text);
+
+            setFn(FleetColumn::FAULT, status.fault ? "Yes" : "No");
+        } else if (is_status_changed) {
+            for (FleetColumn column : {FleetColumn::STATE, FleetColumn::POSITION, FleetColumn::CURRENT,
+                                       FleetColumn::VOLTAGE, FleetColumn::FAULT}) {
+                setFn(column, "-");
+            }
+        }
+
+        row.has_cells  = true;
+        row.has_status = record.has_status;
+        copy(begin(status.registers), end(status.registers), begin(row.registers));
+        row.is_fault = record.has_status && status.fault;
+
+        // Rates over the frame in tenths as shown, formatted only when they change
+        if (elapsed_s > 0 && row.has_counters) {
+            const uint64_t reads  = record.reads  - min(record.reads , row.reads);
+            const uint64_t errors = record.errors - min(record.errors, row.errors);
+
+            const int64_t poll_rate  = llround(10 * (reads + errors) / elapsed_s);
+            const int64_t error_rate = (reads + errors != 0) ? llround(1000.0 * errors / (reads + errors)) : -1;
+
+            if (poll_rate != row.poll_rate) {
+                snprintf(text, sizeof(text), "%.1f Hz", poll_rate / 10.0);
+                setFn(FleetColumn::POLL_RATE, text);
+                row.poll_rate = poll_rate;
+            }
+
+            if (error_rate != row.error_rate) {
+                snprintf(text, sizeof(text), "%.1f %%", error_rate / 10.0);
+                setFn(FleetColumn::ERROR_RATE, (error_rate >= 0) ? text : "-");
+                row.error_rate = error_rate;
+            }
+        }
+
+        if (elapsed_s > 0 || !row.has_counters) {
+            row.reads  = record.reads;
+            row.errors = record.errors;
+            row.has_counters = true;
+        }
+
+        // Runs of changed neighbouring cells
+        int first_changed = -1;
+
+        for (int column = 0; column <= kFleetColumns; column++) {
+            const bool is_changed = column < kFleetColumns && is_set[column] && row.cells[column] != cells[column];
+
+            if (is_changed) {
+                row.cells[column].swap(cells[column]);
+
+                if (first_changed < 0) {
+                    first_changed = column;
+                }
+            } else if (first_changed >= 0) {
+                changed.push_back({(int) i, first_changed, column - 1});
+                first_changed = -1;
+            }
+        }
+    }
+
+    if (!is_same_rows) {
+        changed.clear();
+    }
+
+    return is_same_rows;
+}
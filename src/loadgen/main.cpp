@@ -0,0 +1,716 @@
+/**
+ * @file main.cpp
+ * @brief Closed-loop load generator for the TCP / Unix socket server.
+ * @details Opens N client sessions, each sending commands of a weighted mix at a target rate
+ * with at most 'window' commands waiting for their ack, while receiving the status stream.
+ * Reports command throughput, ack latency percentiles, the server's queue and execution time,
+ * status inter-arrival jitter and status frames lost by sequence gaps (full-rate stream only).
+ *
+ * Latency is measured from the send and, to not hide queueing when the window is full,
+ * also from the time the command was scheduled at (the "intended" latency).
+ *
+ * Run against `datc_daemon --mock` to load the server without hardware.
+ * @version 1.0
+ * @date 2024-04-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "datc_ctrl.hpp"
+#include "wire_protocol.hpp"
+
+#include <cmath>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include <boost/asio.hpp>
+
+using namespace tcp_communication;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+typedef boost::asio::generic::stream_protocol StreamProtocol;
+
+struct MixEntry {
+    CommandRequest request;
+    string name;
+    uint32_t weight = 1;
+};
+
+struct LoadConfig {
+    string host = "127.0.0.1";
+    uint16_t port = 8421;
+    string unix_socket;                /**< Used instead of host/port if set */
+
+    uint32_t clients = 1;
+    double rate      = 10;             /**< Commands per second per client, 0: as fast as acked */
+    uint32_t window  = 1;              /**< Commands per client waiting for their ack */
+    double duration  = 10;
+    double warmup    = 1;              /**< Seconds not included in the results */
+    double status_rate = 0;            /**< Status frames per second per client, 0: every poll */
+
+    WireFormat format = WireFormat::BINARY;
+    vector<MixEntry> mix;
+    uint32_t seed = 1;
+
+    string json_path;
+};
+
+const struct {
+    const char *name;
+    DATC_COMMAND command;
+    int value_1;                       /**< < -32768: no value */
+    int value_2;
+} kCommands[] = {
+    {"enable",     DATC_COMMAND::MOTOR_ENABLE,           -65536, -65536},
+    {"stop",       DATC_COMMAND::MOTOR_STOP,             -65536, -65536},
+    {"disable",    DATC_COMMAND::MOTOR_DISABLE,          -65536, -65536},
+    {"position",   DATC_COMMAND::MOTOR_POSITION_CONTROL, -1200,  500   },
+    {"velocity",   DATC_COMMAND::MOTOR_VELOCITY_CONTROL, 300,    -65536},
+    {"current",    DATC_COMMAND::MOTOR_CURRENT_CONTROL,  300,    -65536},
+    {"init",       DATC_COMMAND::GRIPPER_INITIALIZE,     -65536, -65536},
+    {"open",       DATC_COMMAND::GRIPPER_OPEN,           -65536, -65536},
+    {"close",      DATC_COMMAND::GRIPPER_CLOSE,          -65536, -65536},
+    {"finger",     DATC_COMMAND::SET_FINGER_POSITION,    500,    -65536},
+    {"vacuum_on",  DATC_COMMAND::VACUUM_GRIPPER_ON,      -65536, -65536},
+    {"vacuum_off", DATC_COMMAND::VACUUM_GRIPPER_OFF,     -65536, -65536},
+    {"torque",     DATC_COMMAND::SET_MOTOR_TORQUE,       80,     -65536},
+    {"speed",      DATC_COMMAND::SET_MOTOR_SPEED,        50,     -65536},
+};
+
+const double kAckTimeout = 2.0; /**< Seconds to wait for outstanding acks after the run */
+
+/**
+ * @brief What a session measured. Samples in microseconds.
+ */
+struct SessionResult {
+    bool disconnected = false;
+
+    uint64_t sent = 0, acked = 0, failed = 0;
+    vector<uint32_t> latency_us, intended_us, queue_us, execute_us;
+
+    uint64_t status_frames = 0, status_lost = 0;
+    vector<uint32_t> status_interval_us;
+};
+
+class Session {
+public:
+    Session(boost::asio::io_service &io_service, const LoadConfig &config, uint32_t index)
+        : socket_(io_service), timer_(io_service), config_(config), random_(config.seed + index) {
+        uint32_t total = 0;
+        for (const MixEntry &entry : config.mix) {
+            total += entry.weight;
+        }
+        pick_ = uniform_int_distribution<uint32_t>(0, total - 1);
+
+        if (config.rate > 0) {
+            period_ = chrono::duration_cast<Clock::duration>(chrono::duration<double>(1 / config.rate));
+        }
+    }
+
+    bool connect() {
+        boost::system::error_code ec;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (!config_.unix_socket.empty()) {
+            socket_.connect(boost::asio::local::stream_protocol::endpoint(config_.unix_socket), ec);
+        } else
+#endif
+        {
+            boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string(config_.host, ec), config_.port);
+            if (!ec) socket_.connect(endpoint, ec);
+            if (!ec) socket_.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+        }
+
+        if (ec) {
+            COUT("[Error] Connection failed: " << ec.message());
+            return false;
+        }
+
+        // The subscription is Json, so it goes before the switch to the binary protocol
+        Json::Value subscribe;
+        Json::FastWriter writer;
+
+        subscribe["subscribe"]["rate"] = config_.status_rate;
+        for (const char *field : {"finger_pos", "motor_cur", "motor_pos", "motor_vel", "sequence", "slave"}) {
+            subscribe["subscribe"]["fields"].append(field);
+        }
+
+        write(writer.write(subscribe));
+
+        if (config_.format == WireFormat::BINARY) {
+            write("{\"protocol\": \"binary\"}");
+        }
+
+        return true;
+    }
+
+    void start(Clock::time_point time_start, Clock::time_point time_measure, Clock::time_point time_end) {
+        time_measure_ = time_measure;
+        time_end_     = time_end;
+        next_send_    = time_start;
+
+        startRead();
+        sendDue();
+    }
+
+    void stop() {
+        boost::system::error_code ec;
+        timer_.cancel(ec);
+        socket_.close(ec);
+    }
+
+    bool isIdle() const {return pending_.empty() || result_.disconnected;}
+
+    SessionResult &getResult() {return result_;}
+
+private:
+    struct Pending {
+        Clock::time_point t_intended;
+        Clock::time_point t_sent;
+    };
+
+    // Blocking, a command is far smaller than the socket buffer the server keeps draining
+    void write(const string &data) {
+        boost::system::error_code ec;
+        boost::asio::write(socket_, boost::asio::buffer(data), ec);
+    }
+
+    // Sends every command that is due and fits into the window, then waits for the next one
+    void sendDue() {
+        auto now = Clock::now();
+
+        while (pending_.size() < config_.window && next_send_ < time_end_) {
+            if (config_.rate <= 0) {
+                next_send_ = now;
+                sendCommand(now);
+            } else if (next_send_ <= now) {
+                sendCommand(next_send_);
+                next_send_ += period_;
+            } else {
+                break;
+            }
+        }
+
+        // A full window is reopened by the next ack
+        if (pending_.size() < config_.window && next_send_ < time_end_ && config_.rate > 0) {
+            timer_.expires_at(next_send_);
+            timer_.async_wait([this] (const boost::system::error_code &err) {
+                if (!err) sendDue();
+            });
+        }
+    }
+
+    void sendCommand(Clock::time_point t_intended) {
+        // Weighted pick from the mix
+        uint32_t pick = pick_(random_);
+        const MixEntry *entry = &config_.mix.front();
+
+        for (const MixEntry &candidate : config_.mix) {
+            if (pick < candidate.weight) {
+                entry = &candidate;
+                break;
+            }
+            pick -= candidate.weight;
+        }
+
+        CommandRequest request = entry->request;
+        request.has_id = true;
+        request.id     = next_id_++;
+
+        string frame;
+
+        if (config_.format == WireFormat::BINARY) {
+            binary_protocol::encodeCommand(request, frame);
+        } else {
+            Json::Value json;
+            Json::FastWriter writer;
+
+            json["id"]      = request.id;
+            json["command"] = request.command;
+            if (request.has_value_1) json["value_1"] = (int16_t) request.value_1;
+            if (request.has_value_2) json["value_2"] = request.value_2;
+
+            frame = writer.write(json);
+        }
+
+        pending_[request.id] = {t_intended, Clock::now()};
+        write(frame);
+
+        if (t_intended >= time_measure_) {
+            result_.sent++;
+        }
+    }
+
+    void startRead() {
+        socket_.async_read_some(boost::asio::buffer(data_), [this] (const boost::system::error_code &err, size_t size) {
+            if (err) {
+                if (err != boost::asio::error::operation_aborted) {
+                    COUT("[Error] Session closed by the server: " << err.message());
+                    result_.disconnected = true;
+                }
+                return;
+            }
+
+            received_.append(data_, size);
+            parse();
+            startRead();
+        });
+    }
+
+    // Json lines until the hello frame, binary frames after it
+    void parse() {
+        size_t begin = 0;
+
+        while (begin < received_.size()) {
+            if (!binary_ && (uint8_t) received_[begin] == binary_protocol::MAGIC) {
+                binary_ = true;
+            }
+
+            if (binary_) {
+                if (received_.size() - begin < binary_protocol::HEADER_SIZE) {
+                    break;
+                }
+
+                size_t size = binary_protocol::HEADER_SIZE + (uint8_t) received_[begin + 3];
+                if (received_.size() - begin < size) {
+                    break;
+                }
+
+                handleBinary(received_.data() + begin, received_.data() + begin + size);
+                begin += size;
+            } else {
+                size_t end = received_.find('\n', begin);
+                if (end == string::npos) {
+                    break;
+                }
+
+                handleJson(received_.data() + begin, received_.data() + end);
+                begin = end + 1;
+            }
+        }
+
+        received_.erase(0, begin);
+    }
+
+    void handleBinary(const char *begin, const char *end) {
+        CommandAck ack;
+        StatusMessage status;
+
+        if (binary_protocol::decodeAck(begin, end, ack)) {
+            onAck(ack);
+        } else if (binary_protocol::decodeStatus(begin, end, status)) {
+            onStatus(status.slave, status.sequence);
+        }
+    }
+
+    void handleJson(const char *begin, const char *end) {
+        Json::Value json;
+
+        if (!reader_.parse(begin, end, json, false)) {
+            return;
+        }
+
+        if (json.isMember("ack")) {
+            CommandAck ack;
+
+            ack.id           = json["ack"].asUInt();
+            ack.error        = json["success"].asBool() ? CommandError::NONE : CommandError::COMMAND_FAILED;
+            ack.t_recv_us    = json["t_recv"].asUInt64();
+            ack.t_dequeue_us = json["t_dequeue"].asUInt64();
+            ack.t_done_us    = json["t_done"].asUInt64();
+
+            onAck(ack);
+        } else if (json.isMember("sequence")) {
+            onStatus(json["slave"].asUInt(), json["sequence"].asUInt());
+        }
+    }
+
+    void onAck(const CommandAck &ack) {
+        auto pending = pending_.find(ack.id);
+        if (pending == pending_.end()) {
+            return;
+        }
+
+        auto now = Clock::now();
+
+        if (pending->second.t_intended >= time_measure_) {
+            auto microsFn = [] (Clock::duration duration) {
+                return (uint32_t) chrono::duration_cast<chrono::microseconds>(duration).count();
+            };
+
+            result_.acked++;
+            result_.failed += (ack.error != CommandError::NONE);
+            result_.latency_us.push_back(microsFn(now - pending->second.t_sent));
+            result_.intended_us.push_back(microsFn(now - pending->second.t_intended));
+            result_.queue_us.push_back((uint32_t) (ack.t_dequeue_us - ack.t_recv_us));
+            result_.execute_us.push_back((uint32_t) (ack.t_done_us - ack.t_dequeue_us));
+        }
+
+        pending_.erase(pending);
+
+        sendDue();
+    }
+
+    void onStatus(uint16_t slave, uint32_t sequence) {
+        auto now = Clock::now();
+        auto last = last_status_.find(slave);
+
+        if (now >= time_measure_ && now < time_end_) {
+            result_.status_frames++;
+
+            if (last != last_status_.end()) {
+                // A rate-limited stream skips sequences on purpose
+                if (config_.status_rate <= 0 && sequence > last->second.sequence + 1) {
+                    result_.status_lost += sequence - last->second.sequence - 1;
+                }
+                result_.status_interval_us.push_back(
+                    (uint32_t) chrono::duration_cast<chrono::microseconds>(now - last->second.time).count());
+            }
+        }
+
+        last_status_[slave] = {sequence, now};
+    }
+
+    struct LastStatus {
+        uint32_t sequence;
+        Clock::time_point time;
+    };
+
+    StreamProtocol::socket socket_;
+    boost::asio::steady_timer timer_;
+    const LoadConfig &config_;
+
+    mt19937 random_;
+    uniform_int_distribution<uint32_t> pick_;
+
+    Clock::time_point time_measure_, time_end_, next_send_;
+    Clock::duration period_ = Clock::duration::zero();
+    uint32_t next_id_ = 0;
+    unordered_map<uint32_t, Pending> pending_;
+
+    char data_[4096];
+    string received_;
+    bool binary_ = false;
+    Json::Reader reader_;
+
+    unordered_map<uint16_t, LastStatus> last_status_;
+    SessionResult result_;
+};
+
+void printUsage() {
+    COUT("Usage: datc_loadgen [options]\n"
+         "  --host ADDR          Server address (default 127.0.0.1)\n"
+         "  --port PORT          Server port (default 8421)\n"
+         "  --unix-socket PATH   Connect to the Unix domain socket instead\n"
+         "  --clients N          Client sessions (default 1)\n"
+         "  --rate R             Commands per second per client, 0: next command on every ack (default 10)\n"
+         "  --window N           Commands per client waiting for their ack (default 1)\n"
+         "  --duration S         Seconds of measurement (default 10)\n"
+         "  --warmup S           Seconds before the measurement (default 1)\n"
+         "  --mix LIST           Weighted commands, e.g. open:1,close:1,position:2 (default open:1,close:1)\n"
+         "                       enable stop disable position velocity current init open close\n"
+         "                       finger vacuum_on vacuum_off torque speed\n"
+         "  --format FORMAT      binary or json (default binary)\n"
+         "  --status-rate HZ     Status frames per second per client, 0: every poll (default 0)\n"
+         "  --seed N             Seed of the command mix (default 1)\n"
+         "  --json FILE          Write the results to FILE as Json\n"
+         "Exits with 2 if a command failed or was not acknowledged, or a session was closed.");
+}
+
+bool parseMix(const string &list, vector<MixEntry> &mix) {
+    stringstream ss(list);
+    string item;
+
+    mix.clear();
+
+    while (getline(ss, item, ',')) {
+        size_t colon = item.find(':');
+        const string name = item.substr(0, colon);
+
+        auto command = find_if(begin(kCommands), end(kCommands), [&name] (const decltype(kCommands[0]) &c) {
+            return name == c.name;
+        });
+
+        if (command == end(kCommands)) {
+            COUT("[Error] Undefined command in the mix: " + name);
+            return false;
+        }
+
+        MixEntry entry;
+        entry.name               = name;
+        entry.weight             = (colon == string::npos) ? 1 : stoul(item.substr(colon + 1));
+        entry.request.command    = (uint16_t) command->command;
+        entry.request.has_value_1 = command->value_1 >= -32768;
+        entry.request.has_value_2 = command->value_2 >= -32768;
+        entry.request.value_1    = (uint16_t) command->value_1;
+        entry.request.value_2    = (uint16_t) command->value_2;
+
+        if (entry.weight > 0) {
+            mix.push_back(entry);
+        }
+    }
+
+    if (mix.empty()) {
+        COUT("[Error] Empty command mix");
+        return false;
+    }
+
+    return true;
+}
+
+bool parseArguments(int argc, char **argv, LoadConfig &config) {
+    parseMix("open:1,close:1", config.mix);
+
+    for (int i = 1; i < argc; i++) {
+        const string option = argv[i];
+
+        if (option == "--help" || option == "-h") {
+            return false;
+        }
+
+        if (i + 1 >= argc) {
+            COUT("[Error] Missing value of " + option);
+            return false;
+        }
+
+        const string value = argv[++i];
+
+        try {
+            if      (option == "--host")        config.host        = value;
+            else if (option == "--port")        config.port        = stoi(value);
+            else if (option == "--unix-socket") config.unix_socket = value;
+            else if (option == "--clients")     config.clients     = max(stoi(value), 1);
+            else if (option == "--rate")        config.rate        = stod(value);
+            else if (option == "--window")      config.window      = max(stoi(value), 1);
+            else if (option == "--duration")    config.duration    = stod(value);
+            else if (option == "--warmup")      config.warmup      = stod(value);
+            else if (option == "--status-rate") config.status_rate = stod(value);
+            else if (option == "--seed")        config.seed        = stoul(value);
+            else if (option == "--json")        config.json_path   = value;
+            else if (option == "--mix") {
+                if (!parseMix(value, config.mix)) return false;
+            } else if (option == "--format") {
+                if      (value == "binary") config.format = WireFormat::BINARY;
+                else if (value == "json")   config.format = WireFormat::JSON;
+                else {
+                    COUT("[Error] Undefined format: " + value);
+                    return false;
+                }
+            } else {
+                COUT("[Error] Undefined option: " + option);
+                return false;
+            }
+        } catch (const exception &) {
+            COUT("[Error] Invalid value of " + option + ": " + value);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Sorts the samples and returns p50, p99, p999 and max in milliseconds.
+ */
+Json::Value percentiles(vector<uint32_t> &samples_us) {
+    Json::Value json;
+
+    if (samples_us.empty()) {
+        return json;
+    }
+
+    sort(samples_us.begin(), samples_us.end());
+
+    auto atFn = [&samples_us] (double quantile) {
+        size_t index = min((size_t) (quantile * samples_us.size()), samples_us.size() - 1);
+        return samples_us[index] / 1000.0;
+    };
+
+    json["p50_ms"]  = atFn(0.5);
+    json["p99_ms"]  = atFn(0.99);
+    json["p999_ms"] = atFn(0.999);
+    json["max_ms"]  = samples_us.back() / 1000.0;
+
+    return json;
+}
+
+Json::Value meanStddev(const vector<uint32_t> &samples_us) {
+    Json::Value json;
+    double sum = 0, sum_squares = 0;
+
+    for (uint32_t sample : samples_us) {
+        sum         += sample;
+        sum_squares += (double) sample * sample;
+    }
+
+    if (!samples_us.empty()) {
+        double mean = sum / samples_us.size();
+
+        json["mean_ms"]   = mean / 1000.0;
+        json["stddev_ms"] = sqrt(max(sum_squares / samples_us.size() - mean * mean, 0.0)) / 1000.0;
+    }
+
+    return json;
+}
+
+void printLatency(const string &name, const Json::Value &json) {
+    if (json.isNull()) {
+        return;
+    }
+
+    cout << setw(24) << left << name << fixed << setprecision(3)
+         << "p50 " << json["p50_ms"].asDouble() << "  p99 " << json["p99_ms"].asDouble()
+         << "  p999 " << json["p999_ms"].asDouble() << "  max " << json["max_ms"].asDouble() << " ms" << endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    LoadConfig config;
+
+    if (!parseArguments(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+
+    boost::asio::io_service io_service;
+    vector<unique_ptr<Session>> sessions;
+
+    for (uint32_t i = 0; i < config.clients; i++) {
+        sessions.emplace_back(new Session(io_service, config, i));
+
+        if (!sessions.back()->connect()) {
+            return 1;
+        }
+    }
+
+    auto time_start   = Clock::now();
+    auto time_measure = time_start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(config.warmup));
+    auto time_end     = time_measure + chrono::duration_cast<Clock::duration>(chrono::duration<double>(config.duration));
+
+    for (unique_ptr<Session> &session : sessions) {
+        session->start(time_start, time_measure, time_end);
+    }
+
+    // One thread runs every session, so the generator needs a single core
+    io_service.run_until(time_end);
+
+    auto time_deadline = time_end + chrono::duration_cast<Clock::duration>(chrono::duration<double>(kAckTimeout));
+
+    while (Clock::now() < time_deadline &&
+           any_of(sessions.begin(), sessions.end(), [] (const unique_ptr<Session> &s) {return !s->isIdle();})) {
+        io_service.run_for(chrono::milliseconds(10));
+    }
+
+    // Sessions closed by the server leave nothing to wait for
+    io_service.restart();
+
+    for (unique_ptr<Session> &session : sessions) {
+        session->stop();
+    }
+    io_service.poll();
+
+    // Merge the sessions
+    SessionResult total;
+    uint32_t disconnected = 0;
+
+    for (unique_ptr<Session> &session : sessions) {
+        SessionResult &result = session->getResult();
+
+        disconnected += result.disconnected;
+        total.sent          += result.sent;
+        total.acked         += result.acked;
+        total.failed        += result.failed;
+        total.status_frames += result.status_frames;
+        total.status_lost   += result.status_lost;
+
+        total.latency_us.insert(total.latency_us.end(), result.latency_us.begin(), result.latency_us.end());
+        total.intended_us.insert(total.intended_us.end(), result.intended_us.begin(), result.intended_us.end());
+        total.queue_us.insert(total.queue_us.end(), result.queue_us.begin(), result.queue_us.end());
+        total.execute_us.insert(total.execute_us.end(), result.execute_us.begin(), result.execute_us.end());
+        total.status_interval_us.insert(total.status_interval_us.end(),
+                                        result.status_interval_us.begin(), result.status_interval_us.end());
+    }
+
+    const uint64_t unacked = total.sent - min(total.acked, total.sent);
+
+    Json::Value json;
+    Json::Value &json_config = json["config"];
+
+    json_config["clients"]     = config.clients;
+    json_config["rate"]        = config.rate;
+    json_config["window"]      = config.window;
+    json_config["duration"]    = config.duration;
+    json_config["format"]      = (config.format == WireFormat::BINARY) ? "binary" : "json";
+    json_config["status_rate"] = config.status_rate;
+
+    for (const MixEntry &entry : config.mix) {
+        json_config["mix"][entry.name] = entry.weight;
+    }
+
+    Json::Value &commands = json["commands"];
+
+    json["disconnected"] = disconnected;
+
+    commands["sent"]            = (Json::UInt64) total.sent;
+    commands["acked"]           = (Json::UInt64) total.acked;
+    commands["failed"]          = (Json::UInt64) total.failed;
+    commands["unacked"]         = (Json::UInt64) unacked;
+    commands["throughput"]      = total.acked / config.duration;
+    commands["latency"]         = percentiles(total.latency_us);
+    commands["latency_intended"] = percentiles(total.intended_us);
+    commands["server_queue"]    = percentiles(total.queue_us);
+    commands["server_execute"]  = percentiles(total.execute_us);
+
+    Json::Value &status = json["status"];
+
+    status["frames"]   = (Json::UInt64) total.status_frames;
+    status["lost"]     = (Json::UInt64) total.status_lost;
+    status["rate"]     = total.status_frames / config.duration;
+    status["interval"] = meanStddev(total.status_interval_us);
+
+    Json::Value interval_percentiles = percentiles(total.status_interval_us);
+    for (const string &key : interval_percentiles.getMemberNames()) {
+        status["interval"][key] = interval_percentiles[key];
+    }
+
+    cout << fixed << setprecision(1)
+         << "commands   sent " << total.sent << ", acked " << total.acked << ", failed " << total.failed
+         << ", unacked " << unacked << ", " << commands["throughput"].asDouble() << " per s" << endl;
+    printLatency("latency", commands["latency"]);
+    printLatency("latency (intended)", commands["latency_intended"]);
+    printLatency("server queue", commands["server_queue"]);
+    printLatency("server execute", commands["server_execute"]);
+
+    cout << fixed << setprecision(1)
+         << "status     frames " << total.status_frames << ", lost " << total.status_lost
+         << ", " << status["rate"].asDouble() << " per s" << endl;
+    if (!status["interval"].isNull()) {
+        cout << setprecision(3) << setw(24) << left << "status interval"
+             << "mean " << status["interval"]["mean_ms"].asDouble()
+             << "  stddev " << status["interval"]["stddev_ms"].asDouble() << " ms" << endl;
+        printLatency("", status["interval"]);
+    }
+
+    if (disconnected > 0) {
+        cout << "sessions   " << disconnected << " of " << config.clients << " closed by the server" << endl;
+    }
+
+    if (!config.json_path.empty()) {
+        ofstream file(config.json_path);
+        Json::StyledWriter writer;
+
+        file << writer.write(json);
+
+        if (!file) {
+            COUT("[Error] Could not write " + config.json_path);
+            return 1;
+        }
+    }
+
+    return (total.failed > 0 || unacked > 0 || disconnected > 0) ? 2 : 0;
+}
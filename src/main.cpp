@@ -2,6 +2,9 @@
  * @file main.cpp
  * @author Inhwan Yoon (inhwan94@korea.ac.kr)
  * @brief Qt based gui.
+ * @details The window is shown first. Pages seldom visited, the serial port list and the font
+ * follow, see MainWindow. '--trace FILE' writes the startup and the trace points after it as
+ * Chrome trace Json to FILE on exit.
  * @version 1.0
  * @date 2023-11-06
  *
@@ -10,30 +13,41 @@
  */
 #include "main_window.hpp"
 #include <QApplication>
-#include <QFontDatabase>
 
 int main(int argc, char *argv[]) {
-    QApplication app(argc, argv);
-
-    // Font load
-    QString font_path = ":/font/NotoSansKR-VariableFont_wght.ttf";
+    const uint64_t t_start_us = monotonicMicros();
 
-    QFontDatabase font_database;
+    string trace_path;
 
-    if (font_database.addApplicationFont(font_path) == -1) {
-        COUT("Font not found: \"" + font_path.toStdString() +  "\"");
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--trace") {
+            trace_path = argv[i + 1];
+        }
     }
 
+    tracing::setEnabled(!trace_path.empty());
+    tracing::setThreadName("gui");
+
+    tracing::Span span(tracing::Stage::STARTUP);
+
+    QApplication app(argc, argv);
+
     bool flag_init_success = false;
 
     gripper_ui::MainWindow w(argc, argv, flag_init_success);
 
     if (flag_init_success) {
+        w.setStartTime(t_start_us);
         w.show();
+        span.end();
 
         app.connect(&app, SIGNAL(lastWindowClosed()), &app, SLOT(quit()));
         int result = app.exec();
 
+        if (tracing::isEnabled() && !tracing::writeChromeTrace(trace_path)) {
+            COUT("[Error] Could not write the trace to " + trace_path);
+        }
+
         return result;
     } else {
         return -1;
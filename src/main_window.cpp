@@ -9,18 +9,30 @@
  *
  */
 #include "main_window.hpp"
+#include <QApplication>
+#include <QFontDatabase>
+#include <fstream>
 
 using namespace Qt;
 
 namespace gripper_ui {
 
+const int kPerfRefreshMs  = 1000; /**< Also the window of the rates and the histogram */
+const int kFleetRefreshMs = 200;
+const char kStationFile[] = "datc_config.json"; /**< Connected at startup if no --config is given */
+const char kFontPath[]    = ":/font/NotoSansKR-VariableFont_wght.ttf";
+const int kFirstFrameTargetMs = 300; /**< From main() to the first interactive frame */
+
 MainWindow::MainWindow(int argc, char **argv, bool &success, QWidget *parent) : QMainWindow(parent) {
+    t_start_us_ = monotonicMicros();
+
     ui_ = new Ui::MainWindow();
 
+    // The advanced and TCP pages are built on their first visit, see buildAdvancedPage()
     modbus_widget_        = new ModbusWidget(this);
     datc_ctrl_widget_     = new DatcCtrlWidget(this);
-    tcp_widget_           = new TcpWidget(this);
-    advanced_ctrl_widget_ = new AdvancedCtrlWidget(this);
+    perf_widget_          = new PerfWidget(this);
+    fleet_widget_         = new FleetWidget(this);
 
     ui_->setupUi(this);
 
@@ -30,13 +42,12 @@ MainWindow::MainWindow(int argc, char **argv, bool &success, QWidget *parent) :
     // Stacked widget
     ui_->stackedWidget->addWidget(modbus_widget_);
     ui_->stackedWidget->addWidget(datc_ctrl_widget_);
-    ui_->stackedWidget->addWidget(advanced_ctrl_widget_);
+    ui_->stackedWidget->addWidget(perf_widget_);
+    ui_->stackedWidget->addWidget(fleet_widget_);
 
-#ifndef RCLCPP__RCLCPP_HPP_
-    ui_->stackedWidget->addWidget(tcp_widget_);
-#endif
+    ui_->stackedWidget->setCurrentWidget(modbus_widget_);
 
-    ui_->stackedWidget->setCurrentIndex((int) WidgetSeq::MODBUS_WIDGET);
+    datc_ctrl_widget_->trend_->setHistory(&datc_interface_->getStatusHistory());
 
     // GUI setting
     menu_btn_active_str_   = "background-color:#FFFFFF;color:#000000";
@@ -45,6 +56,11 @@ MainWindow::MainWindow(int argc, char **argv, bool &success, QWidget *parent) :
     btn_active_str_   = "background-color:#FFFFFF;color:#888888;border-style:outset;border-width:7;";
     btn_inactive_str_ = "background-color:#BBBBBB;color:#888888;border-style:inset;border-width:7;";
 
+    // Buttons follow their enabled state through the style sheet, set once so enabling them
+    // later does not polish them again
+    btn_style_str_ = "QPushButton:enabled {" + btn_active_str_ + "} "
+                     "QPushButton:disabled {" + btn_inactive_str_ + "}";
+
     // Initial value setting
     int finger_pos_init_value = 50;
     int torque_init_value = 100;
@@ -66,27 +82,11 @@ MainWindow::MainWindow(int argc, char **argv, bool &success, QWidget *parent) :
     font.setBold(true);
     modbus_widget_->ui_.comboBox_serial_port->lineEdit()->setFont(font);
 
-    on_pushButton_modbus_refresh_clicked();
-
     modbus_widget_->ui_.comboBox_baudrate->setEnabled(true);
     modbus_widget_->ui_.comboBox_baudrate->addItems({"9600", "19200", "38400", "57600", "115200"});
     modbus_widget_->ui_.comboBox_baudrate->setCurrentIndex(2);
     modbus_widget_->ui_.comboBox_baudrate->setDisabled(true);
 
-    // Check box setting
-    QString checkbox_qstr = "QCheckBox::indicator {width:25px; height: 25px;}";
-
-    tcp_widget_->ui_.checkBox_tcp_send_status->setStyleSheet(checkbox_qstr);
-
-    checkbox_qstr = "QCheckBox::indicator {width:20px; height: 20px;}";
-
-    advanced_ctrl_widget_->ui_.checkBox_motor_speed_reverse  ->setStyleSheet(checkbox_qstr);
-    advanced_ctrl_widget_->ui_.checkBox_motor_current_reverse->setStyleSheet(checkbox_qstr);
-
-    // Label
-    advanced_ctrl_widget_->ui_.label_motor_speed  ->setText("(100 % : " + QString::number(kVelMax) + " rpm)");
-    advanced_ctrl_widget_->ui_.label_motor_current->setText("(100 % : " + QString::number(kCurMax) + " mA)");
-
     // DATC control related btn
     QObject::connect(datc_ctrl_widget_->ui_.pushButton_cmd_enable  , SIGNAL(clicked()), this, SLOT(datcEnable()));
     QObject::connect(datc_ctrl_widget_->ui_.pushButton_cmd_disable , SIGNAL(clicked()), this, SLOT(datcDisable()));
@@ -102,6 +102,140 @@ MainWindow::MainWindow(int argc, char **argv, bool &success, QWidget *parent) :
     QObject::connect(datc_ctrl_widget_->ui_.pushButton_set_torque, SIGNAL(clicked()), this, SLOT(datcSetTorque()));
     QObject::connect(datc_ctrl_widget_->ui_.pushButton_set_speed , SIGNAL(clicked()), this, SLOT(datcSetSpeed()));
 
+    // Every command and bus access runs on the gui worker, results come back queued
+    toast_ = new ToastWidget(this);
+
+    connect(this, &MainWindow::commandDone, this, &MainWindow::showCommandResult, Qt::QueuedConnection);
+    connect(this, &MainWindow::modbusStarted, this, &MainWindow::showModbusStarted, Qt::QueuedConnection);
+    connect(this, &MainWindow::stationStarted, this, &MainWindow::showStationStarted, Qt::QueuedConnection);
+    connect(this, &MainWindow::serialPortsFound, this, &MainWindow::showSerialPorts, Qt::QueuedConnection);
+
+    // Modbus RTU related btn
+    QObject::connect(modbus_widget_->ui_.pushButton_modbus_start, SIGNAL(clicked()), this, SLOT(initModbus()));
+    QObject::connect(modbus_widget_->ui_.pushButton_modbus_stop , SIGNAL(clicked()), this, SLOT(releaseModbus()));
+    QObject::connect(modbus_widget_->ui_.pushButton_modbus_slave_change  , SIGNAL(clicked()), this, SLOT(changeSlaveAddress()));
+    QObject::connect(modbus_widget_->ui_.pushButton_modbus_set_slave_addr, SIGNAL(clicked()), this, SLOT(setSlaveAddr()));
+
+#ifdef RCLCPP__RCLCPP_HPP_
+    ui_->pushButton_select_tcp->setHidden(true);
+#endif
+
+    for (QPushButton *btn : {modbus_widget_->ui_.pushButton_modbus_start, modbus_widget_->ui_.pushButton_modbus_stop,
+                             modbus_widget_->ui_.pushButton_modbus_set_slave_addr,
+                             modbus_widget_->ui_.pushButton_modbus_slave_change}) {
+        btn->setStyleSheet(btn_style_str_);
+    }
+
+    // Sliders and spin boxes
+    connectSliderSpinbox(datc_ctrl_widget_->ui_.horizontalSlider_finger_pos, datc_ctrl_widget_->ui_.doubleSpinBox_finger_pos);
+    connectSliderSpinbox(datc_ctrl_widget_->ui_.verticalSlider_torque, datc_ctrl_widget_->ui_.doubleSpinBox_torque);
+    connectSliderSpinbox(datc_ctrl_widget_->ui_.verticalSlider_speed , datc_ctrl_widget_->ui_.doubleSpinBox_speed);
+
+#ifndef RCLCPP__RCLCPP_HPP_
+    // Off as the check box of the TCP page starts, which follows the interface once built
+    datc_interface_->setTcpSendStatus(false);
+#endif
+
+    // Performance page, refreshed only while shown
+    perf_widget_->ui_.tableWidget_perf_clients->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    perf_timer_.start();
+
+    perf_refresh_timer_ = new QTimer(this);
+    perf_refresh_timer_->setInterval(kPerfRefreshMs);
+    connect(perf_refresh_timer_, SIGNAL(timeout()), this, SLOT(updatePerfPage()));
+
+    // Fleet page, a frame of every polled slave while shown
+    fleet_refresh_timer_ = new QTimer(this);
+    fleet_refresh_timer_->setInterval(kFleetRefreshMs);
+    connect(fleet_refresh_timer_, SIGNAL(timeout()), this, SLOT(updateFleetPage()));
+
+    connect(ui_->stackedWidget, &QStackedWidget::currentChanged, this, [this] () {
+        QWidget *current = ui_->stackedWidget->currentWidget();
+
+        if (current == perf_widget_) {
+            perf_refresh_timer_->start();
+        } else {
+            perf_refresh_timer_->stop();
+        }
+
+        if (current == fleet_widget_) {
+            fleet_refresh_timer_->start();
+        } else {
+            fleet_refresh_timer_->stop();
+        }
+    });
+
+    // Status, refreshed only when the poll thread reads something new. A refresh already queued
+    // shows the latest view when it runs, so a fast bus does not queue one per cycle.
+    datc_interface_->setStatusListener([this] () {
+        if (!flag_refresh_pending_.exchange(true)) {
+            QMetaObject::invokeMethod(this, "refreshStatus", Qt::QueuedConnection);
+        }
+    });
+    refreshStatus();
+
+    datc_interface_->start();
+
+    // A station file connects at startup, on the gui worker so the window shows meanwhile
+    has_station_config_ = loadStationFile(argc, argv);
+
+    if (has_station_config_) {
+        applyStationFile();
+        startStationAsync();
+    }
+
+    // Ports are listed in the background, the font is loaded after the first frame
+    scanSerialPorts(has_station_config_);
+
+    success = true;
+}
+
+MainWindow::~MainWindow() {
+    if (port_thread_.joinable()) {
+        port_thread_.join();
+    }
+
+    if(datc_interface_ != NULL) {
+        datc_interface_->setStatusListener(nullptr);
+        datc_interface_->~DatcCommInterface();
+    }
+}
+
+// Each follows the other, the spin box keeps its fraction while the slider shows the integer part
+void MainWindow::connectSliderSpinbox(QSlider *slider, QDoubleSpinBox *spinbox) {
+    connect(slider, &QSlider::valueChanged, spinbox, [=] (int value) {
+        if ((int) spinbox->value() != value) {
+            spinbox->setValue((double) value);
+        }
+    });
+    connect(spinbox, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged), slider,
+            [=] (double value) {
+        if (slider->value() != (int) value) {
+            slider->setValue((int) value);
+        }
+    });
+}
+
+AdvancedCtrlWidget *MainWindow::buildAdvancedPage() {
+    if (advanced_ctrl_widget_ != nullptr) {
+        return advanced_ctrl_widget_;
+    }
+
+    tracing::Span span(tracing::Stage::PAGE_BUILD);
+
+    advanced_ctrl_widget_ = new AdvancedCtrlWidget(this);
+    ui_->stackedWidget->addWidget(advanced_ctrl_widget_);
+
+    // Check box setting
+    const QString checkbox_qstr = "QCheckBox::indicator {width:20px; height: 20px;}";
+
+    advanced_ctrl_widget_->ui_.checkBox_motor_speed_reverse  ->setStyleSheet(checkbox_qstr);
+    advanced_ctrl_widget_->ui_.checkBox_motor_current_reverse->setStyleSheet(checkbox_qstr);
+
+    // Label
+    advanced_ctrl_widget_->ui_.label_motor_speed  ->setText("(100 % : " + QString::number(kVelMax) + " rpm)");
+    advanced_ctrl_widget_->ui_.label_motor_current->setText("(100 % : " + QString::number(kCurMax) + " mA)");
+
     // Advanced control related btn
     QObject::connect(advanced_ctrl_widget_->ui_.pushButton_cmd_enable  , SIGNAL(clicked()), this, SLOT(datcEnable()));
     QObject::connect(advanced_ctrl_widget_->ui_.pushButton_cmd_disable , SIGNAL(clicked()), this, SLOT(datcDisable()));
@@ -116,246 +250,442 @@ MainWindow::MainWindow(int argc, char **argv, bool &success, QWidget *parent) :
     QObject::connect(advanced_ctrl_widget_->ui_.pushButton_set_motor_speed  , SIGNAL(clicked()), this, SLOT(datcMotorVelCtrl()));
     QObject::connect(advanced_ctrl_widget_->ui_.pushButton_set_motor_current, SIGNAL(clicked()), this, SLOT(datcMotorCurCtrl()));
 
-    // Modbus RTU related btn
-    QObject::connect(modbus_widget_->ui_.pushButton_modbus_start, SIGNAL(clicked()), this, SLOT(initModbus()));
-    QObject::connect(modbus_widget_->ui_.pushButton_modbus_stop , SIGNAL(clicked()), this, SLOT(releaseModbus()));
-    QObject::connect(modbus_widget_->ui_.pushButton_modbus_slave_change  , SIGNAL(clicked()), this, SLOT(changeSlaveAddress()));
-    QObject::connect(modbus_widget_->ui_.pushButton_modbus_set_slave_addr, SIGNAL(clicked()), this, SLOT(setSlaveAddr()));
+    // Sliders and spin boxes
+    connectSliderSpinbox(advanced_ctrl_widget_->ui_.horizontalSlider_motor_speed,
+                         advanced_ctrl_widget_->ui_.doubleSpinBox_motor_speed);
+    connectSliderSpinbox(advanced_ctrl_widget_->ui_.horizontalSlider_motor_current,
+                         advanced_ctrl_widget_->ui_.doubleSpinBox_motor_current);
+
+    const int vel_min_percent = (int) ((double) kVelMin / (double) kVelMax * 100);
+    QSlider *slider_motor_speed = advanced_ctrl_widget_->ui_.horizontalSlider_motor_speed;
+
+    auto clampVelFn([=] (int value) {
+        if (value < vel_min_percent) {
+            slider_motor_speed->setValue(vel_min_percent);
+        }
+    });
+    connect(slider_motor_speed, &QSlider::valueChanged, this, clampVelFn);
+    clampVelFn(slider_motor_speed->value());
+
+    return advanced_ctrl_widget_;
+}
 
 #ifndef RCLCPP__RCLCPP_HPP_
+TcpWidget *MainWindow::buildTcpPage() {
+    if (tcp_widget_ != nullptr) {
+        return tcp_widget_;
+    }
+
+    tracing::Span span(tracing::Stage::PAGE_BUILD);
+
+    tcp_widget_ = new TcpWidget(this);
+    ui_->stackedWidget->addWidget(tcp_widget_);
+
+    tcp_widget_->ui_.checkBox_tcp_send_status->setStyleSheet("QCheckBox::indicator {width:25px; height: 25px;}");
+
     // TCP socket commiunication related btn
     QObject::connect(tcp_widget_->ui_.pushButton_tcp_start, SIGNAL(clicked()), this, SLOT(startTcpComm()));
     QObject::connect(tcp_widget_->ui_.pushButton_tcp_stop , SIGNAL(clicked()), this, SLOT(stopTcpComm()));
-#else
-    ui_->pushButton_select_tcp->setHidden(true);
-#endif
 
-    timer_ = new QTimer(this);
-    connect(timer_, SIGNAL(timeout()), this, SLOT(timerCallback()));
-    timer_->start(100); // msec
+    tcp_widget_->ui_.pushButton_tcp_start->setStyleSheet(btn_style_str_);
+    tcp_widget_->ui_.pushButton_tcp_stop ->setStyleSheet(btn_style_str_);
 
-    datc_interface_->start();
-    success = true;
+    const bool is_socket_connected = datc_interface_->isSocketConnected();
+    tcp_widget_->ui_.pushButton_tcp_start->setEnabled(!is_socket_connected);
+    tcp_widget_->ui_.pushButton_tcp_stop ->setEnabled(is_socket_connected);
+
+    // The station and the interface may have changed what the page shows before it was built
+    if (has_station_config_ && station_config_.tcp_port > 0) {
+        tcp_widget_->ui_.lineEdit_tcp_port->setText(QString::number(station_config_.tcp_port));
+    }
+
+    tcp_widget_->ui_.checkBox_tcp_send_status->setChecked(datc_interface_->getTcpSendStatus());
+    connect(tcp_widget_->ui_.checkBox_tcp_send_status, &QCheckBox::toggled, this, [this] (bool checked) {
+        datc_interface_->setTcpSendStatus(checked);
+    });
+
+    return tcp_widget_;
 }
+#endif
 
-MainWindow::~MainWindow() {
-    if(datc_interface_ != NULL) {
-        datc_interface_->~DatcCommInterface();
+void MainWindow::refreshStatus() {
+    // Cleared before reading, a view published meanwhile queues the next refresh
+    flag_refresh_pending_ = false;
+
+    QElapsedTimer refresh_timer;
+    refresh_timer.start();
+
+    const StatusView view = datc_interface_->getStatusView();
+    const StatusView &prev = view_shown_;
+    const bool is_all = !is_view_shown_;
+
+    // Display
+    if (is_all || view.status.finger_pos != prev.status.finger_pos) {
+        ui_->lineEdit_monitor_finger_position->setText(QString::number((double) view.status.finger_pos / 10 , 'f', 1) + " %");
+    }
+    if (is_all || view.status.motor_cur != prev.status.motor_cur) {
+        ui_->lineEdit_monitor_current->setText(QString::number(view.status.motor_cur) + " mA");
+    }
+
+    // Comm. status
+    if (is_all || view.modbus_connected != prev.modbus_connected) {
+        modbus_widget_->ui_.pushButton_modbus_start->setEnabled(!view.modbus_connected);
+        modbus_widget_->ui_.pushButton_modbus_stop ->setEnabled(view.modbus_connected);
+        modbus_widget_->ui_.pushButton_modbus_set_slave_addr->setEnabled(view.modbus_connected);
+        modbus_widget_->ui_.pushButton_modbus_slave_change->setEnabled(view.modbus_connected);
     }
 
-    if(timer_ != NULL) {
-        delete timer_;
+    if (view.modbus_connected) {
+        const bool is_mode_changed = is_all || !prev.modbus_connected ||
+                                     view.modbus_recv_err != prev.modbus_recv_err ||
+                                     view.status.status_str != prev.status.status_str;
+
+        if (is_mode_changed) {
+            ui_->lineEdit_monitor_mode->setText(view.modbus_recv_err ? QString("Failed to read input register.") :
+                                                " " + QString::fromStdString(view.status.status_str));
+        }
+
+        if (is_all || !prev.modbus_connected || view.slave_addr != prev.slave_addr) {
+            ui_->lineEdit_current_slave_addr->setText((view.slave_addr == 0) ? "N/A" : QString::number(view.slave_addr));
+        }
+    } else if (is_all || prev.modbus_connected) {
+        ui_->lineEdit_current_slave_addr->setText("N/A");
+    }
+
+#ifndef RCLCPP__RCLCPP_HPP_
+    // Socket comm. status, the page takes it when built
+    if (tcp_widget_ != nullptr && (is_all || view.socket_connected != prev.socket_connected)) {
+        tcp_widget_->ui_.pushButton_tcp_start->setEnabled(!view.socket_connected);
+        tcp_widget_->ui_.pushButton_tcp_stop ->setEnabled(view.socket_connected);
     }
+#endif
+
+    view_shown_ = view;
+    is_view_shown_ = true;
+
+    gui_refreshes_++;
+    gui_refresh_ns_ += refresh_timer.nsecsElapsed();
 }
 
-void MainWindow::timerCallback() {
-    static std::function setButtonStyle([=] (QPushButton *btn) {
-        bool is_activated = btn->isEnabled();
-        btn->setStyleSheet(is_activated ? btn_active_str_ : btn_inactive_str_);
+// Reads the counters the workers publish without locking the bus. Only the client queue table
+// takes the client lock, briefly and once per refresh
+void MainWindow::updatePerfPage() {
+    const PerfStats stats = datc_interface_->getPerfStats();
+    const double elapsed  = perf_timer_.restart() / 1000.0;
+
+    auto latencyStrFn([] (const LatencySnapshot &snapshot) {
+        if (snapshot.count == 0) {
+            return QString("-");
+        }
+        return QString::number(snapshot.percentileUs(0.5) / 1000.0, 'f', 1) + " / " +
+               QString::number(snapshot.percentileUs(0.99) / 1000.0, 'f', 1) + " ms";
     });
 
-    DatcStatus datc_status = datc_interface_->getDatcStatus();
+    const LatencySnapshot round_trip   = stats.modbus.round_trip - perf_prev_.modbus.round_trip;
+    const LatencySnapshot command_wait = stats.command_wait - perf_prev_.command_wait;
+    const double poll_rate = (elapsed > 0) ? (stats.poll_cycles - perf_prev_.poll_cycles) / elapsed : 0;
+
+    Ui::PerfForm &ui = perf_widget_->ui_;
+
+    ui.lineEdit_perf_poll_rate->setText(QString::number(poll_rate, 'f', 1) + " / " +
+                                        QString::number(DatcCommInterface::getPollFrequency()) + " Hz");
+    ui.lineEdit_perf_overruns ->setText(QString::number(stats.poll_overruns) + " (+" +
+                                        QString::number(stats.poll_overruns - perf_prev_.poll_overruns) + ")");
+    ui.lineEdit_perf_modbus_latency->setText(latencyStrFn(round_trip));
+    ui.lineEdit_perf_modbus_errors ->setText(QString::number(stats.modbus.errors) + " / " +
+                                             QString::number(stats.modbus.timeouts));
+    ui.lineEdit_perf_command_wait  ->setText(latencyStrFn(command_wait));
+
+    // Status views shown per second and the gui thread time they took
+    if (elapsed > 0) {
+        ui.lineEdit_perf_gui_refresh->setText(
+                QString::number((gui_refreshes_ - gui_refreshes_prev_) / elapsed, 'f', 1) + " / s, " +
+                QString::number((gui_refresh_ns_ - gui_refresh_ns_prev_) / elapsed / 1e6, 'f', 2) + " ms / s");
+    }
+    gui_refreshes_prev_  = gui_refreshes_;
+    gui_refresh_ns_prev_ = gui_refresh_ns_;
 
-    // Display
-    ui_->lineEdit_monitor_finger_position->setText(QString::number((double) datc_status.finger_pos / 10 , 'f', 1) + " %");
-    ui_->lineEdit_monitor_current        ->setText(QString::number(datc_status.motor_cur) + " mA");
+    perf_widget_->histogram_->setSnapshot(round_trip);
 
-    // Comm. status check
-    const bool is_modbus_connected = datc_interface_->getConnectionState();
+    // Client queues, ordered by socket id. Copied under the client lock, a broadcast waits for it
+    auto client_stats = datc_interface_->getTcpClientQueueStats();
+    map<uint32_t, ClientQueueStats> clients(client_stats.begin(), client_stats.end());
 
-    modbus_widget_->ui_.pushButton_modbus_start->setEnabled(!is_modbus_connected);
-    modbus_widget_->ui_.pushButton_modbus_stop ->setEnabled(is_modbus_connected);
-    modbus_widget_->ui_.pushButton_modbus_set_slave_addr->setEnabled(is_modbus_connected);
-    modbus_widget_->ui_.pushButton_modbus_slave_change->setEnabled(is_modbus_connected);
+    ui.lineEdit_perf_clients->setText(QString::number(clients.size()));
+    ui.tableWidget_perf_clients->setRowCount(clients.size());
 
-    setButtonStyle(modbus_widget_->ui_.pushButton_modbus_start);
-    setButtonStyle(modbus_widget_->ui_.pushButton_modbus_stop);
-    setButtonStyle(modbus_widget_->ui_.pushButton_modbus_set_slave_addr);
-    setButtonStyle(modbus_widget_->ui_.pushButton_modbus_slave_change);
+    int row = 0;
+    for (const auto &client : clients) {
+        const uint64_t values[] = {client.first, client.second.depth, client.second.max_depth, client.second.dropped};
 
-    if (is_modbus_connected) {
-        if (datc_interface_->getModbusRecvErr()) {
-            ui_->lineEdit_monitor_mode->setText("Failed to read input register.");
-        } else {
-            ui_->lineEdit_monitor_mode->setText(" " + QString::fromStdString(datc_status.status_str));
+        for (int col = 0; col < 4; col++) {
+            QTableWidgetItem *item = ui.tableWidget_perf_clients->item(row, col);
+
+            if (item == nullptr) {
+                item = new QTableWidgetItem();
+                item->setTextAlignment(Qt::AlignCenter);
+                ui.tableWidget_perf_clients->setItem(row, col, item);
+            }
+            item->setText(QString::number(values[col]) + (col == 0 && client.second.lagging ? " (lagging)" : ""));
         }
+        row++;
+    }
+
+    perf_prev_ = stats;
+}
 
-        QString qstr_slave_addr = (datc_interface_->getSlaveAddr() == 0) ?
-                                  "N/A" : QString::number(datc_interface_->getSlaveAddr());
+// Only the cells that changed since the last frame are redrawn
+void MainWindow::updateFleetPage() {
+    const double elapsed = fleet_timer_.isValid() ? fleet_timer_.restart() / 1000.0 : 0;
+
+    if (!fleet_timer_.isValid()) {
+        fleet_timer_.start();
+    }
 
-        ui_->lineEdit_current_slave_addr->setText(qstr_slave_addr);
+    fleet_widget_->model_->update(datc_interface_->getSlaveRecords(), elapsed);
+}
+
+void MainWindow::submitCommand(const QString &name, DATC_COMMAND command, bool has_value_1, uint16_t value_1) {
+    CommandRequest request;
+    request.command     = (uint16_t) command;
+    request.has_value_1 = has_value_1;
+    request.value_1     = value_1;
+
+    submitCommand(name, request);
+}
+
+void MainWindow::submitCommand(const QString &name, const CommandRequest &request) {
+    const bool is_queued = datc_interface_->submitCommand(request, [this, name] (const CommandAck &ack) {
+        Q_EMIT commandDone(name, ack.error == CommandError::NONE, (ack.t_done_us - ack.t_recv_us) / 1000.0);
+    });
+
+    if (!is_queued) {
+        toast_->showMessage(name + ": busy, not sent", false);
+    }
+}
+
+// elapsed_ms is negative if not measured
+void MainWindow::showCommandResult(QString name, bool success, double elapsed_ms) {
+    QString text = name + (success ? ": done" : ": failed");
+
+    if (elapsed_ms >= 0) {
+        text += " (" + QString::number(elapsed_ms, 'f', 0) + " ms)";
+    }
+    toast_->showMessage(text, success);
+}
+
+void MainWindow::showModbusStarted(bool success) {
+    if (success) {
+        toast_->showMessage("Modbus started", true);
     } else {
-        ui_->lineEdit_current_slave_addr->setText("N/A");
+        ui_->lineEdit_monitor_mode->setText("Invalid port or permission.");
+        toast_->showMessage("Modbus start: failed", false);
     }
+}
 
-#ifndef RCLCPP__RCLCPP_HPP_
-    // Socket comm. status check
-    const bool is_socket_connected = datc_interface_->isSocketConnected();
+void MainWindow::showStationStarted(bool success, QString failed, double ready_ms, double first_status_ms) {
+    if (!success) {
+        toast_->showMessage("Station start: could not open " + failed, false);
+        return;
+    }
 
-    tcp_widget_->ui_.pushButton_tcp_start->setEnabled(!is_socket_connected);
-    tcp_widget_->ui_.pushButton_tcp_stop ->setEnabled(is_socket_connected);
+    QString text = "Connected in " + QString::number(ready_ms, 'f', 0) + " ms";
 
-    setButtonStyle(tcp_widget_->ui_.pushButton_tcp_start);
-    setButtonStyle(tcp_widget_->ui_.pushButton_tcp_stop);
+    if (first_status_ms >= 0) {
+        text += ", first status after " + QString::number(first_status_ms, 'f', 0) + " ms";
+    } else {
+        text += ", no status yet";
+    }
+    toast_->showMessage(text, first_status_ms >= 0);
+}
 
-    datc_interface_->setTcpSendStatus(tcp_widget_->ui_.checkBox_tcp_send_status->isChecked());
-#endif
+bool MainWindow::loadStationFile(int argc, char **argv) {
+    string path;
 
-    // Slider control
-    static std::function syncSliderSpinboxFn(
-            [] (int &slider_data_prev, double &spinbox_data_prev, QSlider *slider, QDoubleSpinBox *spinbox) {
-        int slider_data     = slider->value();
-        double spinbox_data = spinbox->value();
+    for (int i = 1; i + 1 < argc; i++) {
+        if (string(argv[i]) == "--config") {
+            path = argv[i + 1];
+        }
+    }
 
-        if (slider_data != slider_data_prev) {
-            spinbox->setValue((double) slider_data);
-        } else if (fabs(spinbox_data - spinbox_data_prev) >= 0.09) {
-            slider->setValue((int) spinbox_data);
+    if (path.empty()) {
+        if (!ifstream(kStationFile).good()) {
+            return false;
         }
+        path = kStationFile;
+    }
 
-        slider_data_prev  = slider->value();
-        spinbox_data_prev = spinbox->value();
-    });
+    station_config_ = StationConfig();
 
-    // Finger position control side
-    static int slider_finger_pos_prev = datc_ctrl_widget_->ui_.horizontalSlider_finger_pos->value();
-    static int slider_torque_prev     = datc_ctrl_widget_->ui_.verticalSlider_torque->value();
-    static int slider_speed_prev      = datc_ctrl_widget_->ui_.verticalSlider_speed ->value();
-
-    static double finger_pos_prev = datc_ctrl_widget_->ui_.doubleSpinBox_finger_pos->value();
-    static double torque_prev     = datc_ctrl_widget_->ui_.doubleSpinBox_torque->value();
-    static double speed_prev      = datc_ctrl_widget_->ui_.doubleSpinBox_speed->value();
-
-    syncSliderSpinboxFn(slider_finger_pos_prev, finger_pos_prev,
-                        datc_ctrl_widget_->ui_.horizontalSlider_finger_pos,
-                        datc_ctrl_widget_->ui_.doubleSpinBox_finger_pos);
-    syncSliderSpinboxFn(slider_torque_prev, torque_prev,
-                        datc_ctrl_widget_->ui_.verticalSlider_torque,
-                        datc_ctrl_widget_->ui_.doubleSpinBox_torque);
-    syncSliderSpinboxFn(slider_speed_prev, speed_prev,
-                        datc_ctrl_widget_->ui_.verticalSlider_speed,
-                        datc_ctrl_widget_->ui_.doubleSpinBox_speed);
-
-    // Advanced control side
-    const int vel_min_percent = (int) ((double) kVelMin / (double) kVelMax * 100);
+    if (!loadStationConfig(path, station_config_)) {
+        return false;
+    }
 
-    if (advanced_ctrl_widget_->ui_.horizontalSlider_motor_speed->value() < vel_min_percent) {
-        advanced_ctrl_widget_->ui_.horizontalSlider_motor_speed->setValue(vel_min_percent);
+    if (station_config_.buses.empty()) {
+        station_config_.buses.resize(1);
     }
 
-    static int slider_vel_prev = advanced_ctrl_widget_->ui_.horizontalSlider_motor_speed->value();
-    static int slider_cur_prev = advanced_ctrl_widget_->ui_.horizontalSlider_motor_current->value();
+    COUT("[INFO] Station file: " + path);
+    return true;
+}
+
+// The modbus page shows the station, so stopping and starting by hand keeps it. The TCP page
+// takes its part when built.
+void MainWindow::applyStationFile() {
+    const BusConfig &bus = station_config_.buses[0];
+
+    modbus_widget_->ui_.comboBox_serial_port->setCurrentText(QString::fromStdString(bus.device));
+    modbus_widget_->ui_.comboBox_baudrate->setCurrentText(QString::number(bus.baudrate));
+    modbus_widget_->ui_.spinBox_slave_addr->setValue(bus.slave);
+
+#ifdef RCLCPP__RCLCPP_HPP_
+    station_config_.tcp_port = 0;
+#endif
+}
+
+void MainWindow::startStationAsync() {
+    auto report = make_shared<StartupReport>();
+
+    auto startFn([this, report] () {
+        return startStation(*datc_interface_, station_config_, *report);
+    });
 
-    static double vel_prev = advanced_ctrl_widget_->ui_.doubleSpinBox_motor_speed->value();
-    static double cur_prev = advanced_ctrl_widget_->ui_.doubleSpinBox_motor_current->value();
+    const bool is_queued = datc_interface_->submitTask(startFn, [this, report] (bool success) {
+        QStringList failed;
+
+        if (!report->is_bus_open) {
+            failed << QString::fromStdString(station_config_.buses[0].device);
+        }
+
+        for (const string &name : report->failed) {
+            failed << QString::fromStdString(name);
+        }
+
+        Q_EMIT stationStarted(success, failed.join(", "), report->ready_ms, report->first_status_ms);
+    });
 
-    syncSliderSpinboxFn(slider_vel_prev, vel_prev,
-                        advanced_ctrl_widget_->ui_.horizontalSlider_motor_speed,
-                        advanced_ctrl_widget_->ui_.doubleSpinBox_motor_speed);
-    syncSliderSpinboxFn(slider_cur_prev, cur_prev,
-                        advanced_ctrl_widget_->ui_.horizontalSlider_motor_current,
-                        advanced_ctrl_widget_->ui_.doubleSpinBox_motor_current);
+    if (!is_queued) {
+        toast_->showMessage("Station start: busy, not sent", false);
+    }
 }
 
 // Enable Disable
 void MainWindow::datcEnable() {
-    datc_interface_->motorEnable();
+    submitCommand("Enable", DATC_COMMAND::MOTOR_ENABLE);
 }
 
 void MainWindow::datcDisable() {
-    datc_interface_->motorDisable();
+    submitCommand("Disable", DATC_COMMAND::MOTOR_DISABLE);
 }
 
 // Datc control
 void MainWindow::datcFingerPosCtrl() {
-    datc_interface_->setFingerPos(datc_ctrl_widget_->ui_.doubleSpinBox_finger_pos->value() * 10);
+    submitCommand("Finger position", DATC_COMMAND::SET_FINGER_POSITION, true,
+                  (uint16_t) (datc_ctrl_widget_->ui_.doubleSpinBox_finger_pos->value() * 10));
 }
 
 void MainWindow::datcMotorVelCtrl() {
     int16_t vel = advanced_ctrl_widget_->ui_.doubleSpinBox_motor_speed->value() * kVelMax / 100;
     vel *= (advanced_ctrl_widget_->ui_.checkBox_motor_speed_reverse->isChecked()) ? -1 : 1;
-    datc_interface_->motorVelCtrl(vel);
+    submitCommand("Motor speed", DATC_COMMAND::MOTOR_VELOCITY_CONTROL, true, (uint16_t) vel);
 }
 
 void MainWindow::datcMotorCurCtrl() {
     int16_t cur = advanced_ctrl_widget_->ui_.doubleSpinBox_motor_current->value() * kCurMax / 100;
     cur *= (advanced_ctrl_widget_->ui_.checkBox_motor_current_reverse->isChecked()) ? -1 : 1;
-    datc_interface_->motorCurCtrl(cur);
+    submitCommand("Motor current", DATC_COMMAND::MOTOR_CURRENT_CONTROL, true, (uint16_t) cur);
 }
 
 void MainWindow::datcInit() {
-    datc_interface_->grpInitialize();
+    submitCommand("Initialize", DATC_COMMAND::GRIPPER_INITIALIZE);
 }
 
 void MainWindow::datcOpen() {
-    datc_interface_->grpOpen();
+    submitCommand("Open", DATC_COMMAND::GRIPPER_OPEN);
 }
 
 void MainWindow::datcClose() {
-    datc_interface_->grpClose();
+    submitCommand("Close", DATC_COMMAND::GRIPPER_CLOSE);
 }
 
 void MainWindow::datcStop() {
-    datc_interface_->motorStop();
+    submitCommand("Stop", DATC_COMMAND::MOTOR_STOP);
 }
 
 void MainWindow::datcVacuumGrpOn() {
-    datc_interface_->vacuumGrpOn();
+    submitCommand("Vacuum on", DATC_COMMAND::VACUUM_GRIPPER_ON);
 }
 
 void MainWindow::datcVacuumGrpOff() {
-    datc_interface_->vacuumGrpOff();
+    submitCommand("Vacuum off", DATC_COMMAND::VACUUM_GRIPPER_OFF);
 }
 
 void MainWindow::datcSetTorque() {
-    datc_interface_->setMotorTorque((uint16_t) datc_ctrl_widget_->ui_.doubleSpinBox_torque->value());
+    submitCommand("Torque", DATC_COMMAND::SET_MOTOR_TORQUE, true,
+                  (uint16_t) datc_ctrl_widget_->ui_.doubleSpinBox_torque->value());
 }
 
 void MainWindow::datcSetSpeed() {
-    datc_interface_->setMotorSpeed((uint16_t) datc_ctrl_widget_->ui_.doubleSpinBox_speed->value());
+    submitCommand("Speed", DATC_COMMAND::SET_MOTOR_SPEED, true,
+                  (uint16_t) datc_ctrl_widget_->ui_.doubleSpinBox_speed->value());
 }
 
-// Modbus RTU related
+// Modbus RTU related, opening and closing the port also wait for the bus
 void MainWindow::initModbus() {
     COUT("--------------------------------------------");
     COUT("[INFO] Port: " + modbus_widget_->ui_.comboBox_serial_port->currentText().toStdString());
     COUT("[INFO] Slave address #" + modbus_widget_->ui_.spinBox_slave_addr->text().toStdString());
     COUT("--------------------------------------------");
 
-    const char* port = modbus_widget_->ui_.comboBox_serial_port->currentText().toStdString().c_str();
+    const string port   = modbus_widget_->ui_.comboBox_serial_port->currentText().toStdString();
     uint16_t slave_addr = modbus_widget_->ui_.spinBox_slave_addr->value();
 
-    if (datc_interface_->init(port, slave_addr)) {
-        // Successed
-    } else {
-        ui_->lineEdit_monitor_mode->setText("Invalid port or permission.");
-        COUT("[ERROR] Port name or slave address invlaid !");
+    const int baudrate  = modbus_widget_->ui_.comboBox_baudrate->currentText().toInt();
+
+    auto initFn([this, port, slave_addr, baudrate] () {
+        return datc_interface_->init(port.c_str(), slave_addr, baudrate);
+    });
+
+    const bool is_queued = datc_interface_->submitTask(initFn, [this] (bool success) {
+        if (!success) {
+            COUT("[ERROR] Port name or slave address invlaid !");
+        }
+        Q_EMIT modbusStarted(success);
+    });
+
+    if (!is_queued) {
+        toast_->showMessage("Modbus start: busy, not sent", false);
     }
 }
 
 void MainWindow::releaseModbus() {
-    datc_interface_->modbusRelease();
-    ui_->lineEdit_monitor_mode->setText("");
-}
+    auto releaseFn([this] () {
+        return datc_interface_->modbusRelease();
+    });
 
-void MainWindow::changeSlaveAddress() {
-    uint16_t slave_addr = modbus_widget_->ui_.spinBox_slave_addr->value();
+    const bool is_queued = datc_interface_->submitTask(releaseFn, [this] (bool success) {
+        Q_EMIT commandDone("Modbus stop", success, -1);
+    });
 
-    if (datc_interface_->modbusSlaveChange(slave_addr)) {
-        // Successed
+    if (is_queued) {
+        ui_->lineEdit_monitor_mode->setText("");
     } else {
-        COUT("[ERROR] Slave change failed !");
+        toast_->showMessage("Modbus stop: busy, not sent", false);
     }
 }
 
-void MainWindow::setSlaveAddr() {
-    uint16_t slave_addr = modbus_widget_->ui_.spinBox_slave_addr_4set->value();
+void MainWindow::changeSlaveAddress() {
+    CommandRequest request;
+    request.type        = RequestType::CHANGE_SLAVE;
+    request.has_value_1 = true;
+    request.value_1     = modbus_widget_->ui_.spinBox_slave_addr->value();
 
-    if (datc_interface_->setModbusAddr(slave_addr)) {
-        // Successed
-    } else {
-        COUT("[ERROR] Slave change failed !");
-    }
+    submitCommand("Change slave", request);
+}
+
+void MainWindow::setSlaveAddr() {
+    submitCommand("Set slave address", DATC_COMMAND::CHANGE_MODBUS_ADDRESS, true,
+                  modbus_widget_->ui_.spinBox_slave_addr_4set->value());
 }
 
 #ifndef RCLCPP__RCLCPP_HPP_
@@ -364,62 +694,195 @@ void MainWindow::startTcpComm() {
     string addr          = tcp_widget_->ui_.lineEdit_tcp_addr->text().toStdString();
     uint16_t socket_port = tcp_widget_->ui_.lineEdit_tcp_port->text().toUInt();
 
-    datc_interface_->initTcp(addr, socket_port);
+    auto initFn([this, addr, socket_port] () {
+        return datc_interface_->initTcp(addr, socket_port);
+    });
+
+    const bool is_queued = datc_interface_->submitTask(initFn, [this] (bool success) {
+        Q_EMIT commandDone("TCP start", success, -1);
+    });
+
+    if (!is_queued) {
+        toast_->showMessage("TCP start: busy, not sent", false);
+    }
 }
 
+// Deleting the server waits for its threads, which is not done on the gui thread
 void MainWindow::stopTcpComm() {
-    datc_interface_->releaseTcp();
+    auto releaseFn([this] () {
+        datc_interface_->releaseTcp();
+        return true;
+    });
+
+    const bool is_queued = datc_interface_->submitTask(releaseFn, [this] (bool success) {
+        Q_EMIT commandDone("TCP stop", success, -1);
+    });
+
+    if (!is_queued) {
+        toast_->showMessage("TCP stop: busy, not sent", false);
+    }
 }
 #endif
 
 void MainWindow::on_pushButton_select_modbus_clicked() {
-    ui_->stackedWidget->setCurrentIndex((int) WidgetSeq::MODBUS_WIDGET);
+    ui_->stackedWidget->setCurrentWidget(modbus_widget_);
 
     ui_->pushButton_select_modbus   ->setStyleSheet(menu_btn_active_str_);
     ui_->pushButton_select_datc_ctrl->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_adv      ->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_tcp      ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_perf     ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_fleet    ->setStyleSheet(menu_btn_inactive_str_);
 }
 
 void MainWindow::on_pushButton_select_datc_ctrl_clicked() {
-    ui_->stackedWidget->setCurrentIndex((int) WidgetSeq::DATC_CTRL_WIDGET);
+    ui_->stackedWidget->setCurrentWidget(datc_ctrl_widget_);
 
     ui_->pushButton_select_modbus   ->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_datc_ctrl->setStyleSheet(menu_btn_active_str_);
     ui_->pushButton_select_adv      ->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_tcp      ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_perf     ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_fleet    ->setStyleSheet(menu_btn_inactive_str_);
 }
 
 void MainWindow::on_pushButton_select_adv_clicked() {
-    ui_->stackedWidget->setCurrentIndex((int) WidgetSeq::ADVANCED_CTRL_WIDGET);
+    ui_->stackedWidget->setCurrentWidget(buildAdvancedPage());
 
     ui_->pushButton_select_modbus   ->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_datc_ctrl->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_adv      ->setStyleSheet(menu_btn_active_str_);
     ui_->pushButton_select_tcp      ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_perf     ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_fleet    ->setStyleSheet(menu_btn_inactive_str_);
 }
 
 void MainWindow::on_pushButton_select_tcp_clicked() {
-    ui_->stackedWidget->setCurrentIndex((int) WidgetSeq::TCP_WIDGET);
+#ifndef RCLCPP__RCLCPP_HPP_
+    ui_->stackedWidget->setCurrentWidget(buildTcpPage());
+#endif
 
     ui_->pushButton_select_modbus   ->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_datc_ctrl->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_adv      ->setStyleSheet(menu_btn_inactive_str_);
     ui_->pushButton_select_tcp      ->setStyleSheet(menu_btn_active_str_);
+    ui_->pushButton_select_perf     ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_fleet    ->setStyleSheet(menu_btn_inactive_str_);
+}
+
+void MainWindow::on_pushButton_select_perf_clicked() {
+    ui_->stackedWidget->setCurrentWidget(perf_widget_);
+
+    ui_->pushButton_select_modbus   ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_datc_ctrl->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_adv      ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_tcp      ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_perf     ->setStyleSheet(menu_btn_active_str_);
+    ui_->pushButton_select_fleet    ->setStyleSheet(menu_btn_inactive_str_);
+
+    updatePerfPage();
+}
+
+void MainWindow::on_pushButton_select_fleet_clicked() {
+    ui_->stackedWidget->setCurrentWidget(fleet_widget_);
+
+    ui_->pushButton_select_modbus   ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_datc_ctrl->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_adv      ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_tcp      ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_perf     ->setStyleSheet(menu_btn_inactive_str_);
+    ui_->pushButton_select_fleet    ->setStyleSheet(menu_btn_active_str_);
+
+    updateFleetPage();
 }
 
 void MainWindow::on_pushButton_modbus_refresh_clicked() {
-    modbus_widget_->ui_.comboBox_serial_port->clear();
+    scanSerialPorts(false);
+}
+
+// Listing the ports may take long, e.g. the device registry on Windows, so it runs on a thread
+void MainWindow::scanSerialPorts(bool keep_current) {
+    // A scan running already lists the ports soon enough
+    if (flag_port_scan_running_.exchange(true)) {
+        return;
+    }
+
+    if (port_thread_.joinable()) {
+        port_thread_.join();
+    }
+
+    port_thread_ = std::thread([this, keep_current] () {
+        tracing::setThreadName("port_scan");
+
+        QStringList ports;
+        {
+            tracing::Span span(tracing::Stage::PORT_SCAN);
+
+            for (const string &port : getSerialPortLists()) {
+                ports << QString::fromStdString(port);
+            }
+        }
+
+        flag_port_scan_running_ = false;
+        Q_EMIT serialPortsFound(ports, keep_current);
+    });
+}
+
+// keep_current: the port shown stays, e.g. the one of the station file
+void MainWindow::showSerialPorts(QStringList ports, bool keep_current) {
+    QComboBox *combobox   = modbus_widget_->ui_.comboBox_serial_port;
+    const QString current = combobox->currentText();
 
-    std::vector<std::string> ser_port_str_vec = getSerialPortLists();
+    combobox->clear();
+    combobox->addItems(ports);
 
-    for (auto i : ser_port_str_vec) {
-        modbus_widget_->ui_.comboBox_serial_port->addItem(QString::fromStdString(i));
+    if (keep_current && !current.isEmpty()) {
+        combobox->setCurrentText(current);
+    } else if (!ports.isEmpty()) {
+        combobox->setCurrentIndex(ports.size() - 1);
     }
+}
+
+void MainWindow::setStartTime(uint64_t t_start_us) {
+    t_start_us_ = t_start_us;
+}
 
-    if (!ser_port_str_vec.empty()) {
-        modbus_widget_->ui_.comboBox_serial_port->setCurrentIndex(ser_port_str_vec.size() - 1);
+bool MainWindow::event(QEvent *event) {
+    // Done once the event loop is free after the first paint
+    if (event->type() == QEvent::Paint && !is_first_frame_) {
+        is_first_frame_ = true;
+        QTimer::singleShot(0, this, &MainWindow::finishStartup);
     }
+
+    return QMainWindow::event(event);
+}
+
+// Resources the first frame does without
+void MainWindow::finishStartup() {
+    tracing::record(tracing::Stage::FIRST_FRAME, tracing::Phase::INSTANT, 0);
+
+    const double first_frame_ms = (monotonicMicros() - t_start_us_) / 1000.0;
+
+    COUT("[INFO] First interactive frame after " << first_frame_ms << " ms (target " << kFirstFrameTargetMs
+         << " ms" << ((first_frame_ms > kFirstFrameTargetMs) ? ", missed)" : ")"));
+
+    // Registered on the gui thread, whose font cache it clears, then the pages are laid out again
+    QElapsedTimer font_timer;
+    font_timer.start();
+
+    tracing::Span span(tracing::Stage::FONT_LOAD);
+
+    if (QFontDatabase::addApplicationFont(kFontPath) == -1) {
+        COUT("Font not found: \"" + string(kFontPath) + "\"");
+        return;
+    }
+
+    for (QWidget *widget : QApplication::allWidgets()) {
+        widget->updateGeometry();
+        widget->update();
+    }
+
+    COUT("[INFO] Font loaded in " << font_timer.elapsed() << " ms");
 }
 
 std::vector<std::string> MainWindow::getSerialPortLists() {
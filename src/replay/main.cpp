@@ -0,0 +1,339 @@
+/**
+ * @file main.cpp
+ * @brief Replays a traffic recording of datc_daemon --record through DatcCommInterface.
+ * @details The recorded modbus transactions answer the bus (see traffic_replay.hpp) and the
+ * recorded client messages are sent again, over the same socket server, by one connection per
+ * recorded client. In real time the messages keep their recorded spacing and the bus its
+ * recorded latency; with --speed fast both happen as fast as the server takes them, which
+ * benchmarks the server against production traffic.
+ *
+ * Reports the replayed messages and commands, the command wait in the server, and whether the
+ * modbus writes of the replay match the recorded ones.
+ * @version 1.0
+ * @date 2024-04-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "datc_comm_interface.hpp"
+#include "traffic_replay.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef boost::asio::generic::stream_protocol StreamProtocol;
+
+struct ReplayConfig {
+    string path;
+    bool realtime  = true;
+    uint16_t port  = 18421;  /**< Used where Unix domain sockets are not available */
+    int slave      = -1;     /**< < 0: slave of the first recorded transaction */
+    double linger  = 1;      /**< Seconds the server gets for the last commands */
+    string json_path;
+};
+
+struct ReplayClient {
+    unique_ptr<StreamProtocol::socket> socket;
+    uint64_t bytes_sent     = 0;
+    uint64_t bytes_received = 0;
+};
+
+void printUsage() {
+    COUT("Usage: datc_replay --file FILE [options]\n"
+         "  --file FILE       Recording of datc_daemon --record\n"
+         "  --speed MODE      realtime (default) or fast\n"
+         "  --slave ADDR      Current slave of the replay (default: as recorded)\n"
+         "  --port PORT       TCP port of the replay server where Unix sockets are not available\n"
+         "  --linger SECONDS  Time for the last commands after the recording ends (default 1)\n"
+         "  --json FILE       Write the results as Json");
+}
+
+bool parseArguments(int argc, char **argv, ReplayConfig &config) {
+    for (int i = 1; i < argc; i++) {
+        const string option = argv[i];
+
+        if (option == "--help" || option == "-h") {
+            return false;
+        }
+
+        if (i + 1 >= argc) {
+            COUT("[Error] Missing value of " + option);
+            return false;
+        }
+
+        const string value = argv[++i];
+
+        try {
+            if      (option == "--file")   config.path      = value;
+            else if (option == "--slave")  config.slave     = stoi(value);
+            else if (option == "--port")   config.port      = stoi(value);
+            else if (option == "--linger") config.linger    = stod(value);
+            else if (option == "--json")   config.json_path = value;
+            else if (option == "--speed") {
+                if      (value == "realtime") config.realtime = true;
+                else if (value == "fast")     config.realtime = false;
+                else {
+                    COUT("[Error] Undefined speed: " + value);
+                    return false;
+                }
+            } else {
+                COUT("[Error] Undefined option: " + option);
+                return false;
+            }
+        } catch (const exception &) {
+            COUT("[Error] Invalid value of " + option + ": " + value);
+            return false;
+        }
+    }
+
+    if (config.path.empty()) {
+        COUT("[Error] --file is required");
+        return false;
+    }
+
+    return true;
+}
+
+// Reads whatever the server sent without blocking, so its client queue never fills up
+void drain(ReplayClient &client) {
+    char buffer[4096];
+    boost::system::error_code error;
+
+    while (client.socket->is_open()) {
+        size_t size = client.socket->read_some(boost::asio::buffer(buffer), error);
+
+        if (error) {
+            break;
+        }
+        client.bytes_received += size;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ReplayConfig config;
+
+    if (!parseArguments(argc, argv, config)) {
+        printUsage();
+        return 1;
+    }
+
+    traffic::TrafficLogReader reader;
+    vector<traffic::TrafficRecord> socket_records;
+    ReplayTransport transport(config.realtime);
+
+    if (!reader.open(config.path)) {
+        return 1;
+    }
+
+    traffic::TrafficRecord record;
+    uint64_t modbus_records = 0;
+    uint64_t t_last_us = 0;
+
+    while (reader.next(record)) {
+        t_last_us = record.t_us;
+
+        if (record.type == traffic::RecordType::MODBUS_READ || record.type == traffic::RecordType::MODBUS_WRITE) {
+            if (config.slave < 0) {
+                config.slave = record.slave;
+            }
+            transport.addRecord(record);
+            modbus_records++;
+        } else if (record.type != traffic::RecordType::TCP_OUT) {
+            socket_records.push_back(record);
+        }
+    }
+
+    if (reader.hasError()) {
+        COUT("The recording ends in a truncated record, replaying the records before it");
+    }
+
+    COUT("Replaying " << modbus_records << " modbus transactions and " << socket_records.size()
+         << " client records over " << fixed << setprecision(1) << t_last_us / 1e6 << " s");
+
+    DatcCommInterface datc_interface(argc, argv);
+
+    if (!datc_interface.init(&transport, (uint16_t) max(config.slave, 1))) {
+        return 1;
+    }
+
+    datc_interface.start();
+
+    boost::asio::io_service io_service;
+    StreamProtocol::endpoint endpoint;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    const string socket_path = "/tmp/datc_replay_" + to_string(getpid()) + ".sock";
+
+    if (!datc_interface.initLocalSocket(socket_path, 0600)) {
+        return 1;
+    }
+    endpoint = boost::asio::local::stream_protocol::endpoint(socket_path);
+#else
+    if (!datc_interface.initTcp("", config.port)) {
+        return 1;
+    }
+    endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), config.port);
+#endif
+
+    // Recorded socket -> replay connection, sockets are reused by the server after a close
+    unordered_map<uint32_t, ReplayClient> clients;
+    vector<ReplayClient> closing;
+    uint64_t messages = 0, connections = 0;
+
+    auto connectFn = [&] (ReplayClient &client) {
+        boost::system::error_code error;
+
+        client.socket.reset(new StreamProtocol::socket(io_service));
+        client.socket->connect(endpoint, error);
+
+        if (error) {
+            cout << "[Error] Replay connection failed: " << error.message() << endl;
+            client.socket.reset();
+            return false;
+        }
+
+        client.socket->non_blocking(true);
+        connections++;
+        return true;
+    };
+
+    const PerfStats perf_start = datc_interface.getPerfStats();
+    const auto time_start = Clock::now();
+
+    for (const traffic::TrafficRecord &socket_record : socket_records) {
+        if (config.realtime) {
+            std::this_thread::sleep_until(time_start + std::chrono::microseconds(socket_record.t_us));
+        }
+
+        ReplayClient &client = clients[socket_record.client];
+
+        if (socket_record.type == traffic::RecordType::TCP_CLOSE) {
+            // As fast as possible, the server gets until the end to answer
+            if (client.socket && !config.realtime) {
+                closing.push_back(move(client));
+                client = ReplayClient();
+            } else if (client.socket) {
+                drain(client);
+                client.socket->close();
+                client.socket.reset();
+            }
+            continue;
+        }
+
+        // A client connected before the recording started is connected on its first message
+        if (!client.socket && !connectFn(client)) {
+            continue;
+        }
+
+        if (socket_record.type == traffic::RecordType::TCP_IN) {
+            boost::system::error_code error;
+
+            client.socket->non_blocking(false);
+            boost::asio::write(*client.socket, boost::asio::buffer(socket_record.payload), error);
+            client.socket->non_blocking(true);
+
+            if (error) {
+                cout << "[Error] Replay write failed: " << error.message() << endl;
+                continue;
+            }
+
+            client.bytes_sent += socket_record.payload.size();
+            messages++;
+        }
+
+        drain(client);
+    }
+
+    for (auto &client : clients) {
+        closing.push_back(move(client.second));
+    }
+
+    // The last commands may still wait for the worker or the bus
+    const auto time_linger = Clock::now() + std::chrono::milliseconds((int) (config.linger * 1000));
+
+    while (Clock::now() < time_linger) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        for (ReplayClient &client : closing) {
+            if (client.socket) drain(client);
+        }
+    }
+
+    const double elapsed = std::chrono::duration<double>(Clock::now() - time_start).count() - config.linger;
+    const PerfStats perf = datc_interface.getPerfStats();
+    const ReplayTransportStats bus = transport.getStats();
+
+    uint64_t bytes_sent = 0, bytes_received = 0;
+
+    for (ReplayClient &client : closing) {
+        bytes_sent     += client.bytes_sent;
+        bytes_received += client.bytes_received;
+
+        if (client.socket) {
+            client.socket->close();
+        }
+    }
+
+    const LatencySnapshot command_wait = perf.command_wait - perf_start.command_wait;
+    const uint64_t commands = perf.commands - perf_start.commands;
+
+    Json::Value json;
+
+    json["recording"]["path"]     = config.path;
+    json["recording"]["duration"] = t_last_us / 1e6;
+    json["speed"]                 = config.realtime ? "realtime" : "fast";
+    json["duration"]              = elapsed;
+
+    json["clients"]["connections"]    = (Json::UInt64) connections;
+    json["clients"]["messages"]       = (Json::UInt64) messages;
+    json["clients"]["bytes_sent"]     = (Json::UInt64) bytes_sent;
+    json["clients"]["bytes_received"] = (Json::UInt64) bytes_received;
+
+    json["commands"]["executed"]    = (Json::UInt64) commands;
+    json["commands"]["throughput"]  = (elapsed > 0) ? commands / elapsed : 0;
+    json["commands"]["wait_p50_ms"] = command_wait.percentileUs(0.5) / 1000.0;
+    json["commands"]["wait_p99_ms"] = command_wait.percentileUs(0.99) / 1000.0;
+
+    json["modbus"]["reads"]             = (Json::UInt64) bus.reads;
+    json["modbus"]["reads_repeated"]    = (Json::UInt64) bus.reads_repeated;
+    json["modbus"]["reads_unanswered"]  = (Json::UInt64) bus.reads_unanswered;
+    json["modbus"]["writes_matched"]    = (Json::UInt64) bus.writes_matched;
+    json["modbus"]["writes_mismatched"] = (Json::UInt64) bus.writes_mismatched;
+    json["modbus"]["writes_unexpected"] = (Json::UInt64) bus.writes_unexpected;
+    json["modbus"]["writes_pending"]    = (Json::UInt64) bus.writes_pending;
+
+    cout << fixed << setprecision(1)
+         << "clients    " << connections << " connections, " << messages << " messages, "
+         << bytes_sent << " bytes sent, " << bytes_received << " bytes received" << endl
+         << "commands   " << commands << " executed in " << elapsed << " s, "
+         << json["commands"]["throughput"].asDouble() << " per s, wait p50 "
+         << json["commands"]["wait_p50_ms"].asDouble() << " p99 " << json["commands"]["wait_p99_ms"].asDouble() << " ms" << endl
+         << "modbus     reads " << bus.reads << " (" << bus.reads_repeated << " repeated, " << bus.reads_unanswered
+         << " unanswered), writes matched " << bus.writes_matched << ", mismatched " << bus.writes_mismatched
+         << ", unexpected " << bus.writes_unexpected << ", not replayed " << bus.writes_pending << endl;
+
+    if (!config.json_path.empty()) {
+        ofstream file(config.json_path);
+        Json::StyledWriter writer;
+
+        file << writer.write(json);
+
+        if (!file) {
+            COUT("[Error] Could not write " + config.json_path);
+            return 1;
+        }
+    }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    datc_interface.releaseLocalSocket();
+#endif
+
+    // The replayed commands reached the bus differently than in the recording
+    return (bus.writes_mismatched > 0 || bus.writes_unexpected > 0) ? 2 : 0;
+}
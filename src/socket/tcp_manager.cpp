@@ -5,15 +5,85 @@
 #include <iostream>
 #include <system_error>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
 
 TcpServer::TcpServer(const int port)
-        :acceptor_(io_service_, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)) {
-    startAccept();
+        :acceptor_(io_service_, StreamProtocol::endpoint(boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port))) {
+    startIoService();
+}
 
-//    boost::thread io_service_thread(boost::bind(&boost::asio::io_service::run, &io_service_));
-    std::thread io_service_thread([&] () {io_service_.run();});
-    io_service_thread.detach();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+TcpServer::TcpServer(const string &path, mode_t mode)
+        :acceptor_(io_service_) {
+    boost::system::error_code error;
+    const StreamProtocol::endpoint endpoint = boost::asio::local::stream_protocol::endpoint(path);
+
+    if (!removeStaleSocket(path, endpoint)) {
+        return;
+    }
+
+    // The file is created by bind with the permissions of the umask, other users must never
+    // see it more open than mode
+    acceptor_.open(endpoint.protocol(), error);
+    if (!error) {
+        const mode_t umask_prev = ::umask(~mode & 0777);
+        acceptor_.bind(endpoint, error);
+        ::umask(umask_prev);
+    }
+    if (!error) acceptor_.listen(boost::asio::socket_base::max_connections, error);
+
+    if (error) {
+        cout << "[Error] Unix socket " << path << ": " << error.message() << endl;
+        acceptor_.close(error);
+        return;
+    }
+
+    unix_path_ = path;
+
+    if (::chmod(path.c_str(), mode) != 0) {
+        cout << "[Error] Unix socket " << path << ": chmod failed, " << strerror(errno) << endl;
+        acceptor_.close(error);
+        ::unlink(path.c_str());
+        unix_path_.clear();
+        return;
+    }
+
+    startIoService();
+}
+
+bool TcpServer::removeStaleSocket(const string &path, const StreamProtocol::endpoint &endpoint) {
+    struct stat status;
+
+    if (::lstat(path.c_str(), &status) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        cout << "[Error] Unix socket " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    if (!S_ISSOCK(status.st_mode)) {
+        cout << "[Error] Unix socket " << path << ": exists and is not a socket" << endl;
+        return false;
+    }
+
+    // Only a socket nobody listens on any more is left by a previous run
+    boost::system::error_code error;
+    StreamProtocol::socket probe(io_service_);
+    probe.connect(endpoint, error);
+
+    if (error != boost::asio::error::connection_refused) {
+        cout << "[Error] Unix socket " << path << ": "
+             << (error ? error.message() : string("another server is listening")) << endl;
+        return false;
+    }
+
+    ::unlink(path.c_str());
+    return true;
 }
+#endif
 
 TcpServer::~TcpServer() {
     acceptor_.close();
@@ -23,9 +93,24 @@ TcpServer::~TcpServer() {
         usleep(1000);
     }
 
+    if (!unix_path_.empty()) {
+        ::unlink(unix_path_.c_str());
+    }
+
     usleep(1000000);
 }
 
+void TcpServer::startIoService() {
+    startAccept();
+
+//    boost::thread io_service_thread(boost::bind(&boost::asio::io_service::run, &io_service_));
+    std::thread io_service_thread([&] () {
+        tracing::setThreadName("socket_io");
+        io_service_.run();
+    });
+    io_service_thread.detach();
+}
+
 void TcpServer::startAccept() {
     TcpSocket *socket = new TcpSocket(io_service_);
 //    acceptor_.async_accept(socket->getSocket(), boost::bind(&TcpServer::acceptHandler, this, socket, boost::asio::placeholders::error));
@@ -45,7 +130,7 @@ void TcpServer::acceptHandler(TcpSocket* socket, const boost::system::error_code
 }
 
 TcpSocket::TcpSocket(boost::asio::io_service &io_service)
-    :message_handler_(MessageManager<Json::Value>::getInstance()), socket_(io_service) {
+    :message_handler_(DatcMessageManager::getInstance()), socket_(io_service) {
 
 }
 
@@ -53,23 +138,42 @@ TcpSocket::~TcpSocket() {
     close();
 }
 
-boost::asio::ip::tcp::socket &TcpSocket::getSocket() {
+StreamProtocol::socket &TcpSocket::getSocket() {
     return socket_;
 }
 
 void TcpSocket::start() {
+    if (traffic::isRecording()) {
+        traffic::recordTcp(traffic::RecordType::TCP_OPEN, socket_.native_handle());
+    }
+
     message_handler_.createClientQueue(socket_.native_handle());
 //    boost::thread parse_thread(boost::bind(&TcpSocket::writeHandler, this));
     std::thread parse_thread(std::bind(&TcpSocket::writeHandler, this));
     parse_thread.detach();
+    startRead();
+}
+
+void TcpSocket::startRead() {
+    // A message larger than the receive buffer can never be framed, so the stream is resynchronized
+    if (recevied_.writeSpace() == 0) {
+        cout << "Receive buffer overflow, discarding " << recevied_.size() << " bytes" << endl;
+        recevied_.clear();
+        framer_.reset();
+    }
+
 //    socket_.async_read_some(boost::asio::buffer(buffer_, MAX_BUFFER), boost::bind(&TcpSocket::readHandler, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
-    socket_.async_read_some(boost::asio::buffer(buffer_, MAX_BUFFER), std::bind(&TcpSocket::readHandler, this, std::placeholders::_1, std::placeholders::_2));
+    socket_.async_read_some(boost::asio::buffer(recevied_.writePtr(), recevied_.writeSpace()),
+                            std::bind(&TcpSocket::readHandler, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 void TcpSocket::close() {
     try {
         message_handler_.deleteClientQueue(socket_.native_handle());
         if (socket_.is_open()) {
+            if (traffic::isRecording()) {
+                traffic::recordTcp(traffic::RecordType::TCP_CLOSE, socket_.native_handle());
+            }
             socket_.close();
         }
     } catch (boost::system::system_error const& e) {
@@ -78,71 +182,342 @@ void TcpSocket::close() {
 }
 
 void TcpSocket::writeHandler() {
+    tracing::setThreadName("client_writer");
+
     while (socket_.is_open()) {
-        Json::Value json;
+        Frame frame;
 
-        if (message_handler_.tryPopFromClientQueue(socket_.native_handle(), json)) {
-            Json::FastWriter writer;
-            string data = writer.write(json);
+        if (message_handler_.isClientLagging(socket_.native_handle())) {
             boost::system::error_code error;
+            cout << "Client lagging behind, disconnecting" << endl;
+            socket_.shutdown(StreamProtocol::socket::shutdown_both, error);
+            close();
+            break;
+        }
 
-            boost::asio::write(socket_, boost::asio::buffer(data, data.size()), error);
-            // boost::asio::write(socket_, boost::asio::buffer(data, 2048), error);
+        // Sleeps until the first frame, then writes every frame that is ready without waiting again
+        if (!message_handler_.tryPopFromClientQueue(socket_.native_handle(), frame, kWriteWait)) {
+            continue;
+        }
 
-            if (error) {
-                cout << "Write error: " << error.message() << endl;
-                socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
-                close();
+        do {
+            if (!writeFrame(frame)) {
+                break;
             }
-        }
-        usleep(1000);
+        } while (socket_.is_open() && message_handler_.tryPopFromClientQueue(socket_.native_handle(), frame));
     }
 }
 
+bool TcpSocket::writeFrame(const Frame &frame) {
+    boost::system::error_code error;
+    tracing::Span span(tracing::Stage::SOCKET_WRITE, 0, frame.get());
+
+    if (traffic::isRecording()) {
+        traffic::recordTcp(traffic::RecordType::TCP_OUT, socket_.native_handle(), frame->data(), frame->size());
+    }
+
+    if (write_framing_ == FramingMode::LENGTH_PREFIXED) {
+        char prefix[MessageFramer::LENGTH_PREFIX_SIZE];
+        MessageFramer::writeLengthPrefix(frame->size(), prefix);
+
+        const array<boost::asio::const_buffer, 2> buffers = {
+            boost::asio::buffer(prefix, MessageFramer::LENGTH_PREFIX_SIZE),
+            boost::asio::buffer(*frame)
+        };
+        boost::asio::write(socket_, buffers, error);
+    } else {
+        boost::asio::write(socket_, boost::asio::buffer(*frame), error);
+    }
+
+    if (error) {
+        cout << "Write error: " << error.message() << endl;
+        socket_.shutdown(StreamProtocol::socket::shutdown_both, error);
+        close();
+        return false;
+    }
+
+    return true;
+}
+
 void TcpSocket::readHandler(const boost::system::error_code& err, size_t bytes_transferred) {
     if (!err) {
-        recevied_ += string(buffer_, buffer_ + bytes_transferred);
+        if (traffic::isRecording()) {
+            traffic::recordTcp(traffic::RecordType::TCP_IN, socket_.native_handle(), recevied_.writePtr(), bytes_transferred);
+        }
 
-        Json::Value json;
-        while (parseJsonFromBuffer(json)) {
-            Json::FastWriter writer;
-            string data = writer.write(json);
+        recevied_.commit(bytes_transferred);
 
-            message_handler_.pushToWorkerQueue(json);
+        const char *begin, *end;
+        while (framer_.next(recevied_, begin, end)) {
+            if (framer_.getMode() == FramingMode::BINARY) {
+                handleBinaryMessage(begin, end);
+            } else {
+                handleJsonMessage(begin, end);
+            }
         }
 
-        usleep(1000);
-//        socket_.async_read_some(boost::asio::buffer(buffer_, MAX_BUFFER), boost::bind(&TcpSocket::readHandler, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
-        socket_.async_read_some(boost::asio::buffer(buffer_, MAX_BUFFER), std::bind(&TcpSocket::readHandler, this, std::placeholders::_1, std::placeholders::_2));
+        if (size_t skipped = framer_.takeSkipped()) {
+            cout << "[Error] Discarded " << skipped << " bytes outside of a Json object" << endl;
+        }
+
+        if (framer_.hasError()) {
+            boost::system::error_code error;
+            cout << "Read error: invalid message frame" << endl;
+            socket_.shutdown(StreamProtocol::socket::shutdown_both, error);
+            close();
+            return;
+        }
+
+        startRead();
     } else {
         boost::system::error_code error_temp = err;
         cout << "Read error: " << err.message() << endl;
-        socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error_temp);
+        socket_.shutdown(StreamProtocol::socket::shutdown_both, error_temp);
         close();
     }
 }
 
-bool TcpSocket::parseJsonFromBuffer(Json::Value &json) {
-    string json_str;
-    size_t index = recevied_.find('{');
-    if (index == string::npos) {
-        recevied_.clear();
-        return false;
+void TcpSocket::handleJsonMessage(const char *begin, const char *end) {
+    Json::Value json;
+
+    if (!reader_.parse(begin, end, json, false)) {
+        cout << "[Error] Invalid json message: " << reader_.getFormattedErrorMessages();
+        return;
     }
-    recevied_.erase(0, index);
 
-    index = recevied_.find('}');
-    if (index == string::npos) {
-        return false;
+    // Session settings are applied here, everything else is a command for the worker
+    if (json.isMember("queue_policy")) {
+        setQueuePolicy(json);
+        return;
+    } else if (json.isMember("framing")) {
+        setFraming(json);
+        return;
+    } else if (json.isMember("protocol")) {
+        setProtocol(json);
+        return;
+    } else if (json.isMember("subscribe")) {
+        setSubscription(json["subscribe"]);
+        return;
     }
 
-    json_str = recevied_.substr(0, index + 1);
-    recevied_.erase(0, index + 1);
+    CommandRequest request;
 
-    Json::Reader reader;
-    if (!reader.parse(json_str, json)) {
-        return false;
+    if (json_protocol::decodeCommand(json, request)) {
+        pushRequest(request);
+    } else {
+        cout << "[Error] Invalid command message" << endl;
+
+        // A client that sent an id waits for an ack, it gets a nack with the id if that was valid
+        if (json.isMember("id")) {
+            CommandAck ack;
+            ack.id        = json["id"].isUInt() ? json["id"].asUInt() : 0;
+            ack.error     = CommandError::MALFORMED;
+            ack.t_recv_us = ack.t_dequeue_us = ack.t_done_us = monotonicMicros();
+
+            auto nack = make_shared<string>();
+            json_protocol::encodeAck(ack, *nack);
+            message_handler_.pushReliableToClientQueue(socket_.native_handle(), nack);
+        }
     }
+}
 
-    return true;
+void TcpSocket::handleBinaryMessage(const char *begin, const char *end) {
+    CommandRequest request;
+
+    if (binary_protocol::decodeCommand(begin, end, request)) {
+        pushRequest(request);
+    } else {
+        cout << "[Error] Unsupported binary frame" << endl;
+    }
+}
+
+void TcpSocket::pushRequest(CommandRequest &request) {
+    request.client    = socket_.native_handle();
+    request.t_recv_us = monotonicMicros();
+
+    if (tracing::isEnabled()) {
+        request.trace_id = tracing::nextId();
+        tracing::record(tracing::Stage::SOCKET_READ, tracing::Phase::INSTANT, request.trace_id);
+        tracing::record(tracing::Stage::WORKER_QUEUE, tracing::Phase::ASYNC_BEGIN, request.trace_id);
+    }
+
+    message_handler_.pushToWorkerQueue(request);
+}
+
+void TcpSocket::setQueuePolicy(const Json::Value &json) {
+    ClientQueueConfig config = message_handler_.getDefaultClientQueueConfig();
+
+    if (!json["queue_policy"].isString()) {
+        cout << "[Error] \"queue_policy\" must be a string" << endl;
+        return;
+    }
+
+    const string policy = json["queue_policy"].asString();
+
+    if (policy == "drop_oldest") {
+        config.policy = QueuePolicy::DROP_OLDEST;
+    } else if (policy == "keep_latest") {
+        config.policy = QueuePolicy::KEEP_LATEST;
+    } else if (policy == "disconnect_on_lag") {
+        config.policy = QueuePolicy::DISCONNECT_ON_LAG;
+    } else {
+        cout << "[Error] Undefined queue policy: " << policy << endl;
+        return;
+    }
+
+    if (json.isMember("queue_size")) {
+        const Json::Value &size = json["queue_size"];
+
+        if (!size.isUInt() || size.asUInt() == 0 || size.asUInt() > kMaxClientQueueCapacity) {
+            cout << "[Error] \"queue_size\" must be 1 to " << kMaxClientQueueCapacity << endl;
+            return;
+        }
+        config.capacity = size.asUInt();
+    }
+
+    message_handler_.setClientQueueConfig(socket_.native_handle(), config);
+}
+
+void TcpSocket::setFraming(const Json::Value &json) {
+    if (!json["framing"].isString()) {
+        cout << "[Error] \"framing\" must be a string" << endl;
+        return;
+    }
+
+    const string framing = json["framing"].asString();
+    FramingMode mode;
+
+    if (framing == "newline") {
+        mode = FramingMode::JSON_OBJECTS;
+    } else if (framing == "length_prefixed") {
+        mode = FramingMode::LENGTH_PREFIXED;
+    } else {
+        cout << "[Error] Undefined framing: " << framing << endl;
+        return;
+    }
+
+    // Applies to every message after this one, in both directions
+    framer_.setMode(mode);
+    write_framing_ = mode;
+}
+
+void TcpSocket::setProtocol(const Json::Value &json) {
+    if (!json["protocol"].isString()) {
+        cout << "[Error] \"protocol\" must be a string" << endl;
+        return;
+    }
+
+    const string protocol = json["protocol"].asString();
+
+    if (protocol != "binary") {
+        cout << "[Error] Undefined protocol: " << protocol << endl;
+        return;
+    }
+
+    const Json::Value &version = json["version"];
+
+    if (json.isMember("version") && (!version.isUInt() || version.asUInt() != binary_protocol::VERSION)) {
+        cout << "[Error] Unsupported binary protocol version: " << version.toStyledString();
+        return;
+    }
+
+    // Binary frames are self-delimiting, in both directions
+    framer_.setMode(FramingMode::BINARY);
+    write_framing_ = FramingMode::BINARY;
+
+    StreamConfig stream;
+    message_handler_.getClientStream(socket_.native_handle(), stream);
+    stream.format = WireFormat::BINARY;
+
+    // The hello frame tells the client that every following frame is binary
+    auto hello = make_shared<string>();
+    binary_protocol::encodeHello(*hello);
+    message_handler_.setClientStream(socket_.native_handle(), stream, hello);
+}
+
+void TcpSocket::setSubscription(const Json::Value &json) {
+    // A bad member rejects the whole subscription, the stream stays as it was
+    auto rejectFn([] (const string &reason) {
+        cout << "[Error] Invalid subscription: " << reason << endl;
+    });
+
+    if (!json.isObject()) {
+        rejectFn("\"subscribe\" must be an object");
+        return;
+    }
+
+    StreamConfig stream;
+    message_handler_.getClientStream(socket_.native_handle(), stream);
+
+    if (json.isMember("fields")) {
+        if (!json["fields"].isArray()) {
+            rejectFn("\"fields\" must be an array");
+            return;
+        }
+
+        uint16_t fields = 0;
+
+        for (const Json::Value &field : json["fields"]) {
+            if (!field.isString()) {
+                rejectFn("status fields must be strings");
+                return;
+            }
+
+            auto name = find(begin(STATUS_FIELD_NAMES), end(STATUS_FIELD_NAMES), field.asString());
+
+            if (name == end(STATUS_FIELD_NAMES)) {
+                rejectFn("undefined status field " + field.asString());
+                return;
+            }
+            fields |= 1 << (name - begin(STATUS_FIELD_NAMES));
+        }
+
+        stream.fields = fields;
+    }
+
+    if (json.isMember("rate")) {
+        if (!json["rate"].isNumeric()) {
+            rejectFn("\"rate\" must be a number");
+            return;
+        }
+
+        double rate = json["rate"].asDouble();
+        stream.period_us = (rate > 0) ? (uint32_t) (1e6 / rate) : 0;
+    }
+
+    if (json.isMember("slaves")) {
+        if (!json["slaves"].isArray()) {
+            rejectFn("\"slaves\" must be an array");
+            return;
+        }
+
+        stream.slaves.clear();
+
+        for (const Json::Value &slave : json["slaves"]) {
+            if (!slave.isUInt() || slave.asUInt() > kMaxSlaveAddr) {
+                rejectFn("slaves must be modbus addresses 0 to " + to_string(kMaxSlaveAddr));
+                return;
+            }
+            stream.slaves.push_back(slave.asUInt());
+        }
+        sort(stream.slaves.begin(), stream.slaves.end());
+    }
+
+    if (json.isMember("delta")) {
+        if (!json["delta"].isBool()) {
+            rejectFn("\"delta\" must be true or false");
+            return;
+        }
+        stream.delta = json["delta"].asBool();
+    }
+
+    if (json.isMember("keyframe_interval")) {
+        if (!json["keyframe_interval"].isUInt()) {
+            rejectFn("\"keyframe_interval\" must be a positive integer");
+            return;
+        }
+        stream.keyframe_interval = (uint16_t) min(max(json["keyframe_interval"].asUInt(), 1u), 65535u);
+    }
+
+    message_handler_.setClientStream(socket_.native_handle(), stream);
 }
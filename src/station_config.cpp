@@ -0,0 +1,243 @@
+/**
+ * @file station_config.cpp
+ * @brief Station files and the parallel bring-up of a station.
+ * @version 1.0
+ * @date 2024-04-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "station_config.hpp"
+#include <fstream>
+#include <future>
+
+namespace {
+
+void parseBus(const Json::Value &json, BusConfig &bus) {
+    bus.device   = json.get("device", bus.device).asString();
+    bus.baudrate = json.get("baudrate", bus.baudrate).asInt();
+    bus.slave    = json.get("slave", bus.slave).asUInt();
+
+    if (json.isMember("poll_slaves")) {
+        bus.poll_slaves.clear();
+
+        for (const Json::Value &slave : json["poll_slaves"]) {
+            bus.poll_slaves.push_back(slave.asUInt());
+        }
+    }
+}
+
+void parseTelemetry(const Json::Value &json, StationConfig &config) {
+    config.telemetry_dir        = json.get("dir", config.telemetry_dir).asString();
+    config.telemetry_segment_mb = json.get("segment_mb", (Json::UInt64) config.telemetry_segment_mb).asUInt64();
+    config.telemetry_segments   = json.get("segments", (Json::UInt64) config.telemetry_segments).asUInt64();
+    config.telemetry_compress   = json.get("compress", config.telemetry_compress).asBool();
+}
+
+double elapsedMs(uint64_t t_from_us, uint64_t t_to_us) {
+    return (t_to_us - t_from_us) / 1000.0;
+}
+
+} // namespace
+
+bool parseStationConfig(const Json::Value &json, StationConfig &config) {
+    if (!json.isObject()) {
+        return false;
+    }
+
+    if (json["buses"].isArray()) {
+        config.buses.clear();
+
+        for (const Json::Value &bus_json : json["buses"]) {
+            BusConfig bus;
+            parseBus(bus_json, bus);
+            config.buses.push_back(bus);
+        }
+    }
+
+    // Flat keys of datc_daemon files
+    for (const char *key : {"device", "baudrate", "slave", "poll_slaves"}) {
+        if (json.isMember(key)) {
+            if (config.buses.empty()) {
+                config.buses.push_back(BusConfig());
+            }
+            parseBus(json, config.buses[0]);
+            break;
+        }
+    }
+
+    const Json::Value &tcp = json["tcp"];
+
+    if (tcp.isObject()) {
+        config.tcp_port        = tcp.get("port", config.tcp_port).asInt();
+        config.tcp_send_status = tcp.get("send_status", config.tcp_send_status).asBool();
+    }
+    config.tcp_port = json.get("tcp_port", config.tcp_port).asInt();
+
+    const Json::Value &udp = json["udp"];
+
+    if (udp.isObject()) {
+        config.udp_group = udp.get("group", config.udp_group).asString();
+        config.udp_port  = udp.get("port", config.udp_port).asUInt();
+    }
+    config.udp_group = json.get("udp_group", config.udp_group).asString();
+    config.udp_port  = json.get("udp_port", config.udp_port).asUInt();
+
+    config.unix_socket = json.get("unix_socket", config.unix_socket).asString();
+    config.shm_name    = json.get("shm", config.shm_name).asString();
+
+    const Json::Value &telemetry = json["telemetry"];
+
+    if (telemetry.isObject()) {
+        parseTelemetry(telemetry, config);
+    } else if (telemetry.isString()) {
+        config.telemetry_dir = telemetry.asString();
+    }
+    config.telemetry_segment_mb = json.get("telemetry_segment_mb", (Json::UInt64) config.telemetry_segment_mb).asUInt64();
+    config.telemetry_segments   = json.get("telemetry_segments", (Json::UInt64) config.telemetry_segments).asUInt64();
+    config.telemetry_compress   = json.get("telemetry_compress", config.telemetry_compress).asBool();
+
+    config.first_status_timeout_ms = json.get("first_status_timeout_ms", config.first_status_timeout_ms).asInt();
+
+    return true;
+}
+
+bool loadStationConfig(const string &path, StationConfig &config) {
+    ifstream file(path);
+    Json::Value json;
+    Json::Reader reader;
+
+    if (!file || !reader.parse(file, json) || !parseStationConfig(json, config)) {
+        COUT("[Error] Invalid config file: " + path);
+        return false;
+    }
+
+    return true;
+}
+
+bool startStation(DatcCommInterface &datc_interface, const StationConfig &config, StartupReport &report,
+                  ModbusTransport *transport) {
+    const uint64_t t_start_us = monotonicMicros();
+
+    report = StartupReport();
+
+    if (config.buses.size() > 1) {
+        COUT("[INFO] " << config.buses.size() << " buses configured, this process drives only "
+             << config.buses[0].device);
+    }
+
+    // The poll loop waits for the bus, so it runs before anything is open
+    datc_interface.start();
+    datc_interface.setTcpSendStatus(config.tcp_send_status);
+
+    const BusConfig bus = config.buses.empty() ? BusConfig() : config.buses[0];
+    datc_interface.setPollSlaves(bus.poll_slaves);
+
+    auto openBusFn([&] () {
+        const bool is_open = (transport != nullptr) ? datc_interface.init(transport, bus.slave)
+                                                    : datc_interface.init(bus.device.c_str(), bus.slave, bus.baudrate);
+        report.bus_ms = elapsedMs(t_start_us, monotonicMicros());
+        return is_open;
+    });
+
+    // Every endpoint has its own lock in the interface, none waits for another
+    struct Endpoint {
+        string name;
+        future<bool> is_open;
+        function<void ()> release;
+    };
+    vector<Endpoint> endpoints;
+
+    auto openFn([&endpoints] (const string &name, function<bool ()> open, function<void ()> release) {
+        endpoints.push_back({name, async(launch::async, open), release});
+    });
+
+    if (config.tcp_port > 0) {
+        openFn("tcp", [&] () {return datc_interface.initTcp("", config.tcp_port);},
+               [&] () {datc_interface.releaseTcp();});
+    }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (!config.unix_socket.empty()) {
+        openFn("unix_socket", [&] () {return datc_interface.initLocalSocket(config.unix_socket);},
+               [&] () {datc_interface.releaseLocalSocket();});
+    }
+#endif
+
+    if (!config.udp_group.empty()) {
+        openFn("udp", [&] () {return datc_interface.initUdp(config.udp_group, config.udp_port);},
+               [&] () {datc_interface.releaseUdp();});
+    }
+
+#ifndef _WIN32
+    if (!config.shm_name.empty()) {
+        openFn("shm", [&] () {return datc_interface.initShm(config.shm_name);},
+               [&] () {datc_interface.releaseShm();});
+    }
+
+    if (!config.telemetry_dir.empty()) {
+        openFn("telemetry", [&] () {
+            telemetry::TelemetryConfig telemetry_config;
+
+            telemetry_config.segment_bytes = max<size_t>(config.telemetry_segment_mb, 1) * 1024 * 1024;
+            telemetry_config.max_segments  = config.telemetry_segments;
+            telemetry_config.compress      = config.telemetry_compress;
+
+            return datc_interface.initTelemetry(config.telemetry_dir, telemetry_config);
+        }, [&] () {datc_interface.releaseTelemetry();});
+    }
+#endif
+
+    // The bus on this thread, the endpoints meanwhile on theirs
+    report.is_bus_open = openBusFn();
+
+    vector<bool> is_endpoint_open;
+
+    for (Endpoint &endpoint : endpoints) {
+        is_endpoint_open.push_back(endpoint.is_open.get());
+
+        if (!is_endpoint_open.back()) {
+            report.failed.push_back(endpoint.name);
+        }
+    }
+
+    report.ready_ms = elapsedMs(t_start_us, monotonicMicros());
+
+    if (!report.is_bus_open) {
+        COUT("[Error] Modbus connection to " + ((transport != nullptr) ? string("custom transport") : bus.device)
+             + " failed");
+    }
+
+    for (const string &name : report.failed) {
+        COUT("[Error] Could not open " + name);
+    }
+
+    // Nothing is left half open, a retry starts from scratch
+    if (!report.is_bus_open || !report.failed.empty()) {
+        for (size_t i = 0; i < endpoints.size(); i++) {
+            if (is_endpoint_open[i]) {
+                endpoints[i].release();
+            }
+        }
+
+        if (report.is_bus_open) {
+            datc_interface.modbusRelease();
+        }
+        return false;
+    }
+
+    // The first read follows within a poll cycle unless the slave does not answer
+    const uint64_t t_deadline_us = t_start_us + (uint64_t) max(config.first_status_timeout_ms, 0) * 1000;
+
+    while (datc_interface.getFirstStatusTime() == 0 && monotonicMicros() < t_deadline_us) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const uint64_t t_first_status_us = datc_interface.getFirstStatusTime();
+
+    if (t_first_status_us != 0) {
+        report.first_status_ms = elapsedMs(t_start_us, max(t_first_status_us, t_start_us));
+    }
+
+    return true;
+}
@@ -0,0 +1,421 @@
+/**
+ * @file telemetry_codec.cpp
+ * @brief Column coding of telemetry blocks and the archive writer.
+ * @version 1.0
+ * @date 2024-04-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "telemetry_codec.hpp"
+#include "telemetry_store.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+
+namespace telemetry {
+
+namespace {
+
+void putU16(char *out, uint16_t value) {
+    out[0] = (char) (value & 0xFF);
+    out[1] = (char) (value >> 8);
+}
+
+void putU32(char *out, uint32_t value) {
+    putU16(out, value & 0xFFFF);
+    putU16(out + 2, value >> 16);
+}
+
+void putU64(char *out, uint64_t value) {
+    putU32(out, value & 0xFFFFFFFF);
+    putU32(out + 4, value >> 32);
+}
+
+uint16_t getU16(const char *in) {
+    return (uint16_t) ((uint8_t) in[0] | ((uint8_t) in[1] << 8));
+}
+
+uint32_t getU32(const char *in) {
+    return getU16(in) | ((uint32_t) getU16(in + 2) << 16);
+}
+
+uint64_t getU64(const char *in) {
+    return getU32(in) | ((uint64_t) getU32(in + 4) << 32);
+}
+
+inline uint64_t zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+inline size_t varintSize(uint64_t value) {
+    size_t size = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+inline void putVarint(string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char) value);
+}
+
+inline bool getVarint(const char *&in, const char *end, uint64_t &value) {
+    value = 0;
+
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        const uint8_t byte = (uint8_t) *in++;
+
+        value |= (uint64_t) (byte & 0x7F) << shift;
+
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Column values of the samples, registers as registerValue()
+void columnValues(const TelemetrySample *samples, size_t count, size_t column, int64_t *values) {
+    for (size_t i = 0; i < count; i++) {
+        if (column == 0) {
+            values[i] = (int64_t) samples[i].t_us;
+        } else if (column == 1) {
+            values[i] = samples[i].sequence;
+        } else {
+            values[i] = registerValue(samples[i], column - 2);
+        }
+    }
+}
+
+void encodeColumn(const int64_t *values, size_t count, string &out) {
+    // Sizes of the encodings of the differences, the first value is stored the same by all
+    size_t size_varint = 0, size_rle = 0, size_delta2 = 0;
+
+    for (size_t i = 1; i < count;) {
+        const int64_t delta = values[i] - values[i - 1];
+        const int64_t delta_last = (i > 1) ? values[i - 1] - values[i - 2] : 0;
+        size_t run = 1;
+
+        while (i + run < count && values[i + run] - values[i + run - 1] == delta) {
+            run++;
+        }
+
+        // Within a run the second differences are 0, one byte each
+        size_varint += varintSize(zigzag(delta)) * run;
+        size_rle    += varintSize(zigzag(delta)) + varintSize(run);
+        size_delta2 += varintSize(zigzag(delta - delta_last)) + (run - 1);
+        i += run;
+    }
+
+    ColumnEncoding encoding = ColumnEncoding::DELTA_VARINT;
+
+    if (size_rle < size_varint && size_rle <= size_delta2) {
+        encoding = ColumnEncoding::DELTA_RLE;
+    } else if (size_delta2 < size_varint) {
+        encoding = ColumnEncoding::DELTA_DELTA_VARINT;
+    }
+
+    out.push_back((char) encoding);
+    putVarint(out, zigzag(values[0]));
+
+    for (size_t i = 1; i < count;) {
+        const int64_t delta = values[i] - values[i - 1];
+
+        if (encoding == ColumnEncoding::DELTA_VARINT) {
+            putVarint(out, zigzag(delta));
+            i++;
+            continue;
+        }
+
+        if (encoding == ColumnEncoding::DELTA_DELTA_VARINT) {
+            putVarint(out, zigzag(delta - ((i > 1) ? values[i - 1] - values[i - 2] : 0)));
+            i++;
+            continue;
+        }
+
+        size_t run = 1;
+
+        while (i + run < count && values[i + run] - values[i + run - 1] == delta) {
+            run++;
+        }
+
+        putVarint(out, zigzag(delta));
+        putVarint(out, run);
+        i += run;
+    }
+}
+
+bool decodeColumn(const char *&in, const char *end, size_t count, int64_t *values) {
+    uint64_t value;
+
+    if (in >= end) {
+        return false;
+    }
+
+    const ColumnEncoding encoding = (ColumnEncoding) *in++;
+
+    if (!getVarint(in, end, value)) {
+        return false;
+    }
+
+    values[0] = unzigzag(value);
+
+    int64_t delta_last = 0;
+
+    for (size_t i = 1; i < count;) {
+        uint64_t delta, run = 1;
+
+        if (!getVarint(in, end, delta)) {
+            return false;
+        }
+
+        if (encoding == ColumnEncoding::DELTA_DELTA_VARINT) {
+            delta_last += unzigzag(delta);
+            values[i] = values[i - 1] + delta_last;
+            i++;
+            continue;
+        }
+
+        if (encoding == ColumnEncoding::DELTA_RLE) {
+            if (!getVarint(in, end, run) || run == 0 || run > count - i) {
+                return false;
+            }
+        } else if (encoding != ColumnEncoding::DELTA_VARINT) {
+            return false;
+        }
+
+        for (const size_t run_end = i + run; i < run_end; i++) {
+            values[i] = values[i - 1] + unzigzag(delta);
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+void encodeBlock(const TelemetrySample *samples, size_t count, string &out, BlockIndex *index_out) {
+    BlockIndex index;
+
+    count = min(count, kBlockSamples);
+
+    index.slave          = samples[0].slave;
+    index.count          = (uint16_t) count;
+    index.t_first_us     = samples[0].t_us;
+    index.t_last_us      = samples[count - 1].t_us;
+    index.sequence_first = samples[0].sequence;
+    index.states_all     = 0xFFFF;
+
+    for (size_t reg = 0; reg < TELEMETRY_REGISTERS; reg++) {
+        index.min[reg] = index.max[reg] = registerValue(samples[0], reg);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        index.states_any |= samples[i].registers[0];
+        index.states_all &= samples[i].registers[0];
+
+        for (size_t reg = 0; reg < TELEMETRY_REGISTERS; reg++) {
+            const int32_t value = registerValue(samples[i], reg);
+
+            index.min[reg] = min(index.min[reg], value);
+            index.max[reg] = max(index.max[reg], value);
+        }
+    }
+
+    // The index is written once the size of the columns is known
+    const size_t index_offset = out.size();
+    out.resize(index_offset + BLOCK_INDEX_SIZE);
+
+    int64_t values[kBlockSamples];
+
+    for (size_t column = 0; column < BLOCK_COLUMNS; column++) {
+        columnValues(samples, count, column, values);
+        encodeColumn(values, count, out);
+    }
+
+    index.size = (uint32_t) (out.size() - index_offset - BLOCK_INDEX_SIZE);
+
+    char *header = &out[index_offset];
+
+    putU16(header + 0,  index.slave);
+    putU16(header + 2,  index.count);
+    putU32(header + 4,  index.size);
+    putU64(header + 8,  index.t_first_us);
+    putU64(header + 16, index.t_last_us);
+    putU32(header + 24, index.sequence_first);
+    putU16(header + 28, index.states_any);
+    putU16(header + 30, index.states_all);
+
+    for (size_t reg = 0; reg < TELEMETRY_REGISTERS; reg++) {
+        putU16(header + 32 + 2 * reg, (uint16_t) index.min[reg]);
+        putU16(header + 48 + 2 * reg, (uint16_t) index.max[reg]);
+    }
+
+    if (index_out != nullptr) {
+        *index_out = index;
+    }
+}
+
+bool readBlockIndex(const char *data, size_t size, BlockIndex &index) {
+    if (size < BLOCK_INDEX_SIZE) {
+        return false;
+    }
+
+    index.slave          = getU16(data + 0);
+    index.count          = getU16(data + 2);
+    index.size           = getU32(data + 4);
+    index.t_first_us     = getU64(data + 8);
+    index.t_last_us      = getU64(data + 16);
+    index.sequence_first = getU32(data + 24);
+    index.states_any     = getU16(data + 28);
+    index.states_all     = getU16(data + 30);
+
+    for (size_t reg = 0; reg < TELEMETRY_REGISTERS; reg++) {
+        const uint16_t min = getU16(data + 32 + 2 * reg), max = getU16(data + 48 + 2 * reg);
+
+        index.min[reg] = isSignedRegister(reg) ? (int16_t) min : min;
+        index.max[reg] = isSignedRegister(reg) ? (int16_t) max : max;
+    }
+
+    return index.count > 0 && index.count <= kBlockSamples && index.size <= size - BLOCK_INDEX_SIZE;
+}
+
+bool decodeBlock(const BlockIndex &index, const char *columns, vector<TelemetrySample> &samples) {
+    const size_t count = index.count, first = samples.size();
+    const char *in = columns, *end = columns + index.size;
+    int64_t values[kBlockSamples];
+
+    samples.resize(first + count);
+    TelemetrySample *out = &samples[first];
+
+    for (size_t column = 0; column < BLOCK_COLUMNS; column++) {
+        if (!decodeColumn(in, end, count, values)) {
+            samples.resize(first);
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (column == 0) {
+                out[i].t_us = (uint64_t) values[i];
+            } else if (column == 1) {
+                out[i].sequence = (uint32_t) values[i];
+            } else {
+                out[i].registers[column - 2] = (uint16_t) values[i];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        out[i].slave = index.slave;
+    }
+
+    return true;
+}
+
+bool ArchiveWriter::open(const string &path, uint64_t sequence) {
+    close();
+
+    file_ = fopen(path.c_str(), "wb");
+
+    if (file_ == nullptr) {
+        cout << "[Error] Telemetry archive " << path << " could not be created: " << strerror(errno) << endl;
+        return false;
+    }
+
+    char header[ARCHIVE_HEADER_SIZE] = {};
+
+    memcpy(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    putU32(header + 8, ARCHIVE_VERSION);
+    putU64(header + 16, sequence);
+
+    error_ = fwrite(header, sizeof(header), 1, file_) != 1;
+    bytes_ = sizeof(header);
+    pending_.assign(kTelemetrySlaves, vector<TelemetrySample>());
+
+    return !error_;
+}
+
+void ArchiveWriter::append(const TelemetrySample &sample) {
+    vector<TelemetrySample> &pending = pending_[min<size_t>(sample.slave, kTelemetrySlaves - 1)];
+
+    // A slave beyond the table shares the last one, a block holds one slave
+    if (!pending.empty() && pending[0].slave != sample.slave) {
+        flush(pending);
+    }
+
+    pending.push_back(sample);
+
+    if (pending.size() >= kBlockSamples) {
+        flush(pending);
+    }
+}
+
+bool ArchiveWriter::close() {
+    if (file_ == nullptr) {
+        return false;
+    }
+
+    for (vector<TelemetrySample> &pending : pending_) {
+        flush(pending);
+    }
+
+    error_ |= fclose(file_) != 0;
+    file_ = nullptr;
+    pending_.clear();
+
+    return !error_;
+}
+
+void ArchiveWriter::flush(vector<TelemetrySample> &pending) {
+    if (pending.empty()) {
+        return;
+    }
+
+    block_.clear();
+    encodeBlock(pending.data(), pending.size(), block_);
+    pending.clear();
+
+    error_ |= fwrite(block_.data(), block_.size(), 1, file_) != 1;
+    bytes_ += block_.size();
+}
+
+bool compactSegment(const string &segment_path, const string &archive_path) {
+    TelemetrySegment segment;
+    ArchiveWriter writer;
+    const string temp_path = archive_path + ".tmp";
+
+    if (!segment.open(segment_path) || !writer.open(temp_path, segment.getSequence())) {
+        return false;
+    }
+
+    const uint64_t size = segment.size();
+
+    for (uint64_t i = 0; i < size; i++) {
+        writer.append(segment.at(i));
+    }
+
+    if (!writer.close() || rename(temp_path.c_str(), archive_path.c_str()) != 0) {
+        cout << "[Error] Telemetry archive " << archive_path << " could not be written" << endl;
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace telemetry
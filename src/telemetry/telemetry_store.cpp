@@ -0,0 +1,657 @@
+/**
+ * @file telemetry_store.cpp
+ * @brief Segment writer and the readers of segments and archives.
+ * @version 1.0
+ * @date 2024-04-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "telemetry_store.hpp"
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace telemetry {
+
+namespace {
+
+const auto kWriteInterval = std::chrono::milliseconds(20);
+
+uint64_t wallMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+string segmentPath(const string &dir, uint64_t sequence, const char *suffix = SEGMENT_SUFFIX) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s%010llu%s", SEGMENT_PREFIX, (unsigned long long) sequence, suffix);
+    return dir + "/" + name;
+}
+
+bool hasSuffix(const string &name, const char *suffix) {
+    const size_t suffix_size = strlen(suffix);
+    return name.size() > suffix_size && name.compare(name.size() - suffix_size, suffix_size, suffix) == 0;
+}
+
+// Sequence of a segment or archive file name, false for other files
+bool parseSegmentName(const string &name, uint64_t &sequence) {
+    const size_t prefix_size = strlen(SEGMENT_PREFIX);
+    const char *suffix = hasSuffix(name, SEGMENT_SUFFIX) ? SEGMENT_SUFFIX : ARCHIVE_SUFFIX;
+    const size_t suffix_size = strlen(suffix);
+
+    if (name.size() <= prefix_size + suffix_size || name.compare(0, prefix_size, SEGMENT_PREFIX) != 0 ||
+        !hasSuffix(name, suffix)) {
+        return false;
+    }
+
+    const string digits = name.substr(prefix_size, name.size() - prefix_size - suffix_size);
+
+    if (digits.find_first_not_of("0123456789") != string::npos) {
+        return false;
+    }
+
+    sequence = stoull(digits);
+    return true;
+}
+
+} // namespace
+
+bool TelemetryWriter::open(const string &dir, const TelemetryConfig &config) {
+    close();
+
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        cout << "[Error] Telemetry directory " << dir << " could not be created: " << strerror(errno) << endl;
+        return false;
+    }
+
+    if (access(dir.c_str(), W_OK) != 0) {
+        cout << "[Error] Telemetry directory " << dir << " is not writable" << endl;
+        return false;
+    }
+
+    dir_    = dir;
+    config_ = config;
+    config_.max_segments = max<size_t>(config_.max_segments, 1);
+    capacity_ = (max(config_.segment_bytes, SEGMENT_HEADER_SIZE + sizeof(TelemetrySample)) - SEGMENT_HEADER_SIZE)
+                / sizeof(TelemetrySample);
+
+    segment_paths_ = TelemetryReader::listFiles(dir);
+    next_sequence_ = 0;
+
+    if (!segment_paths_.empty()) {
+        uint64_t sequence = 0;
+        parseSegmentName(segment_paths_.back().substr(dir.size() + 1), sequence);
+        next_sequence_ = sequence + 1;
+    }
+
+    queue_.assign(kTelemetryQueueSize, TelemetrySample());
+    queue_head_ = 0;
+    queue_tail_ = 0;
+    t_last_us_  = 0;
+    written_    = 0;
+    dropped_    = 0;
+    segments_   = 0;
+    archived_   = 0;
+    archived_bytes_ = 0;
+    archive_bytes_  = 0;
+
+    flag_stop_ = false;
+    writer_ = std::thread(&TelemetryWriter::writerLoop, this);
+
+    return true;
+}
+
+void TelemetryWriter::close() {
+    if (!writer_.joinable()) {
+        return;
+    }
+
+    flag_stop_ = true;
+    writer_.join();
+
+    // The last segment is archived as far as it was written, the next open starts a new one
+    if (segment_ != nullptr) {
+        unmapSegment();
+
+        if (config_.compress) {
+            archiveSegment(segment_paths_.size() - 1);
+        }
+    }
+}
+
+bool TelemetryWriter::append(TelemetrySample &sample) {
+    const uint64_t head = queue_head_.load(memory_order_relaxed);
+
+    if (head - queue_tail_.load(memory_order_acquire) >= kTelemetryQueueSize) {
+        dropped_.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    sample.t_us = wallMicros();
+    if (sample.slave < kTelemetrySlaves) {
+        sample.sequence = sequences_[sample.slave]++;
+    }
+
+    queue_[head & (kTelemetryQueueSize - 1)] = sample;
+    queue_head_.store(head + 1, memory_order_release);
+
+    return true;
+}
+
+TelemetryStats TelemetryWriter::getStats() const {
+    TelemetryStats stats;
+
+    stats.appended = queue_head_.load(memory_order_relaxed);
+    stats.written  = written_.load(memory_order_relaxed);
+    stats.dropped  = dropped_.load(memory_order_relaxed);
+    stats.segments = segments_.load(memory_order_relaxed);
+    stats.archived = archived_.load(memory_order_relaxed);
+    stats.archived_bytes = archived_bytes_.load(memory_order_relaxed);
+    stats.archive_bytes  = archive_bytes_.load(memory_order_relaxed);
+
+    return stats;
+}
+
+void TelemetryWriter::writerLoop() {
+    while (!flag_stop_) {
+        writeQueued();
+        std::this_thread::sleep_for(kWriteInterval);
+    }
+
+    // Samples appended before close()
+    writeQueued();
+}
+
+void TelemetryWriter::writeQueued() {
+    const uint64_t head = queue_head_.load(memory_order_acquire);
+    uint64_t tail = queue_tail_.load(memory_order_relaxed);
+
+    for (; tail < head; tail++) {
+        TelemetrySample sample = queue_[tail & (kTelemetryQueueSize - 1)];
+
+        if (segment_ == nullptr || segment_->count.load(memory_order_relaxed) >= capacity_) {
+            if (!rotate()) {
+                dropped_.fetch_add(1, memory_order_relaxed);
+                continue;
+            }
+        }
+
+        // A clock stepped back must not break the time order of the store
+        sample.t_us = t_last_us_ = max(sample.t_us, t_last_us_);
+
+        const uint64_t count = segment_->count.load(memory_order_relaxed);
+        samples_[count] = sample;
+
+        if (count == 0) {
+            segment_->t_first_us.store(sample.t_us, memory_order_relaxed);
+        }
+        segment_->t_last_us.store(sample.t_us, memory_order_relaxed);
+        segment_->count.store(count + 1, memory_order_release);
+
+        written_.fetch_add(1, memory_order_relaxed);
+    }
+
+    queue_tail_.store(tail, memory_order_release);
+}
+
+bool TelemetryWriter::rotate() {
+    if (segment_ != nullptr) {
+        unmapSegment();
+
+        // Delays the queued samples by the encoding, a few ms per MiB of segment
+        if (config_.compress) {
+            archiveSegment(segment_paths_.size() - 1);
+        }
+    }
+
+    const string path = segmentPath(dir_, next_sequence_);
+    const size_t size = SEGMENT_HEADER_SIZE + capacity_ * sizeof(TelemetrySample);
+
+    int fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    void *address = MAP_FAILED;
+
+    // Blocks are allocated now, a full disk fails here rather than in a page fault of the mapping
+    if (fd >= 0) {
+        if ((errno = posix_fallocate(fd, 0, size)) == 0) {
+            address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+    }
+
+    if (address == MAP_FAILED) {
+        // Reported once per failing segment, the samples meanwhile are counted as dropped
+        static uint64_t failed_sequence = UINT64_MAX;
+        if (failed_sequence != next_sequence_) {
+            failed_sequence = next_sequence_;
+            cout << "[Error] Telemetry segment " << path << " could not be created: " << strerror(errno) << endl;
+        }
+        unlink(path.c_str());
+        return false;
+    }
+
+    // The new file reads as zeros, the magic is written last so readers never see half a header
+    segment_ = static_cast<SegmentHeader *>(address);
+    samples_ = reinterpret_cast<TelemetrySample *>(static_cast<char *>(address) + SEGMENT_HEADER_SIZE);
+
+    segment_->version     = SEGMENT_VERSION;
+    segment_->sample_size = sizeof(TelemetrySample);
+    segment_->capacity    = capacity_;
+    segment_->sequence    = next_sequence_;
+    atomic_thread_fence(memory_order_release);
+    memcpy(segment_->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+
+    next_sequence_++;
+    segments_.fetch_add(1, memory_order_relaxed);
+    segment_paths_.push_back(path);
+
+    while (segment_paths_.size() > config_.max_segments) {
+        unlink(segment_paths_.front().c_str());
+        segment_paths_.erase(segment_paths_.begin());
+    }
+
+    return true;
+}
+
+void TelemetryWriter::archiveSegment(size_t index) {
+    const string segment_path = segment_paths_[index];
+
+    if (!hasSuffix(segment_path, SEGMENT_SUFFIX)) {
+        return;
+    }
+
+    const string archive_path = segment_path.substr(0, segment_path.size() - strlen(SEGMENT_SUFFIX)) + ARCHIVE_SUFFIX;
+    uint64_t samples = 0;
+
+    {
+        TelemetrySegment segment;
+
+        if (segment.open(segment_path)) {
+            samples = segment.size();
+        }
+    }
+
+    // Kept as a segment if the archive could not be written
+    if (!compactSegment(segment_path, archive_path)) {
+        return;
+    }
+
+    struct stat st;
+
+    if (stat(archive_path.c_str(), &st) == 0) {
+        archive_bytes_.fetch_add(st.st_size, memory_order_relaxed);
+    }
+
+    unlink(segment_path.c_str());
+    segment_paths_[index] = archive_path;
+
+    archived_.fetch_add(1, memory_order_relaxed);
+    archived_bytes_.fetch_add(samples * sizeof(TelemetrySample), memory_order_relaxed);
+}
+
+void TelemetryWriter::unmapSegment() {
+    if (segment_ == nullptr) {
+        return;
+    }
+
+    const size_t size = SEGMENT_HEADER_SIZE + segment_->capacity * sizeof(TelemetrySample);
+
+    msync(segment_, size, MS_ASYNC);
+    munmap(segment_, size);
+
+    segment_ = nullptr;
+    samples_ = nullptr;
+}
+
+bool TelemetrySegment::open(const string &path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *address = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= SEGMENT_HEADER_SIZE) {
+        address = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    header_      = static_cast<const SegmentHeader *>(address);
+    samples_     = reinterpret_cast<const TelemetrySample *>(static_cast<const char *>(address) + SEGMENT_HEADER_SIZE);
+    mapped_size_ = st.st_size;
+    path_        = path;
+
+    // Also rejects a segment whose header is still being written
+    if (memcmp(header_->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 || header_->version != SEGMENT_VERSION ||
+        header_->sample_size != sizeof(TelemetrySample) ||
+        SEGMENT_HEADER_SIZE + header_->capacity * sizeof(TelemetrySample) > mapped_size_) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void TelemetrySegment::close() {
+    if (header_ != nullptr) {
+        munmap((void *) header_, mapped_size_);
+        header_  = nullptr;
+        samples_ = nullptr;
+    }
+}
+
+uint64_t TelemetrySegment::lowerBound(uint64_t t_us) const {
+    uint64_t first = 0, count = size();
+
+    while (count > 0) {
+        uint64_t step = count / 2;
+
+        if (samples_[first + step].t_us < t_us) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+uint64_t TelemetrySegment::forEach(uint64_t t_from_us, uint64_t t_to_us,
+                                   const function<bool (const TelemetrySample &)> &fn, int slave, bool &stop) const {
+    const uint64_t size = this->size();
+    uint64_t visited = 0;
+
+    if (size == 0 || getLastTime() < t_from_us || getFirstTime() >= t_to_us) {
+        return 0;
+    }
+
+    for (uint64_t i = lowerBound(t_from_us); i < size && samples_[i].t_us < t_to_us; i++) {
+        if (slave >= 0 && samples_[i].slave != slave) {
+            continue;
+        }
+
+        visited++;
+
+        if (!fn(samples_[i])) {
+            stop = true;
+            break;
+        }
+    }
+
+    return visited;
+}
+
+bool TelemetryArchive::open(const string &path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *address = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= ARCHIVE_HEADER_SIZE) {
+        address = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    mapping_     = address;
+    mapped_size_ = st.st_size;
+    path_        = path;
+
+    const char *data = static_cast<const char *>(address);
+    uint32_t version = 0;
+
+    memcpy(&version, data + 8, sizeof(version));
+    memcpy(&sequence_, data + 16, sizeof(sequence_));
+
+    if (memcmp(data, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || version != ARCHIVE_VERSION) {
+        close();
+        return false;
+    }
+
+    t_first_us_ = UINT64_MAX;
+
+    for (size_t offset = ARCHIVE_HEADER_SIZE; offset < mapped_size_;) {
+        ArchiveBlock block;
+
+        if (!readBlockIndex(data + offset, mapped_size_ - offset, block.index)) {
+            break;
+        }
+
+        block.columns = data + offset + BLOCK_INDEX_SIZE;
+        blocks_.push_back(block);
+
+        samples_   += block.index.count;
+        t_first_us_ = min(t_first_us_, block.index.t_first_us);
+        t_last_us_  = max(t_last_us_, block.index.t_last_us);
+
+        offset += BLOCK_INDEX_SIZE + block.index.size;
+    }
+
+    if (blocks_.empty()) {
+        t_first_us_ = 0;
+    }
+
+    return true;
+}
+
+void TelemetryArchive::close() {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapped_size_);
+        mapping_ = nullptr;
+    }
+
+    blocks_.clear();
+    samples_ = t_first_us_ = t_last_us_ = 0;
+}
+
+uint64_t TelemetryArchive::forEach(uint64_t t_from_us, uint64_t t_to_us,
+                                   const function<bool (const TelemetrySample &)> &fn, int slave, bool &stop) const {
+    // Per slave: its blocks in the range, the decoded block and the position in it
+    struct Cursor {
+        vector<const ArchiveBlock *> blocks;
+        size_t next_block = 0;
+        vector<TelemetrySample> samples;
+        size_t position = 0;
+    };
+
+    unordered_map<uint16_t, Cursor> cursors;
+
+    for (const ArchiveBlock &block : blocks_) {
+        if (block.index.overlaps(t_from_us, t_to_us) && (slave < 0 || block.index.slave == slave)) {
+            cursors[block.index.slave].blocks.push_back(&block);
+        }
+    }
+
+    // Next sample of the cursor in the range, false once the cursor is exhausted
+    auto advanceFn = [&] (Cursor &cursor) {
+        while (true) {
+            for (; cursor.position < cursor.samples.size(); cursor.position++) {
+                const uint64_t t_us = cursor.samples[cursor.position].t_us;
+
+                if (t_us >= t_to_us) {
+                    return false;
+                }
+                if (t_us >= t_from_us) {
+                    return true;
+                }
+            }
+
+            if (cursor.next_block >= cursor.blocks.size()) {
+                return false;
+            }
+
+            cursor.samples.clear();
+            cursor.position = 0;
+
+            if (!decode(*cursor.blocks[cursor.next_block++], cursor.samples)) {
+                cout << "[Error] Telemetry archive " << path_ << " has a corrupt block" << endl;
+                return false;
+            }
+        }
+    };
+
+    // Earliest sample first, ties in slave order
+    typedef tuple<uint64_t, uint16_t, Cursor *> Head;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+
+    auto headFn = [] (Cursor &cursor) {
+        const TelemetrySample &sample = cursor.samples[cursor.position];
+        return Head(sample.t_us, sample.slave, &cursor);
+    };
+
+    for (auto &cursor : cursors) {
+        if (advanceFn(cursor.second)) {
+            heads.push(headFn(cursor.second));
+        }
+    }
+
+    uint64_t visited = 0;
+
+    while (!heads.empty()) {
+        Cursor &cursor = *get<2>(heads.top());
+        heads.pop();
+
+        visited++;
+
+        if (!fn(cursor.samples[cursor.position++])) {
+            stop = true;
+            break;
+        }
+
+        if (advanceFn(cursor)) {
+            heads.push(headFn(cursor));
+        }
+    }
+
+    return visited;
+}
+
+unique_ptr<TelemetryFile> TelemetryFile::open(const string &path) {
+    if (hasSuffix(path, ARCHIVE_SUFFIX)) {
+        unique_ptr<TelemetryArchive> archive(new TelemetryArchive());
+        return archive->open(path) ? move(archive) : nullptr;
+    }
+
+    unique_ptr<TelemetrySegment> segment(new TelemetrySegment());
+    return segment->open(path) ? move(segment) : nullptr;
+}
+
+bool TelemetryReader::open(const string &dir) {
+    files_.clear();
+
+    for (const string &path : listFiles(dir)) {
+        unique_ptr<TelemetryFile> file = TelemetryFile::open(path);
+
+        // A file deleted or archived by the writer meanwhile is skipped
+        if (file) {
+            files_.push_back(move(file));
+        }
+    }
+
+    return !files_.empty();
+}
+
+uint64_t TelemetryReader::forEach(uint64_t t_from_us, uint64_t t_to_us,
+                                  const function<bool (const TelemetrySample &)> &fn, int slave) const {
+    uint64_t visited = 0;
+    bool stop = false;
+
+    for (const unique_ptr<TelemetryFile> &file : files_) {
+        visited += file->forEach(t_from_us, t_to_us, fn, slave, stop);
+
+        if (stop) {
+            break;
+        }
+    }
+
+    return visited;
+}
+
+vector<TelemetrySample> TelemetryReader::read(uint64_t t_from_us, uint64_t t_to_us, int slave) const {
+    vector<TelemetrySample> samples;
+
+    forEach(t_from_us, t_to_us, [&samples] (const TelemetrySample &sample) {
+        samples.push_back(sample);
+        return true;
+    }, slave);
+
+    return samples;
+}
+
+uint64_t TelemetryReader::getFirstTime() const {
+    for (const unique_ptr<TelemetryFile> &file : files_) {
+        if (file->size() > 0) {
+            return file->getFirstTime();
+        }
+    }
+    return 0;
+}
+
+uint64_t TelemetryReader::getLastTime() const {
+    for (auto itr = files_.rbegin(); itr != files_.rend(); itr++) {
+        if ((*itr)->size() > 0) {
+            return (*itr)->getLastTime();
+        }
+    }
+    return 0;
+}
+
+vector<string> TelemetryReader::listFiles(const string &dir) {
+    vector<pair<uint64_t, string>> segments;
+    DIR *directory = opendir(dir.c_str());
+
+    if (directory == NULL) {
+        return {};
+    }
+
+    while (struct dirent *entry = readdir(directory)) {
+        uint64_t sequence;
+
+        if (parseSegmentName(entry->d_name, sequence)) {
+            segments.emplace_back(sequence, dir + "/" + entry->d_name);
+        }
+    }
+    closedir(directory);
+
+    // ".seg" sorts before ".tlc": of a segment and its archive, the segment is listed
+    sort(segments.begin(), segments.end());
+
+    vector<string> paths;
+    for (size_t i = 0; i < segments.size(); i++) {
+        if (i == 0 || segments[i].first != segments[i - 1].first) {
+            paths.push_back(segments[i].second);
+        }
+    }
+    return paths;
+}
+
+} // namespace telemetry
@@ -0,0 +1,291 @@
+/**
+ * @file trace_recorder.cpp
+ * @brief Per-thread trace buffers and the Chrome trace export.
+ * @version 1.0
+ * @date 2024-04-17
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "trace_recorder.hpp"
+
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+namespace tracing {
+
+atomic<bool> g_trace_enabled{false};
+
+namespace {
+
+struct TraceBuffer {
+    atomic<uint64_t> head{0}; /**< Events ever recorded, the writer's only shared state */
+    TraceEvent events[kTraceBufferEvents];
+
+    uint32_t tid = 0;
+    string name;              /**< Guarded by the registry mutex, as is in_use */
+    bool in_use = false;
+};
+
+struct Registry {
+    mutex mutex_buffers;
+    vector<unique_ptr<TraceBuffer>> buffers; /**< Never shrinks, buffers of exited threads are reused */
+
+    atomic<uint32_t> next_id{1};
+    atomic<uint64_t> t_clear_ns{0};
+};
+
+// Never destroyed, detached client writers may still record during exit
+Registry &registry() {
+    static Registry *registry = new Registry();
+    return *registry;
+}
+
+uint64_t nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The calling thread's buffer, taken on the first event and handed back when the thread exits
+struct ThreadState {
+    TraceBuffer *buffer = nullptr;
+    uint32_t current_id = 0;
+    string name;
+
+    TraceBuffer *getBuffer() {
+        if (buffer == nullptr) {
+            Registry &reg = registry();
+            unique_lock<mutex> lg(reg.mutex_buffers);
+
+            auto itr = find_if(reg.buffers.begin(), reg.buffers.end(), [] (const unique_ptr<TraceBuffer> &b) {
+                return !b->in_use;
+            });
+
+            if (itr == reg.buffers.end()) {
+                reg.buffers.emplace_back(new TraceBuffer());
+                reg.buffers.back()->tid = reg.buffers.size();
+                itr = reg.buffers.end() - 1;
+            }
+
+            (*itr)->in_use = true;
+            (*itr)->name   = name.empty() ? "thread " + to_string((*itr)->tid) : name;
+            buffer = itr->get();
+        }
+        return buffer;
+    }
+
+    ~ThreadState() {
+        if (buffer != nullptr) {
+            unique_lock<mutex> lg(registry().mutex_buffers);
+            buffer->in_use = false;
+        }
+    }
+};
+
+thread_local ThreadState t_state;
+
+struct ExportedEvent {
+    TraceEvent event;
+    uint32_t tid;
+    uint64_t queue_ns; /**< Socket writes: time the frame waited in the client queue */
+};
+
+/**
+ * @brief Copies the events of a buffer, without the ones its writer overwrote meanwhile.
+ */
+void snapshot(const TraceBuffer &buffer, uint64_t t_from_ns, vector<ExportedEvent> &out) {
+    uint64_t head  = buffer.head.load(memory_order_acquire);
+    uint64_t first = (head > kTraceBufferEvents) ? head - kTraceBufferEvents : 0;
+
+    vector<TraceEvent> events;
+    events.reserve(head - first);
+
+    for (uint64_t i = first; i < head; i++) {
+        events.push_back(buffer.events[i % kTraceBufferEvents]);
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t head_after = buffer.head.load(memory_order_relaxed);
+    uint64_t valid      = (head_after > kTraceBufferEvents) ? head_after - kTraceBufferEvents : 0;
+
+    for (uint64_t i = max(first, valid); i < head; i++) {
+        const TraceEvent &event = events[i - first];
+
+        if (event.t_ns >= t_from_ns) {
+            out.push_back({event, buffer.tid, 0});
+        }
+    }
+}
+
+const char *phaseString(Phase phase) {
+    switch (phase) {
+        case Phase::BEGIN:       return "B";
+        case Phase::END:         return "E";
+        case Phase::ASYNC_BEGIN: return "b";
+        case Phase::ASYNC_END:   return "e";
+        default:                 return "i";
+    }
+}
+
+void writeTimestamp(ostream &out, uint64_t t_ns) {
+    char ts[32];
+    snprintf(ts, sizeof(ts), "%llu.%03u", (unsigned long long) (t_ns / 1000), (unsigned) (t_ns % 1000));
+    out << ts;
+}
+
+} // namespace
+
+void setEnabled(bool enabled) {
+    g_trace_enabled = enabled;
+}
+
+void clear() {
+    registry().t_clear_ns = nowNs();
+}
+
+uint32_t nextId() {
+    uint32_t id = registry().next_id.fetch_add(1, memory_order_relaxed);
+    return (id != 0) ? id : registry().next_id.fetch_add(1, memory_order_relaxed);
+}
+
+uint32_t currentId() {
+    return t_state.current_id;
+}
+
+void setCurrentId(uint32_t id) {
+    t_state.current_id = id;
+}
+
+void setThreadName(const string &name) {
+    t_state.name = name;
+
+    // Threads that never record take no buffer
+    if (t_state.buffer != nullptr) {
+        unique_lock<mutex> lg(registry().mutex_buffers);
+        t_state.buffer->name = name;
+    }
+}
+
+void recordEvent(Stage stage, Phase phase, uint32_t id, const void *frame) {
+    TraceBuffer *buffer = t_state.getBuffer();
+    uint64_t head = buffer->head.load(memory_order_relaxed);
+
+    buffer->events[head % kTraceBufferEvents] = {nowNs(), (uint64_t) (uintptr_t) frame, id, stage, phase};
+    buffer->head.store(head + 1, memory_order_release);
+}
+
+void exportChromeTrace(ostream &out) {
+    Registry &reg = registry();
+    vector<ExportedEvent> events;
+    vector<pair<uint32_t, string>> threads;
+
+    {
+        unique_lock<mutex> lg(reg.mutex_buffers);
+
+        for (const unique_ptr<TraceBuffer> &buffer : reg.buffers) {
+            snapshot(*buffer, reg.t_clear_ns, events);
+            threads.emplace_back(buffer->tid, buffer->name);
+        }
+    }
+
+    stable_sort(events.begin(), events.end(), [] (const ExportedEvent &a, const ExportedEvent &b) {
+        return a.event.t_ns < b.event.t_ns;
+    });
+
+    // Socket writes take the id of the frame's latest enqueue
+    unordered_map<uint64_t, pair<uint32_t, uint64_t>> enqueued;
+
+    for (ExportedEvent &exported : events) {
+        TraceEvent &event = exported.event;
+
+        if (event.stage == Stage::CLIENT_ENQUEUE && event.frame != 0) {
+            enqueued[event.frame] = {event.id, event.t_ns};
+        } else if (event.stage == Stage::SOCKET_WRITE && event.frame != 0) {
+            auto itr = enqueued.find(event.frame);
+
+            if (itr != enqueued.end()) {
+                event.id          = itr->second.first;
+                exported.queue_ns = event.t_ns - itr->second.second;
+            }
+        }
+    }
+
+    // Flow arrows through the slices of each id, from its first to its last stage
+    unordered_map<uint32_t, size_t> flow_last;
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent &event = events[i].event;
+
+        if (event.id != 0 && (event.phase == Phase::BEGIN || event.phase == Phase::INSTANT)) {
+            flow_last[event.id] = i;
+        }
+    }
+
+    unordered_map<uint32_t, bool> flow_started;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"datc\"}}";
+
+    for (const pair<uint32_t, string> &thread : threads) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.first
+            << ",\"args\":{\"name\":\"" << thread.second << "\"}}";
+    }
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent &event = events[i].event;
+
+        out << ",\n{\"name\":\"" << STAGE_NAMES[(size_t) event.stage] << "\",\"cat\":\"datc\",\"ph\":\""
+            << phaseString(event.phase) << "\",\"pid\":1,\"tid\":" << events[i].tid << ",\"ts\":";
+        writeTimestamp(out, event.t_ns);
+
+        if (event.phase == Phase::ASYNC_BEGIN || event.phase == Phase::ASYNC_END) {
+            out << ",\"id\":" << event.id;
+        } else if (event.phase == Phase::INSTANT) {
+            out << ",\"s\":\"t\"";
+        }
+
+        if (event.id != 0) {
+            out << ",\"args\":{\"id\":" << event.id;
+            if (events[i].queue_ns != 0 && event.phase == Phase::BEGIN) {
+                out << ",\"client_queue_us\":" << events[i].queue_ns / 1000;
+            }
+            out << "}";
+        }
+        out << "}";
+
+        if (event.id == 0 || !(event.phase == Phase::BEGIN || event.phase == Phase::INSTANT)) {
+            continue;
+        }
+
+        bool &started = flow_started[event.id];
+        const char *flow_phase = !started ? "s" : (flow_last[event.id] == i ? "f" : "t");
+
+        if (!started && flow_last[event.id] == i) {
+            continue; // A single slice, nothing to connect
+        }
+        started = true;
+
+        out << ",\n{\"name\":\"flow\",\"cat\":\"datc\",\"ph\":\"" << flow_phase << "\",\"bp\":\"e\",\"id\":"
+            << event.id << ",\"pid\":1,\"tid\":" << events[i].tid << ",\"ts\":";
+        writeTimestamp(out, event.t_ns);
+        out << "}";
+    }
+
+    out << "\n]}\n";
+}
+
+bool writeChromeTrace(const string &path) {
+    ofstream file(path);
+
+    if (!file) {
+        return false;
+    }
+
+    exportChromeTrace(file);
+
+    return (bool) file;
+}
+
+} // namespace tracing
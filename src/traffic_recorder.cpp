@@ -0,0 +1,320 @@
+/**
+ * @file traffic_recorder.cpp
+ * @brief Background writer of the traffic log and its reader.
+ * @version 1.0
+ * @date 2024-04-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "traffic_recorder.hpp"
+
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <condition_variable>
+
+namespace traffic {
+
+atomic<bool> g_recording{false};
+
+namespace {
+
+const auto kFlushInterval = chrono::milliseconds(200);
+const size_t kFlushBytes  = 64 * 1024;
+
+struct Recorder {
+    mutex mutex_pending;
+    condition_variable cv_pending;
+    string pending;     /**< Encoded records not yet handed to the writer */
+    bool flag_stop = false;
+
+    mutex mutex_control; /**< Serializes start and stop */
+    FILE *file = nullptr;
+    std::thread writer;
+
+    atomic<uint64_t> t_start_ns{0};
+    atomic<uint64_t> records{0};
+    atomic<uint64_t> bytes{0};
+    atomic<uint64_t> dropped{0};
+};
+
+// Never destroyed, detached client writers may still record during exit
+Recorder &recorder() {
+    static Recorder *recorder = new Recorder();
+    return *recorder;
+}
+
+uint64_t nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void putU16(char *out, uint16_t value) {
+    out[0] = (char) (value & 0xFF);
+    out[1] = (char) (value >> 8);
+}
+
+void putU32(char *out, uint32_t value) {
+    putU16(out, value & 0xFFFF);
+    putU16(out + 2, value >> 16);
+}
+
+void putU64(char *out, uint64_t value) {
+    putU32(out, value & 0xFFFFFFFF);
+    putU32(out + 4, value >> 32);
+}
+
+uint16_t getU16(const char *in) {
+    return (uint16_t) ((uint8_t) in[0] | ((uint8_t) in[1] << 8));
+}
+
+uint32_t getU32(const char *in) {
+    return getU16(in) | ((uint32_t) getU16(in + 2) << 16);
+}
+
+uint64_t getU64(const char *in) {
+    return getU32(in) | ((uint64_t) getU32(in + 4) << 32);
+}
+
+void append(const TrafficRecord &record, const char *payload, size_t size) {
+    Recorder &rec = recorder();
+    char header[RECORD_HEADER_SIZE];
+
+    header[0] = (char) record.type;
+    header[1] = (char) record.flags;
+    putU16(header + 2,  record.slave);
+    putU16(header + 4,  record.reg_addr);
+    putU32(header + 6,  record.client);
+    putU32(header + 10, record.latency_us);
+    putU64(header + 14, record.t_us);
+    putU32(header + 22, (uint32_t) size);
+
+    unique_lock<mutex> lg(rec.mutex_pending);
+
+    if (rec.pending.size() + sizeof(header) + size > kMaxPendingBytes) {
+        rec.dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    rec.pending.append(header, sizeof(header));
+    rec.pending.append(payload, size);
+    rec.records.fetch_add(1, memory_order_relaxed);
+
+    if (rec.pending.size() >= kFlushBytes) {
+        rec.cv_pending.notify_one();
+    }
+}
+
+uint64_t recordTime() {
+    return (nowNs() - recorder().t_start_ns.load(memory_order_relaxed)) / 1000;
+}
+
+// Swaps the pending records out and writes them without holding the lock
+void writerLoop() {
+    Recorder &rec = recorder();
+    string writing;
+    bool flag_stop = false;
+
+    while (!flag_stop) {
+        {
+            unique_lock<mutex> lg(rec.mutex_pending);
+            rec.cv_pending.wait_for(lg, kFlushInterval, [&] () {
+                return rec.flag_stop || rec.pending.size() >= kFlushBytes;
+            });
+
+            flag_stop = rec.flag_stop;
+            writing.swap(rec.pending);
+        }
+
+        if (!writing.empty()) {
+            if (fwrite(writing.data(), 1, writing.size(), rec.file) != writing.size()) {
+                cout << "[Error] Traffic recording write failed" << endl;
+            }
+            fflush(rec.file);
+            rec.bytes.fetch_add(writing.size(), memory_order_relaxed);
+            writing.clear();
+        }
+    }
+}
+
+} // namespace
+
+vector<uint16_t> TrafficRecord::registers() const {
+    vector<uint16_t> registers(payload.size() / 2);
+
+    for (size_t i = 0; i < registers.size(); i++) {
+        registers[i] = getU16(&payload[2 * i]);
+    }
+    return registers;
+}
+
+bool startRecording(const string &path) {
+    Recorder &rec = recorder();
+    unique_lock<mutex> lg_control(rec.mutex_control);
+
+    if (rec.file != nullptr) {
+        return false;
+    }
+
+    rec.file = fopen(path.c_str(), "wb");
+
+    if (rec.file == nullptr) {
+        cout << "[Error] Cannot create traffic recording " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    const uint64_t t_wall_us = chrono::duration_cast<chrono::microseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+
+    char header[FILE_HEADER_SIZE];
+    memcpy(header, FILE_MAGIC, sizeof(FILE_MAGIC));
+    putU32(header + 8, FILE_VERSION);
+    putU64(header + 12, t_wall_us);
+    fwrite(header, 1, sizeof(header), rec.file);
+
+    {
+        unique_lock<mutex> lg(rec.mutex_pending);
+        rec.pending.clear();
+        rec.flag_stop = false;
+    }
+
+    rec.t_start_ns = nowNs();
+    rec.records = 0;
+    rec.bytes   = sizeof(header);
+    rec.dropped = 0;
+
+    rec.writer = std::thread(writerLoop);
+    g_recording = true;
+
+    return true;
+}
+
+void stopRecording() {
+    Recorder &rec = recorder();
+    unique_lock<mutex> lg_control(rec.mutex_control);
+
+    if (rec.file == nullptr) {
+        return;
+    }
+
+    g_recording = false;
+
+    {
+        unique_lock<mutex> lg(rec.mutex_pending);
+        rec.flag_stop = true;
+    }
+    rec.cv_pending.notify_one();
+    rec.writer.join();
+
+    fclose(rec.file);
+    rec.file = nullptr;
+}
+
+RecorderStats getRecorderStats() {
+    Recorder &rec = recorder();
+    RecorderStats stats;
+
+    stats.records = rec.records.load(memory_order_relaxed);
+    stats.bytes   = rec.bytes.load(memory_order_relaxed);
+    stats.dropped = rec.dropped.load(memory_order_relaxed);
+
+    return stats;
+}
+
+void recordModbus(RecordType type, uint16_t slave, int reg_addr, int nb, const uint16_t *registers,
+                  uint32_t latency_us, uint8_t flags) {
+    TrafficRecord record;
+
+    record.type       = type;
+    record.flags      = flags;
+    record.slave      = slave;
+    record.reg_addr   = (uint16_t) reg_addr;
+    record.latency_us = latency_us;
+    record.t_us       = recordTime();
+
+    char payload[2 * nb + 1];
+    for (int i = 0; i < nb; i++) {
+        putU16(payload + 2 * i, registers[i]);
+    }
+
+    append(record, payload, 2 * nb);
+}
+
+void recordTcp(RecordType type, uint32_t client, const char *data, size_t size) {
+    TrafficRecord record;
+
+    record.type   = type;
+    record.client = client;
+    record.t_us   = recordTime();
+
+    append(record, data, size);
+}
+
+TrafficLogReader::~TrafficLogReader() {
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+}
+
+bool TrafficLogReader::open(const string &path) {
+    file_ = fopen(path.c_str(), "rb");
+
+    if (file_ == nullptr) {
+        cout << "[Error] Cannot open traffic recording " << path << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    char header[FILE_HEADER_SIZE];
+
+    if (fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+        memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        cout << "[Error] " << path << " is not a traffic recording" << endl;
+        return false;
+    }
+
+    if (getU32(header + 8) != FILE_VERSION) {
+        cout << "[Error] Unsupported traffic recording version: " << getU32(header + 8) << endl;
+        return false;
+    }
+
+    t_start_wall_us_ = getU64(header + 12);
+
+    return true;
+}
+
+bool TrafficLogReader::next(TrafficRecord &record) {
+    char header[RECORD_HEADER_SIZE];
+
+    if (file_ == nullptr || error_) {
+        return false;
+    }
+
+    size_t size = fread(header, 1, sizeof(header), file_);
+
+    if (size != sizeof(header)) {
+        error_ = (size != 0); // A record cut off by a crash
+        return false;
+    }
+
+    record.type       = (RecordType) header[0];
+    record.flags      = (uint8_t) header[1];
+    record.slave      = getU16(header + 2);
+    record.reg_addr   = getU16(header + 4);
+    record.client     = getU32(header + 6);
+    record.latency_us = getU32(header + 10);
+    record.t_us       = getU64(header + 14);
+
+    record.payload.resize(getU32(header + 22));
+
+    if (fread(&record.payload[0], 1, record.payload.size(), file_) != record.payload.size()) {
+        error_ = true;
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace traffic
@@ -0,0 +1,66 @@
+/**
+ * @file main.cpp
+ * @brief Runs one test by name, or every test.
+ * @version 1.0
+ * @date 2024-04-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "tests.hpp"
+
+#include <string>
+
+namespace {
+
+struct Test {
+    const char *name;
+    TestResult (*fn)();
+};
+
+const Test kTests[] = {
+    {"status_json",  testStatusJson},
+    {"udp_loopback", testUdpLoopback},
+};
+
+void printUsage() {
+    printf("Usage: datc_tests [NAME]\n"
+           "Tests:");
+    for (const Test &test : kTests) {
+        printf(" %s", test.name);
+    }
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        printUsage();
+        return 2;
+    }
+
+    const string name = argc == 2 ? argv[1] : "";
+    bool found = false, passed = false, failed = false;
+
+    for (const Test &test : kTests) {
+        if (!name.empty() && name != test.name) {
+            continue;
+        }
+        found = true;
+
+        TestResult test_result = test.fn();
+        printf("%-16s %s\n", test.name,
+               test_result == TEST_PASSED ? "passed" : test_result == TEST_SKIPPED ? "skipped" : "FAILED");
+
+        passed |= test_result == TEST_PASSED;
+        failed |= test_result == TEST_FAILED;
+    }
+
+    if (!found) {
+        printUsage();
+        return 2;
+    }
+
+    return failed ? TEST_FAILED : passed ? TEST_PASSED : TEST_SKIPPED;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file test_status_json.cpp
+ * @brief The fixed-schema status writer against the Json::FastWriter output it replaced.
+ * @version 1.0
+ * @date 2024-04-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "tests.hpp"
+#include "wire_protocol.hpp"
+
+using namespace tcp_communication;
+
+namespace {
+
+// Status serialization as done before json_protocol::writeStatus
+void encodeStatusFastWriter(const StatusMessage &status, string &out) {
+    Json::Value json;
+
+    json["states"]     = status.states;
+    json["motor_pos"]  = status.motor_pos;
+    json["motor_vel"]  = status.motor_vel;
+    json["motor_cur"]  = status.motor_cur;
+    json["finger_pos"] = status.finger_pos;
+    json["voltage"]    = status.voltage;
+
+    Json::FastWriter writer;
+    out = writer.write(json);
+}
+
+} // namespace
+
+TestResult testStatusJson() {
+    // Every digit count and sign of both value types, plus the extremes
+    const int16_t  signed_values[]   = {INT16_MIN, -10000, -1259, -100, -99, -10, -9, -1, 0, 1, 9, 10, 99, 100, 9999, 10000, INT16_MAX};
+    const uint16_t unsigned_values[] = {0, 1, 9, 10, 99, 100, 999, 1000, 9999, 10000, 65535};
+
+    string expected, actual;
+    StatusMessage status;
+
+    for (int16_t s : signed_values) {
+        for (uint16_t u : unsigned_values) {
+            status.motor_pos  = s;
+            status.motor_vel  = -s;
+            status.motor_cur  = s;
+            status.finger_pos = u;
+            status.states     = u;
+            status.voltage    = 65535 - u;
+
+            encodeStatusFastWriter(status, expected);
+            json_protocol::encodeStatus(status, actual);
+
+            if (expected != actual) {
+                printf("Status serializer mismatch:\n  expected %s  actual   %s", expected.c_str(), actual.c_str());
+                return TEST_FAILED;
+            }
+        }
+    }
+
+    return TEST_PASSED;
+}
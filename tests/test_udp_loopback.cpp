@@ -0,0 +1,149 @@
+/**
+ * @file test_udp_loopback.cpp
+ * @brief Multicast status publisher over loopback: every frame arrives, in order, at the paced rate.
+ * @version 1.0
+ * @date 2024-04-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "tests.hpp"
+#include "udp_publisher.hpp"
+
+#include <thread>
+
+using namespace tcp_communication;
+namespace ip = boost::asio::ip;
+
+namespace {
+
+const char *kGroup   = "239.255.42.2";
+const uint16_t kPort = 18422;
+
+const uint32_t kFrames = 5000;
+const uint32_t kRateHz = 10000; /**< 200 times the poll rate of one slave */
+
+// Receives status frames and checks their sequence
+class Listener {
+public:
+    Listener() : socket_(io_service_) {}
+    ~Listener() {stop();}
+
+    bool open() {
+        boost::system::error_code ec;
+
+        socket_.open(ip::udp::v4(), ec);
+        if (!ec) socket_.set_option(ip::udp::socket::reuse_address(true), ec);
+        if (!ec) socket_.set_option(boost::asio::socket_base::receive_buffer_size(1 << 20), ec);
+        if (!ec) socket_.bind(ip::udp::endpoint(ip::address_v4::any(), kPort), ec);
+        if (!ec) socket_.set_option(ip::multicast::join_group(ip::address_v4::from_string(kGroup),
+                                                              ip::address_v4::loopback()), ec);
+        if (ec) {
+            printf("No multicast on loopback: %s\n", ec.message().c_str());
+            return false;
+        }
+
+        thread_ = std::thread([this] () {receive();});
+        return true;
+    }
+
+    void stop() {
+        boost::system::error_code ec;
+        socket_.shutdown(ip::udp::socket::shutdown_both, ec);
+        socket_.close(ec);
+
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // Waits until 'frames' arrived or nothing arrived for 100 ms
+    void waitFor(uint64_t frames) {
+        uint64_t last = 0;
+
+        while (received_ < frames) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (received_ == last) {
+                break;
+            }
+            last = received_;
+        }
+    }
+
+    uint64_t getReceived() const {return received_;}
+    uint64_t getOutOfOrder() const {return out_of_order_;}
+
+private:
+    void receive() {
+        char data[64];
+        StatusMessage status;
+
+        while (true) {
+            boost::system::error_code ec;
+            size_t size = socket_.receive(boost::asio::buffer(data), 0, ec);
+
+            if (ec) {
+                return;
+            }
+
+            if (binary_protocol::decodeStatus(data, data + size, status)) {
+                if (status.sequence != received_) {
+                    out_of_order_++;
+                }
+                received_++;
+            }
+        }
+    }
+
+    boost::asio::io_service io_service_;
+    ip::udp::socket socket_;
+    std::thread thread_;
+
+    atomic<uint64_t> received_{0};
+    atomic<uint64_t> out_of_order_{0};
+};
+
+} // namespace
+
+TestResult testUdpLoopback() {
+    Listener listener;
+
+    if (!listener.open()) {
+        return TEST_SKIPPED;
+    }
+
+    UdpStatusPublisher publisher;
+
+    if (!publisher.open(kGroup, kPort, 1, "127.0.0.1")) {
+        return TEST_FAILED;
+    }
+
+    StatusMessage status;
+    status.slave = 1;
+
+    auto period     = std::chrono::nanoseconds(1000000000 / kRateHz);
+    auto time_start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < kFrames; i++) {
+        std::this_thread::sleep_until(time_start + i * period);
+        status.sequence = i;
+        publisher.publish(status);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - time_start;
+    listener.waitFor(kFrames);
+
+    const double rate     = kFrames / elapsed.count();
+    const uint64_t lost   = kFrames - listener.getReceived();
+    const uint64_t dropped = publisher.getStats().dropped;
+
+    printf("%u frames at %.0f frames/s: %llu lost, %llu dropped, %llu out of order\n", kFrames, rate,
+           (unsigned long long) lost, (unsigned long long) dropped, (unsigned long long) listener.getOutOfOrder());
+
+    // Pacing only ever catches up, so a low rate means publish() itself is too slow
+    if (rate < 0.9 * kRateHz || lost != 0 || dropped != 0 || listener.getOutOfOrder() != 0) {
+        return TEST_FAILED;
+    }
+
+    return TEST_PASSED;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file tests.hpp
+ * @brief Correctness tests run by ctest, one add_test per test.
+ * @version 1.0
+ * @date 2024-04-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef TESTS_HPP
+#define TESTS_HPP
+
+#include <cstdio>
+#include <cstdint>
+
+using namespace std;
+
+enum TestResult {
+    TEST_PASSED  = 0,
+    TEST_FAILED  = 1,
+    TEST_SKIPPED = 77, /**< SKIP_RETURN_CODE of the ctest tests, e.g. no multicast on the host */
+};
+
+TestResult testStatusJson();
+TestResult testUdpLoopback();
+
+#endif // TESTS_HPP